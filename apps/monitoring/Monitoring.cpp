@@ -29,6 +29,7 @@
 
 #include "AmConfigReader.h"
 #include "AmEventDispatcher.h"
+#include "AmLatencyStats.h"
 
 #include "log.h"
 
@@ -137,6 +138,10 @@ void Monitor::invoke(const string& method,
     clear(args,ret);
   } else if(method == "eraseByFilter"){
     listByFilter(args,ret, true);
+  } else if(method == "getLatencyStats"){
+    AmLatencyStats::getStats(ret);
+  } else if(method == "getThreadStats"){
+    AmThread::getThreadStats(ret);
   } else if(method == "_list"){ 
     ret.push(AmArg("log"));
     ret.push(AmArg("set"));
@@ -161,6 +166,8 @@ void Monitor::invoke(const string& method,
     ret.push(AmArg("listByRegex"));
     ret.push(AmArg("listFinished"));
     ret.push(AmArg("listActive"));
+    ret.push(AmArg("getLatencyStats"));
+    ret.push(AmArg("getThreadStats"));
   } else
     throw AmDynInvoke::NotImplemented(method);
 }
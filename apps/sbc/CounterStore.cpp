@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2012-2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "CounterStore.h"
+#include "sip/hash.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+CounterEntry* CounterBucket::get(const string& key, bool rate_limit,
+				 unsigned int time_base_ms, long int now)
+{
+  CounterEntry* e = NULL;
+
+  lock();
+  value_map::iterator it = elmts.find(key);
+  if(it != elmts.end()) {
+    e = it->second;
+  }
+  else {
+    e = new CounterEntry(time_base_ms);
+    insert(key, e);
+  }
+
+  if(rate_limit)
+    e->has_rate_limit = true;
+  e->last_used = now;
+  inc_ref(e);
+  unlock();
+
+  return e;
+}
+
+void CounterBucket::gbc(long int now)
+{
+  lock();
+  for(value_map::iterator it = elmts.begin(); it != elmts.end();) {
+    CounterEntry* e = it->second;
+    // entries which have been looked up in the last
+    // seconds might still be in use without a count
+    if(!e->value.get() &&
+       (now - e->last_used > COUNTER_STORE_IDLE_TIMEOUT)) {
+      value_map::iterator del_it = it++;
+      elmts.erase(del_it);
+      allocator().dispose(e);
+      continue;
+    }
+    it++;
+  }
+  unlock();
+}
+
+void CounterBucket::getCounters(AmArg& counters, AmArg& limiters)
+{
+  lock();
+  for(value_map::iterator it = elmts.begin(); it != elmts.end(); it++) {
+    CounterEntry* e = it->second;
+    if(e->has_rate_limit)
+      limiters[it->first] = e->rate_limit.getCounter();
+    else
+      counters[it->first] = (int)e->value.get();
+  }
+  unlock();
+}
+
+_CounterStore::_CounterStore()
+  : counters_ht(COUNTER_STORE_TABLE_ENTRIES),
+    export_interval(0),
+    stopped(false),
+    app_timer(AmAppTimer::instance())
+{
+}
+
+CounterBucket* _CounterStore::getBucket(const string& key)
+{
+  return counters_ht[hashlittle(key.c_str(),key.length(),0)];
+}
+
+CounterEntry* _CounterStore::getEntry(const string& key, bool rate_limit,
+				      unsigned int time_base_ms)
+{
+  return getBucket(key)->get(key, rate_limit, time_base_ms,
+			     app_timer->unix_clock.get());
+}
+
+bool _CounterStore::incIfBelow(const string& key, unsigned int limit,
+			       unsigned int& value)
+{
+  CounterEntry* e = getEntry(key);
+  bool res = e->value.inc_if_below(limit, value);
+  dec_ref(e);
+  return res;
+}
+
+unsigned int _CounterStore::inc(const string& key)
+{
+  CounterEntry* e = getEntry(key);
+  unsigned int res = e->value.inc();
+  dec_ref(e);
+  return res;
+}
+
+unsigned int _CounterStore::dec(const string& key)
+{
+  CounterEntry* e = getEntry(key);
+
+  unsigned int old_val;
+  do {
+    old_val = e->value.get();
+    if(!old_val) break;
+  } while(!e->value.cas(old_val, old_val-1));
+
+  dec_ref(e);
+  return old_val ? old_val-1 : 0;
+}
+
+unsigned int _CounterStore::get(const string& key)
+{
+  CounterEntry* e = getEntry(key);
+  unsigned int res = e->value.get();
+  dec_ref(e);
+  return res;
+}
+
+bool _CounterStore::limit(const string& key, unsigned int rate, unsigned int peak,
+			  unsigned int time_base_ms, unsigned int size)
+{
+  CounterEntry* e = getEntry(key, true, time_base_ms);
+  bool res = e->rate_limit.limit(rate, peak, size);
+  dec_ref(e);
+  return res;
+}
+
+void _CounterStore::getCounters(AmArg& counters, AmArg& limiters)
+{
+  counters.assertStruct();
+  limiters.assertStruct();
+  for(unsigned long i=0; i<COUNTER_STORE_TABLE_ENTRIES; i++)
+    counters_ht[i]->getCounters(counters, limiters);
+}
+
+void _CounterStore::setExport(const string& file, unsigned int interval)
+{
+  export_file = file;
+  export_interval = interval;
+}
+
+bool _CounterStore::exportCounters()
+{
+  AmArg counters, limiters;
+  getCounters(counters, limiters);
+
+  // write to a temporary file first, so that readers
+  // never see a partially written export
+  string tmp_file = export_file + ".tmp";
+  FILE* f = fopen(tmp_file.c_str(), "w");
+  if(!f) {
+    ERROR("opening counters export file '%s': %s\n",
+	  tmp_file.c_str(), strerror(errno));
+    return false;
+  }
+
+  for(AmArg::ValueStruct::const_iterator it = counters.begin();
+      it != counters.end(); it++) {
+    fprintf(f, "counter %s %d\n", it->first.c_str(), it->second.asInt());
+  }
+  for(AmArg::ValueStruct::const_iterator it = limiters.begin();
+      it != limiters.end(); it++) {
+    fprintf(f, "limiter %s %d\n", it->first.c_str(), it->second.asInt());
+  }
+
+  if(fclose(f) || rename(tmp_file.c_str(), export_file.c_str())) {
+    ERROR("writing counters export file '%s': %s\n",
+	  export_file.c_str(), strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void _CounterStore::run()
+{
+  long int last_export = app_timer->unix_clock.get();
+  unsigned long gbc_bucket_id = 0;
+
+  // one bucket per 10ms: all buckets are checked every ~10s
+  while(!stopped.wait_for_to(10)) {
+    long int now = app_timer->unix_clock.get();
+
+    counters_ht[gbc_bucket_id]->gbc(now);
+    gbc_bucket_id = (gbc_bucket_id+1) % COUNTER_STORE_TABLE_ENTRIES;
+
+    if(export_interval && !export_file.empty() &&
+       (now - last_export >= (long int)export_interval)) {
+      exportCounters();
+      last_export = now;
+    }
+  }
+}
+
+void _CounterStore::on_stop()
+{
+  stopped.set(true);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2012-2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _CounterStore_h_
+#define _CounterStore_h_
+
+#include "singleton.h"
+#include "hash_table.h"
+#include "atomic_types.h"
+#include "AmArg.h"
+#include "AmAppTimer.h"
+#include "RateLimit.h"
+
+#include <string>
+using std::string;
+
+#define COUNTER_STORE_TABLE_ENTRIES     1024
+#define COUNTER_STORE_IDLE_TIMEOUT      60  /* seconds */
+#define COUNTER_STORE_DEFAULT_TIME_BASE 1000 /* ms */
+
+/**
+ * Entry of the counter store: a counter and a token bucket.
+ * Once looked up, all operations are done with atomic
+ * instructions on the entry.
+ */
+class CounterEntry
+  : public atomic_ref_cnt
+{
+  friend class CounterBucket;
+
+  // unix time of the last lookup (protected by the bucket lock)
+  long int last_used;
+
+public:
+  atomic_int   value;
+  DynRateLimit rate_limit;
+  bool         has_rate_limit;
+
+  CounterEntry(unsigned int time_base_ms)
+    : last_used(0), rate_limit(time_base_ms), has_rate_limit(false) {}
+};
+
+class CounterBucket
+  : public ht_map_bucket<string,CounterEntry,ht_ref_cnt<CounterEntry> >
+{
+public:
+  CounterBucket(unsigned long id)
+    : ht_map_bucket<string,CounterEntry,ht_ref_cnt<CounterEntry> >(id) {}
+
+  /** returns the entry with a reference held, creates it if needed */
+  CounterEntry* get(const string& key, bool rate_limit,
+		    unsigned int time_base_ms, long int now);
+
+  /** remove unused entries */
+  void gbc(long int now);
+
+  void getCounters(AmArg& counters, AmArg& limiters);
+};
+
+/**
+ * Store for counters and rate limiters keyed by arbitrary strings
+ * (e.g. uuid, source IP or trunk evaluated from the call profile).
+ *
+ * The keys are spread over COUNTER_STORE_TABLE_ENTRIES buckets, each with
+ * its own lock which is only held for the lookup (so every operation
+ * takes a bucket lock, but not a common one). Counting and limiting
+ * is done with atomic operations on the entry, so that call setups
+ * on different cores do not serialize on a common lock.
+ *
+ * Entries not used for COUNTER_STORE_IDLE_TIMEOUT seconds with a counter
+ * of 0 are removed by the store's thread, which can also periodically
+ * export all counters to a file.
+ */
+class _CounterStore
+  : public AmThread
+{
+  hash_table<CounterBucket> counters_ht;
+
+  string       export_file;
+  unsigned int export_interval;
+
+  AmCondition<bool> stopped;
+
+  // cached to avoid the singleton's lock
+  AmAppTimer* app_timer;
+
+  CounterBucket* getBucket(const string& key);
+  CounterEntry* getEntry(const string& key, bool rate_limit = false,
+			 unsigned int time_base_ms = COUNTER_STORE_DEFAULT_TIME_BASE);
+
+  bool exportCounters();
+
+protected:
+  _CounterStore();
+  ~_CounterStore() {}
+
+  void dispose() { stop(); }
+
+  /* AmThread interface */
+  void run();
+  void on_stop();
+
+public:
+  /** export_interval: seconds, 0 to disable the export */
+  void setExport(const string& file, unsigned int interval);
+
+  /**
+   * Increment the counter if it is below limit.
+   * Returns false (limit reached) otherwise;
+   * value is set to the counter value.
+   */
+  bool incIfBelow(const string& key, unsigned int limit, unsigned int& value);
+
+  /** Increment the counter, returns the new value. */
+  unsigned int inc(const string& key);
+
+  /** Decrement the counter (not below 0), returns the new value. */
+  unsigned int dec(const string& key);
+
+  /** Get the counter value. */
+  unsigned int get(const string& key);
+
+  /**
+   * Token bucket (see DynRateLimit):
+   * rate, peak: units/time_base_ms
+   * returns true if 'size' should be dropped
+   */
+  bool limit(const string& key, unsigned int rate, unsigned int peak,
+	     unsigned int time_base_ms = COUNTER_STORE_DEFAULT_TIME_BASE,
+	     unsigned int size = 1);
+
+  /** Get all counters and rate limiters (remaining units) */
+  void getCounters(AmArg& counters, AmArg& limiters);
+};
+
+typedef singleton<_CounterStore> CounterStore;
+
+#endif
@@ -3,6 +3,9 @@
 
 #include "CallLeg.h"
 #include "sbc_events.h"
+#include "SBCCallControlAPI.h"
+
+#include <sys/time.h>
 
 class SBCCallLeg;
 struct SBCCallProfile;
@@ -101,4 +104,119 @@ class ExtendedCCInterface
 
 };
 
+/** parameters common to the typed call control hooks */
+struct CCCallParams
+{
+  const string& cc_name;         // cc namespace
+  const string& ltag;            // local tag of the A leg
+  SBCCallProfile* call_profile;
+
+  const struct timeval& start_ts;
+  const struct timeval& connect_ts;
+  const struct timeval& end_ts;
+
+  CCCallParams(const string& _cc_name, const string& _ltag,
+	       SBCCallProfile* _call_profile,
+	       const struct timeval& _start_ts,
+	       const struct timeval& _connect_ts,
+	       const struct timeval& _end_ts)
+    : cc_name(_cc_name), ltag(_ltag), call_profile(_call_profile),
+      start_ts(_start_ts), connect_ts(_connect_ts), end_ts(_end_ts) { }
+};
+
+struct CCStartParams : public CCCallParams
+{
+  const AmSipRequest& req;                 // initial INVITE
+  const map<string, string>& values;       // cc values from the call profile
+  int timer_id;                            // current call timer ID
+
+  CCStartParams(const CCCallParams& p, const AmSipRequest& _req,
+		const map<string, string>& _values, int _timer_id)
+    : CCCallParams(p), req(_req), values(_values), timer_id(_timer_id) { }
+};
+
+struct CCConnectParams : public CCCallParams
+{
+  const string& other_ltag;
+
+  CCConnectParams(const CCCallParams& p, const string& _other_ltag)
+    : CCCallParams(p), other_ltag(_other_ltag) { }
+};
+
+typedef CCCallParams CCEndParams;
+
+/** actions requested by a call control module on call start */
+struct CCStartResult
+{
+  enum Action { Continue = 0, Drop, Refuse };
+
+  Action action;
+
+  unsigned int refuse_code;
+  string refuse_reason;
+  string refuse_headers;   // CRLF terminated
+
+  vector<double> call_timers;
+
+  CCStartResult() : action(Continue), refuse_code(0) { }
+
+  void refuse(unsigned int code, const string& reason) {
+    action = Refuse;
+    refuse_code = code;
+    refuse_reason = reason;
+  }
+
+  void drop() { action = Drop; }
+
+  void setCallTimer(double timeout) { call_timers.push_back(timeout); }
+
+  /** convert into the DI return value of 'start' (see SBCCallControlAPI.h) */
+  void toDIResult(AmArg& res) const {
+    for (vector<double>::const_iterator it = call_timers.begin();
+	 it != call_timers.end(); it++) {
+      res.push(AmArg());
+      res.back()[SBC_CC_ACTION] = SBC_CC_SET_CALL_TIMER_ACTION;
+      res.back()[SBC_CC_TIMER_TIMEOUT] = *it;
+    }
+
+    if (action == Drop) {
+      res.push(AmArg());
+      res.back()[SBC_CC_ACTION] = SBC_CC_DROP_ACTION;
+    }
+    else if (action == Refuse) {
+      res.push(AmArg());
+      AmArg& res_cmd = res.back();
+      res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
+      res_cmd[SBC_CC_REFUSE_CODE] = (int)refuse_code;
+      res_cmd[SBC_CC_REFUSE_REASON] = refuse_reason;
+      if (!refuse_headers.empty()) {
+	vector<string> hdrs = explode(refuse_headers, "\r\n");
+	for (vector<string>::iterator h = hdrs.begin(); h != hdrs.end(); h++)
+	  res_cmd[SBC_CC_REFUSE_HEADERS].push(*h);
+      }
+    }
+  }
+};
+
+/**
+ * Typed version of the call control "start", "connect" and "end"
+ * DI functions. A CC module offers it by returning an AmObject
+ * implementing this interface from the DI function
+ * "getTypedInterfaceHandler"; the SBC then calls these methods
+ * directly instead of packing the parameters into AmArgs.
+ *
+ * Modules should still implement the DI functions for other users
+ * of the CC API.
+ */
+class TypedCCInterface
+{
+  protected:
+    ~TypedCCInterface() { }
+
+  public:
+    virtual void start(const CCStartParams& params, CCStartResult& res) { }
+    virtual void connect(const CCConnectParams& params) { }
+    virtual void end(const CCEndParams& params) { }
+};
+
 #endif
@@ -3,37 +3,54 @@
 
 #define min(a,b) ((a) < (b) ? (a) : (b))
 
+static inline u_int32_t wall_clock()
+{
+  // avoids the singleton's mutex on every call
+  static AmAppTimer* app_timer = AmAppTimer::instance();
+  return app_timer->wall_clock;
+}
+
 DynRateLimit::DynRateLimit(unsigned int time_base_ms)
-  : last_update(0), counter(0)
 {
   // wall_clock has a resolution of 20ms
   time_base = time_base_ms / 20;
 }
 
+DynRateLimit::DynRateLimit(const DynRateLimit& rl)
+  : time_base(rl.time_base)
+{
+  state.set(const_cast<DynRateLimit&>(rl).state.get());
+}
+
 bool DynRateLimit::limit(unsigned int rate, unsigned int peak, 
 			 unsigned int size)
 {
-  lock();
+  unsigned long long old_state, new_state;
+  bool res;
 
-  if(AmAppTimer::instance()->wall_clock - last_update 
-     > time_base) {
+  do {
+    old_state = state.get();
 
-    update_limit(rate,peak);
-  }
+    u_int32_t last_update = (u_int32_t)(old_state >> 32);
+    int counter = (int)(u_int32_t)old_state;
 
-  if(counter <= 0) {
-    unlock();
-    return true; // limit reached
-  }
+    u_int32_t now = wall_clock();
+    if(now - last_update > time_base) {
+      counter = min((int)peak, counter+(int)rate);
+      last_update = now;
+    }
 
-  counter -= size;
-  unlock();
+    if(counter <= 0) {
+      res = true; // limit reached
+    }
+    else {
+      counter -= size;
+      res = false; // do not limit
+    }
 
-  return false; // do not limit
-}
+    new_state = ((unsigned long long)last_update << 32) | (u_int32_t)counter;
 
-void DynRateLimit::update_limit(int rate, int peak)
-{
-  counter = min(peak, counter+rate);
-  last_update = AmAppTimer::instance()->wall_clock;
+  } while((new_state != old_state) && !state.cas(old_state, new_state));
+
+  return res;
 }
@@ -5,19 +5,22 @@
 #include "atomic_types.h"
 #include <sys/types.h>
 
+/**
+ * Token bucket. The bucket state (last update, counter) is kept
+ * in one 64 bit word and updated with compare-and-swap, so that
+ * limit() does not need any lock.
+ */
 class DynRateLimit
-  : protected AmMutex
 {
-  u_int32_t last_update;
-  int counter;
+  // last_update (high 32 bits) | counter (low 32 bits)
+  atomic_int64 state;
 
   unsigned int time_base;
 
-  void update_limit(int rate, int peak);
-
 public:
   // time_base_ms: milliseconds
   DynRateLimit(unsigned int time_base_ms);
+  DynRateLimit(const DynRateLimit& rl);
 
   virtual ~DynRateLimit() {}
 
@@ -31,7 +34,10 @@ public:
   bool limit(unsigned int rate, unsigned int peak, unsigned int size);
 
   /** Get last update timestamp (wheeltimer::wallclock ticks) */
-  u_int32_t getLastUpdate() { return last_update; }
+  u_int32_t getLastUpdate() { return (u_int32_t)(state.get() >> 32); }
+
+  /** Get current counter (units left, may be negative) */
+  int getCounter() { return (int)(u_int32_t)state.get(); }
 };
 
 class RateLimit
@@ -107,6 +107,26 @@ void AorBucket::gbc(RegCacheStorageHandler* h, long int now,
   }
 }
 
+void AorBucket::getBindings(list<RegCacheBinding>& bindings) const
+{
+  for(value_map::const_iterator it = elmts.begin(); it != elmts.end(); it++) {
+
+    const AorEntry* aor_e = it->second;
+    if(!aor_e) continue;
+
+    for(AorEntry::const_iterator reg_it = aor_e->begin();
+	reg_it != aor_e->end(); reg_it++) {
+
+      const RegBinding* binding = reg_it->second;
+      if(!binding) continue;
+
+      bindings.push_back(RegCacheBinding());
+      bindings.back().reg_expire = binding->reg_expire;
+      bindings.back().alias_entry.alias = binding->alias;
+    }
+  }
+}
+
 AliasEntry* AliasBucket::getContact(const string& alias)
 {
   value_map::iterator it = find(alias);
@@ -243,6 +263,9 @@ void _RegisterCache::run()
     gbc(gbc_bucket_id);
     gbc_bucket_id = (gbc_bucket_id+1);
     gbc_bucket_id &= (REG_CACHE_TABLE_ENTRIES-1);
+    if(!gbc_bucket_id && storage_handler.get()) {
+      storage_handler->onGbcCycle(AmAppTimer::instance()->unix_clock.get());
+    }
     nanosleep(&tick,&rem);
   }  
 }
@@ -369,6 +392,12 @@ void _RegisterCache::removeAliasUATimer(AliasEntry* alias_e)
 
 void _RegisterCache::update(const string& alias, long int reg_expires,
 			    const AliasEntry& alias_update)
+{
+  update(alias,reg_expires,alias_update,true);
+}
+
+void _RegisterCache::update(const string& alias, long int reg_expires,
+			    const AliasEntry& alias_update, bool notify)
 {
   string uri = alias_update.contact_uri;
   string canon_aor = alias_update.aor;
@@ -456,7 +485,7 @@ void _RegisterCache::update(const string& alias, long int reg_expires,
   }
 #endif
   
-  if(storage_handler.get())
+  if(notify && storage_handler.get())
     storage_handler->onUpdate(canon_aor,alias,reg_expires,*alias_e);
 
   alias_bucket->unlock();
@@ -778,6 +807,39 @@ bool _RegisterCache::findAliasEntry(const string& alias, AliasEntry& alias_entry
   return res;
 }
 
+void _RegisterCache::getBindings(list<RegCacheBinding>& bindings)
+{
+  for(unsigned int i=0; i < REG_CACHE_TABLE_ENTRIES; i++) {
+
+    list<RegCacheBinding> bucket_bindings;
+    AorBucket* bucket = reg_cache_ht.get_bucket(i);
+    bucket->lock();
+    bucket->getBindings(bucket_bindings);
+
+    // same locking order as update(): AoR bucket, then alias bucket
+    for(list<RegCacheBinding>::iterator it = bucket_bindings.begin();
+	it != bucket_bindings.end();) {
+
+      if(!findAliasEntry(it->alias_entry.alias,it->alias_entry)) {
+	bucket_bindings.erase(it++);
+	continue;
+      }
+      it++;
+    }
+    bucket->unlock();
+
+    bindings.splice(bindings.end(),bucket_bindings);
+  }
+}
+
+void _RegisterCache::loadBindings(const list<RegCacheBinding>& bindings)
+{
+  for(list<RegCacheBinding>::const_iterator it = bindings.begin();
+      it != bindings.end(); it++) {
+    update(it->alias_entry.alias,it->reg_expire,it->alias_entry,false);
+  }
+}
+
 bool _RegisterCache::findAEByContact(const string& contact_uri,
 				     const string& remote_ip,
 				     unsigned short remote_port,
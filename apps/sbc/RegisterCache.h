@@ -80,6 +80,8 @@ struct AliasEntry
 
 struct RegCacheStorageHandler 
 {
+  virtual ~RegCacheStorageHandler() {}
+
   virtual void onDelete(const string& aor, const string& uri, 
 			const string& alias) {}
 
@@ -87,6 +89,24 @@ struct RegCacheStorageHandler
 			long int expires, const AliasEntry& alias_update) {}
 
   virtual void onUpdate(const string& alias, long int ua_expires) {}
+
+  /* called from the register cache thread after each GBC cycle */
+  virtual void onGbcCycle(long int now) {}
+};
+
+/**
+ * Complete binding, as needed to rebuild the
+ * cache (i.e. from a persistent snapshot)
+ */
+struct RegCacheBinding
+{
+  // registrar side expiration (see RegBinding)
+  long int   reg_expire;
+  AliasEntry alias_entry;
+
+  RegCacheBinding()
+    : reg_expire(0)
+  {}
 };
 
 /**
@@ -110,6 +130,7 @@ public:
   /* Maintenance stuff */
 
   void gbc(RegCacheStorageHandler* h, long int now, list<string>& alias_list);
+  void getBindings(list<RegCacheBinding>& bindings) const;
   void dump_elmt(const string& aor, const AorEntry* p_aor_entry) const;
 };
 
@@ -208,6 +229,9 @@ class _RegisterCache
   void gbc(unsigned int bucket_id);
   void removeAlias(const string& alias, bool generate_event);
 
+  void update(const string& alias, long int reg_expires,
+	      const AliasEntry& alias_update, bool notify);
+
 protected:
   _RegisterCache();
   ~_RegisterCache();
@@ -351,6 +375,21 @@ public:
 			const AmSipRequest& req,
                         msg_logger *logger = NULL);
 
+  /**
+   * Retrieve a copy of all bindings (persistent snapshot).
+   *
+   * Note: this function locks and unlocks
+   *       each contact cache bucket and
+   *       the alias map buckets.
+   */
+  void getBindings(list<RegCacheBinding>& bindings);
+
+  /**
+   * Bulk-insert bindings (i.e. on startup from a persistent snapshot).
+   * The storage handler is not notified.
+   */
+  void loadBindings(const list<RegCacheBinding>& bindings);
+
   /**
    * Statistics
    */
@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2012-2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "RegisterCacheStorage.h"
+#include "log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <map>
+using std::map;
+
+#define REG_CACHE_SNAPSHOT_MAGIC   "SEMSRCS1"
+#define REG_CACHE_SNAPSHOT_VERSION 1
+
+/*
+ * Record format (journal & snapshot body):
+ *  u32 length (of the following data)
+ *  u8  type
+ *  ... type specific fields
+ *
+ * Integers are stored in host byte order: the files
+ * are not meant to be moved to another architecture.
+ */
+enum RegCacheRecordType {
+  RCR_UPDATE = 1,
+  RCR_DELETE,
+  RCR_UA_EXPIRES
+};
+
+struct RegCacheSnapshotHdr
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t records;
+  int64_t  created;
+  uint64_t length;  // body length (after the header)
+};
+
+template<class T>
+static void put_int(string& buf, T v)
+{
+  buf.append((const char*)&v, sizeof(T));
+}
+
+static void put_str(string& buf, const string& s)
+{
+  put_int<uint32_t>(buf, s.length());
+  buf.append(s);
+}
+
+static void put_record(string& buf, const string& rec)
+{
+  put_int<uint32_t>(buf, rec.length());
+  buf.append(rec);
+}
+
+static void encode_update(string& buf, long int reg_expire,
+			  const string& aor, const string& alias,
+			  const AliasEntry& ae)
+{
+  string rec;
+  put_int<uint8_t>(rec, RCR_UPDATE);
+  put_int<int64_t>(rec, reg_expire);
+  put_int<int64_t>(rec, ae.ua_expire);
+  put_int<uint16_t>(rec, ae.source_port);
+  put_int<uint16_t>(rec, ae.local_if);
+  put_str(rec, aor);
+  put_str(rec, ae.contact_uri);
+  put_str(rec, alias);
+  put_str(rec, ae.source_ip);
+  put_str(rec, ae.trsp);
+  put_str(rec, ae.remote_ua);
+  put_record(buf, rec);
+}
+
+class RecordReader
+{
+  const char* p;
+  const char* end;
+  bool ok;
+
+public:
+  RecordReader(const char* p, size_t len)
+    : p(p), end(p + len), ok(true)
+  {}
+
+  template<class T>
+  T get() {
+    T v = T();
+    if(!ok || (size_t)(end - p) < sizeof(T)) {
+      ok = false;
+      return v;
+    }
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+  }
+
+  string get_str() {
+    uint32_t len = get<uint32_t>();
+    if(!ok || (size_t)(end - p) < len) {
+      ok = false;
+      return string();
+    }
+    string s(p, len);
+    p += len;
+    return s;
+  }
+
+  bool good() const { return ok; }
+};
+
+typedef map<string,RegCacheBinding> RegCacheBindingMap;
+
+static bool replay_record(const char* data, size_t len,
+			  RegCacheBindingMap& bindings)
+{
+  RecordReader r(data, len);
+
+  switch(r.get<uint8_t>()) {
+  case RCR_UPDATE: {
+    RegCacheBinding b;
+    b.reg_expire = r.get<int64_t>();
+    b.alias_entry.ua_expire = r.get<int64_t>();
+    b.alias_entry.source_port = r.get<uint16_t>();
+    b.alias_entry.local_if = r.get<uint16_t>();
+    b.alias_entry.aor = r.get_str();
+    b.alias_entry.contact_uri = r.get_str();
+    b.alias_entry.alias = r.get_str();
+    b.alias_entry.source_ip = r.get_str();
+    b.alias_entry.trsp = r.get_str();
+    b.alias_entry.remote_ua = r.get_str();
+    if(!r.good()) return false;
+    bindings[b.alias_entry.alias] = b;
+  } break;
+
+  case RCR_DELETE: {
+    r.get_str(); // aor
+    r.get_str(); // contact-uri
+    string alias = r.get_str();
+    if(!r.good()) return false;
+    bindings.erase(alias);
+  } break;
+
+  case RCR_UA_EXPIRES: {
+    long int ua_expire = r.get<int64_t>();
+    string alias = r.get_str();
+    if(!r.good()) return false;
+    RegCacheBindingMap::iterator it = bindings.find(alias);
+    if(it != bindings.end())
+      it->second.alias_entry.ua_expire = ua_expire;
+  } break;
+
+  default:
+    return false;
+  }
+
+  return true;
+}
+
+static void replay_records(const string& path, const char* data, size_t len,
+			   RegCacheBindingMap& bindings)
+{
+  const char* p = data;
+  const char* end = data + len;
+
+  while(p < end) {
+    uint32_t rec_len;
+    if((size_t)(end - p) < sizeof(rec_len)) {
+      WARN("%s: truncated record (%u bytes left)\n",
+	   path.c_str(), (unsigned int)(end - p));
+      return;
+    }
+    memcpy(&rec_len, p, sizeof(rec_len));
+    p += sizeof(rec_len);
+
+    if((size_t)(end - p) < rec_len) {
+      // torn write at the end of the journal
+      WARN("%s: truncated record (%u bytes left)\n",
+	   path.c_str(), (unsigned int)(end - p));
+      return;
+    }
+
+    if(!replay_record(p, rec_len, bindings)) {
+      WARN("%s: malformed record at offset %lu, stopping here\n",
+	   path.c_str(), (unsigned long)(p - data));
+      return;
+    }
+    p += rec_len;
+  }
+}
+
+/**
+ * Map a file read-only.
+ * Returns 0 if the file does not exist or is empty (*data == NULL).
+ */
+static int map_file(const string& path, void** data, size_t* len)
+{
+  *data = NULL;
+  *len = 0;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    if(errno == ENOENT)
+      return 0;
+    ERROR("open(%s): %s\n", path.c_str(), strerror(errno));
+    return -1;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    ERROR("fstat(%s): %s\n", path.c_str(), strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  if(!st.st_size) {
+    close(fd);
+    return 0;
+  }
+
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(p == MAP_FAILED) {
+    ERROR("mmap(%s): %s\n", path.c_str(), strerror(errno));
+    return -1;
+  }
+
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+  *data = p;
+  *len = st.st_size;
+  return 0;
+}
+
+static int load_snapshot(const string& path, RegCacheBindingMap& bindings)
+{
+  void* data;
+  size_t len;
+
+  if(map_file(path, &data, &len) < 0)
+    return -1;
+
+  if(!data)
+    return 0;
+
+  const RegCacheSnapshotHdr* hdr = (const RegCacheSnapshotHdr*)data;
+  if((len < sizeof(RegCacheSnapshotHdr)) ||
+     memcmp(hdr->magic, REG_CACHE_SNAPSHOT_MAGIC, sizeof(hdr->magic)) ||
+     (hdr->version != REG_CACHE_SNAPSHOT_VERSION) ||
+     (hdr->length != len - sizeof(RegCacheSnapshotHdr))) {
+    ERROR("%s: invalid or incomplete register cache snapshot, ignoring it\n",
+	  path.c_str());
+    munmap(data, len);
+    return 0;
+  }
+
+  DBG("%s: %u records (created @%li)\n", path.c_str(),
+      hdr->records, (long)hdr->created);
+
+  replay_records(path, (const char*)data + sizeof(RegCacheSnapshotHdr),
+		 hdr->length, bindings);
+
+  munmap(data, len);
+  return 0;
+}
+
+static int load_journal(const string& path, RegCacheBindingMap& bindings)
+{
+  void* data;
+  size_t len;
+
+  if(map_file(path, &data, &len) < 0)
+    return -1;
+
+  if(!data)
+    return 0;
+
+  replay_records(path, (const char*)data, len, bindings);
+
+  munmap(data, len);
+  return 0;
+}
+
+RegCacheStorage::RegCacheStorage(const string& dir,
+				 unsigned int snapshot_interval)
+  : journal_path(dir + "/regcache.journal"),
+    old_journal_path(dir + "/regcache.journal.old"),
+    snapshot_path(dir + "/regcache.snapshot"),
+    snapshot_interval(snapshot_interval),
+    last_snapshot(0),
+    journal_fd(-1)
+{
+}
+
+RegCacheStorage::~RegCacheStorage()
+{
+  if(journal_fd >= 0)
+    close(journal_fd);
+}
+
+int RegCacheStorage::load(long int now, list<RegCacheBinding>& bindings)
+{
+  RegCacheBindingMap binding_map;
+
+  if((load_snapshot(snapshot_path, binding_map) < 0) ||
+     (load_journal(old_journal_path, binding_map) < 0) ||
+     (load_journal(journal_path, binding_map) < 0))
+    return -1;
+
+  int loaded = 0, expired = 0;
+  for(RegCacheBindingMap::iterator it = binding_map.begin();
+      it != binding_map.end(); it++) {
+
+    if(it->second.reg_expire <= now) {
+      expired++;
+      continue;
+    }
+
+    bindings.push_back(it->second);
+    loaded++;
+  }
+
+  INFO("register cache: loaded %i bindings from '%s' (%i expired)\n",
+       loaded, snapshot_path.c_str(), expired);
+
+  return loaded;
+}
+
+void RegCacheStorage::openJournal()
+{
+  journal_fd = open(journal_path.c_str(),
+		    O_WRONLY | O_CREAT | O_APPEND, 0600);
+  if(journal_fd < 0) {
+    ERROR("open(%s): %s\n", journal_path.c_str(), strerror(errno));
+  }
+}
+
+void RegCacheStorage::appendRecord(const string& rec)
+{
+  journal_mut.lock();
+  if(journal_fd >= 0) {
+    // single write() per record: a crash can only tear the last one
+    ssize_t res = write(journal_fd, rec.data(), rec.length());
+    if(res != (ssize_t)rec.length()) {
+      ERROR("writing to register cache journal '%s' failed: %s\n",
+	    journal_path.c_str(), res < 0 ? strerror(errno) : "short write");
+    }
+  }
+  journal_mut.unlock();
+}
+
+bool RegCacheStorage::writeSnapshot(const list<RegCacheBinding>& bindings,
+				    long int now)
+{
+  string body;
+  for(list<RegCacheBinding>::const_iterator it = bindings.begin();
+      it != bindings.end(); it++) {
+    const AliasEntry& ae = it->alias_entry;
+    encode_update(body, it->reg_expire, ae.aor, ae.alias, ae);
+  }
+
+  RegCacheSnapshotHdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, REG_CACHE_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+  hdr.version = REG_CACHE_SNAPSHOT_VERSION;
+  hdr.records = bindings.size();
+  hdr.created = now;
+  hdr.length  = body.length();
+
+  size_t len = sizeof(hdr) + body.length();
+  string tmp_path = snapshot_path + ".tmp";
+
+  int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if(fd < 0) {
+    ERROR("open(%s): %s\n", tmp_path.c_str(), strerror(errno));
+    return false;
+  }
+
+  if(ftruncate(fd, len) < 0) {
+    ERROR("ftruncate(%s): %s\n", tmp_path.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  void* p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(p == MAP_FAILED) {
+    ERROR("mmap(%s): %s\n", tmp_path.c_str(), strerror(errno));
+    return false;
+  }
+
+  memcpy(p, &hdr, sizeof(hdr));
+  memcpy((char*)p + sizeof(hdr), body.data(), body.length());
+
+  bool res = true;
+  if(msync(p, len, MS_SYNC) < 0) {
+    ERROR("msync(%s): %s\n", tmp_path.c_str(), strerror(errno));
+    res = false;
+  }
+  munmap(p, len);
+
+  if(res && (rename(tmp_path.c_str(), snapshot_path.c_str()) < 0)) {
+    ERROR("rename(%s,%s): %s\n", tmp_path.c_str(),
+	  snapshot_path.c_str(), strerror(errno));
+    res = false;
+  }
+
+  return res;
+}
+
+bool RegCacheStorage::snapshot(long int now)
+{
+  // Rotate the journal: everything written from now on
+  // goes to the new journal, which is kept with the snapshot.
+  // Records found in both are replayed idempotently.
+  journal_mut.lock();
+  if(journal_fd >= 0) {
+    close(journal_fd);
+    journal_fd = -1;
+  }
+  if(access(old_journal_path.c_str(), F_OK) < 0) {
+    // if the previous snapshot failed, old journal is kept
+    // and the current one is not rotated.
+    rename(journal_path.c_str(), old_journal_path.c_str());
+  }
+  openJournal();
+  journal_mut.unlock();
+
+  list<RegCacheBinding> bindings;
+  RegisterCache::instance()->getBindings(bindings);
+
+  last_snapshot = now;
+  if(!writeSnapshot(bindings, now)) {
+    ERROR("could not write register cache snapshot '%s'\n",
+	  snapshot_path.c_str());
+    return false;
+  }
+
+  // old journal is now fully included in the snapshot
+  unlink(old_journal_path.c_str());
+
+  DBG("register cache snapshot written: %u bindings\n",
+      (unsigned int)bindings.size());
+  return true;
+}
+
+void RegCacheStorage::onDelete(const string& aor, const string& uri,
+			       const string& alias)
+{
+  string rec;
+  put_int<uint8_t>(rec, RCR_DELETE);
+  put_str(rec, aor);
+  put_str(rec, uri);
+  put_str(rec, alias);
+
+  string buf;
+  put_record(buf, rec);
+  appendRecord(buf);
+}
+
+void RegCacheStorage::onUpdate(const string& canon_aor, const string& alias,
+			       long int expires, const AliasEntry& alias_update)
+{
+  string buf;
+  encode_update(buf, expires, canon_aor, alias, alias_update);
+  appendRecord(buf);
+}
+
+void RegCacheStorage::onUpdate(const string& alias, long int ua_expires)
+{
+  string rec;
+  put_int<uint8_t>(rec, RCR_UA_EXPIRES);
+  put_int<int64_t>(rec, ua_expires);
+  put_str(rec, alias);
+
+  string buf;
+  put_record(buf, rec);
+  appendRecord(buf);
+}
+
+void RegCacheStorage::onGbcCycle(long int now)
+{
+  if(snapshot_interval && (now - last_snapshot >= (long int)snapshot_interval))
+    snapshot(now);
+}
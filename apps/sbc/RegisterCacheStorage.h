@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2012-2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _RegisterCacheStorage_h_
+#define _RegisterCacheStorage_h_
+
+#include "RegisterCache.h"
+#include "AmThread.h"
+
+#include <string>
+#include <list>
+using std::string;
+using std::list;
+
+#define REG_CACHE_DEFAULT_SNAPSHOT_INTERVAL 300 /* seconds */
+
+/**
+ * Persistent register cache storage:
+ *
+ * Every write operation on the cache is appended to a journal
+ * (<dir>/regcache.journal). Periodically, a complete snapshot of
+ * the cache is written (memory-mapped) to <dir>/regcache.snapshot
+ * and the journal is rotated.
+ *
+ * On startup, the snapshot is loaded and the journal(s) replayed
+ * on top of it, so that the cache can be refilled in bulk before
+ * the UAs re-register.
+ */
+class RegCacheStorage
+  : public RegCacheStorageHandler
+{
+  string journal_path;
+  string old_journal_path;
+  string snapshot_path;
+
+  unsigned int snapshot_interval;
+  long int     last_snapshot;
+
+  int     journal_fd;
+  AmMutex journal_mut;
+
+  void openJournal();
+  void appendRecord(const string& rec);
+
+  bool writeSnapshot(const list<RegCacheBinding>& bindings, long int now);
+
+public:
+  RegCacheStorage(const string& dir,
+		  unsigned int snapshot_interval = REG_CACHE_DEFAULT_SNAPSHOT_INTERVAL);
+  ~RegCacheStorage();
+
+  /**
+   * Read the snapshot and replay the journals.
+   * Bindings already expired at the registrar side are dropped.
+   *
+   * Returns the number of bindings loaded, -1 on error.
+   */
+  int load(long int now, list<RegCacheBinding>& bindings);
+
+  /**
+   * Write a new snapshot of the register cache,
+   * rotate the journal and start journaling.
+   */
+  bool snapshot(long int now);
+
+  /* from RegCacheStorageHandler */
+  void onDelete(const string& aor, const string& uri,
+		const string& alias);
+
+  void onUpdate(const string& canon_aor, const string& alias,
+		long int expires, const AliasEntry& alias_update);
+
+  void onUpdate(const string& alias, long int ua_expires);
+
+  void onGbcCycle(long int now);
+};
+
+#endif
@@ -60,6 +60,8 @@ SBC - feature-wishlist
 #include "SubscriptionDialog.h"
 #include "RegisterDialog.h"
 #include "RegisterCache.h"
+#include "RegisterCacheStorage.h"
+#include "CounterStore.h"
 
 #include <algorithm>
 
@@ -100,6 +102,44 @@ bool getCCInterfaces(CCInterfaceListT& cc_interfaces, vector<AmDynInvoke*>& cc_m
   return true;
 }
 
+/** TypedCCInterface offered by the CC module instances (NULL if none) */
+static map<AmDynInvoke*, TypedCCInterface*> typed_cc_ifs;
+static AmMutex typed_cc_ifs_mut;
+
+static TypedCCInterface* getTypedCCInterface(AmDynInvoke* cc_di)
+{
+  AmLock l(typed_cc_ifs_mut);
+
+  map<AmDynInvoke*, TypedCCInterface*>::iterator it = typed_cc_ifs.find(cc_di);
+  if (it != typed_cc_ifs.end())
+    return it->second;
+
+  // looked up only once per module instance
+  TypedCCInterface* iface = NULL;
+  try {
+    AmArg args, ret;
+    cc_di->invoke("getTypedInterfaceHandler", args, ret);
+    iface = dynamic_cast<TypedCCInterface*>(ret[0].asObject());
+    if (!iface)
+      WARN("BUG: returned invalid typed CC interface\n");
+  } catch (...) {
+    // not supported by the module: use DI
+  }
+
+  typed_cc_ifs[cc_di] = iface;
+  return iface;
+}
+
+void getTypedCCInterfaces(const vector<AmDynInvoke*>& cc_modules,
+			  vector<TypedCCInterface*>& cc_typed)
+{
+  cc_typed.clear();
+  for (vector<AmDynInvoke*>::const_iterator it = cc_modules.begin();
+       it != cc_modules.end(); it++) {
+    cc_typed.push_back(getTypedCCInterface(*it));
+  }
+}
+
 void assertEndCRLF(string& s) {
   if (s[s.size()-2] != '\r' ||
       s[s.size()-1] != '\n') {
@@ -157,6 +197,7 @@ SBCFactory::SBCFactory(const string& _app_name)
 
 SBCFactory::~SBCFactory() {
   RegisterCache::dispose();
+  CounterStore::dispose();
 }
 
 int SBCFactory::onLoad()
@@ -244,10 +285,41 @@ int SBCFactory::onLoad()
     return -1;
   }
 
+  string regcache_storage_dir = cfg.getParameter("regcache_storage_dir");
+  if(!regcache_storage_dir.empty()) {
+    RegCacheStorage* storage =
+      new RegCacheStorage(regcache_storage_dir,
+			  cfg.getParameterInt("regcache_snapshot_interval",
+					      REG_CACHE_DEFAULT_SNAPSHOT_INTERVAL));
+
+    list<RegCacheBinding> bindings;
+    long int now = time(NULL);
+    if(storage->load(now, bindings) < 0) {
+      ERROR("loading register cache from '%s'\n",
+	    regcache_storage_dir.c_str());
+      delete storage;
+      return -1;
+    }
+
+    RegisterCache::instance()->loadBindings(bindings);
+    RegisterCache::instance()->setStorageHandler(storage);
+
+    if(!storage->snapshot(now)) {
+      ERROR("writing register cache snapshot to '%s'\n",
+	    regcache_storage_dir.c_str());
+      return -1;
+    }
+  }
+
   // TODO: add config param for the number of threads
   subnot_processor.addThreads(1);
   RegisterCache::instance()->start();
 
+  CounterStore::instance()->
+    setExport(cfg.getParameter("counters_export_file"),
+	      cfg.getParameterInt("counters_export_interval", 0));
+  CounterStore::instance()->start();
+
   return 0;
 }
 
@@ -468,6 +540,10 @@ void SBCFactory::invoke(const string& method, const AmArg& args,
   } else if (method == "postControlCmd"){
     args.assertArrayFmt("ss"); // at least call-ltag, cmd
     postControlCmd(args,ret);
+  } else if (method == "getCounters"){
+    ret.push(AmArg());
+    ret.push(AmArg());
+    CounterStore::instance()->getCounters(ret.get(0), ret.get(1));
   } else if(method == "_list"){ 
     ret.push(AmArg("listProfiles"));
     ret.push(AmArg("reloadProfiles"));
@@ -480,6 +556,7 @@ void SBCFactory::invoke(const string& method, const AmArg& args,
     ret.push(AmArg("loadCallcontrolModules"));
     ret.push(AmArg("postControlCmd"));
     ret.push(AmArg("printCallStats"));
+    ret.push(AmArg("getCounters"));
   } else if(method == "printCallStats"){ 
     B2BMediaStatistics::instance()->getReport(args, ret);
   }  else
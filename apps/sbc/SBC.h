@@ -36,6 +36,7 @@
 #include "AmEventQueueProcessor.h"
 
 #include "CallLeg.h"
+#include "ExtendedCCInterface.h"
 class SBCCallLeg;
 
 #include <map>
@@ -137,6 +138,7 @@ class SBCFactory: public AmSessionFactory,
 
 extern void assertEndCRLF(string& s);
 extern bool getCCInterfaces(CCInterfaceListT& cc_interfaces, vector<AmDynInvoke*>& cc_modules);
+extern void getTypedCCInterfaces(const vector<AmDynInvoke*>& cc_modules, vector<TypedCCInterface*>& cc_typed);
 extern void oodHandlingTerminated(const AmSipRequest &req, vector<AmDynInvoke*>& cc_modules, SBCCallProfile& call_profile);
 
 #endif
@@ -41,6 +41,7 @@
 #include "SubscriptionDialog.h"
 
 #include "sip/pcap_logger.h"
+#include "sip/ring_msg_logger.h"
 #include "sip/sip_parser.h"
 #include "sip/sip_trans.h"
 
@@ -244,6 +245,10 @@ void SBCCallLeg::applyAProfile()
     setRtpRelayTransparentSSRC(call_profile.rtprelay_transparent_ssrc);
     setEnableDtmfRtpFiltering(call_profile.rtprelay_dtmf_filtering);
     setEnableDtmfRtpDetection(call_profile.rtprelay_dtmf_detection);
+    if (call_profile.transcoder.useJitterBuffer()) {
+      setJitterBufferDelay(call_profile.transcoder.jitter_buffer_min_delay,
+			   call_profile.transcoder.jitter_buffer_max_delay);
+    }
 
     if(call_profile.transcoder.isActive()) {
       setRtpRelayMode(RTP_Transcoding);
@@ -385,6 +390,10 @@ void SBCCallLeg::applyBProfile()
     setRtpRelayTransparentSSRC(call_profile.rtprelay_transparent_ssrc);
     setEnableDtmfRtpFiltering(call_profile.rtprelay_dtmf_filtering);
     setEnableDtmfRtpDetection(call_profile.rtprelay_dtmf_detection);
+    if (call_profile.transcoder.useJitterBuffer()) {
+      setJitterBufferDelay(call_profile.transcoder.jitter_buffer_min_delay,
+			   call_profile.transcoder.jitter_buffer_max_delay);
+    }
 
     // copy stats counters
     rtp_pegs = call_profile.bleg_rtp_counters;
@@ -730,6 +739,18 @@ void SBCCallLeg::onControlCmd(string& cmd, AmArg& params) {
     }
     return;
   }
+  if (cmd == "dump_capture") {
+    // the capture is shared by both legs
+    ring_msg_logger* ring = dynamic_cast<ring_msg_logger*>(logger);
+    if (ring) {
+      int n = ring->dump();
+      DBG("dumped %d captured packets on control cmd\n", n);
+    }
+    else {
+      DBG("no packet capture to dump\n");
+    }
+    return;
+  }
   DBG("ignoring unknown control cmd : '%s'\n", cmd.c_str());
 }
 
@@ -850,6 +871,12 @@ void SBCCallLeg::onInvite(const AmSipRequest& req)
     }
   }
 
+  if (!logger) {
+    // not opened by call control (e.g. no CC interfaces)
+    msg_logger *l = call_profile.get_logger(req);
+    if (l) setLogger(l);
+  }
+
   call_profile.sst_aleg_enabled = 
     ctx.replaceParameters(call_profile.sst_aleg_enabled,
 			  "enable_aleg_session_timer", req);
@@ -1008,7 +1035,11 @@ void SBCCallLeg::connectCallee(const string& remote_party,
 }
 
 bool SBCCallLeg::getCCInterfaces() {
-  return ::getCCInterfaces(call_profile.cc_interfaces, cc_modules);
+  if (!::getCCInterfaces(call_profile.cc_interfaces, cc_modules))
+    return false;
+
+  ::getTypedCCInterfaces(cc_modules, cc_typed);
+  return true;
 }
 
 void SBCCallLeg::onCallConnected(const AmSipReply& reply) {
@@ -1075,15 +1106,87 @@ void SBCCallLeg::stopCallTimers() {
   }
 }
 
+void SBCCallLeg::CCStartFailed(const CCInterfaceListIteratorT& cc_it) {
+  // call 'end' of call control modules up to here
+  call_end_ts.tv_sec = call_start_ts.tv_sec;
+  call_end_ts.tv_usec = call_start_ts.tv_usec;
+  CCEnd(cc_it);
+}
+
+void SBCCallLeg::CCRefuse(const AmSipRequest& req, const CCInterfaceListIteratorT& cc_it,
+			  int code, const string& reason, const string& headers) {
+  DBG("replying with %d %s on call control action REFUSE from '%s' headers='%s'\n",
+      code, reason.c_str(), cc_it->cc_name.c_str(), headers.c_str());
+
+  SBCEventLog::instance()->
+    logCallStart(req, getLocalTag(), dlg->getRemoteUA(), "",
+		 code, reason);
+
+  dlg->reply(req, code, reason, NULL, headers);
+
+  CCStartFailed(cc_it);
+}
+
+void SBCCallLeg::CCDrop(const CCInterfaceListIteratorT& cc_it) {
+  DBG("dropping call on call control action DROP from '%s'\n",
+      cc_it->cc_name.c_str());
+  dlg->setStatus(AmSipDialog::Disconnected);
+
+  CCStartFailed(cc_it);
+}
+
+void SBCCallLeg::CCSetCallTimer(double timeout) {
+  if (cc_timer_id > SBC_TIMER_ID_CALL_TIMERS_END) {
+    ERROR("too many call timers - ignoring timer\n");
+    return;
+  }
+
+  DBG("saving call timer %i: timeout %f\n", cc_timer_id, timeout);
+  saveCallTimer(cc_timer_id, timeout);
+  cc_timer_id++;
+}
+
 bool SBCCallLeg::CCStart(const AmSipRequest& req) {
   if (!a_leg) return true; // preserve original behavior of the CC interface
 
   vector<AmDynInvoke*>::iterator cc_mod=cc_modules.begin();
+  vector<TypedCCInterface*>::iterator cc_typed_if=cc_typed.begin();
 
   for (CCInterfaceListIteratorT cc_it=call_profile.cc_interfaces.begin();
-       cc_it != call_profile.cc_interfaces.end(); cc_it++) {
+       cc_it != call_profile.cc_interfaces.end(); cc_it++, cc_mod++, cc_typed_if++) {
     CCInterface& cc_if = *cc_it;
 
+    if (*cc_typed_if) {
+      CCStartResult res;
+      (*cc_typed_if)->
+	start(CCStartParams(CCCallParams(cc_if.cc_name, getLocalTag(), &call_profile,
+					 call_start_ts, call_connect_ts, call_end_ts),
+			    req, cc_if.cc_values, cc_timer_id), res);
+
+      if (!logger) {
+	// open the logger if not already opened
+	msg_logger *l = call_profile.get_logger(req);
+	if (l) setLogger(l);
+      }
+
+      for (vector<double>::iterator it = res.call_timers.begin();
+	   it != res.call_timers.end(); it++) {
+	CCSetCallTimer(*it);
+      }
+
+      switch (res.action) {
+      case CCStartResult::Continue: break;
+      case CCStartResult::Drop:
+	CCDrop(cc_it);
+	return false;
+      case CCStartResult::Refuse:
+	CCRefuse(req, cc_it, res.refuse_code, res.refuse_reason, res.refuse_headers);
+	return false;
+      }
+
+      continue;
+    }
+
     AmArg di_args,ret;
     di_args.push(cc_if.cc_name);
     di_args.push(getLocalTag());
@@ -1128,11 +1231,7 @@ bool SBCCallLeg::CCStart(const AmSipRequest& req) {
 		     500, SIP_REPLY_SERVER_INTERNAL_ERROR);
       AmBasicSipDialog::reply_error(req, 500, SIP_REPLY_SERVER_INTERNAL_ERROR);
 
-      // call 'end' of call control modules up to here
-      call_end_ts.tv_sec = call_start_ts.tv_sec;
-      call_end_ts.tv_usec = call_start_ts.tv_usec;
-      CCEnd(cc_it);
-
+      CCStartFailed(cc_it);
       return false;
     }
 
@@ -1154,15 +1253,7 @@ bool SBCCallLeg::CCStart(const AmSipRequest& req) {
 	}
 	switch (ret[i][SBC_CC_ACTION].asInt()) {
 	case SBC_CC_DROP_ACTION: {
-	  DBG("dropping call on call control action DROP from '%s'\n",
-	      cc_if.cc_name.c_str());
-	  dlg->setStatus(AmSipDialog::Disconnected);
-
-	  // call 'end' of call control modules up to here
-	  call_end_ts.tv_sec = call_start_ts.tv_sec;
-	  call_end_ts.tv_usec = call_start_ts.tv_usec;
-	  CCEnd(cc_it);
-
+	  CCDrop(cc_it);
 	  return false;
 	}
 
@@ -1180,33 +1271,12 @@ bool SBCCallLeg::CCStart(const AmSipRequest& req) {
 	      headers += string(ret[i][SBC_CC_REFUSE_HEADERS][h].asCStr()) + CRLF;
 	  }
 
-	  DBG("replying with %d %s on call control action REFUSE from '%s' headers='%s'\n",
-	      ret[i][SBC_CC_REFUSE_CODE].asInt(), ret[i][SBC_CC_REFUSE_REASON].asCStr(),
-	      cc_if.cc_name.c_str(), headers.c_str());
-
-	  SBCEventLog::instance()->
-	    logCallStart(req, getLocalTag(), dlg->getRemoteUA(), "",
-			 ret[i][SBC_CC_REFUSE_CODE].asInt(),
-			 ret[i][SBC_CC_REFUSE_REASON].asCStr());
-
-	  dlg->reply(req,
-		     ret[i][SBC_CC_REFUSE_CODE].asInt(),
-		     ret[i][SBC_CC_REFUSE_REASON].asCStr(),
-		     NULL, headers);
-
-	  // call 'end' of call control modules up to here
-	  call_end_ts.tv_sec = call_start_ts.tv_sec;
-	  call_end_ts.tv_usec = call_start_ts.tv_usec;
-	  CCEnd(cc_it);
+	  CCRefuse(req, cc_it, ret[i][SBC_CC_REFUSE_CODE].asInt(),
+		   ret[i][SBC_CC_REFUSE_REASON].asCStr(), headers);
 	  return false;
 	}
 
 	case SBC_CC_SET_CALL_TIMER_ACTION: {
-	  if (cc_timer_id > SBC_TIMER_ID_CALL_TIMERS_END) {
-	    ERROR("too many call timers - ignoring timer\n");
-	    continue;
-	  }
-
 	  if (ret[i].size() < 2 ||
 	      (!(isArgInt(ret[i][SBC_CC_TIMER_TIMEOUT]) ||
 		 isArgDouble(ret[i][SBC_CC_TIMER_TIMEOUT])))) {
@@ -1221,9 +1291,7 @@ bool SBCCallLeg::CCStart(const AmSipRequest& req) {
 	  else
 	    timeout = ret[i][SBC_CC_TIMER_TIMEOUT].asDouble();
 
-	  DBG("saving call timer %i: timeout %f\n", cc_timer_id, timeout);
-	  saveCallTimer(cc_timer_id, timeout);
-	  cc_timer_id++;
+	  CCSetCallTimer(timeout);
 	} break;
 	default: {
 	  ERROR("unknown call control action: '%s'\n", AmArg::print(ret[i]).c_str());
@@ -1234,8 +1302,6 @@ bool SBCCallLeg::CCStart(const AmSipRequest& req) {
 
       }
     }
-
-    cc_mod++;
   }
   cc_started = true;
   return true;
@@ -1245,11 +1311,20 @@ void SBCCallLeg::CCConnect(const AmSipReply& reply) {
   if (!cc_started) return; // preserve original behavior of the CC interface
 
   vector<AmDynInvoke*>::iterator cc_mod=cc_modules.begin();
+  vector<TypedCCInterface*>::iterator cc_typed_if=cc_typed.begin();
 
   for (CCInterfaceListIteratorT cc_it=call_profile.cc_interfaces.begin();
-       cc_it != call_profile.cc_interfaces.end(); cc_it++) {
+       cc_it != call_profile.cc_interfaces.end(); cc_it++, cc_mod++, cc_typed_if++) {
     CCInterface& cc_if = *cc_it;
 
+    if (*cc_typed_if) {
+      (*cc_typed_if)->
+	connect(CCConnectParams(CCCallParams(cc_if.cc_name, getLocalTag(), &call_profile,
+					     call_start_ts, call_connect_ts, call_end_ts),
+				getOtherId()));
+      continue;
+    }
+
     AmArg di_args,ret;
     di_args.push(cc_if.cc_name);                // cc name
     di_args.push(getLocalTag());                // call ltag
@@ -1282,8 +1357,6 @@ void SBCCallLeg::CCConnect(const AmSipReply& reply) {
       stopCall(StatusChangeCause::InternalError);
       return;
     }
-
-    cc_mod++;
   }
 }
 
@@ -1293,11 +1366,19 @@ void SBCCallLeg::CCEnd() {
 
 void SBCCallLeg::CCEnd(const CCInterfaceListIteratorT& end_interface) {
   vector<AmDynInvoke*>::iterator cc_mod=cc_modules.begin();
+  vector<TypedCCInterface*>::iterator cc_typed_if=cc_typed.begin();
 
   for (CCInterfaceListIteratorT cc_it=call_profile.cc_interfaces.begin();
-       cc_it != end_interface; cc_it++) {
+       cc_it != end_interface; cc_it++, cc_mod++, cc_typed_if++) {
     CCInterface& cc_if = *cc_it;
 
+    if (*cc_typed_if) {
+      (*cc_typed_if)->
+	end(CCEndParams(cc_if.cc_name, getLocalTag(), &call_profile,
+			call_start_ts, call_connect_ts, call_end_ts));
+      continue;
+    }
+
     AmArg di_args,ret;
     di_args.push(cc_if.cc_name);
     di_args.push(getLocalTag());                 // call ltag
@@ -1324,8 +1405,6 @@ void SBCCallLeg::CCEnd(const CCInterfaceListIteratorT& end_interface) {
 	    cc_if.cc_module.c_str(), cc_if.cc_name.c_str(),
 	    AmArg::print(di_args).c_str());
     }
-
-    cc_mod++;
   }
 }
 
@@ -1348,6 +1427,8 @@ void SBCCallLeg::onCallFailed(CallFailureReason reason, const AmSipReply *reply)
   switch (reason) {
     case CallRefused:
       if (reply) logCallStart(*reply);
+      if (reply && call_profile.capture.onReply(reply->code))
+	triggerCapture("call failed with " + int2str(reply->code));
       break;
 
     case CallCanceled:
@@ -1356,6 +1437,13 @@ void SBCCallLeg::onCallFailed(CallFailureReason reason, const AmSipReply *reply)
   }
 }
 
+void SBCCallLeg::onRtpTimeout()
+{
+  if (call_profile.capture.on_rtp_timeout)
+    triggerCapture("RTP timeout");
+  CallLeg::onRtpTimeout();
+}
+
 bool SBCCallLeg::onBeforeRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr)
 {
   if(rtp_relay_rate_limit.get() &&
@@ -1418,6 +1506,23 @@ int SBCCallLeg::filterSdp(AmMimeBody &body, const string &method)
        method == SIP_METH_PRACK ||
        method == SIP_METH_ACK)) return 0;
 
+  bool needs_normalization =
+          call_profile.codec_prefs.shouldOrderPayloads(a_leg) ||
+          call_profile.transcoder.isActive() ||
+          !call_profile.sdpfilter.empty();
+
+  if (!needs_normalization) {
+    // media and a-line filters can be applied directly on the SDP lines
+    if (call_profile.mediafilter.empty() && call_profile.sdpalinesfilter.empty())
+      return 0;
+
+    string n_body;
+    int res = filterSDPLines((const char *)sdp_body->getPayload(), sdp_body->getLen(),
+			     n_body, call_profile.mediafilter, call_profile.sdpalinesfilter);
+    sdp_body->setPayload((const unsigned char*)n_body.c_str(), n_body.length());
+    return res;
+  }
+
   AmSdp sdp;
   int res = sdp.parse((const char *)sdp_body->getPayload());
   if (0 != res) {
@@ -1428,11 +1533,6 @@ int SBCCallLeg::filterSdp(AmMimeBody &body, const string &method)
   bool changed = false;
   bool prefer_existing_codecs = call_profile.codec_prefs.preferExistingCodecs(a_leg);
 
-  bool needs_normalization =
-          call_profile.codec_prefs.shouldOrderPayloads(a_leg) ||
-          call_profile.transcoder.isActive() ||
-          !call_profile.sdpfilter.empty();
-
   if (needs_normalization) {
     normalizeSDP(sdp, false, ""); // anonymization is done in the other leg to use correct IP address
     changed = true;
@@ -1870,6 +1970,12 @@ void SBCCallLeg::setLogger(msg_logger *_logger)
   }
 }
 
+void SBCCallLeg::triggerCapture(const string& reason)
+{
+  ring_msg_logger* ring = dynamic_cast<ring_msg_logger*>(logger);
+  if (ring) ring->trigger(reason);
+}
+
 void SBCCallLeg::computeRelayMask(const SdpMedia &m, bool &enable, PayloadMask &mask)
 {
   if (call_profile.transcoder.isActive()) {
@@ -59,6 +59,8 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
   // call control
   vector<AmDynInvoke*> cc_modules;
   vector<ExtendedCCInterface*> cc_ext;
+  // typed interface of cc_modules (NULL: module is called through DI)
+  vector<TypedCCInterface*> cc_typed;
 
   // modules to initialize
   CCInterfaceListT cc_module_queue;
@@ -90,6 +92,9 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
 
   void setLogger(msg_logger *_logger);
 
+  /** write the in-memory packet capture at the end of the call */
+  void triggerCapture(const string& reason);
+
   void fixupCCInterface(const string& val, CCInterface& cc_if);
 
   /** handler called when call is stopped (see AmSession) */
@@ -103,6 +108,13 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
   void CCEnd();
   void CCEnd(const CCInterfaceListIteratorT& end_interface);
 
+  /** CC actions on call start */
+  void CCStartFailed(const CCInterfaceListIteratorT& cc_it);
+  void CCRefuse(const AmSipRequest& req, const CCInterfaceListIteratorT& cc_it,
+		int code, const string& reason, const string& headers);
+  void CCDrop(const CCInterfaceListIteratorT& cc_it);
+  void CCSetCallTimer(double timeout);
+
   void connectCallee(const string& remote_party, const string& remote_uri, 
 		     const string &from, const AmSipRequest &original_invite, 
 		     const AmSipRequest &invite_req);
@@ -123,6 +135,8 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
   /** handler called when the call is refused with a non-ok reply or canceled */
   virtual void onCallFailed(CallFailureReason reason, const AmSipReply *reply);
 
+  virtual void onRtpTimeout();
+
   /** handler called when the second leg is connected */
   virtual void onCallConnected(const AmSipReply& reply);
 
@@ -26,6 +26,7 @@
 #include "SBCCallProfile.h"
 #include "SBC.h"
 #include <algorithm>
+#include <stdlib.h>
 
 #include "log.h"
 #include "AmUtils.h"
@@ -38,6 +39,7 @@
 #include "RegisterCache.h"
 
 #include "sip/pcap_logger.h"
+#include "sip/ring_msg_logger.h"
 
 typedef vector<SdpPayload>::iterator PayloadIterator;
 static string payload2str(const SdpPayload &p);
@@ -390,6 +392,7 @@ bool SBCCallProfile::readFromConfiguration(const string& name,
   msg_logger_path = cfg.getParameter("msg_logger_path");
   log_rtp = cfg.getParameter("log_rtp","no") == "yes";
   log_sip = cfg.getParameter("log_sip","yes") == "yes";
+  if (!capture.readConfig(cfg)) return false;
 
   reg_caching = cfg.getParameter("enable_reg_caching","no") == "yes";
   min_reg_expires = cfg.getParameterInt("min_reg_expires",0);
@@ -681,6 +684,7 @@ string SBCCallProfile::print() const {
   
   res += codec_prefs.print();
   res += transcoder.print();
+  res += capture.print();
 
   if (reply_translations.size()) {
     string reply_trans_codes;
@@ -1548,6 +1552,10 @@ void SBCCallProfile::TranscoderSettings::infoPrint() const
   INFO("SBC:      enable transcoder: %s\n", transcoder_mode_str.c_str());
   INFO("SBC:      norelay audio codecs: %s\n", audio_codecs_norelay_str.c_str());
   INFO("SBC:      norelay audio codecs (aleg): %s\n", audio_codecs_norelay_aleg_str.c_str());
+  if (useJitterBuffer()) {
+    INFO("SBC:      jitter buffer delay: min %ims, max %ims\n",
+	 jitter_buffer_min_delay, jitter_buffer_max_delay);
+  }
 }
 
 bool SBCCallProfile::TranscoderSettings::readConfig(AmConfigReader &cfg)
@@ -1561,6 +1569,26 @@ bool SBCCallProfile::TranscoderSettings::readConfig(AmConfigReader &cfg)
   audio_codecs_norelay_str = cfg.getParameter("prefer_transcoding_for_codecs");
   audio_codecs_norelay_aleg_str = cfg.getParameter("prefer_transcoding_for_codecs_aleg");
 
+  if (cfg.hasParameter("jitter_buffer_min_delay") &&
+      (!str2int(cfg.getParameter("jitter_buffer_min_delay"), jitter_buffer_min_delay) ||
+       jitter_buffer_min_delay < 0)) {
+    ERROR("invalid jitter_buffer_min_delay value\n");
+    return false;
+  }
+  if (cfg.hasParameter("jitter_buffer_max_delay") &&
+      (!str2int(cfg.getParameter("jitter_buffer_max_delay"), jitter_buffer_max_delay) ||
+       jitter_buffer_max_delay < 0)) {
+    ERROR("invalid jitter_buffer_max_delay value\n");
+    return false;
+  }
+  if (useJitterBuffer()) {
+    // unset limit: global default
+    if (jitter_buffer_min_delay < 0)
+      jitter_buffer_min_delay = AmConfig::JitterBufferMinDelay;
+    if (jitter_buffer_max_delay < 0)
+      jitter_buffer_max_delay = AmConfig::JitterBufferMaxDelay;
+  }
+
   return true;
 }
 
@@ -1570,6 +1598,8 @@ bool SBCCallProfile::TranscoderSettings::operator==(const TranscoderSettings& rh
   res = res && (enabled == rhs.enabled);
   res = res && (payloadDescsEqual(callee_codec_capabilities, rhs.callee_codec_capabilities));
   res = res && (audio_codecs == rhs.audio_codecs);
+  res = res && (jitter_buffer_min_delay == rhs.jitter_buffer_min_delay);
+  res = res && (jitter_buffer_max_delay == rhs.jitter_buffer_max_delay);
   return res;
 }
 
@@ -1596,6 +1626,11 @@ string SBCCallProfile::TranscoderSettings::print() const
     case OnMissingCompatible: s = "on_missing_compatible"; break;
   }
   res += "\nenable transcoder: " + s;
+
+  if (useJitterBuffer()) {
+    res += "\njitter buffer delay: " + int2str(jitter_buffer_min_delay) +
+      "-" + int2str(jitter_buffer_max_delay) + "ms";
+  }
   
   res += "\ntranscoder currently enabled: ";
   if (enabled) res += "yes\n";
@@ -1649,9 +1684,24 @@ bool SBCCallProfile::TranscoderSettings::evaluate(ParamReplacerCtx& ctx,
 
 void SBCCallProfile::create_logger(const AmSipRequest& req)
 {
-  if (msg_logger_path.empty()) return;
-
   ParamReplacerCtx ctx(this);
+
+  if (msg_logger_path.empty()) {
+    if (!capture.ring_size || capture.path.empty()) return;
+
+    string path = ctx.replaceParameters(capture.path, "capture_path", req);
+    if (path.empty()) return;
+
+    ring_msg_logger *log = new ring_msg_logger(capture.ring_size,
+					       capture.headers_only, path);
+    if (capture.sampling > 0 &&
+	get_random() % 1000000 < capture.sampling * 10000)
+      log->trigger("sampling");
+
+    logger.reset(log);
+    return;
+  }
+
   string log_path = ctx.replaceParameters(msg_logger_path, "msg_logger_path", req);
   if (log_path.empty()) return;
 
@@ -1669,10 +1719,75 @@ void SBCCallProfile::create_logger(const AmSipRequest& req)
 
 msg_logger* SBCCallProfile::get_logger(const AmSipRequest& req)
 {
-  if (!logger.get() && !msg_logger_path.empty()) create_logger(req);
+  if (!logger.get() && (!msg_logger_path.empty() || capture.ring_size))
+    create_logger(req);
   return logger.get();
 }
 
+bool SBCCallProfile::CaptureSettings::readConfig(AmConfigReader &cfg)
+{
+  ring_size = cfg.getParameterInt("capture_ring_size", 0);
+  headers_only = cfg.getParameter("capture_headers_only", "no") == "yes";
+  path = cfg.getParameter("capture_path");
+  on_rtp_timeout = cfg.getParameter("capture_on_rtp_timeout", "no") == "yes";
+
+  sampling = 0;
+  string s = cfg.getParameter("capture_sampling");
+  if (!s.empty()) {
+    char* end;
+    sampling = strtod(s.c_str(), &end);
+    if (*end || sampling < 0 || sampling > 100) {
+      ERROR("invalid capture_sampling '%s' (percent of calls)\n", s.c_str());
+      return false;
+    }
+  }
+
+  codes.clear();
+  vector<string> items = explode(cfg.getParameter("capture_on_codes"), ",");
+  for (vector<string>::iterator it = items.begin(); it != items.end(); it++) {
+    string c = trim(*it, " ");
+    unsigned int code;
+    if (c.length() == 3 && c[1] == 'x' && c[2] == 'x' && c[0] >= '1' && c[0] <= '6')
+      codes.insert(c[0] - '0');
+    else if (!str2i(c, code) && code >= 100 && code < 700)
+      codes.insert(code);
+    else {
+      ERROR("invalid reply code '%s' in capture_on_codes\n", c.c_str());
+      return false;
+    }
+  }
+
+  if (ring_size && path.empty()) {
+    WARN("capture_ring_size set without capture_path, capture disabled\n");
+  }
+
+  return true;
+}
+
+bool SBCCallProfile::CaptureSettings::onReply(int code) const
+{
+  return codes.find(code) != codes.end() || codes.find(code / 100) != codes.end();
+}
+
+string SBCCallProfile::CaptureSettings::print() const
+{
+  if (!ring_size) return "";
+
+  string res;
+  res += "capture_ring_size:    " + int2str(ring_size) + "\n";
+  res += "capture_headers_only: " + string(headers_only ? "true" : "false") + "\n";
+  res += "capture_path:         " + path + "\n";
+  string c;
+  for (set<int>::const_iterator it = codes.begin(); it != codes.end(); it++) {
+    if (!c.empty()) c += ",";
+    c += *it < 10 ? int2str(*it) + "xx" : int2str(*it);
+  }
+  res += "capture_on_codes:     " + c + "\n";
+  res += "capture_on_rtp_timeout: " + string(on_rtp_timeout ? "true" : "false") + "\n";
+  res += "capture_sampling:     " + double2str(sampling) + "\n";
+  return res;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 
 bool PayloadDesc::match(const SdpPayload &p) const
@@ -232,6 +232,13 @@ struct SBCCallProfile
     enum { DTMFAlways, DTMFLowFiCodecs, DTMFNever } dtmf_mode;
     bool readTranscoderMode(const std::string &src);
     bool readDTMFMode(const std::string &src);
+
+    /** jitter buffer delay limits (ms) for transcoded streams, -1 if not set */
+    int jitter_buffer_min_delay;
+    int jitter_buffer_max_delay;
+    bool useJitterBuffer() const {
+      return jitter_buffer_min_delay >= 0 || jitter_buffer_max_delay >= 0;
+    }
   
     bool enabled;
     
@@ -243,7 +250,9 @@ struct SBCCallProfile
     string print() const;
 
     bool isActive() { return enabled; }
-    TranscoderSettings(): enabled(false), transcoder_mode(Never) { }
+    TranscoderSettings(): transcoder_mode(Never),
+      jitter_buffer_min_delay(-1), jitter_buffer_max_delay(-1),
+      enabled(false) { }
   } transcoder;
 
   struct CodecPreferences {
@@ -324,6 +333,28 @@ struct SBCCallProfile
   // milliseconds), according to RFC 3261 should be 2000 ms
   int max_491_retry_time;
 
+  /** in-memory capture of the last packets of a call, written into
+   *  a pcap file only if triggered (used without msg_logger_path) */
+  struct CaptureSettings {
+    unsigned int ring_size; // packets, 0: disabled
+    bool headers_only;
+    string path;            // may contain replacement patterns
+
+    // reply codes (e.g. 408) or classes (e.g. 5 for 5xx) failing
+    // the call which trigger the dump
+    set<int> codes;
+    bool on_rtp_timeout;
+    double sampling;        // percent of calls dumped anyway
+
+    CaptureSettings()
+      : ring_size(0), headers_only(false), on_rtp_timeout(false), sampling(0)
+    { }
+
+    bool readConfig(AmConfigReader &cfg);
+    bool onReply(int code) const;
+    string print() const;
+  } capture;
+
  private:
   // message logging feature
   string msg_logger_path;
@@ -29,6 +29,8 @@
 #include "AmUtils.h"
 #include "RTPParameters.h"
 
+#include <string.h>
+
 int filterSDP(AmSdp& sdp, const vector<FilterEntry>& filter_list) {
   
   for (vector<FilterEntry>::const_iterator it=
@@ -72,7 +74,7 @@ int filterSDP(AmSdp& sdp, const vector<FilterEntry>& filter_list) {
         media_line_filtered_out = true;
       }
       else media_line_left = true;
-      media.payloads = new_pl;
+      media.payloads.swap(new_pl);
     }
     if ((!media_line_left) && media_line_filtered_out) {
       // no filter adds new payloads, we can safely return error
@@ -160,29 +162,38 @@ void fix_incomplete_silencesupp(SdpMedia& m) {
   }
 }
 
-std::vector<SdpAttribute> filterSDPAttributes(std::vector<SdpAttribute> attributes,
+static bool isFilteredAttribute(const string& attribute, FilterType sdpalinesfilter,
+				const std::set<string>& sdpalinesfilter_list) {
+  // Case insensitive search:
+  string c = attribute;
+  std::transform(c.begin(), c.end(), c.begin(), ::tolower);
+
+  // Check, if this should be filtered:
+  bool is_filtered =  (sdpalinesfilter == Whitelist) ^
+    (sdpalinesfilter_list.find(c) != sdpalinesfilter_list.end());
+
+  DBG("%s (%s) is_filtered: %s\n", attribute.c_str(), c.c_str(),
+      is_filtered?"true":"false");
+
+  return is_filtered;
+}
+
+static void filterSDPAttributes(std::vector<SdpAttribute>& attributes,
   FilterType sdpalinesfilter, const std::set<string>& sdpalinesfilter_list) {
 
-  std::vector<SdpAttribute> res;
+  // filter in place, keeping the order
+  std::vector<SdpAttribute>::iterator w_it = attributes.begin();
   for (std::vector<SdpAttribute>::iterator a_it =
     attributes.begin(); a_it != attributes.end(); a_it++) {
-    
-    // Case insensitive search:
-    string c = a_it->attribute;
-    std::transform(c.begin(), c.end(), c.begin(), ::tolower);
-    
-    // Check, if this should be filtered:
-    bool is_filtered =  (sdpalinesfilter == Whitelist) ^
-      (sdpalinesfilter_list.find(c) != sdpalinesfilter_list.end());
-
-    DBG("%s (%s) is_filtered: %s\n", a_it->attribute.c_str(), c.c_str(), 
-     	  is_filtered?"true":"false");
- 
-    // If it is not filtered, just add it to the list:
-    if (!is_filtered)
-	res.push_back(*a_it);
+
+    if (isFilteredAttribute(a_it->attribute, sdpalinesfilter, sdpalinesfilter_list))
+      continue;
+
+    if (w_it != a_it)
+      *w_it = *a_it;
+    w_it++;
   }
-  return res;
+  attributes.erase(w_it, attributes.end());
 }
 
 int filterSDPalines(AmSdp& sdp, const vector<FilterEntry>& filter_list) {
@@ -197,15 +208,13 @@ int filterSDPalines(AmSdp& sdp, const vector<FilterEntry>& filter_list) {
       continue;
   
     // We start with per Session-alines
-    sdp.attributes =
-      filterSDPAttributes(sdp.attributes, sdpalinesfilter, sdpalinesfilter_list);
+    filterSDPAttributes(sdp.attributes, sdpalinesfilter, sdpalinesfilter_list);
 
     for (std::vector<SdpMedia>::iterator m_it =
 	   sdp.media.begin(); m_it != sdp.media.end(); m_it++) {
       SdpMedia& media = *m_it;
       // todo: what if no payload supported any more?
-      media.attributes =
-	filterSDPAttributes(media.attributes, sdpalinesfilter, sdpalinesfilter_list);
+      filterSDPAttributes(media.attributes, sdpalinesfilter, sdpalinesfilter_list);
     }
   }
 
@@ -243,4 +252,130 @@ int normalizeSDP(AmSdp& sdp, bool anonymize_sdp, const string &advertised_ip) {
   return 0;
 }
 
+// media type as seen by filterMedia (see SdpMedia::type2str)
+static string mediaTypeStr(const char* s, size_t len) {
+  static const char* types[] = { "audio", "video", "application",
+				 "text", "message", "image", NULL };
+  for (int i=0; types[i]; i++) {
+    if (strlen(types[i]) == len && !memcmp(types[i], s, len))
+      return types[i];
+  }
+  return "<unknown media type>";
+}
+
+// media level attributes not handled by filterSDPalines (parsed by AmSdp)
+static bool isMediaParamAttribute(const char* s, size_t len) {
+  static const char* attrs[] = { "rtpmap", "fmtp", "direction", "sendrecv",
+				 "sendonly", "recvonly", "inactive", NULL };
+  for (int i=0; attrs[i]; i++) {
+    if (strlen(attrs[i]) == len && !memcmp(attrs[i], s, len))
+      return true;
+  }
+  return false;
+}
+
+static bool isFilteredMedia(const string& type, const vector<FilterEntry>& filter_list) {
+  for (vector<FilterEntry>::const_iterator i = filter_list.begin(); i != filter_list.end(); ++i) {
+    if (!isActiveFilter(i->filter_type)) continue;
+    if ((i->filter_type == Whitelist) ^ (i->filter_list.find(type) != i->filter_list.end()))
+      return true;
+  }
+  return false;
+}
+
+static bool isFilteredAttribute(const string& attribute, const vector<FilterEntry>& filter_list) {
+  for (vector<FilterEntry>::const_iterator i = filter_list.begin(); i != filter_list.end(); ++i) {
+    if (!isActiveFilter(i->filter_type)) continue;
+    if (isFilteredAttribute(attribute, i->filter_type, i->filter_list))
+      return true;
+  }
+  return false;
+}
+
+int filterSDPLines(const char* sdp, size_t len, string& out,
+		   const vector<FilterEntry>& mediafilter,
+		   const vector<FilterEntry>& alinesfilter)
+{
+  unsigned int media_lines = 0;
+  unsigned int filtered_out = 0;
+
+  out.clear();
+  out.reserve(len);
+
+  const char* end = sdp + len;
+  const char* line = sdp;
+  while (line < end) {
+    // line including its line break
+    const char* next = (const char*)memchr(line, '\n', end - line);
+    next = next ? next + 1 : end;
+
+    // line content without line break
+    const char* le = next;
+    while (le > line && (le[-1] == '\n' || le[-1] == '\r'))
+      le--;
+
+    if (le - line < 2 || line[1] != '=') {
+      out.append(line, next - line);
+      line = next;
+      continue;
+    }
+
+    if (line[0] == 'm') {
+      media_lines++;
+
+      // m=<media> <port>[/<number of ports>] <proto> <fmt> ...
+      const char* type_end = (const char*)memchr(line + 2, ' ', le - line - 2);
+      const char* port_end = NULL;
+      if (type_end) {
+	port_end = type_end + 1;
+	while (port_end < le && *port_end != ' ' && *port_end != '/')
+	  port_end++;
+      }
+
+      if (!type_end || port_end == type_end + 1) {
+	out.append(line, next - line);
+	line = next;
+	continue;
+      }
+
+      bool inactive = (port_end - type_end - 1 == 1) && (type_end[1] == '0');
+      if (!inactive && !mediafilter.empty()) {
+	string type = mediaTypeStr(line + 2, type_end - line - 2);
+	DBG("checking whether to filter out '%s'\n", type.c_str());
+	if (isFilteredMedia(type, mediafilter)) {
+	  out.append(line, type_end + 1 - line);
+	  out += '0';
+	  out.append(port_end, next - port_end);
+	  filtered_out++;
+	  line = next;
+	  continue;
+	}
+      }
+
+      out.append(line, next - line);
+      line = next;
+      continue;
+    }
+
+    if (line[0] == 'a' && !alinesfilter.empty()) {
+      const char* name_end = (const char*)memchr(line + 2, ':', le - line - 2);
+      if (!name_end) name_end = le;
 
+      if (!(media_lines && isMediaParamAttribute(line + 2, name_end - line - 2)) &&
+	  isFilteredAttribute(string(line + 2, name_end - line - 2), alinesfilter)) {
+	line = next;
+	continue;
+      }
+    }
+
+    out.append(line, next - line);
+    line = next;
+  }
+
+  if (filtered_out > 0 && filtered_out == media_lines) {
+    DBG("all streams were marked as inactive\n");
+    return -488;
+  }
+
+  return 0;
+}
@@ -39,6 +39,18 @@ int filterSDP(AmSdp& sdp, const vector<FilterEntry>& filter_list);
 int filterSDPalines(AmSdp& sdp, const vector<FilterEntry>& filter_list);
 int filterMedia(AmSdp& sdp, const vector<FilterEntry>& filter_list);
 
+/**
+ * Apply media type and a-line filters (as filterMedia and filterSDPalines)
+ * while copying the SDP line by line into out, i.e. without parsing it into
+ * AmSdp and printing it again. Lines not affected by the filters are kept
+ * verbatim.
+ *
+ * @return 0 or -488 if all media streams were filtered out
+ */
+int filterSDPLines(const char* sdp, size_t len, string& out,
+		   const vector<FilterEntry>& mediafilter,
+		   const vector<FilterEntry>& alinesfilter);
+
 /** normalize SDP, fixing some common issues and anonymize (IP addresses
  * replaced in such case by advertised_ip) */
 int normalizeSDP(AmSdp& sdp, bool anonymize_sdp, const string &advertised_ip);
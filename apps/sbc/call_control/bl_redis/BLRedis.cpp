@@ -58,6 +58,11 @@ EXPORT_PLUGIN_CLASS_FACTORY(CCBLRedisFactory, MOD_NAME);
 
 CCBLRedis* CCBLRedis::_instance=0;
 
+static int async_reply_handler(redisContext* c, redisReply* reply, bool& hit)
+{
+  return CCBLRedis::instance()->handle_redis_reply(c, reply, hit);
+}
+
 CCBLRedis* CCBLRedis::instance()
 {
     if(!_instance)
@@ -66,6 +71,8 @@ CCBLRedis* CCBLRedis::instance()
 }
 
 CCBLRedis::CCBLRedis()
+  : pass_on_bl_unavailable(false), max_retries(0),
+    full_logging(false), async_mode(false), max_wait(0)
 {
 }
 
@@ -79,10 +86,15 @@ int CCBLRedis::onLoad() {
   string redis_reconnect_timers = "5,10,20,50,100,500,1000";
   string redis_connections = "10";
   string redis_max_conn_wait = "1000";
+  string redis_mode = "sync";
   pass_on_bl_unavailable = false;
 
   full_logging = false;
 
+  unsigned int cache_hit_ttl = 0;
+  unsigned int cache_miss_ttl = 0;
+  unsigned int cache_max_entries = 100000;
+
   if(cfg.loadPluginConf(MOD_NAME)) {
     INFO(MOD_NAME "configuration  file not found, assuming default "
 	 "configuration is fine\n");
@@ -96,6 +108,19 @@ int CCBLRedis::onLoad() {
     full_logging = cfg.getParameter("redis_full_logging", "no")=="yes";
 
     pass_on_bl_unavailable = cfg.getParameter("pass_on_bl_unavailable", "no")=="yes";
+
+    redis_mode = cfg.getParameter("redis_mode", redis_mode);
+    cache_hit_ttl = cfg.getParameterInt("redis_cache_hit_ttl", cache_hit_ttl);
+    cache_miss_ttl = cfg.getParameterInt("redis_cache_miss_ttl", cache_miss_ttl);
+    cache_max_entries =
+      cfg.getParameterInt("redis_cache_max_entries", cache_max_entries);
+  }
+
+  if (redis_mode == "async") {
+    async_mode = true;
+  } else if (redis_mode != "sync") {
+    ERROR("could not understand redis_mode=%s\n", redis_mode.c_str());
+    return -1;
   }
 
   unsigned int i_redis_connections;
@@ -129,6 +154,17 @@ int CCBLRedis::onLoad() {
     reconnect_timers.push_back(r);
   }
 
+  max_wait = i_redis_max_conn_wait;
+  result_cache.set_config(cache_hit_ttl, cache_miss_ttl, cache_max_entries);
+
+  if (async_mode) {
+    DBG("using pipelined REDIS queries on a single connection\n");
+    async_pipeline.set_config(redis_server, i_redis_port, reconnect_timers,
+			      async_reply_handler);
+    async_pipeline.start();
+    return 0;
+  }
+
   connection_pool.set_config(redis_server, i_redis_port,
 			     reconnect_timers, i_redis_max_conn_wait);
   connection_pool.add_connections(i_redis_connections);
@@ -179,10 +215,13 @@ void CCBLRedis::invoke(const string& method, const AmArg& args, AmArg& ret)
     // 	args[CC_API_PARAMS_TIMESTAMPS][CC_API_TS_END_SEC].asInt(),
     // 	args[CC_API_PARAMS_TIMESTAMPS][CC_API_TS_END_USEC].asInt()
     // 	);
+  } else if(method == "getStats"){
+    getStats(ret);
   } else if(method == "_list"){
     ret.push("start");
     ret.push("connect");
     ret.push("end");
+    ret.push("getStats");
   }
   else
     throw AmDynInvoke::NotImplemented(method);
@@ -302,24 +341,28 @@ void CCBLRedis::start(const string& cc_name, const string& ltag,
   }
 
   unsigned int argv_index=0;
-  string query;
+  string query, cache_key;
   for (; argv_index<argv_max;argv_index++) {
     argv[argv_index] = values["argv_"+int2str(argv_index)].asCStr();
     argvlen[argv_index] = strlen(argv[argv_index]);
     if (query.length())
       query+=" ";
     query+=string(argv[argv_index], argvlen[argv_index]);
+    cache_key+=int2str((unsigned int)argvlen[argv_index])+":"+
+      string(argv[argv_index], argvlen[argv_index]);
   }
 
   DBG("query to REDIS: '%s'\n", query.c_str());
 
   bool hit = false;
 
-  unsigned int retries = 0;
-  for (;retries<max_retries;retries++) {
-    redisContext* redis_context = connection_pool.getActiveConnection();
-    if (NULL == redis_context) {
-      INFO("no connection to REDIS\n");
+  if (!result_cache.get(cache_key, hit)) {
+
+    int ret = async_mode ?
+      async_pipeline.query(argv_index, argv, argvlen, max_wait, hit) :
+      query_sync(argv_index, argv, argvlen, hit);
+
+    if (ret != RWT_E_OK) {
       if (!pass_on_bl_unavailable) {
 	res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
 	res_cmd[SBC_CC_REFUSE_CODE] = 500;
@@ -328,12 +371,45 @@ void CCBLRedis::start(const string& cc_name, const string& ltag,
       return;
     }
 
+    result_cache.put(cache_key, hit);
+  }
+  else {
+    DBG("REDIS result cached: %s\n", hit ? "hit" : "no hit");
+  }
+
+  if (hit) {
+    if (values.hasMember("action") && isArgCStr(values["action"]) && 
+	values["action"] == "drop") {
+      DBG("Blacklist: Dropping call\n");
+      res_cmd[SBC_CC_ACTION] = SBC_CC_DROP_ACTION;
+    } else {
+      DBG("Blacklist: Refusing call\n");
+      res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
+      res_cmd[SBC_CC_REFUSE_CODE] = 403;
+      res_cmd[SBC_CC_REFUSE_REASON] = "Unauthorized";  
+    }
+  }
+}
+
+int CCBLRedis::query_sync(unsigned int argc, const char** argv,
+			  const size_t* argvlen, bool& hit)
+{
+  unsigned int retries = 0;
+  for (;retries<max_retries;retries++) {
+    redisContext* redis_context = connection_pool.getActiveConnection();
+    if (NULL == redis_context) {
+      INFO("no connection to REDIS\n");
+      return RWT_E_CONNECTION;
+    }
+
     DBG("using redis connection [%p]\n", redis_context);
 
     redisReply* reply = (redisReply *)
-      redisCommandArgv(redis_context, argv_index, argv, argvlen);
+      redisCommandArgv(redis_context, argc, argv, argvlen);
 
     int ret = handle_redis_reply(redis_context, reply, hit);
+    if (reply)
+      freeReplyObject(reply);
 
     if (ret == RWT_E_CONNECTION) {
       WARN("connection [%p] failed - retrying\n", redis_context);
@@ -342,30 +418,22 @@ void CCBLRedis::start(const string& cc_name, const string& ltag,
     }
 
     connection_pool.returnConnection(redis_context);
-    break;
-  }
-
-  if (retries == max_retries) {
-    if (!pass_on_bl_unavailable) {
-      res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-      res_cmd[SBC_CC_REFUSE_CODE] = 500;
-      res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;
-    }
-    return;
+    return ret;
   }
 
+  return RWT_E_CONNECTION;
+}
 
-  if (hit) {
-    if (values.hasMember("action") && isArgCStr(values["action"]) && 
-	values["action"] == "drop") {
-      DBG("Blacklist: Dropping call\n");
-      res_cmd[SBC_CC_ACTION] = SBC_CC_DROP_ACTION;
-    } else {
-      DBG("Blacklist: Refusing call\n");
-      res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-      res_cmd[SBC_CC_REFUSE_CODE] = 403;
-      res_cmd[SBC_CC_REFUSE_REASON] = "Unauthorized";  
-    }
+void CCBLRedis::getStats(AmArg& ret)
+{
+  map<string,unsigned long long> stats;
+  if (async_mode)
+    async_pipeline.getStats(stats);
+  result_cache.getStats(stats);
+
+  for (map<string,unsigned long long>::iterator it = stats.begin();
+       it != stats.end(); it++) {
+    ret[it->first] = (int)it->second;
   }
 }
 
@@ -28,6 +28,7 @@
 
 #include "AmApi.h"
 #include "RedisConnectionPool.h"
+#include "RedisAsyncPipeline.h"
 
 #include "hiredis/hiredis.h"
 
@@ -53,7 +54,10 @@ class CCBLRedis : public AmDynInvoke
   unsigned int max_retries;
 
   bool full_logging;
-  int handle_redis_reply(redisContext* redis_context, redisReply* reply, bool& hit);
+
+  // pipelined mode: one connection, queries from all calls batched
+  bool async_mode;
+  unsigned int max_wait;
 
   void start(const string& cc_name, const string& ltag, SBCCallProfile* call_profile,
 	     int start_ts_sec, int start_ts_usec, const AmArg& values,
@@ -65,6 +69,13 @@ class CCBLRedis : public AmDynInvoke
 	   int end_ts_sec, int end_ts_usec);
 
   RedisConnectionPool connection_pool;
+  RedisAsyncPipeline  async_pipeline;
+  BLRedisResultCache  result_cache;
+
+  int query_sync(unsigned int argc, const char** argv, const size_t* argvlen,
+		 bool& hit);
+
+  void getStats(AmArg& ret);
 
  public:
   CCBLRedis();
@@ -72,6 +83,8 @@ class CCBLRedis : public AmDynInvoke
   static CCBLRedis* instance();
   void invoke(const string& method, const AmArg& args, AmArg& ret);
   int onLoad();
+
+  int handle_redis_reply(redisContext* redis_context, redisReply* reply, bool& hit);
 };
 
 #endif 
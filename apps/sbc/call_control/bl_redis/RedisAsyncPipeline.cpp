@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2012 Stefan Sayer
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "RedisAsyncPipeline.h"
+#include "BLRedis.h" // RWT_E_*
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+
+#include <event2/event.h>
+#include "hiredis/adapters/libevent.h"
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static unsigned long long now_ms()
+{
+  struct timeval now;
+  gettimeofday(&now,NULL);
+  return (unsigned long long)now.tv_sec * 1000ULL + now.tv_usec / 1000;
+}
+
+RedisAsyncQuery::RedisAsyncQuery(unsigned int argc, const char** _argv,
+				 const size_t* argvlen)
+  : done(false), result(RWT_E_CONNECTION), hit(false)
+{
+  for(unsigned int i=0; i<argc; i++)
+    argv.push_back(string(_argv[i], argvlen[i]));
+}
+
+void RedisAsyncQuery::complete(int res, bool is_hit)
+{
+  result = res;
+  hit = is_hit;
+  done.set(true);
+}
+
+RedisAsyncPipeline::RedisAsyncPipeline()
+  : ev_base(NULL), ev_flush(NULL), ev_reconnect(NULL),
+    ac(NULL), connected(false), reply_handler(NULL),
+    redis_port(0), retry_index(0)
+{
+  // session threads wake up the event loop through this pipe
+  if(pipe(flush_fds) < 0) {
+    ERROR("pipe(): %s\n", strerror(errno));
+    flush_fds[0] = flush_fds[1] = -1;
+  }
+  else {
+    fcntl(flush_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(flush_fds[1], F_SETFL, O_NONBLOCK);
+  }
+
+  ev_base = event_base_new();
+  ev_flush = event_new(ev_base, flush_fds[0], EV_READ|EV_PERSIST,
+		       flush_cb, this);
+  ev_reconnect = evtimer_new(ev_base, reconnect_cb, this);
+}
+
+RedisAsyncPipeline::~RedisAsyncPipeline()
+{
+  event_free(ev_reconnect);
+  event_free(ev_flush);
+  event_base_free(ev_base);
+  close(flush_fds[0]);
+  close(flush_fds[1]);
+}
+
+void RedisAsyncPipeline::set_config(const string& server, unsigned int port,
+				    const vector<unsigned int>& timers,
+				    RedisReplyHandler handler)
+{
+  reply_handler = handler;
+  redis_server = server;
+  redis_port = port;
+  retry_timers = timers;
+  retry_index = 0;
+}
+
+void RedisAsyncPipeline::connect()
+{
+  ac = redisAsyncConnect(redis_server.c_str(), redis_port);
+  if(!ac || ac->err) {
+    DBG("connection to %s:%u failed: '%s'\n", redis_server.c_str(),
+	redis_port, ac ? ac->errstr : "out of memory");
+    if(ac) redisAsyncFree(ac);
+    ac = NULL;
+    scheduleReconnect();
+    return;
+  }
+
+  ac->data = this;
+  redisLibeventAttach(ac, ev_base);
+  redisAsyncSetConnectCallback(ac, connect_cb);
+  redisAsyncSetDisconnectCallback(ac, disconnect_cb);
+}
+
+void RedisAsyncPipeline::scheduleReconnect()
+{
+  unsigned int to_ms = 50;
+  if(retry_timers.size()) {
+    to_ms = retry_timers[retry_index];
+    if(retry_index < retry_timers.size()-1)
+      retry_index++;
+  }
+
+  DBG("waiting for retry %u ms (index %u)\n", to_ms, retry_index);
+
+  struct timeval tv;
+  tv.tv_sec = to_ms / 1000;
+  tv.tv_usec = (to_ms % 1000) * 1000;
+  evtimer_add(ev_reconnect, &tv);
+}
+
+void RedisAsyncPipeline::connect_cb(const redisAsyncContext* c, int status)
+{
+  RedisAsyncPipeline* p = (RedisAsyncPipeline*)c->data;
+
+  if(status != REDIS_OK) {
+    DBG("connection to %s:%u failed: '%s'\n", p->redis_server.c_str(),
+	p->redis_port, c->errstr);
+    // context is freed by hiredis
+    p->ac = NULL;
+    p->connected.set(false);
+    p->scheduleReconnect();
+    return;
+  }
+
+  DBG("successfully connected to server %s:%u [%p]\n",
+      p->redis_server.c_str(), p->redis_port, c);
+  p->connected.set(true);
+  p->retry_index = 0;
+
+  // queries might have been waiting for the connection
+  p->flush();
+}
+
+void RedisAsyncPipeline::disconnect_cb(const redisAsyncContext* c, int status)
+{
+  RedisAsyncPipeline* p = (RedisAsyncPipeline*)c->data;
+
+  if(status != REDIS_OK) {
+    WARN("connection to %s:%u lost: '%s'\n", p->redis_server.c_str(),
+	 p->redis_port, c->errstr);
+  }
+
+  // pending replies have already been called back
+  // with a NULL reply by hiredis
+  p->ac = NULL;
+  p->connected.set(false);
+  p->scheduleReconnect();
+}
+
+void RedisAsyncPipeline::reconnect_cb(int sd, short what, void* ctx)
+{
+  ((RedisAsyncPipeline*)ctx)->connect();
+}
+
+void RedisAsyncPipeline::flush_cb(int sd, short what, void* ctx)
+{
+  char buf[64];
+  while(read(sd, buf, sizeof(buf)) > 0);
+
+  ((RedisAsyncPipeline*)ctx)->flush();
+}
+
+void RedisAsyncPipeline::reply_cb(redisAsyncContext* c, void* r, void* privdata)
+{
+  RedisAsyncQuery* q = (RedisAsyncQuery*)privdata;
+  redisReply* reply = (redisReply*)r;
+
+  bool hit = false;
+  int res = RWT_E_CONNECTION;
+  RedisAsyncPipeline* p = (RedisAsyncPipeline*)c->data;
+  if(reply) {
+    res = p->reply_handler(&c->c, reply, hit);
+  }
+
+  q->complete(res, hit);
+  dec_ref(q);
+}
+
+void RedisAsyncPipeline::flush()
+{
+  list<RedisAsyncQuery*> batch;
+  queue_mut.lock();
+  batch.swap(pending);
+  queue_mut.unlock();
+
+  if(batch.empty())
+    return;
+
+  if(!connected.get()) {
+    if(ac) {
+      // still connecting: sent from connect_cb
+      queue_mut.lock();
+      pending.splice(pending.begin(), batch);
+      queue_mut.unlock();
+      return;
+    }
+
+    for(list<RedisAsyncQuery*>::iterator it = batch.begin();
+	it != batch.end(); it++) {
+      (*it)->complete(RWT_E_CONNECTION, false);
+      dec_ref(*it);
+    }
+    return;
+  }
+
+  // hiredis only buffers the commands here: they are all
+  // written at once as soon as the socket becomes writable.
+  for(list<RedisAsyncQuery*>::iterator it = batch.begin();
+      it != batch.end(); it++) {
+
+    RedisAsyncQuery* q = *it;
+
+    vector<const char*> argv(q->argv.size());
+    vector<size_t> argvlen(q->argv.size());
+    for(size_t i=0; i<q->argv.size(); i++) {
+      argv[i] = q->argv[i].data();
+      argvlen[i] = q->argv[i].length();
+    }
+
+    if(redisAsyncCommandArgv(ac, reply_cb, q, argv.size(),
+			     &argv[0], &argvlen[0]) != REDIS_OK) {
+      q->complete(RWT_E_WRITE, false);
+      dec_ref(q);
+    }
+  }
+
+  batches.inc();
+  queries.inc(batch.size());
+}
+
+int RedisAsyncPipeline::query(unsigned int argc, const char** argv,
+			      const size_t* argvlen, unsigned int timeout_ms,
+			      bool& hit)
+{
+  RedisAsyncQuery* q = new RedisAsyncQuery(argc, argv, argvlen);
+  inc_ref(q); // ours
+  inc_ref(q); // pipeline's
+
+  queue_mut.lock();
+  pending.push_back(q);
+  queue_mut.unlock();
+
+  char c = 0;
+  write(flush_fds[1], &c, 1); // EAGAIN: wake-up already pending
+
+  int res = RWT_E_CONNECTION;
+  if(q->done.wait_for_to(timeout_ms)) {
+    res = q->result;
+    hit = q->hit;
+  }
+  else {
+    WARN("timeout waiting for REDIS reply (waited %ums)\n", timeout_ms);
+  }
+
+  dec_ref(q);
+  return res;
+}
+
+void RedisAsyncPipeline::getStats(map<string,unsigned long long>& stats)
+{
+  stats["queries"] = queries.get();
+  stats["batches"] = batches.get();
+  stats["connected"] = connected.get() ? 1 : 0;
+}
+
+void RedisAsyncPipeline::run()
+{
+  DBG("RedisAsyncPipeline thread starting\n");
+
+  // also keeps the event loop running while not connected
+  event_add(ev_flush, NULL);
+  connect();
+
+  event_base_loop(ev_base, 0);
+
+  if(ac) {
+    redisAsyncDisconnect(ac);
+    ac = NULL;
+  }
+
+  DBG("RedisAsyncPipeline thread finished\n");
+}
+
+void RedisAsyncPipeline::on_stop()
+{
+  event_base_loopbreak(ev_base);
+}
+
+BLRedisResultCache::BLRedisResultCache()
+  : hit_ttl(0), miss_ttl(0), max_entries(0)
+{
+}
+
+void BLRedisResultCache::set_config(unsigned int hit_ttl_ms,
+				    unsigned int miss_ttl_ms,
+				    unsigned int max)
+{
+  hit_ttl = hit_ttl_ms;
+  miss_ttl = miss_ttl_ms;
+  max_entries = max;
+}
+
+bool BLRedisResultCache::get(const string& key, bool& hit)
+{
+  bool res = false;
+  lookups.inc();
+
+  entries_mut.lock();
+  EntryMap::iterator it = entries.find(key);
+  if(it != entries.end()) {
+    if(it->second.expires > now_ms()) {
+      hit = it->second.hit;
+      res = true;
+    }
+    else {
+      erase(it);
+    }
+  }
+  entries_mut.unlock();
+
+  if(res) found.inc();
+  return res;
+}
+
+void BLRedisResultCache::erase(EntryMap::iterator it)
+{
+  by_expiry.erase(it->second.expiry_it);
+  entries.erase(it);
+}
+
+void BLRedisResultCache::purgeExpired(unsigned long long now)
+{
+  while(!by_expiry.empty() && (by_expiry.begin()->first <= now))
+    erase(entries.find(by_expiry.begin()->second));
+}
+
+void BLRedisResultCache::put(const string& key, bool hit)
+{
+  unsigned int ttl = hit ? hit_ttl : miss_ttl;
+  if(!ttl)
+    return;
+
+  unsigned long long now = now_ms();
+
+  entries_mut.lock();
+  EntryMap::iterator it = entries.find(key);
+  if(it != entries.end()) {
+    // re-inserted with the new expiry
+    erase(it);
+  }
+
+  if(max_entries && (entries.size() >= max_entries)) {
+    purgeExpired(now);
+    // still full: drop the entries expiring first
+    while(!by_expiry.empty() && (entries.size() >= max_entries))
+      erase(entries.find(by_expiry.begin()->second));
+  }
+
+  Entry& e = entries[key];
+  e.hit = hit;
+  e.expires = now + ttl;
+  e.expiry_it = by_expiry.insert(std::make_pair(e.expires, key));
+  entries_mut.unlock();
+}
+
+void BLRedisResultCache::getStats(map<string,unsigned long long>& stats)
+{
+  entries_mut.lock();
+  stats["cache_entries"] = entries.size();
+  entries_mut.unlock();
+  stats["cache_lookups"] = lookups.get();
+  stats["cache_found"] = found.get();
+}
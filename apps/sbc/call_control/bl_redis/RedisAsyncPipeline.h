@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2012 Stefan Sayer
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _RedisAsyncPipeline_h_
+#define _RedisAsyncPipeline_h_
+
+#include "hiredis/hiredis.h"
+#include "hiredis/async.h"
+
+#include "AmThread.h"
+#include "atomic_types.h"
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+
+using std::string;
+using std::list;
+using std::vector;
+using std::map;
+using std::multimap;
+
+struct event_base;
+struct event;
+
+/**
+ * Evaluates a reply (NULL if the connection failed):
+ * returns RWT_E_OK and sets hit, or an error code.
+ */
+typedef int (*RedisReplyHandler)(redisContext* c, redisReply* reply, bool& hit);
+
+/**
+ * One blacklist query, shared by the waiting
+ * session thread and the pipeline thread.
+ */
+class RedisAsyncQuery
+  : public atomic_ref_cnt
+{
+public:
+  vector<string> argv;
+
+  AmCondition<bool> done;
+  int  result;
+  bool hit;
+
+  RedisAsyncQuery(unsigned int argc, const char** argv, const size_t* argvlen);
+
+  void complete(int res, bool is_hit);
+};
+
+/**
+ * Asynchronous REDIS client:
+ *
+ * All queries from the session threads are queued and
+ * sent from the pipeline thread over a single connection.
+ * Queries arriving during the same event loop iteration are
+ * written in one go (pipelined), so that concurrent calls share
+ * one round-trip instead of one pooled connection each.
+ */
+class RedisAsyncPipeline
+  : public AmThread
+{
+  struct event_base* ev_base;
+  int                flush_fds[2];
+  struct event*      ev_flush;
+  struct event*      ev_reconnect;
+
+  redisAsyncContext* ac;
+  AmSharedVar<bool>  connected; // also read by getStats
+
+  RedisReplyHandler  reply_handler;
+
+  AmMutex                queue_mut;
+  list<RedisAsyncQuery*> pending;
+
+  string redis_server;
+  unsigned int redis_port;
+
+  vector<unsigned int> retry_timers;
+  unsigned int retry_index;
+
+  // stats
+  atomic_int64 queries;
+  atomic_int64 batches;
+
+  void connect();
+  void scheduleReconnect();
+  void flush();
+
+  static void flush_cb(int sd, short what, void* ctx);
+  static void reconnect_cb(int sd, short what, void* ctx);
+  static void connect_cb(const redisAsyncContext* c, int status);
+  static void disconnect_cb(const redisAsyncContext* c, int status);
+  static void reply_cb(redisAsyncContext* c, void* reply, void* privdata);
+
+public:
+  RedisAsyncPipeline();
+  ~RedisAsyncPipeline();
+
+  void set_config(const string& server, unsigned int port,
+		  const vector<unsigned int>& timers,
+		  RedisReplyHandler handler);
+
+  /**
+   * Queue a query and wait at most timeout_ms for the reply.
+   * Returns RWT_E_OK, RWT_E_CONNECTION or RWT_E_WRITE.
+   */
+  int query(unsigned int argc, const char** argv, const size_t* argvlen,
+	    unsigned int timeout_ms, bool& hit);
+
+  void getStats(map<string,unsigned long long>& stats);
+
+  void run();
+  void on_stop();
+};
+
+/**
+ * Local TTL cache of blacklist query results
+ * (positive and negative results have separate TTLs).
+ * If full, the entries expiring first are dropped.
+ */
+class BLRedisResultCache
+{
+  typedef multimap<unsigned long long,string> ExpiryIndex;
+
+  struct Entry {
+    bool hit;
+    unsigned long long expires; // ms
+    ExpiryIndex::iterator expiry_it;
+  };
+
+  typedef map<string,Entry> EntryMap;
+
+  EntryMap    entries;
+  ExpiryIndex by_expiry;
+  AmMutex     entries_mut;
+
+  unsigned int hit_ttl;
+  unsigned int miss_ttl;
+  unsigned int max_entries;
+
+  // stats
+  atomic_int64 lookups;
+  atomic_int64 found;
+
+  void erase(EntryMap::iterator it);
+  void purgeExpired(unsigned long long now);
+
+public:
+  BLRedisResultCache();
+
+  void set_config(unsigned int hit_ttl_ms, unsigned int miss_ttl_ms,
+		  unsigned int max_entries);
+
+  bool enabled() const { return hit_ttl || miss_ttl; }
+
+  bool get(const string& key, bool& hit);
+  void put(const string& key, bool hit);
+
+  void getStats(map<string,unsigned long long>& stats);
+};
+
+#endif
@@ -107,6 +107,8 @@ void CallTimer::invoke(const string& method, const AmArg& args, AmArg& ret)
     // unused
   } else if (method == "end"){
     // unused
+  } else if (method == "getTypedInterfaceHandler"){
+    ret.push((AmObject*)this);
   } else if (method == "_list"){
     ret.push("start");
     ret.push("connect");
@@ -128,31 +130,39 @@ void CallTimer::start(const AmArg& values, int timer_id, AmArg& res) {
       timer = values["timer"].asInt();
     }
   }
+
+  CCStartResult start_res;
+  start(timer, timer_id, start_res);
+  start_res.toDIResult(res);
+}
+
+void CallTimer::start(const CCStartParams& params, CCStartResult& res) {
+
+  int timer = default_timer;
+
+  map<string, string>::const_iterator it = params.values.find("timer");
+  if (it != params.values.end() && !it->second.empty())
+    str2int(it->second, timer);
+
+  start(timer, params.timer_id, res);
+}
+
+void CallTimer::start(int timer, int timer_id, CCStartResult& res) {
+
   DBG("got timer value '%i'\n", timer);
 
   if (timer==0) {
-    res.push(AmArg());
-    AmArg& res_cmd = res.back();
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = 503;
-    res_cmd[SBC_CC_REFUSE_REASON] = "Service Unavailable";
+    res.refuse(503, "Service Unavailable");
     return;
   }
 
   if (timer<0) {
     ERROR("configuration error: timer missing for call timer call control!\n");
-    res.push(AmArg());
-    AmArg& res_cmd = res.back();
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = 500;
-    res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;
+    res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
     return;
   }
-  res.push(AmArg());
-  AmArg& res_cmd = res.back();
 
   // Set Timer:
   DBG("setting timer ID %i, timeout %i\n", timer_id, timer);
-  res_cmd[SBC_CC_ACTION] = SBC_CC_SET_CALL_TIMER_ACTION;
-  res_cmd[SBC_CC_TIMER_TIMEOUT] = timer;
+  res.setCallTimer(timer);
 }
@@ -29,17 +29,19 @@
 #include "AmApi.h"
 
 #include "SBCCallProfile.h"
+#include "ExtendedCCInterface.h"
 
 /**
  * sample call control module
  */
-class CallTimer : public AmDynInvoke
+class CallTimer : public AmDynInvoke, public TypedCCInterface, public AmObject
 {
   static CallTimer* _instance;
 
   int default_timer;
 
   void start(const AmArg& values, int timer_id, AmArg& res);
+  void start(int timer, int timer_id, CCStartResult& res);
 
  public:
   CallTimer();
@@ -47,6 +49,9 @@ class CallTimer : public AmDynInvoke
   static CallTimer* instance();
   void invoke(const string& method, const AmArg& args, AmArg& ret);
   int onLoad();
+
+  /* from TypedCCInterface */
+  void start(const CCStartParams& params, CCStartResult& res);
 };
 
 #endif 
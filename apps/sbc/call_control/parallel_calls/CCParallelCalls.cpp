@@ -35,10 +35,16 @@
 
 #define SBCVAR_PARALLEL_CALLS_UUID "uuid"
 
+// keys in the counter store
+#define PARALLEL_CALLS_KEY(uuid) ("pcalls::" + (uuid))
+#define CALL_RATE_KEY(uuid)      ("pcalls_cps::" + (uuid))
+
 unsigned int CCParallelCalls::refuse_code = 402;
 string CCParallelCalls::refuse_reason = "Too Many Simultaneous Calls";
+string CCParallelCalls::cps_refuse_reason = "Too Many Calls Per Second";
 
 CCParallelCalls::CCParallelCalls()
+  : counters(NULL)
 {
 }
 
@@ -47,6 +53,8 @@ CCParallelCalls::~CCParallelCalls() { }
 int CCParallelCalls::onLoad() {
   AmConfigReader cfg;
 
+  counters = CounterStore::instance();
+
   if(cfg.loadFile(AmConfig::ModConfigPath + string(MOD_NAME ".conf"))) {
     INFO(MOD_NAME "configuration  file (%s) not found, "
   	 "assuming default configuration is fine\n",
@@ -57,6 +65,9 @@ int CCParallelCalls::onLoad() {
   refuse_reason = cfg.hasParameter("refuse_reason") ?
     cfg.getParameter("refuse_reason") : refuse_reason;
 
+  cps_refuse_reason = cfg.hasParameter("cps_refuse_reason") ?
+    cfg.getParameter("cps_refuse_reason") : cps_refuse_reason;
+
   if (cfg.hasParameter("refuse_code")) {
     if (str2i(cfg.getParameter("refuse_code"), refuse_code)) {
       ERROR("refuse_code '%s' not understood\n", cfg.getParameter("refuse_code").c_str());
@@ -92,6 +103,8 @@ void CCParallelCalls::invoke(const string& method, const AmArg& args, AmArg& ret
 
   } else if(method == CC_INTERFACE_MAND_VALUES_METHOD){
     ret.push("uuid");
+  } else if(method == "getTypedInterfaceHandler"){
+    ret.push((AmObject*)this);
   } else if(method == "_list"){
     ret.push("start");
     ret.push("connect");
@@ -104,71 +117,92 @@ void CCParallelCalls::invoke(const string& method, const AmArg& args, AmArg& ret
 void CCParallelCalls::start(const string& cc_namespace,
 			    const string& ltag, SBCCallProfile* call_profile,
 			    const AmArg& values, AmArg& res) {
-#define REFUSE_WITH_SERVER_INTERNAL_ERROR				\
-  res.push(AmArg());							\
-  AmArg& res_cmd = res[0];						\
-  res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;			\
-  res_cmd[SBC_CC_REFUSE_CODE] = 500;					\
-  res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;	\
-  return;
+  string uuid, max_calls_str, max_cps_str;
+  if (values.hasMember("uuid") && isArgCStr(values["uuid"]))
+    uuid = values["uuid"].asCStr();
+  if (values.hasMember("max_calls") && isArgCStr(values["max_calls"]))
+    max_calls_str = values["max_calls"].asCStr();
+  if (values.hasMember("max_cps") && isArgCStr(values["max_cps"]))
+    max_cps_str = values["max_cps"].asCStr();
+
+  CCStartResult start_res;
+  start(cc_namespace, call_profile, uuid, max_calls_str, max_cps_str, start_res);
+  start_res.toDIResult(res);
+}
+
+void CCParallelCalls::start(const CCStartParams& params, CCStartResult& res) {
+  static const string empty;
+
+  map<string, string>::const_iterator uuid_it = params.values.find("uuid");
+  map<string, string>::const_iterator max_calls_it = params.values.find("max_calls");
+  map<string, string>::const_iterator max_cps_it = params.values.find("max_cps");
+
+  start(params.cc_name, params.call_profile,
+	uuid_it != params.values.end() ? uuid_it->second : empty,
+	max_calls_it != params.values.end() ? max_calls_it->second : empty,
+	max_cps_it != params.values.end() ? max_cps_it->second : empty,
+	res);
+}
 
+void CCParallelCalls::start(const string& cc_namespace, SBCCallProfile* call_profile,
+			    const string& uuid, const string& max_calls_str,
+			    const string& max_cps_str, CCStartResult& res) {
   if (!call_profile) {
     ERROR("internal: call_profile object not found in parameters\n");
-    REFUSE_WITH_SERVER_INTERNAL_ERROR;
+    res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
     return;
   }
 
-  if (!values.hasMember("uuid") || !isArgCStr(values["uuid"]) ||
-      !strlen(values["uuid"].asCStr())) {
+  if (uuid.empty()) {
     ERROR("configuration error: uuid missing for parallel calls call control!\n");
-    REFUSE_WITH_SERVER_INTERNAL_ERROR;
+    res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
+    return;
   }
 
-  string uuid = values["uuid"].asCStr();
-
-  call_profile->cc_vars[cc_namespace+"::"+SBCVAR_PARALLEL_CALLS_UUID] = uuid;
-
   unsigned int max_calls = 1; // default
-  if (values.hasMember("max_calls") && isArgCStr(values["max_calls"])) {
-    if (str2i(values["max_calls"].asCStr(), max_calls)) {
-      ERROR("max_calls '%s' could not be interpreted!\n", values["max_calls"].asCStr());
-      REFUSE_WITH_SERVER_INTERNAL_ERROR;
+  if (!max_calls_str.empty()) {
+    if (str2i(max_calls_str, max_calls)) {
+      ERROR("max_calls '%s' could not be interpreted!\n", max_calls_str.c_str());
+      res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
+      return;
     }
   }
 
-  DBG("enforcing limit of %i calls for uuid '%s'\n", max_calls, uuid.c_str());
-
-  bool do_limit = !max_calls;
-  unsigned int current_calls = 0;
-  if (max_calls) {
-    call_control_calls_mut.lock();
-    map<string, unsigned int>::iterator it=call_control_calls.find(uuid);
-    if (it==call_control_calls.end()) {
-      call_control_calls[uuid] = current_calls = 1;
-    } else {
-      if (it->second < max_calls) {
-	it->second++;
-      } else {
-	do_limit = true;
-      }
-      current_calls = it->second;
+  unsigned int max_cps = 0; // default: no rate limit
+  if (!max_cps_str.empty()) {
+    if (str2i(max_cps_str, max_cps)) {
+      ERROR("max_cps '%s' could not be interpreted!\n", max_cps_str.c_str());
+      res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
+      return;
     }
   }
 
-  call_control_calls_mut.unlock();
+  if (max_cps && counters->limit(CALL_RATE_KEY(uuid), max_cps, max_cps)) {
+    DBG("uuid %s exceeds %u calls per second\n", uuid.c_str(), max_cps);
+    res.refuse(refuse_code, cps_refuse_reason);
+    return;
+  }
+
+  DBG("enforcing limit of %i calls for uuid '%s'\n", max_calls, uuid.c_str());
+
+  unsigned int current_calls = 0;
+  bool do_limit = !counters->incIfBelow(PARALLEL_CALLS_KEY(uuid), max_calls,
+					 current_calls);
 
   DBG("uuid %s has %u active calls (limit = %s)\n",
       uuid.c_str(), current_calls, do_limit?"true":"false");
 
   if (do_limit) {
-    res.push(AmArg());
-    AmArg& res_cmd = res[0];
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = (int)refuse_code;
-    res_cmd[SBC_CC_REFUSE_REASON] = refuse_reason;
+    res.refuse(refuse_code, refuse_reason);
+    return;
   }
 
-#undef REFUSE_WITH_SERVER_INTERNAL_ERROR
+  // counted: to be released in end()
+  call_profile->cc_vars[cc_namespace+"::"+SBCVAR_PARALLEL_CALLS_UUID] = uuid;
+}
+
+void CCParallelCalls::end(const CCEndParams& params) {
+  end(params.cc_name, params.ltag, params.call_profile);
 }
 
 void CCParallelCalls::end(const string& cc_namespace, const string& ltag,
@@ -187,15 +221,7 @@ void CCParallelCalls::end(const string& cc_namespace, const string& ltag,
   string uuid = vars_it->second.asCStr();
   call_profile->cc_vars.erase(cc_namespace+"::"+SBCVAR_PARALLEL_CALLS_UUID);
 
-  unsigned int new_call_count  = 0;
-
-  call_control_calls_mut.lock();
-  if (call_control_calls[uuid] > 1) {
-    new_call_count = --call_control_calls[uuid];
-  }  else {
-    call_control_calls.erase(uuid);
-  }
-  call_control_calls_mut.unlock();
+  unsigned int new_call_count = counters->dec(PARALLEL_CALLS_KEY(uuid));
 
   DBG("uuid '%s' now has %u active calls\n", uuid.c_str(), new_call_count);
 }
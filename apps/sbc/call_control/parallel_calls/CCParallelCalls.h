@@ -30,26 +30,31 @@
 #include <map>
 
 #include "SBCCallProfile.h"
+#include "ExtendedCCInterface.h"
+#include "CounterStore.h"
 
 using std::map;
 
 /**
  * call control module limiting parallel number of calls
  */
-class CCParallelCalls : public AmDynInvoke
+class CCParallelCalls : public AmDynInvoke, public TypedCCInterface, public AmObject
 {
   static unsigned int refuse_code;
   static string refuse_reason;
+  static string cps_refuse_reason;
 
-  // this map contains # of calls per uuid
-  map<string, unsigned int> call_control_calls;
-  AmMutex call_control_calls_mut;
+  // # of calls and call rate per uuid
+  _CounterStore* counters;
 
   static CCParallelCalls* _instance;
 
   void start(const string& cc_namespace,
 	     const string& ltag, SBCCallProfile* call_profile,
 	     const AmArg& values, AmArg& res);
+  void start(const string& cc_namespace, SBCCallProfile* call_profile,
+	     const string& uuid, const string& max_calls_str,
+	     const string& max_cps_str, CCStartResult& res);
   void end(const string& cc_namespace,
 	   const string& ltag, SBCCallProfile* call_profile);
 
@@ -59,6 +64,10 @@ class CCParallelCalls : public AmDynInvoke
   static CCParallelCalls* instance();
   void invoke(const string& method, const AmArg& args, AmArg& ret);
   int onLoad();
+
+  /* from TypedCCInterface */
+  void start(const CCStartParams& params, CCStartResult& res);
+  void end(const CCEndParams& params);
 };
 
 #endif 
@@ -159,6 +159,8 @@ void Prepaid::invoke(const string& method, const AmArg& args, AmArg& ret)
     assertArgInt(args.get(1));
     ret.push(setCredit(args.get(0).asCStr(),
 		       args.get(1).asInt()));	
+  } else if (method == "getTypedInterfaceHandler"){
+    ret.push((AmObject*)this);
   } else if (method == "_list"){
     ret.push("start");
     ret.push("connect");
@@ -178,45 +180,53 @@ void Prepaid::start(const string& cc_name, const string& ltag,
 		    int start_ts_sec, int start_ts_usec,
 		    const AmArg& values, int timer_id, AmArg& res) {
 
-  if (!call_profile) return;
+  string uuid;
+  if (values.hasMember("uuid") && isArgCStr(values["uuid"]))
+    uuid = values["uuid"].asCStr();
+
+  CCStartResult start_res;
+  start(cc_name, call_profile, uuid, timer_id, start_res);
+  start_res.toDIResult(res);
+}
+
+void Prepaid::start(const CCStartParams& params, CCStartResult& res) {
+  static const string empty;
+
+  map<string, string>::const_iterator it = params.values.find("uuid");
+  start(params.cc_name, params.call_profile,
+	it != params.values.end() ? it->second : empty,
+	params.timer_id, res);
+}
 
-  res.push(AmArg());
-  AmArg& res_cmd = res[0];
+void Prepaid::start(const string& cc_name, SBCCallProfile* call_profile,
+		    const string& uuid, int timer_id, CCStartResult& res) {
 
-  if (!values.hasMember("uuid") || !isArgCStr(values["uuid"]) ||
-      !strlen(values["uuid"].asCStr())) {
+  if (!call_profile) return;
+
+  if (uuid.empty()) {
     ERROR("configuration error: uuid missing for prepaid call control!\n");
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = 500;
-    res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;
+    res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
     return;
   }
 
-  string uuid = values["uuid"].asCStr();
-
   call_profile->cc_vars[cc_name+"::"+SBCVAR_PREPAID_UUID] = uuid;
 
   bool found;
   int credit = getCredit(uuid, found);
   if (!found) {
     ERROR("Failed to fetch credit for uuid '%s'\n", uuid.c_str());
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = 500;
-    res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;
+    res.refuse(500, SIP_REPLY_SERVER_INTERNAL_ERROR);
     return;
   }
 
   if (credit<=0) {
-    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
-    res_cmd[SBC_CC_REFUSE_CODE] = 402;
-    res_cmd[SBC_CC_REFUSE_REASON] = "Insufficient Credit";
+    res.refuse(402, "Insufficient Credit");
     return;
   }
 
   // Set Timer:
   DBG("setting prepaid call timer ID %i of %i seconds\n", timer_id, credit);
-  res_cmd[SBC_CC_ACTION] = SBC_CC_SET_CALL_TIMER_ACTION;
-  res_cmd[SBC_CC_TIMER_TIMEOUT] = credit;
+  res.setCallTimer(credit);
 }
 
 void Prepaid::connect(const string& cc_name, 
@@ -280,6 +290,13 @@ void Prepaid::end(const string& cc_name,
   }
 }
 
+void Prepaid::end(const CCEndParams& params) {
+  end(params.cc_name, params.ltag, params.call_profile,
+      params.start_ts.tv_sec, params.start_ts.tv_usec,
+      params.connect_ts.tv_sec, params.connect_ts.tv_usec,
+      params.end_ts.tv_sec, params.end_ts.tv_usec);
+}
+
 /* accounting functions... */
 int Prepaid::getCredit(string pin, bool& found) {
   credits_mut.lock();
@@ -29,13 +29,14 @@
 #include "AmApi.h"
 
 #include "SBCCallProfile.h"
+#include "ExtendedCCInterface.h"
 
 #include <map>
 
 /**
  * sample call control module
  */
-class Prepaid : public AmDynInvoke
+class Prepaid : public AmDynInvoke, public TypedCCInterface, public AmObject
 {
   static Prepaid* _instance;
 
@@ -57,6 +58,8 @@ class Prepaid : public AmDynInvoke
   void start(const string& cc_name, const string& ltag, SBCCallProfile* call_profile,
 	     int start_ts_sec, int start_ts_usec, const AmArg& values,
 	     int timer_id, AmArg& res);
+  void start(const string& cc_name, SBCCallProfile* call_profile,
+	     const string& uuid, int timer_id, CCStartResult& res);
   void connect(const string& cc_name, const string& ltag, SBCCallProfile* call_profile,
 	       const string& other_ltag,
 	       int connect_ts_sec, int connect_ts_usec);
@@ -71,6 +74,10 @@ class Prepaid : public AmDynInvoke
   static Prepaid* instance();
   void invoke(const string& method, const AmArg& args, AmArg& ret);
   int onLoad();
+
+  /* from TypedCCInterface */
+  void start(const CCStartParams& params, CCStartResult& res);
+  void end(const CCEndParams& params);
 };
 
 #endif 
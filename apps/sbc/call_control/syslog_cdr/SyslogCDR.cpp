@@ -151,6 +151,8 @@ void SyslogCDR::invoke(const string& method, const AmArg& args, AmArg& ret)
       // ret.push("From-tag");
     } else if (method == "getExtendedInterfaceHandler") {
       ret.push((AmObject*)this);
+    } else if (method == "getTypedInterfaceHandler") {
+      ret.push((AmObject*)this);
     } else if(method == "_list"){
       ret.push("start");
       ret.push("connect");
@@ -180,6 +182,26 @@ void SyslogCDR::start(const string& ltag, SBCCallProfile* call_profile,
   call_profile->cc_vars[CDR_VARS] = values;
 }
 
+void SyslogCDR::start(const CCStartParams& params, CCStartResult& res) {
+  if (!params.call_profile) return;
+
+  // the values are kept with the call for writing the CDR
+  AmArg& values = params.call_profile->cc_vars[CDR_VARS];
+  values.clear();
+  values.assertStruct();
+  for (map<string, string>::const_iterator it = params.values.begin();
+       it != params.values.end(); it++) {
+    values[it->first] = it->second;
+  }
+}
+
+void SyslogCDR::end(const CCEndParams& params) {
+  end(params.ltag, params.call_profile,
+      params.start_ts.tv_sec, params.start_ts.tv_usec,
+      params.connect_ts.tv_sec, params.connect_ts.tv_usec,
+      params.end_ts.tv_sec, params.end_ts.tv_usec);
+}
+
 string getTimeDiffString(int from_ts_sec, int from_ts_usec,
 			 int to_ts_sec, int to_ts_usec,
 			 bool ms_precision) {
@@ -42,7 +42,8 @@
 /**
  * accounting for generating CDR lines in CSV format in syslog
  */
-class SyslogCDR : public AmDynInvoke, public ExtendedCCInterface, public AmObject
+class SyslogCDR : public AmDynInvoke, public ExtendedCCInterface,
+  public TypedCCInterface, public AmObject
 {
   static SyslogCDR* _instance;
 
@@ -71,6 +72,10 @@ class SyslogCDR : public AmDynInvoke, public ExtendedCCInterface, public AmObjec
 
   virtual void onStateChange(SBCCallLeg *call, const CallLeg::StatusChangeCause &cause);
   virtual CCChainProcessing onEvent(SBCCallLeg *call, AmEvent *e);
+
+  /* from TypedCCInterface */
+  void start(const CCStartParams& params, CCStartResult& res);
+  void end(const CCEndParams& params);
 };
 
 #endif 
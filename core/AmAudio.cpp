@@ -31,6 +31,7 @@
 #include "AmSdp.h"
 #include "AmRtpStream.h"
 #include "AmConfig.h"
+#include "AmCodecStats.h"
 #include "amci/codecs.h"
 #include "log.h"
 
@@ -244,6 +245,44 @@ unsigned int AmInternalResamplerState::resample(unsigned char *samples, unsigned
   //DBG("Returning %d samples", s);
   return PCM16_S2B(s);
 }
+
+AmPolyphaseResamplerState::AmPolyphaseResamplerState()
+  : rstate(NULL), rstate_ratio(0.0), fallback(NULL)
+{
+}
+
+AmPolyphaseResamplerState::~AmPolyphaseResamplerState()
+{
+  delete rstate;
+  delete fallback;
+}
+
+unsigned int AmPolyphaseResamplerState::resample(unsigned char *samples, unsigned int s, double ratio)
+{
+  if (!rstate || (ratio != rstate_ratio)) {
+    delete rstate;
+    rstate = PolyphaseResampler::create(ratio);
+    rstate_ratio = ratio;
+    if (!rstate) {
+      DBG("no polyphase filter for ratio %f, using internal resampler\n", ratio);
+    }
+  }
+
+  if (!rstate) {
+    if (!fallback) fallback = new AmInternalResamplerState();
+    return fallback->resample(samples, s, ratio);
+  }
+
+  unsigned int in = PCM16_B2S(s);
+  if (rstate->max_output(in) > PCM16_B2S(AUDIO_BUFFER_SIZE)) {
+    ERROR("too many samples to resample (%u)\n", in);
+    return s;
+  }
+
+  unsigned int out = rstate->resample((signed short *)samples, in, resample_out);
+  memcpy(samples, resample_out, PCM16_S2B(out));
+  return PCM16_S2B(out);
+}
 #endif
 
 AmAudio::AmAudio()
@@ -370,8 +409,10 @@ int AmAudio::decode(unsigned int size)
   }
 
   if(codec->decode){
+    unsigned long long t = AmCodecStats::start();
     s = (*codec->decode)(samples.back_buffer(),samples,s,
 			 fmt->channels,getSampleRate(),h_codec);
+    AmCodecStats::decoded(codec->id, t);
     if(s<0) return s;
     samples.swap();
   }
@@ -388,8 +429,10 @@ int AmAudio::encode(unsigned int size)
 
   assert(codec);
   if(codec->encode){
+    unsigned long long t = AmCodecStats::start();
     s = (*codec->encode)(samples.back_buffer(),samples,(unsigned int) size,
 			 fmt->channels,getSampleRate(),h_codec);
+    AmCodecStats::encoded(codec->id, t);
     if(s<0) return s;
     samples.swap();
   }
@@ -419,6 +462,9 @@ unsigned int AmAudio::resampleInput(unsigned char* buffer, unsigned int s, int i
     if (AmConfig::ResamplingImplementationType == AmAudio::INTERNAL_RESAMPLER) {
       DBG("using internal resampler for input");
       input_resampling_state.reset(new AmInternalResamplerState());
+    } else if (AmConfig::ResamplingImplementationType == AmAudio::POLYPHASE_RESAMPLER) {
+      DBG("using polyphase resampler for input");
+      input_resampling_state.reset(new AmPolyphaseResamplerState());
     } else
 #endif
 #ifdef USE_LIBSAMPLERATE
@@ -446,6 +492,9 @@ unsigned int AmAudio::resampleOutput(unsigned char* buffer, unsigned int s, int
     if (AmConfig::ResamplingImplementationType == AmAudio::INTERNAL_RESAMPLER) {
       DBG("using internal resampler for output");
       output_resampling_state.reset(new AmInternalResamplerState());
+    } else if (AmConfig::ResamplingImplementationType == AmAudio::POLYPHASE_RESAMPLER) {
+      DBG("using polyphase resampler for output");
+      output_resampling_state.reset(new AmPolyphaseResamplerState());
     } else
 #endif
 #ifdef USE_LIBSAMPLERATE
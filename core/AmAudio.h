@@ -47,6 +47,7 @@ using std::string;
 
 #ifdef USE_INTERNAL_RESAMPLER
 #include "resample/resample.h"
+#include "resample/polyphase.h"
 #endif
 
 #define PCM16_B2S(b) ((b) >> 1)
@@ -75,6 +76,9 @@ using std::string;
 #define WC_INC_MS 10LL /* 10 ms */
 #define WC_INC ((WALLCLOCK_RATE*WC_INC_MS)/1000LL)
 
+/** returned by AmAudio::getEncoded() if the audio has to be encoded */
+#define AUDIO_NOT_ENCODED -100
+
 struct SdpPayload;
 struct CodecContainer;
 struct Payload;
@@ -155,6 +159,9 @@ public:
   /** set the sampling rate */
   void setRate(unsigned int sample_rate);
 
+  /** @return codec id, @see amci/codecs.h */
+  int getCodecId() const { return codec_id; }
+
   /** @return Handler returned by the codec's init function.*/
   long             getHCodec();
   long             getHCodecNoInit() { return h_codec; } // do not initialize
@@ -227,6 +234,25 @@ public:
 
   virtual unsigned int resample(unsigned char* samples, unsigned int size, double ratio);
 };
+
+/**
+ * Polyphase FIR resampler for the fixed ratios between 8/16/32/48 kHz,
+ * the internal resampler is used for other ratios.
+ */
+class AmPolyphaseResamplerState: public AmResamplingState
+{
+private:
+  PolyphaseResampler *rstate;
+  double rstate_ratio;
+  AmInternalResamplerState *fallback;
+  short resample_out[PCM16_B2S(AUDIO_BUFFER_SIZE)];
+
+public:
+  AmPolyphaseResamplerState();
+  virtual ~AmPolyphaseResamplerState();
+
+  virtual unsigned int resample(unsigned char* samples, unsigned int size, double ratio);
+};
 #endif
 
 /**
@@ -247,6 +273,7 @@ public:
   enum ResamplingImplementationType {
 	LIBSAMPLERATE,
 	INTERNAL_RESAMPLER,
+	POLYPHASE_RESAMPLER,
 	UNAVAILABLE
   };
 
@@ -365,6 +392,18 @@ public:
    */
   virtual int put(unsigned long long system_ts, unsigned char* buffer, 
 		  int input_sample_rate, unsigned int size);
+
+  /**
+   * Get a frame already encoded with the given codec
+   * (e.g. from the prompt cache) instead of samples.
+   * @param rate codec sample rate
+   * @param frame_size samples per frame
+   * @return # bytes of the encoded frame, -1 if error, -2 at the end,
+   *         AUDIO_NOT_ENCODED if the samples must be read with get()
+   */
+  virtual int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+			 int codec_id, unsigned int rate, unsigned int frame_size)
+  { return AUDIO_NOT_ENCODED; }
   
   int  getSampleRate();
 
@@ -28,8 +28,10 @@
 #include "AmAudioFile.h"
 #include "AmPlugIn.h"
 #include "AmUtils.h"
+#include "AmConfig.h"
 
 #include <string.h>
+#include <errno.h>
 
 AmAudioFileFormat::AmAudioFileFormat(const string& name, int subtype)
   : name(name), subtype(subtype), p_subtype(0)
@@ -140,7 +142,22 @@ int  AmAudioFile::open(const string& filename, OpenMode mode, bool is_tmp)
   string f_name = filename;
   string subtype = getSubtype(f_name);
 
-  if(!is_tmp){
+  if(!is_tmp && mode == AmAudioFile::Read && AmConfig::MmapAudioFiles){
+    // read from the shared mapping instead of the file
+    mapped = AmMappedFiles::instance()->map(f_name, MADV_SEQUENTIAL);
+    if(mapped){
+      n_fp = fmemopen(mapped->getData(), mapped->getSize(), "r");
+      if(!n_fp){
+	WARN("fmemopen failed for %s: %s\n",f_name.c_str(),strerror(errno));
+	AmMappedFiles::instance()->release(mapped);
+	mapped = NULL;
+      }
+    }
+  }
+
+  if(n_fp){
+    // mapped
+  } else if(!is_tmp){
     n_fp = fopen(f_name.c_str(),mode == AmAudioFile::Read ? "r" : "w+");
     if(!n_fp){
       if(mode == AmAudioFile::Read)
@@ -218,6 +235,9 @@ int AmAudioFile::fpopen_int(const string& filename, OpenMode mode,
       setBufferSize(fd.buffer_size, fd.buffer_thresh, fd.buffer_full_thresh);
     }
     begin = ftell(fp);
+
+    if (mode == AmAudioFile::Write)
+      rec_file = AmRecordingWriter::instance()->open(fp);
   } else {
     if(!iofmt->open)
       ERROR("no open function\n");
@@ -241,7 +261,8 @@ int AmAudioFile::fpopen_int(const string& filename, OpenMode mode,
 
 AmAudioFile::AmAudioFile()
   : AmBufferedAudio(0, 0, 0), data_size(0),
-    fp(0), begin(0), loop(false), autorewind(false),
+    fp(0), begin(0), mapped(NULL), rec_file(NULL),
+    loop(false), autorewind(false),
     on_close_done(false),
     close_on_exit(true)
 {
@@ -292,6 +313,15 @@ void AmAudioFile::on_close()
 {
   if(fp && !on_close_done){
 
+    if(rec_file){
+      // wait for the writer thread
+      unsigned long long written = 0;
+      AmRecordingWriter::instance()->close(rec_file, written);
+      rec_file = NULL;
+      // without dropped data
+      data_size = written;
+    }
+
     AmAudioFileFormat* f_fmt = 
       dynamic_cast<AmAudioFileFormat*>(fmt.get());
 
@@ -325,11 +355,30 @@ void AmAudioFile::on_close()
 void AmAudioFile::close()
 {
   if(fp){
+    if(rec_file && close_on_exit && !on_close_done){
+      // fp is not used any more: no long wait for the writer thread
+      unsigned long long written = 0;
+      bool closed = AmRecordingWriter::instance()->close(rec_file, written, true);
+      rec_file = NULL;
+      if(!closed){
+	// closed by the writer thread
+	fp = 0;
+	on_close_done = true;
+	return;
+      }
+      data_size = written;
+    }
+
     on_close();
 
     if(close_on_exit)
       fclose(fp);
     fp = 0;
+
+    // if fp is not closed, its mapping must not be removed
+    if(mapped && close_on_exit)
+      AmMappedFiles::instance()->release(mapped);
+    mapped = NULL;
   }
 }
 
@@ -427,6 +476,13 @@ int AmAudioFile::write(unsigned int user_ts, unsigned int size)
     return size;
   }
 
+  if (rec_file) {
+    if (rec_file->write((unsigned char*)samples, size))
+      return -1;
+    data_size += size;
+    return size;
+  }
+
   int s = fwrite((void*)((unsigned char*)samples),1,size,fp);
   if(s>0)
     data_size += s;
@@ -30,6 +30,8 @@
 
 #include "AmAudio.h"
 #include "AmBufferedAudio.h"
+#include "AmMappedFile.h"
+#include "AmRecordingWriter.h"
 
 /** \brief \ref AmAudioFormat for file */
 class AmAudioFileFormat: public AmAudioFormat
@@ -81,6 +83,12 @@ protected:
   FILE* fp;
   long begin;
 
+  /** mapping fp reads from (mmap_audio_files), or NULL */
+  AmMappedFile* mapped;
+
+  /** writer thread's file if written asynchronously, or NULL */
+  AmRecordingFile* rec_file;
+
   /** Format of that file. @see fp, open(). */
   amci_inoutfmt_t* iofmt;
   /** Open mode. */
@@ -6,6 +6,7 @@
 #include "AmB2BSession.h"
 #include "AmRtpReceiver.h"
 #include "sip/msg_logger.h"
+#include "AmPayloadTranscoder.h"
 
 #include <algorithm>
 #include <stdexcept>
@@ -170,6 +171,11 @@ void AudioStreamData::initialize(AmB2BSession *session)
   stream->setRtpRelayFilterRtpDtmf(session->getEnableDtmfRtpFiltering());
   if (session->getEnableDtmfRtpDetection())
     stream->force_receive_dtmf = true;
+  jitter_buffer = session->getJitterBufferMaxDelay() > 0;
+  if (jitter_buffer) {
+    stream->setJitterBufferDelay(session->getJitterBufferMinDelay(),
+				 session->getJitterBufferMaxDelay());
+  }
   force_symmetric_rtp = session->getRtpRelayForceSymmetricRtp();
   enable_dtmf_transcoding = session->getEnableDtmfTranscoding();
   session->getLowFiPLs(lowfi_payloads);
@@ -184,6 +190,7 @@ AudioStreamData::AudioStreamData(AmB2BSession *session):
   incoming_payload(UNDEFINED_PAYLOAD),
   force_symmetric_rtp(false),
   enable_dtmf_transcoding(false),
+  jitter_buffer(false),
   muted(false), relay_paused(false), receiving(true)
 {
   if (session) initialize(session);
@@ -270,6 +277,43 @@ void AudioStreamData::setRelayStream(AmRtpStream *other)
 
 void AudioStreamData::setRelayPayloads(const SdpMedia &m, RelayController *ctrl) {
   ctrl->computeRelayMask(m, relay_enabled, relay_mask);
+  relay_remote_payloads = m.payloads;
+}
+
+void AudioStreamData::setRelayTranscoding(const AmSdp &local_sdp, int media_idx, bool enable)
+{
+  if (!stream) return;
+
+  RelayTranscodingTable table;
+  if (enable && relay_enabled &&
+      (media_idx >= 0) && ((size_t)media_idx < local_sdp.media.size()))
+    fillRelayTranscoding(local_sdp.media[media_idx], table);
+
+  // entries are replaced one by one, without clearing the table first
+  stream->setRelayTranscoding(table);
+}
+
+void AudioStreamData::fillRelayTranscoding(const SdpMedia &m,
+					   RelayTranscodingTable &table)
+{
+
+  // the remote end sends us the payloads from our local SDP
+  for (vector<SdpPayload>::const_iterator p = m.payloads.begin();
+      p != m.payloads.end(); ++p)
+  {
+    if (relay_mask.get(p->payload_type)) continue; // relayed as is
+
+    for (vector<SdpPayload>::const_iterator r = relay_remote_payloads.begin();
+        r != relay_remote_payloads.end(); ++r)
+    {
+      unsigned int id = AmPayloadTranscoder::getTableId(
+        AmPayloadTranscoder::getTable(*p, *r));
+      if (id) {
+        table.set(p->payload_type, r->payload_type, id);
+        break;
+      }
+    }
+  }
 }
 
 void AudioStreamData::setRelayDestination(const string& connection_address, int port) {
@@ -346,7 +390,7 @@ bool AudioStreamData::initStream(PlayoutType playout_type,
 
   stream->setOnHold(false); // just hack to do correctly mute detection in stream->init
   if (stream->init(local_sdp, remote_sdp, force_symmetric_rtp) == 0) {
-    stream->setPlayoutType(playout_type);
+    stream->setPlayoutType(jitter_buffer ? JB_PLAYOUT : playout_type);
     initialized = true;
 
 //    // do not unmute if muted because of 0.0.0.0 remote IP (the mute flag is set during init)
@@ -655,10 +699,8 @@ void AmB2BMedia::clearAudio(bool a_leg)
   }
 
   for (RelayStreamIterator j = relay_streams.begin(); j != relay_streams.end(); ++j) {
-    if ((*j)->a.hasLocalSocket())
-      AmRtpReceiver::instance()->removeStream((*j)->a.getLocalSocket());
-    if ((*j)->b.hasLocalSocket())
-      AmRtpReceiver::instance()->removeStream((*j)->b.getLocalSocket());
+    (*j)->a.stopReceiving();
+    (*j)->b.stopReceiving();
   }
 
   // forget sessions to avoid using them once clearAudio is called
@@ -874,6 +916,13 @@ void AmB2BMedia::updateStreamPair(AudioStreamPair &pair)
   else pair.b.setRelayStream(pair.a.getStream());
   if (have_b) pair.b.initStream(playout_type, b_leg_local_sdp, b_leg_remote_sdp, pair.media_idx);
 
+  // translate G.711 A-law <-> u-law directly if possible (not if the audio
+  // has to be decoded for inband DTMF detection in the other leg)
+  if (have_a) pair.a.setRelayTranscoding(a_leg_local_sdp, pair.media_idx,
+      !pair.b.getEnableDtmfTranscoding());
+  if (have_b) pair.b.setRelayTranscoding(b_leg_local_sdp, pair.media_idx,
+      !pair.a.getEnableDtmfTranscoding());
+
   TRACE("audio streams updated\n");
 }
 
@@ -927,7 +976,8 @@ void AmB2BMedia::updateAudioStreams()
 
 void AmB2BMedia::updateRelayStream(AmRtpStream *stream, AmB2BSession *session,
 				   const string& connection_address,
-				   const SdpMedia &m, AmRtpStream *relay_to)
+				   const SdpMedia &m, bool rtcp_mux,
+				   AmRtpStream *relay_to)
 {
   static const PayloadMask true_mask(true);
 
@@ -944,6 +994,7 @@ void AmB2BMedia::updateRelayStream(AmRtpStream *stream, AmB2BSession *session,
     stream->setRelayPayloads(true_mask);
     if (!relay_paused)
       stream->enableRtpRelay();
+    stream->setRtcpMux(rtcp_mux);
     stream->setRAddr(connection_address,m.port,m.port+1);
     if((m.transport != TP_RTPAVP) && (m.transport != TP_RTPSAVP))
       stream->enableRawRelay();
@@ -1017,13 +1068,18 @@ void AmB2BMedia::updateStreams(bool a_leg, const AmSdp &local_sdp, const AmSdp &
 
       RelayStreamPair& relay_stream = **rstream;
 
+      // rtcp-mux if offered and answered
+      size_t idx = m - remote_sdp.media.begin();
+      bool rtcp_mux = m->hasRtcpMux() && (idx < local_sdp.media.size()) &&
+	local_sdp.media[idx].hasRtcpMux();
+
       if(a_leg) {
 	DBG("updating A-leg relay_stream");
-        updateRelayStream(&relay_stream.a, a, connection_address, *m, &relay_stream.b);
+        updateRelayStream(&relay_stream.a, a, connection_address, *m, rtcp_mux, &relay_stream.b);
       }
       else {
 	DBG("updating B-leg relay_stream");
-        updateRelayStream(&relay_stream.b, b, connection_address, *m, &relay_stream.a);
+        updateRelayStream(&relay_stream.b, b, connection_address, *m, rtcp_mux, &relay_stream.a);
       }
       ++rstream;
     }
@@ -1243,6 +1299,14 @@ void AmB2BMedia::restartRelay() {
   }
 }
 
+void AudioStreamData::getStats(AmArg &stats)
+{
+  if (stream && initialized) {
+    stats["port"] = stream->getLocalPort();
+    stream->getStats(stats);
+  }
+}
+
 void AudioStreamData::debug()
 {
   DBG("\tmuted: %s\n", muted ? "yes" : "no");
@@ -1253,6 +1317,19 @@ void AudioStreamData::debug()
     DBG("\t<null> <-> <null>");
 }
 
+void AmB2BMedia::getStats(AmArg &stats)
+{
+  AmLock lock(mutex);
+
+  stats.assertArray();
+  for (AudioStreamIterator i = audio.begin(); i != audio.end(); ++i) {
+    AmArg pair;
+    i->a.getStats(pair["a"]);
+    i->b.getStats(pair["b"]);
+    stats.push(pair);
+  }
+}
+
 // print debug info
 void AmB2BMedia::debug()
 {
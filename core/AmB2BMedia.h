@@ -73,6 +73,9 @@ class AudioStreamData {
     /** Enables DTMF detection with RTP DTMF (2833/4733) */
     bool enable_dtmf_rtp_detection;
 
+    /** use the jitter buffer (JB_PLAYOUT) instead of the media's playout type */
+    bool jitter_buffer;
+
     /** Low fidelity payloads for which inband DTMF transcoding should be used */
     vector<SdpPayload> lowfi_payloads;
   
@@ -88,6 +91,8 @@ class AudioStreamData {
 
     PayloadMask relay_mask;
     bool relay_enabled;
+    /** payloads accepted by the remote end of the other leg */
+    vector<SdpPayload> relay_remote_payloads;
     std::string relay_address;
     int relay_port;
 
@@ -155,6 +160,13 @@ class AudioStreamData {
 
     void setRelayDestination(const string& connection_address, int port);
 
+    /** sets up compressed domain transcoding (e.g. PCMA -> PCMU) for the
+     * payloads in our local SDP which are not relayed but can be translated
+     * directly to a payload accepted by the other leg's remote end
+     * (see AmPayloadTranscoder) */
+    void setRelayTranscoding(const AmSdp &local_sdp, int media_idx, bool enable);
+    void fillRelayTranscoding(const SdpMedia &m, RelayTranscodingTable &table);
+
     /** set relay temporarily to paused (stream relation may still be up) */
     void setRelayPaused(bool paused);
 
@@ -204,6 +216,7 @@ class AudioStreamData {
     }
 
     bool isInitialized() { return initialized; }
+    bool getEnableDtmfTranscoding() const { return enable_dtmf_transcoding; }
     void getSdpOffer(int media_idx, SdpMedia &m) { if (stream) stream->getSdpOffer(media_idx, m); }
     void getSdpAnswer(int media_idx, const SdpMedia &offer, SdpMedia &answer) { if (stream) stream->getSdpAnswer(media_idx, offer, answer); }
     void mute(bool set_mute);
@@ -213,6 +226,9 @@ class AudioStreamData {
 
     void setLogger(msg_logger *logger) { if (stream) stream->setLogger(logger); }
 
+    /** receive statistics of the stream (see AmRtpAudio::getStats) */
+    void getStats(AmArg &stats);
+
     void debug();
 };
 
@@ -351,7 +367,8 @@ class AmB2BMedia: public AmMediaSession
     void updateAudioStreams();
     void updateRelayStream(AmRtpStream *stream, AmB2BSession *session,
 			   const string& connection_address,
-			   const SdpMedia &m, AmRtpStream *relay_to);
+			   const SdpMedia &m, bool rtcp_mux,
+			   AmRtpStream *relay_to);
 
     void setMuteFlag(bool a_leg, bool set);
     void changeSessionUnsafe(bool a_leg, AmB2BSession *new_session);
@@ -486,6 +503,9 @@ class AmB2BMedia: public AmMediaSession
     /** set 'receving' property of RTP/relay streams (not receiving=drop incoming packets) */
     void setReceiving(bool receiving_a, bool receiving_b);
 
+    /** receive statistics of the audio streams, one item per stream pair */
+    void getStats(AmArg &stats);
+
     // print debug info
     void debug();
 };
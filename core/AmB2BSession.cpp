@@ -75,6 +75,7 @@ AmB2BSession::AmB2BSession(const string& other_local_tag, AmSipDialog* p_dlg,
     enable_dtmf_transcoding(false),
     enable_dtmf_rtp_filtering(false),
     enable_dtmf_rtp_detection(false),
+    jitter_buffer_min_delay(0), jitter_buffer_max_delay(0),
     rtp_relay_transparent_seqno(true), rtp_relay_transparent_ssrc(true),
     est_invite_cseq(0),est_invite_other_cseq(0),
     media_session(NULL)
@@ -928,6 +929,11 @@ void AmB2BSession::setLowFiPLs(const vector<SdpPayload>& lowfi_payloads) {
   this->lowfi_payloads = lowfi_payloads;
 }
 
+void AmB2BSession::setJitterBufferDelay(unsigned int min_delay, unsigned int max_delay) {
+  jitter_buffer_min_delay = min_delay;
+  jitter_buffer_max_delay = max_delay;
+}
+
 void AmB2BSession::clearRtpReceiverRelay() {
   switch (rtp_relay_mode) {
 
@@ -281,6 +281,10 @@ private:
   bool enable_dtmf_rtp_filtering;
   /** detect DTMF through RTP DTMF (2833 / 4733) packets */
   bool enable_dtmf_rtp_detection;
+  /** jitter buffer playout delay limits (ms) for transcoded streams,
+      jitter buffer not used if max delay is 0 */
+  unsigned int jitter_buffer_min_delay;
+  unsigned int jitter_buffer_max_delay;
 
   /** Low fidelity payloads for which inband DTMF 
       transcoding should be used */
@@ -338,6 +342,9 @@ private:
   void setEnableDtmfRtpFiltering(bool enable);
   void setEnableDtmfRtpDetection(bool enable);
   void setLowFiPLs(const vector<SdpPayload>& lowfi_payloads);
+  void setJitterBufferDelay(unsigned int min_delay, unsigned int max_delay);
+  unsigned int getJitterBufferMinDelay() const { return jitter_buffer_min_delay; }
+  unsigned int getJitterBufferMaxDelay() const { return jitter_buffer_max_delay; }
   
   bool getRtpRelayTransparentSeqno() { return rtp_relay_transparent_seqno; }
   bool getRtpRelayTransparentSSRC() { return rtp_relay_transparent_ssrc; }
@@ -39,43 +39,32 @@
 using std::string;
 
 AmFileCache::AmFileCache() 
-  : data(NULL), 
+  : mapped(NULL),
+    data(NULL), 
     data_size(0)
 { }
 
 AmFileCache::~AmFileCache() {
-  if ((data != NULL) && 
-      munmap(data, data_size)) {
-    ERROR("while unmapping file.\n");
-  }
+  AmMappedFiles::instance()->release(mapped);
 }
 
 int AmFileCache::load(const std::string& filename) {
-  int fd; 
-  struct stat sbuf;
-
   name = filename;
 
-  if ((fd = open(name.c_str(), O_RDONLY)) == -1) {
-    ERROR("while opening file '%s' for caching.\n", 
+  AmMappedFiles::instance()->release(mapped);
+  data = NULL;
+  data_size = 0;
+
+  // prompts are played from anywhere by many sessions
+  mapped = AmMappedFiles::instance()->map(name, MADV_WILLNEED);
+  if (!mapped) {
+    ERROR("cannot map file '%s' for caching.\n", 
 	  filename.c_str());
     return -1;
   }
 
-  if (fstat(fd,  &sbuf) == -1) {
-    ERROR("cannot stat file '%s'.\n", 
-	  name.c_str());
-    return -2;
-  }
-	
-  if ((data = mmap((caddr_t)0, sbuf.st_size, PROT_READ, MAP_PRIVATE, 
-		   fd, 0)) == (caddr_t)(-1)) {
-    ERROR("cannot mmap file '%s'.\n", 
-	  name.c_str());
-    return -3;
-  }
-
-  data_size = sbuf.st_size;
+  data = mapped->getData();
+  data_size = mapped->getSize();
 
   return 0;
 }
@@ -98,17 +87,18 @@ int AmFileCache::read(void* buf,
   return r_size;
 }
 
-inline size_t AmFileCache::getSize() {
+size_t AmFileCache::getSize() {
   return data_size;
 }
 
-inline const string& AmFileCache::getFilename() {
+const string& AmFileCache::getFilename() {
   return name;
 }
 
 
-AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache) 
-  : cache(cache), loop(false), fpos(0), begin(0), good(false)
+AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache, bool use_prompt_cache) 
+  : cache(cache), loop(false), fpos(0), begin(0), good(false),
+    use_prompt_cache(use_prompt_cache), encoded(NULL), encoded_pos(0)
 {
   if (!cache) {
     ERROR("Need open file cache.\n");
@@ -156,6 +146,8 @@ AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache)
 }
 
 AmCachedAudioFile::~AmCachedAudioFile() {
+  if (encoded)
+    dec_ref(encoded);
 }
 
 AmAudioFileFormat* AmCachedAudioFile::fileName2Fmt(const string& name)
@@ -177,6 +169,7 @@ AmAudioFileFormat* AmCachedAudioFile::fileName2Fmt(const string& name)
 
 void AmCachedAudioFile::rewind() {
   fpos = begin;
+  encoded_pos = 0;
 }
 
 /** Closes the file. */
@@ -213,6 +206,57 @@ int AmCachedAudioFile::read(unsigned int user_ts, unsigned int size) {
   return (fpos==cache->getSize() && !loop.get() ? -2 : ret);
 }
 
+int AmCachedAudioFile::getEncoded(unsigned long long system_ts, unsigned char* buffer,
+				  int codec_id, unsigned int rate, unsigned int frame_size)
+{
+  if (!use_prompt_cache || !good)
+    return AUDIO_NOT_ENCODED;
+
+  if (!encoded || codec_id != encoded_codec_id ||
+      rate != encoded_rate || frame_size != encoded_frame_size) {
+
+    // already playing from the file
+    if (!encoded && fpos != begin)
+      return AUDIO_NOT_ENCODED;
+
+    AmEncodedPrompt* p =
+      AmPromptCache::instance()->get(cache, codec_id, rate, frame_size);
+
+    if (encoded) {
+      // codec changed while playing: continue at the same time
+      encoded_pos = (unsigned long long)encoded_pos * encoded_frame_size * rate
+	/ encoded_rate / frame_size;
+      dec_ref(encoded);
+      if (!p) {
+	// from the beginning of the file, as its position is unknown
+	encoded = NULL;
+	return AUDIO_NOT_ENCODED;
+      }
+    }
+
+    if (!p)
+      return AUDIO_NOT_ENCODED;
+
+    encoded = p;
+    encoded_codec_id = codec_id;
+    encoded_rate = rate;
+    encoded_frame_size = frame_size;
+  }
+
+  if (encoded_pos >= encoded->numFrames()) {
+    if (!loop.get())
+      return -2;
+    DBG("rewinding encoded prompt...\n");
+    encoded_pos = 0;
+  }
+
+  unsigned int size = encoded->frameSize(encoded_pos);
+  memcpy(buffer, encoded->frame(encoded_pos), size);
+  encoded_pos++;
+
+  return size;
+}
+
 int AmCachedAudioFile::write(unsigned int user_ts, unsigned int size) {
   ERROR("AmCachedAudioFile writing not supported!\n");
   return -1;
@@ -27,6 +27,8 @@
 #define _AMFILECACHE_H
 
 #include "AmAudioFile.h"
+#include "AmPromptCache.h"
+#include "AmMappedFile.h"
 
 #include <string>
 
@@ -34,10 +36,12 @@
  * \brief memory cache for AmAudioFile 
  * 
  * The AmFileCache class loads a file once into memory 
- * to be used e.g. by AmCachedAudioFile.
+ * to be used e.g. by AmCachedAudioFile. The file is mapped
+ * (shared with other caches of the same file, see AmMappedFiles).
  */
 class AmFileCache 
 {
+  AmMappedFile* mapped;
   void* data;
   size_t data_size;
   std::string name;
@@ -76,6 +80,16 @@ class AmCachedAudioFile
   size_t begin; 
   bool good;
 
+  /** use frames from the prompt cache if possible */
+  bool use_prompt_cache;
+  /** encoded prompt being played (referenced), NULL if playing from the file */
+  AmEncodedPrompt* encoded;
+  int encoded_codec_id;
+  unsigned int encoded_rate;
+  unsigned int encoded_frame_size;
+  /** current frame in encoded */
+  unsigned int encoded_pos;
+
   /** @see AmAudio::read */
   int read(unsigned int user_ts, unsigned int size);
 
@@ -89,9 +103,17 @@ class AmCachedAudioFile
   amci_inoutfmt_t* iofmt;
 
  public:
-  AmCachedAudioFile(AmFileCache* cache);
+  /**
+   * @param use_prompt_cache play frames pre-encoded by the
+   *        AmPromptCache if the codec of the stream is known
+   */
+  AmCachedAudioFile(AmFileCache* cache, bool use_prompt_cache = false);
   ~AmCachedAudioFile();
 
+  /** @see AmAudio::getEncoded */
+  int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 int codec_id, unsigned int rate, unsigned int frame_size);
+
   /** loop the file? */
   AmSharedVar<bool> loop;
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmCodecBatch.h"
+#include "AmCodecStats.h"
+#include "AmRtpAudio.h"
+#include "log.h"
+
+#include <string.h>
+#include <algorithm>
+
+__thread AmCodecBatch* AmCodecBatch::thread_batch = NULL;
+
+AmCodecBatch::AmCodecBatch()
+  : num_frames(0)
+{
+}
+
+AmCodecBatch::~AmCodecBatch()
+{
+  for (unsigned int i = 0; i < frames.size(); i++)
+    delete frames[i];
+}
+
+void AmCodecBatch::add(AmRtpAudio* stream, amci_codec_t* codec, long h_codec,
+		       unsigned int channels, unsigned int rate, unsigned int rtp_ts,
+		       unsigned char* buffer, unsigned int size)
+{
+  if (size > AUDIO_BUFFER_SIZE)
+    size = AUDIO_BUFFER_SIZE;
+
+  frames_mut.lock();
+  if (num_frames == frames.size())
+    frames.push_back(new Frame());
+
+  Frame* f = frames[num_frames++];
+  f->stream = stream;
+  f->codec = codec;
+  f->h_codec = h_codec;
+  f->channels = channels;
+  f->rate = rate;
+  f->rtp_ts = rtp_ts;
+  f->size = size;
+  memcpy(f->in, buffer, size);
+  frames_mut.unlock();
+}
+
+void AmCodecBatch::cancel(AmRtpAudio* stream)
+{
+  frames_mut.lock();
+  for (unsigned int i = 0; i < num_frames; i++) {
+    if (frames[i]->stream == stream)
+      frames[i]->stream = NULL;
+  }
+  frames_mut.unlock();
+}
+
+/** order of the frames for grouping them by codec */
+struct FrameGroupLess
+{
+  template<class F> bool operator()(const F* a, const F* b) const {
+    if (a->codec != b->codec) return a->codec < b->codec;
+    if (a->rate != b->rate) return a->rate < b->rate;
+    return a->channels < b->channels;
+  }
+};
+
+void AmCodecBatch::encodeGroup(unsigned int begin, unsigned int end)
+{
+  unsigned int n = end - begin;
+  amci_codec_t* codec = frames[begin]->codec;
+
+  in_bufs.resize(n);
+  out_bufs.resize(n);
+  sizes.resize(n);
+  h_codecs.resize(n);
+
+  for (unsigned int i = 0; i < n; i++) {
+    Frame* f = frames[begin + i];
+    in_bufs[i] = f->in;
+    out_bufs[i] = f->out;
+    sizes[i] = f->size;
+    h_codecs[i] = f->h_codec;
+  }
+
+  unsigned long long t = AmCodecStats::start();
+  int err = (*codec->encode_batch)(&out_bufs[0], &in_bufs[0], &sizes[0], n,
+				   frames[begin]->channels, frames[begin]->rate,
+				   &h_codecs[0]);
+  AmCodecStats::encoded(codec->id, t, n);
+
+  if (err < 0) {
+    ERROR("batch encoding of %u frames with codec %i failed: %i\n",
+	  n, codec->id, err);
+    sizes.assign(n, 0);
+  }
+
+  for (unsigned int i = 0; i < n; i++) {
+    Frame* f = frames[begin + i];
+    if (sizes[i] > 0)
+      f->stream->send(f->rtp_ts, f->out, sizes[i]);
+  }
+}
+
+void AmCodecBatch::flush()
+{
+  frames_mut.lock();
+  if (!num_frames) {
+    frames_mut.unlock();
+    return;
+  }
+
+  // the codec instances of cancelled frames may be gone already
+  unsigned int queued = 0;
+  for (unsigned int i = 0; i < num_frames; i++) {
+    if (frames[i]->stream)
+      std::swap(frames[queued++], frames[i]);
+  }
+  num_frames = queued;
+
+  // stable: frames of the same stream (codec state) stay in order
+  std::stable_sort(frames.begin(), frames.begin() + num_frames, FrameGroupLess());
+
+  unsigned int begin = 0;
+  FrameGroupLess less;
+  for (unsigned int i = 1; i <= num_frames; i++) {
+    if (i == num_frames || less(frames[begin], frames[i])) {
+      encodeGroup(begin, i);
+      begin = i;
+    }
+  }
+
+  // sent; the streams may be destroyed without cancelling
+  for (unsigned int i = 0; i < num_frames; i++)
+    frames[i]->stream->batch = NULL;
+
+  num_frames = 0;
+  frames_mut.unlock();
+}
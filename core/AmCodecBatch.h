@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmCodecBatch.h */
+#ifndef _AmCodecBatch_h_
+#define _AmCodecBatch_h_
+
+#include "AmThread.h"
+#include "amci/amci.h"
+
+#include <vector>
+
+class AmRtpAudio;
+
+/**
+ * \brief frames of one media processor thread encoded together
+ *
+ * If the codec has a batch encoder (amci_codec_t::encode_batch),
+ * AmRtpAudio::put() only queues its frame into the batch of the media
+ * processor thread. After all sessions' writeStreams (conferences with
+ * AmMultiPartyMixer, AmB2BMedia relays, ...) the thread flushes the
+ * batch: the frames are encoded with one call per codec and sent.
+ */
+class AmCodecBatch
+{
+  struct Frame {
+    AmRtpAudio*   stream;
+    amci_codec_t* codec;
+    long          h_codec;
+    unsigned int  channels;
+    unsigned int  rate;
+    unsigned int  rtp_ts;
+    int           size;
+    unsigned char in[AUDIO_BUFFER_SIZE];
+    unsigned char out[AUDIO_BUFFER_SIZE];
+  };
+
+  /* frames[0..num_frames) are queued, the rest is kept for reuse */
+  std::vector<Frame*> frames;
+  unsigned int num_frames;
+
+  /* arguments of one batch encoder call */
+  std::vector<unsigned char*> in_bufs;
+  std::vector<unsigned char*> out_bufs;
+  std::vector<int>            sizes;
+  std::vector<long>           h_codecs;
+
+  /* held while flushing, so that streams can be cancelled
+     from other threads (see cancel()) */
+  AmMutex frames_mut;
+
+  static __thread AmCodecBatch* thread_batch;
+
+  void encodeGroup(unsigned int begin, unsigned int end);
+
+public:
+  AmCodecBatch();
+  ~AmCodecBatch();
+
+  /** batch of the calling thread, NULL if not batching */
+  static AmCodecBatch* current() { return thread_batch; }
+
+  /** make this the batch of the calling thread */
+  void setCurrent() { thread_batch = this; }
+
+  /** queue size bytes of PCM to be encoded with the stream's current codec */
+  void add(AmRtpAudio* stream, amci_codec_t* codec, long h_codec,
+	   unsigned int channels, unsigned int rate, unsigned int rtp_ts,
+	   unsigned char* buffer, unsigned int size);
+
+  /** drop the frames of a stream (destroyed, changing its codec or
+      anything used for sending: called under the stream's media lock) */
+  void cancel(AmRtpAudio* stream);
+
+  /** encode and send all queued frames */
+  void flush();
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmCodecStats.h"
+#include "AmPlugIn.h"
+#include "AmThread.h"
+#include "AmUtils.h"
+#include "log.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+__thread AmCodecThreadStats* AmCodecStats::thread_stats = NULL;
+
+/* all threads' stats, never freed (threads are long-lived) */
+static std::vector<AmCodecThreadStats*> all_thread_stats;
+static AmMutex all_thread_stats_mut;
+
+AmCodecThreadStats* AmCodecStats::registerThread()
+{
+  AmCodecThreadStats* s = new AmCodecThreadStats();
+  memset(s, 0, sizeof(AmCodecThreadStats));
+  s->thread = pthread_self();
+
+  all_thread_stats_mut.lock();
+  all_thread_stats.push_back(s);
+  all_thread_stats_mut.unlock();
+
+  thread_stats = s;
+  return s;
+}
+
+double AmCodecStats::ticksPerUs()
+{
+#ifdef CODEC_STATS_TSC
+  static double tsc_per_us = 0.0;
+
+  if (tsc_per_us == 0.0) {
+    // measure once
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    unsigned long long c0 = ticks();
+    usleep(20000);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    unsigned long long c1 = ticks();
+
+    double us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    tsc_per_us = (c1 - c0) / us;
+  }
+  return tsc_per_us;
+#else
+  return 1000.0;
+#endif
+}
+
+static string codecName(int codec_id)
+{
+  vector<SdpPayload> payloads;
+  AmPlugIn::instance()->getPayloads(payloads);
+  for (vector<SdpPayload>::iterator it = payloads.begin();
+       it != payloads.end(); it++) {
+    amci_payload_t* p = AmPlugIn::instance()->payload(it->payload_type);
+    if (p && p->codec_id == codec_id)
+      return string(p->name) + "/" + int2str(p->sample_rate);
+  }
+  return "codec_" + int2str(codec_id);
+}
+
+static void addCounter(AmArg& codec, const char* dir,
+		       const AmCodecThreadStats::Counter& c, double ticks_per_us)
+{
+  string frames = string(dir) + "_frames";
+  string us = string(dir) + "_us";
+
+  if (!codec.hasMember(frames)) {
+    codec[frames] = (long long)0;
+    codec[us] = (long long)0;
+  }
+  codec[frames] = codec[frames].asLongLong() + (long long)c.frames;
+  codec[us] = codec[us].asLongLong() + (long long)(c.ticks / ticks_per_us);
+}
+
+static void addAverage(AmArg& codec, const char* dir)
+{
+  string frames = string(dir) + "_frames";
+  if (!codec.hasMember(frames) || !codec[frames].asLongLong())
+    return;
+
+  codec[string(dir) + "_us_per_frame"] =
+    (double)codec[string(dir) + "_us"].asLongLong() / codec[frames].asLongLong();
+}
+
+void AmCodecStats::getStats(AmArg& stats)
+{
+  double ticks_per_us = ticksPerUs();
+  std::map<int, string> names;
+
+  AmArg& codecs = stats["codecs"];
+  AmArg& threads = stats["threads"];
+  codecs.assertStruct();
+  threads.assertStruct();
+  stats["enabled"] = AmConfig::CodecStats;
+
+  all_thread_stats_mut.lock();
+  for (std::vector<AmCodecThreadStats*>::iterator it = all_thread_stats.begin();
+       it != all_thread_stats.end(); it++) {
+    AmCodecThreadStats* s = *it;
+    char tid[24];
+    snprintf(tid, sizeof(tid), "%lx", (unsigned long)s->thread);
+    AmArg& thread = threads[tid];
+    thread.assertStruct();
+
+    for (int id = 0; id < CODEC_STATS_MAX_ID; id++) {
+      if (!s->encode[id].frames && !s->decode[id].frames)
+	continue;
+
+      if (names.find(id) == names.end())
+	names[id] = codecName(id);
+      const string& name = names[id];
+
+      if (s->encode[id].frames) {
+	addCounter(codecs[name], "encode", s->encode[id], ticks_per_us);
+	addCounter(thread[name], "encode", s->encode[id], ticks_per_us);
+      }
+      if (s->decode[id].frames) {
+	addCounter(codecs[name], "decode", s->decode[id], ticks_per_us);
+	addCounter(thread[name], "decode", s->decode[id], ticks_per_us);
+      }
+    }
+  }
+  all_thread_stats_mut.unlock();
+
+  for (AmArg::ValueStruct::const_iterator it = codecs.begin();
+       it != codecs.end(); it++) {
+    addAverage(codecs[it->first], "encode");
+    addAverage(codecs[it->first], "decode");
+  }
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmCodecStats.h */
+#ifndef _AmCodecStats_h_
+#define _AmCodecStats_h_
+
+#include "AmArg.h"
+#include "AmConfig.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CODEC_STATS_TSC
+#include <x86intrin.h>
+#endif
+
+/** codec ids (amci/codecs.h) counted */
+#define CODEC_STATS_MAX_ID 128
+
+/**
+ * \brief time spent in codecs, per thread
+ *
+ * Only the thread itself writes its counters.
+ */
+struct AmCodecThreadStats
+{
+  struct Counter {
+    unsigned long long frames;
+    unsigned long long ticks;
+  };
+
+  pthread_t thread;
+  Counter encode[CODEC_STATS_MAX_ID];
+  Counter decode[CODEC_STATS_MAX_ID];
+};
+
+/**
+ * \brief per codec and thread accounting of encoding/decoding
+ *
+ * AmAudio::encode()/decode() count frames and CPU time stamp counter
+ * ticks (ns where there is no TSC) spent in the codec per thread
+ * (codec_stats in sems.conf). The counters are read with the
+ * stats command get_codecstats.
+ */
+class AmCodecStats
+{
+  static __thread AmCodecThreadStats* thread_stats;
+
+  static AmCodecThreadStats* registerThread();
+
+public:
+  /** time stamp to pass to encoded()/decoded(), 0 if disabled */
+  static inline unsigned long long start();
+
+  /** frames: number of frames coded since start_ticks (batch conversion) */
+  static inline void encoded(int codec_id, unsigned long long start_ticks,
+			     unsigned int frames = 1);
+  static inline void decoded(int codec_id, unsigned long long start_ticks,
+			     unsigned int frames = 1);
+
+  static inline unsigned long long ticks() {
+#ifdef CODEC_STATS_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+  /** ticks per microsecond */
+  static double ticksPerUs();
+
+  /** counters summed up per codec and per thread */
+  static void getStats(AmArg& stats);
+};
+
+inline unsigned long long AmCodecStats::start()
+{
+  if (!AmConfig::CodecStats)
+    return 0;
+  return ticks();
+}
+
+inline void AmCodecStats::encoded(int codec_id, unsigned long long start_ticks,
+				  unsigned int frames)
+{
+  if (!start_ticks || codec_id < 0 || codec_id >= CODEC_STATS_MAX_ID)
+    return;
+
+  AmCodecThreadStats* s = thread_stats;
+  if (!s) s = registerThread();
+
+  s->encode[codec_id].frames += frames;
+  s->encode[codec_id].ticks += ticks() - start_ticks;
+}
+
+inline void AmCodecStats::decoded(int codec_id, unsigned long long start_ticks,
+				  unsigned int frames)
+{
+  if (!start_ticks || codec_id < 0 || codec_id >= CODEC_STATS_MAX_ID)
+    return;
+
+  AmCodecThreadStats* s = thread_stats;
+  if (!s) s = registerThread();
+
+  s->decode[codec_id].frames += frames;
+  s->decode[codec_id].ticks += ticks() - start_ticks;
+}
+
+#endif
@@ -42,6 +42,7 @@
 #include "AmUtils.h"
 #include "AmSessionContainer.h"
 #include "Am100rel.h"
+#include "AmRtpPortMap.h"
 #include "sip/transport.h"
 #include "sip/resolver.h"
 #include "sip/ip_util.h"
@@ -97,6 +98,28 @@ unsigned int AmConfig::MaxForwards             = MAX_FORWARDS;
 bool	     AmConfig::SingleCodecInOK	       = false;
 unsigned int AmConfig::DeadRtpTime             = DEAD_RTP_TIME;
 bool         AmConfig::IgnoreRTPXHdrs          = false;
+bool         AmConfig::PrecodedPrompts         = false;
+unsigned int AmConfig::PrecodedPromptsMaxSize  = 64*1024*1024;
+bool         AmConfig::MmapAudioFiles          = false;
+bool         AmConfig::CodecStats              = true;
+bool         AmConfig::BatchEncoding           = false;
+bool         AmConfig::LatencyStats            = true;
+unsigned int AmConfig::JitterBufferMinDelay    = 20;
+unsigned int AmConfig::JitterBufferMaxDelay    = 500;
+unsigned int AmConfig::RtpSocketPool           = 16;
+unsigned int AmConfig::RtpPortQuarantine       = 5;
+bool         AmConfig::RtcpMux                 = false;
+bool         AmConfig::RtcpReports             = false;
+unsigned int AmConfig::RtpSharedPorts          = 0;
+unsigned int AmConfig::RtpPacingSlots          = 4;
+unsigned int AmConfig::RtpPacingQueue          = 1024;
+unsigned int AmConfig::RecordingWriterThreads  = 1;
+unsigned int AmConfig::RecordingWriterMaxQueue = 16*1024*1024;
+bool         AmConfig::MsgLoggerAsync          = false;
+unsigned int AmConfig::MsgLoggerRingSize       = 1024*1024;
+unsigned int AmConfig::MsgLoggerFlushInterval  = 100;
+unsigned long long AmConfig::MsgLoggerMaxFileSize = 0;
+unsigned int AmConfig::MsgLoggerRotateInterval = 0;
 string       AmConfig::Application             = "";
 AmConfig::ApplicationSelector AmConfig::AppSelect        = AmConfig::App_SPECIFIED;
 RegexMappingVector AmConfig::AppMapping;
@@ -132,6 +155,7 @@ vector <string> AmConfig::CodecOrder;
 
 Dtmf::InbandDetectorType 
 AmConfig::DefaultDTMFDetector     = Dtmf::SEMSInternal;
+bool AmConfig::DtmfFaxTones       = false;
 bool AmConfig::IgnoreSIGCHLD      = true;
 bool AmConfig::IgnoreSIGPIPE      = true;
 
@@ -169,29 +193,24 @@ AmConfig::RTP_interface::RTP_interface()
   : IP_interface(),
     RtpLowPort(RTP_LOWPORT),
     RtpHighPort(RTP_HIGHPORT),
-    next_rtp_port(-1)
+    Dscp(-1),
+    RelayDscp(-1),
+    Priority(-1),
+    RelayPriority(-1),
+    Pacing(false),
+    port_map(NULL)
 {
 }
 
-int AmConfig::RTP_interface::getNextRtpPort()
+AmRtpPortMap* AmConfig::RTP_interface::getPortMap()
 {
-    
-  int port=0;
+  AmLock l(port_map_mut);
 
-  next_rtp_port_mut.lock();
-  if(next_rtp_port < 0){
-    next_rtp_port = RtpLowPort;
-  }
-    
-  port = next_rtp_port & 0xfffe;
-  next_rtp_port += 2;
+  if (!port_map)
+    port_map = new AmRtpPortMap(RtpLowPort, RtpHighPort,
+				RtpPortQuarantine * 1000);
 
-  if(next_rtp_port >= RtpHighPort){
-    next_rtp_port = RtpLowPort;
-  }
-  next_rtp_port_mut.unlock();
-    
-  return port;
+  return port_map;
 }
 
 
@@ -544,6 +563,64 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("recording_writer_threads")){
+    if(str2i(cfg.getParameter("recording_writer_threads"),
+	     RecordingWriterThreads)){
+      ERROR("invalid recording_writer_threads value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("recording_writer_max_queue")){
+    unsigned int kb;
+    if(str2i(cfg.getParameter("recording_writer_max_queue"), kb)){
+      ERROR("invalid recording_writer_max_queue value specified");
+      ret = -1;
+    } else {
+      RecordingWriterMaxQueue = kb * 1024;
+    }
+  }
+
+  if (cfg.hasParameter("msg_logger_async")) {
+    MsgLoggerAsync = (cfg.getParameter("msg_logger_async") == "yes");
+  }
+
+  if(cfg.hasParameter("msg_logger_ring_size")){
+    unsigned int kb;
+    if(str2i(cfg.getParameter("msg_logger_ring_size"), kb) || !kb){
+      ERROR("invalid msg_logger_ring_size value specified");
+      ret = -1;
+    } else {
+      MsgLoggerRingSize = kb * 1024;
+    }
+  }
+
+  if(cfg.hasParameter("msg_logger_flush_interval")){
+    if(str2i(cfg.getParameter("msg_logger_flush_interval"),
+	     MsgLoggerFlushInterval) || !MsgLoggerFlushInterval){
+      ERROR("invalid msg_logger_flush_interval value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("msg_logger_max_file_size")){
+    unsigned int kb;
+    if(str2i(cfg.getParameter("msg_logger_max_file_size"), kb)){
+      ERROR("invalid msg_logger_max_file_size value specified");
+      ret = -1;
+    } else {
+      MsgLoggerMaxFileSize = kb * 1024ULL;
+    }
+  }
+
+  if(cfg.hasParameter("msg_logger_rotate_interval")){
+    if(str2i(cfg.getParameter("msg_logger_rotate_interval"),
+	     MsgLoggerRotateInterval)){
+      ERROR("invalid msg_logger_rotate_interval value specified");
+      ret = -1;
+    }
+  }
+
   if(cfg.hasParameter("rtp_receiver_threads")){
     if(!setRTPReceiverThreads(cfg.getParameter("rtp_receiver_threads"))){
       ERROR("invalid rtp_receiver_threads value specified");
@@ -551,6 +628,35 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("rtp_socket_pool")){
+    if(str2i(cfg.getParameter("rtp_socket_pool"), RtpSocketPool)){
+      ERROR("invalid rtp_socket_pool value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("rtp_port_quarantine")){
+    if(str2i(cfg.getParameter("rtp_port_quarantine"), RtpPortQuarantine)){
+      ERROR("invalid rtp_port_quarantine value specified");
+      ret = -1;
+    }
+  }
+
+  if (cfg.hasParameter("rtcp_mux")) {
+    RtcpMux = (cfg.getParameter("rtcp_mux") == "yes");
+  }
+
+  if (cfg.hasParameter("rtcp_reports")) {
+    RtcpReports = (cfg.getParameter("rtcp_reports") == "yes");
+  }
+
+  if(cfg.hasParameter("rtp_shared_ports")){
+    if(str2i(cfg.getParameter("rtp_shared_ports"), RtpSharedPorts)){
+      ERROR("invalid rtp_shared_ports value specified");
+      ret = -1;
+    }
+  }
+
   if(cfg.hasParameter("sip_server_threads")){
     if(!setSIPServerThreads(cfg.getParameter("sip_server_threads"))){
       ERROR("invalid sip_server_threads value specified");
@@ -588,6 +694,10 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("dtmf_fax_tones")){
+    DtmfFaxTones = (cfg.getParameter("dtmf_fax_tones") == "yes");
+  }
+
   if(cfg.hasParameter("session_limit")){ 
     vector<string> limit = explode(cfg.getParameter("session_limit"), ";");
     if (limit.size() != 3) {
@@ -667,11 +777,84 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if (cfg.hasParameter("precoded_prompts")) {
+    PrecodedPrompts = (cfg.getParameter("precoded_prompts") == "yes");
+  }
+
+  if(cfg.hasParameter("precoded_prompts_max_size")){
+    unsigned int kb;
+    if(str2i(cfg.getParameter("precoded_prompts_max_size"), kb)){
+      ERROR("invalid precoded_prompts_max_size value specified");
+      ret = -1;
+    } else {
+      PrecodedPromptsMaxSize = kb * 1024;
+    }
+  }
+
+  if (cfg.hasParameter("mmap_audio_files")) {
+    MmapAudioFiles = (cfg.getParameter("mmap_audio_files") == "yes");
+  }
+
+  if (cfg.hasParameter("codec_stats")) {
+    CodecStats = (cfg.getParameter("codec_stats") != "no");
+  }
+
+  if(cfg.hasParameter("rtp_pacing_slots")){
+    if(str2i(cfg.getParameter("rtp_pacing_slots"), RtpPacingSlots) ||
+       !RtpPacingSlots){
+      ERROR("invalid rtp_pacing_slots value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("rtp_pacing_queue")){
+    if(str2i(cfg.getParameter("rtp_pacing_queue"), RtpPacingQueue)){
+      ERROR("invalid rtp_pacing_queue value specified");
+      ret = -1;
+    }
+  }
+
+  if (cfg.hasParameter("batch_encoding")) {
+    BatchEncoding = (cfg.getParameter("batch_encoding") == "yes");
+  }
+
+  if (cfg.hasParameter("latency_stats")) {
+    LatencyStats = (cfg.getParameter("latency_stats") != "no");
+  }
+
+  if(cfg.hasParameter("jitter_buffer_min_delay")){
+    if(str2i(cfg.getParameter("jitter_buffer_min_delay"),
+	     JitterBufferMinDelay)){
+      ERROR("invalid jitter_buffer_min_delay value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("jitter_buffer_max_delay")){
+    if(str2i(cfg.getParameter("jitter_buffer_max_delay"),
+	     JitterBufferMaxDelay)){
+      ERROR("invalid jitter_buffer_max_delay value specified");
+      ret = -1;
+    }
+  }
+
   if (cfg.hasParameter("resampling_library")) {
 	string resamplings = cfg.getParameter("resampling_library");
 	if (resamplings == "libsamplerate") {
 	  ResamplingImplementationType = AmAudio::LIBSAMPLERATE;
 	}
+#ifdef USE_INTERNAL_RESAMPLER
+	else if (resamplings == "internal") {
+	  ResamplingImplementationType = AmAudio::INTERNAL_RESAMPLER;
+	}
+	else if (resamplings == "polyphase") {
+	  ResamplingImplementationType = AmAudio::POLYPHASE_RESAMPLER;
+	}
+#endif
+	else {
+	  WARN("unknown resampling_library '%s', using default\n",
+	       resamplings.c_str());
+	}
   }
 
   return ret;
@@ -862,6 +1045,45 @@ static int readRTPInterface(AmConfigReader& cfg, const string& i_name)
     }
   }
 
+  // rtp_dscp / rtp_relay_dscp
+  if(cfg.hasParameter("rtp_dscp" + suffix)){
+    if(!str2int(cfg.getParameter("rtp_dscp" + suffix),intf.Dscp) ||
+       intf.Dscp < 0 || intf.Dscp > 63){
+      ERROR("rtp_dscp%s: invalid DSCP value\n",suffix.c_str());
+      ret = -1;
+    }
+  }
+  intf.RelayDscp = intf.Dscp;
+  if(cfg.hasParameter("rtp_relay_dscp" + suffix)){
+    if(!str2int(cfg.getParameter("rtp_relay_dscp" + suffix),intf.RelayDscp) ||
+       intf.RelayDscp < 0 || intf.RelayDscp > 63){
+      ERROR("rtp_relay_dscp%s: invalid DSCP value\n",suffix.c_str());
+      ret = -1;
+    }
+  }
+
+  // rtp_priority / rtp_relay_priority
+  if(cfg.hasParameter("rtp_priority" + suffix)){
+    if(!str2int(cfg.getParameter("rtp_priority" + suffix),intf.Priority) ||
+       intf.Priority < 0){
+      ERROR("rtp_priority%s: invalid priority\n",suffix.c_str());
+      ret = -1;
+    }
+  }
+  intf.RelayPriority = intf.Priority;
+  if(cfg.hasParameter("rtp_relay_priority" + suffix)){
+    if(!str2int(cfg.getParameter("rtp_relay_priority" + suffix),
+	       intf.RelayPriority) || intf.RelayPriority < 0){
+      ERROR("rtp_relay_priority%s: invalid priority\n",suffix.c_str());
+      ret = -1;
+    }
+  }
+
+  // rtp_pacing
+  if(cfg.hasParameter("rtp_pacing" + suffix)){
+    intf.Pacing = (cfg.getParameter("rtp_pacing" + suffix) == "yes");
+  }
+
   if(!i_name.empty())
     intf.name = i_name;
   else
@@ -41,6 +41,8 @@ using std::map;
 using std::multimap;
 #include <utility>
 
+class AmRtpPortMap;
+
 /**
  * \brief holds the current configuration.
  *
@@ -126,13 +128,25 @@ struct AmConfig
     /** Highest local RTP port */
     int RtpHighPort;
 
+    /** DSCP and SO_PRIORITY of streams processed locally / relayed
+	(-1: not set) */
+    int Dscp;
+    int RelayDscp;
+    int Priority;
+    int RelayPriority;
+
+    /** spread the packets of the media processor over the tick
+	(AmRtpPacer) */
+    bool Pacing;
+
     RTP_interface();
 
-    int getNextRtpPort();
+    /** ports of the interface (created on first use) */
+    AmRtpPortMap* getPortMap();
 
   private:
-    int next_rtp_port;
-    AmMutex next_rtp_port_mut;
+    AmRtpPortMap* port_map;
+    AmMutex port_map_mut;
   };
 
   static vector<SIP_interface>      SIP_Ifs;
@@ -260,6 +274,9 @@ struct AmConfig
 
   static Dtmf::InbandDetectorType DefaultDTMFDetector;
 
+  /** Report fax CNG/CED tones from the internal inband detector? */
+  static bool DtmfFaxTones;
+
   static bool IgnoreSIGCHLD;
 
   static bool IgnoreSIGPIPE;
@@ -272,6 +289,60 @@ struct AmConfig
 
   static AmAudio::ResamplingImplementationType ResamplingImplementationType;
 
+  /** Play prompts pre-encoded per codec (AmPromptCache)? */
+  static bool PrecodedPrompts;
+  /** Maximum bytes of pre-encoded prompts kept in the AmPromptCache */
+  static unsigned int PrecodedPromptsMaxSize;
+
+  /** Read audio files from shared memory mappings? */
+  static bool MmapAudioFiles;
+
+  /** Account time spent in codecs (AmCodecStats)? */
+  static bool CodecStats;
+
+  /** Encode the frames of a media processor thread together (AmCodecBatch)? */
+  static bool BatchEncoding;
+
+  /** Record latency histograms (AmLatencyStats)? */
+  static bool LatencyStats;
+
+  /** Playout delay limits of the jitter buffer (JB_PLAYOUT) in ms */
+  static unsigned int JitterBufferMinDelay;
+  static unsigned int JitterBufferMaxDelay;
+
+  /** Bound RTP/RTCP socket pairs kept ready per RTP interface */
+  static unsigned int RtpSocketPool;
+  /** Time a released RTP port pair is not used again in s */
+  static unsigned int RtpPortQuarantine;
+  /** Offer rtcp-mux (RFC 5761) and accept it in answers? */
+  static bool RtcpMux;
+  /** Send RTCP reports for streams processed locally? */
+  static bool RtcpReports;
+  /** RTP/RTCP socket pairs per RTP interface shared by all streams (0: off) */
+  static unsigned int RtpSharedPorts;
+
+  /** Send slots per media processor tick (rtp_pacing) */
+  static unsigned int RtpPacingSlots;
+  /** Packets queued per media processor thread for pacing */
+  static unsigned int RtpPacingQueue;
+
+  /** Threads writing recorded files, 0 to write in the media processor */
+  static unsigned int RecordingWriterThreads;
+
+  /** Maximum bytes queued per recording writer thread */
+  static unsigned int RecordingWriterMaxQueue;
+
+  /** Write message logs (SIP/RTP pcap) from a writer thread? */
+  static bool MsgLoggerAsync;
+  /** Bytes of log records buffered per thread */
+  static unsigned int MsgLoggerRingSize;
+  /** Interval of the message log writer in ms */
+  static unsigned int MsgLoggerFlushInterval;
+  /** Rotate message log files bigger than this (bytes, 0: never) */
+  static unsigned long long MsgLoggerMaxFileSize;
+  /** Rotate message log files older than this (seconds, 0: never) */
+  static unsigned int MsgLoggerRotateInterval;
+
   /** Read global configuration file and insert values. Maybe overwritten by
    * command line arguments */
   static int readConfiguration();
@@ -28,13 +28,20 @@
  */
 #include "AmDtmfDetector.h"
 #include "AmSession.h"
+#include "AmConfig.h"
 #include "log.h"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <math.h>
+#include <string.h>
 #include <sys/time.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GOERTZEL_X86_SIMD
+#include <immintrin.h>
+#endif
+
 // per RFC this is 5000ms, but in reality then 
 // one needs to wait 5 sec on the first keypress
 // (e.g. due to a bug on recent snoms)
@@ -199,7 +206,8 @@ void AmDtmfDetector::setInbandDetector(Dtmf::InbandDetectorType t, int sample_ra
 	  "recompile with -D USE_SPANDSP\n");
   }
   if (!m_inbandDetector.get())
-    m_inbandDetector.reset(new AmSemsInbandDtmfDetector(this, sample_rate));
+    m_inbandDetector.reset(new AmSemsInbandDtmfDetector(this, sample_rate,
+							AmConfig::DtmfFaxTones));
 
   return;
 #else
@@ -207,7 +215,8 @@ void AmDtmfDetector::setInbandDetector(Dtmf::InbandDetectorType t, int sample_ra
   if ((t != m_inband_type) || (!m_inbandDetector.get())) {
     if (t == Dtmf::SEMSInternal) {
       DBG("Setting internal DTMF detector\n");
-      m_inbandDetector.reset(new AmSemsInbandDtmfDetector(this, sample_rate));
+      m_inbandDetector.reset(new AmSemsInbandDtmfDetector(this, sample_rate,
+							  AmConfig::DtmfFaxTones));
     } else { // if t == SpanDSP
       DBG("Setting spandsp DTMF detector\n");
       m_inbandDetector.reset(new AmSpanDSPInbandDtmfDetector(this, sample_rate));
@@ -503,6 +512,10 @@ AmInbandDtmfDetector::AmInbandDtmfDetector(AmKeyPressSink *keysink)
 #define IVR_DTMF_C        14 
 #define IVR_DTMF_D        15
 
+/* fax tones, reported with their RFC 4733 event codes */
+#define IVR_FAX_CED       32 /* ANSam/CED, 2100 Hz */
+#define IVR_FAX_CNG       36 /* CNG, 1100 Hz */
+
 /* the detector returns these values */
 
 static int IVR_dtmf_matrix[4][4] =
@@ -520,6 +533,10 @@ static int IVR_dtmf_matrix[4][4] =
 #define REL_DTMF_TRESH     4000     /* above this is dtmf                         */
 #define REL_SILENCE_TRESH   200     /* below this is silence                      */
 #define REL_AMP_BITS          9     /* bits per sample, reduced to avoid overflow */
+/* below this block energy (sum of squared samples) no filter can reach
+   REL_DTMF_TRESH (|X(k)|**2 <= N * energy), i.e. the block is silence;
+   ~ -37 dBFS, 1/4 of the bound to allow for rounding in the filters */
+#define REL_ENERGY_GATE   10000
 #define PI              3.1415926
 #define NELEMSOF(x) (sizeof(x)/sizeof(*x))
 
@@ -541,6 +558,9 @@ static dtmf_t dtmf_tones[8] =
     {1633, HIGRP}
   };
 
+static int fax_freqs[2] = { 1100, 2100 };
+static int fax_events[2] = { IVR_FAX_CNG, IVR_FAX_CED };
+
 static char dtmf_matrix[4][4] =
   {
     {'1', '2', '3', 'A'},
@@ -549,53 +569,166 @@ static char dtmf_matrix[4][4] =
     {'*', '0', '#', 'D'}
   };
 
-AmSemsInbandDtmfDetector::AmSemsInbandDtmfDetector(AmKeyPressSink *keysink, int sample_rate)
+/*
+ * Goertzel algorithm.
+ * See http://ptolemy.eecs.berkeley.edu/~pino/Ptolemy/papers/96/dtmf_ict/
+ * for more info.
+ *
+ * The filters run side by side, one vector lane each, over a block of
+ * n samples:  sk = x[n] + ((coeff[k] * sk1) >> 15) - sk2
+ * with 32 bit wrap around (as the vector instructions do). The last two
+ * states of the nfilt (multiple of 8) filters are stored to s1 and s2.
+ */
+
+static void goertzel_c(const int* x, int n, const int* coeff, int nfilt,
+		       int* s1, int* s2)
+{
+  for (int k = 0; k < nfilt; k++) {
+    unsigned int sk = 0, sk1 = 0, sk2 = 0;
+    for (int i = 0; i < n; i++) {
+      sk = (unsigned int)x[i] + (unsigned int)((int)(coeff[k] * sk1) >> 15) - sk2;
+      sk2 = sk1;
+      sk1 = sk;
+    }
+    s1[k] = (int)sk;
+    s2[k] = (int)sk2;
+  }
+}
+
+#ifdef GOERTZEL_X86_SIMD
+
+__attribute__((target("sse4.1")))
+static void goertzel_sse41(const int* x, int n, const int* coeff, int nfilt,
+			   int* s1, int* s2)
+{
+  for (int k = 0; k < nfilt; k += 8) {
+    __m128i c0 = _mm_loadu_si128((const __m128i*)(coeff + k));
+    __m128i c1 = _mm_loadu_si128((const __m128i*)(coeff + k + 4));
+    __m128i a1 = _mm_setzero_si128(), a2 = a1;
+    __m128i b1 = a1, b2 = a1;
+
+    for (int i = 0; i < n; i++) {
+      __m128i xi = _mm_set1_epi32(x[i]);
+      __m128i a = _mm_sub_epi32(_mm_add_epi32(xi, _mm_srai_epi32(_mm_mullo_epi32(c0, a1), 15)), a2);
+      __m128i b = _mm_sub_epi32(_mm_add_epi32(xi, _mm_srai_epi32(_mm_mullo_epi32(c1, b1), 15)), b2);
+      a2 = a1; a1 = a;
+      b2 = b1; b1 = b;
+    }
+    _mm_storeu_si128((__m128i*)(s1 + k), a1);
+    _mm_storeu_si128((__m128i*)(s1 + k + 4), b1);
+    _mm_storeu_si128((__m128i*)(s2 + k), a2);
+    _mm_storeu_si128((__m128i*)(s2 + k + 4), b2);
+  }
+}
+
+__attribute__((target("avx2")))
+static void goertzel_avx2(const int* x, int n, const int* coeff, int nfilt,
+			  int* s1, int* s2)
+{
+  for (int k = 0; k < nfilt; k += 8) {
+    __m256i c = _mm256_loadu_si256((const __m256i*)(coeff + k));
+    __m256i a1 = _mm256_setzero_si256(), a2 = a1;
+
+    for (int i = 0; i < n; i++) {
+      __m256i a = _mm256_sub_epi32(_mm256_add_epi32(_mm256_set1_epi32(x[i]),
+						    _mm256_srai_epi32(_mm256_mullo_epi32(c, a1), 15)),
+				   a2);
+      a2 = a1; a1 = a;
+    }
+    _mm256_storeu_si256((__m256i*)(s1 + k), a1);
+    _mm256_storeu_si256((__m256i*)(s2 + k), a2);
+  }
+}
+
+#endif
+
+typedef void (*goertzel_fn)(const int*, int, const int*, int, int*, int*);
+
+static int simd_level = -1;
+static goertzel_fn goertzel = goertzel_c;
+
+static int cpu_simd_level()
+{
+#ifdef GOERTZEL_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return 2;
+  if (__builtin_cpu_supports("sse4.1")) return 1;
+#endif
+  return 0;
+}
+
+void AmSemsInbandDtmfDetector::setSimdLevel(int level)
+{
+  int max = cpu_simd_level();
+  simd_level = level < max ? level : max;
+
+  switch (simd_level) {
+#ifdef GOERTZEL_X86_SIMD
+  case 2: goertzel = goertzel_avx2; break;
+  case 1: goertzel = goertzel_sse41; break;
+#endif
+  default: goertzel = goertzel_c; break;
+  }
+}
+
+int AmSemsInbandDtmfDetector::getSimdLevel()
+{
+  if (simd_level < 0) setSimdLevel(2);
+  return simd_level;
+}
+
+/* audio timestamp to time of day (as used for the key press times) */
+static void ts2timeval(int ts, int rate, struct timeval& tv)
+{
+  tv.tv_sec = ts / rate;
+  tv.tv_usec = ((ts * 10000) / (rate/100)) % 1000000;
+}
+
+AmSemsInbandDtmfDetector::AmSemsInbandDtmfDetector(AmKeyPressSink *keysink, int sample_rate,
+						   bool fax_tones)
   : AmInbandDtmfDetector(keysink),
+    SAMPLERATE(sample_rate),
+    m_nfilters(fax_tones ? REL_NCOEFF + REL_NFAX : REL_NCOEFF),
+    m_energy(0),
     m_last(' '),
     m_idx(0),
     m_count(0),
-    SAMPLERATE(sample_rate)
+    m_fax_tones(fax_tones),
+    m_fax_last(-1),
+    m_fax_count(0)
 {
+  memset(rel_cos2pik, 0, sizeof(rel_cos2pik));
+  memset(m_result, 0, sizeof(m_result));
+
   /* precalculate 2 * cos (2 PI k / N) */
-  for(unsigned i = 0; i < NELEMSOF(rel_cos2pik); i++) {
+  for(int i = 0; i < m_nfilters; i++) {
+    int freq = i < REL_NCOEFF ? dtmf_tones[i].freq : fax_freqs[i - REL_NCOEFF];
     // FIXME: fixed samplerate. won't work for wideband
-    int k = (int)((double)dtmf_tones[i].freq * REL_DTMF_NPOINTS / SAMPLERATE + 0.5);
+    int k = (int)((double)freq * REL_DTMF_NPOINTS / SAMPLERATE + 0.5);
     rel_cos2pik[i] = (int)(2 * 32768 * cos(2 * PI * k / REL_DTMF_NPOINTS));
   }
+
+  getSimdLevel();
 }
 AmSemsInbandDtmfDetector::~AmSemsInbandDtmfDetector() {
 }
 
-/*
- * Goertzel algorithm.
- * See http://ptolemy.eecs.berkeley.edu/~pino/Ptolemy/papers/96/dtmf_ict/
- * for more info.
- */
-
 void AmSemsInbandDtmfDetector::isdn_audio_goertzel_relative()
 {
-  int sk, sk1, sk2;
+  int s1[REL_MAXFILTERS], s2[REL_MAXFILTERS];
+
+  goertzel(m_buf, REL_DTMF_NPOINTS, rel_cos2pik, (m_nfilters + 7) & ~7, s1, s2);
 
-  for (int k = 0; k < REL_NCOEFF; k++) {
+  for (int k = 0; k < m_nfilters; k++) {
     // like m_buf, sk..sk2 are in (32-REL_AMP_BITS).REL_AMP_BITS fixed-point format
-    sk = sk1 = sk2 = 0;
-    for (int n = 0; n < REL_DTMF_NPOINTS; n++) {
-      sk = m_buf[n] + ((rel_cos2pik[k] * sk1) >> 15) - sk2;
-      sk2 = sk1;
-      sk1 = sk;
-    }
+    int sk = s1[k];
+    int sk2 = s2[k];
+
     /* Avoid overflows */
     sk >>= 1;
     sk2 >>= 1;
-    /* compute |X(k)|**2 */
-    /* report overflows. This should not happen. */
-    /* Comment this out if desired */
-    /*if (sk < -32768 || sk > 32767)
-      DBG("isdn_audio: dtmf goertzel overflow, sk=%d\n", sk);
-      if (sk2 < -32768 || sk2 > 32767)
-      DBG("isdn_audio: dtmf goertzel overflow, sk2=%d\n", sk2);
-    */
 
+    /* compute |X(k)|**2 */
     // note that the result still is in (32-REL_AMP_BITS).REL_AMP_BITS format
     m_result[k] =
       ((sk * sk) >> REL_AMP_BITS) -
@@ -661,11 +794,7 @@ void AmSemsInbandDtmfDetector::isdn_audio_eval_dtmf_relative()
 	m_lastCode = IVR_dtmf_matrix[grp[LOGRP]][grp[HIGRP]];
 		
 	if (what != m_last)
-	  {
-	    m_startTime.tv_sec = m_last_ts / SAMPLERATE;
-	    m_startTime.tv_usec = ((m_last_ts * 10000) / (SAMPLERATE/100)) 
-	      % 1000000;
-	  }
+	  ts2timeval(m_last_ts, SAMPLERATE, m_startTime);
       } else
 	what = '.';
     }
@@ -684,8 +813,7 @@ void AmSemsInbandDtmfDetector::isdn_audio_eval_dtmf_relative()
       if (m_last != ' ' && m_last != '.' && m_count >= DTMF_INTERVAL)
         {
 	  struct timeval stop;
-	  stop.tv_sec = m_last_ts / SAMPLERATE;
-	  stop.tv_usec = ((m_last_ts * 10000) / (SAMPLERATE/100)) % 1000000;
+	  ts2timeval(m_last_ts, SAMPLERATE, stop);
 	  m_keysink->registerKeyReleased(m_lastCode, Dtmf::SOURCE_INBAND, m_startTime, stop);
         }
       m_count = 0;
@@ -693,6 +821,37 @@ void AmSemsInbandDtmfDetector::isdn_audio_eval_dtmf_relative()
   m_last = what;
 }
 
+void AmSemsInbandDtmfDetector::isdn_audio_eval_fax()
+{
+  int tone = -1;
+
+  // a fax tone is alone: a pure tone at the filter frequency
+  // gives N * energy / 4096, require at least half of that
+  for (int i = 0; i < REL_NFAX; i++) {
+    int r = m_result[REL_NCOEFF + i];
+    if (r > REL_DTMF_TRESH &&
+	(long long)r * 8192 > (long long)REL_DTMF_NPOINTS * m_energy)
+      tone = i;
+  }
+
+  if (tone >= 0 && tone == m_fax_last) {
+    if (++m_fax_count >= FAX_INTERVAL)
+      m_keysink->registerKeyPressed(fax_events[tone], Dtmf::SOURCE_INBAND);
+  }
+  else {
+    if (m_fax_last >= 0 && m_fax_count >= FAX_INTERVAL) {
+      struct timeval stop;
+      ts2timeval(m_last_ts, SAMPLERATE, stop);
+      m_keysink->registerKeyReleased(fax_events[m_fax_last], Dtmf::SOURCE_INBAND,
+				     m_faxStartTime, stop);
+    }
+    if (tone >= 0)
+      ts2timeval(m_last_ts, SAMPLERATE, m_faxStartTime);
+    m_fax_count = tone >= 0 ? 1 : 0;
+  }
+  m_fax_last = tone;
+}
+
 void AmSemsInbandDtmfDetector::isdn_audio_calc_dtmf(const signed short* buf, int len, unsigned int ts)
 {
   int c;
@@ -708,12 +867,23 @@ void AmSemsInbandDtmfDetector::isdn_audio_calc_dtmf(const signed short* buf, int
       // m_buf is in (32-REL_AMP_BITS).REL_AMP_BITS fixed-point format, the samples
       // itself are in the last REL_AMP_BITS bits, i.e. they go from -1.0 to +1.0
       // (or more exactly from -1.0 to ~+0.996)
-      m_buf[m_idx++] = (*buf++) >> (15 - REL_AMP_BITS);
+      int s = (*buf++) >> (15 - REL_AMP_BITS);
+      m_buf[m_idx++] = s;
+      m_energy += s * s;
     }
     if (m_idx == NELEMSOF(m_buf)) {
-      isdn_audio_goertzel_relative();
+      if (m_energy < REL_ENERGY_GATE) {
+	// too quiet for any tone, skip the filters
+	memset(m_result, 0, sizeof(m_result));
+      }
+      else
+	isdn_audio_goertzel_relative();
+
       isdn_audio_eval_dtmf_relative();
+      if (m_fax_tones)
+	isdn_audio_eval_fax();
       m_idx = 0;
+      m_energy = 0;
       m_last_ts = ts + c;
     }
     len -= c;
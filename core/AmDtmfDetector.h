@@ -232,7 +232,9 @@ class AmInbandDtmfDetector
 /**
  * \brief Inband DTMF detector
  *
- * This class implements detection of DTMF from audio stream
+ * This class implements detection of DTMF from audio stream. All
+ * Goertzel filters run in one pass over a block (SSE4.1/AVX2 where
+ * available), blocks below the DTMF level are not filtered at all.
  */
 class AmSemsInbandDtmfDetector
 : public AmInbandDtmfDetector
@@ -245,6 +247,8 @@ class AmSemsInbandDtmfDetector
 
   static const int REL_DTMF_NPOINTS = 205;    /* Number of samples for DTMF recognition */
   static const int REL_NCOEFF = 8;            /* number of frequencies to be analyzed   */
+  static const int REL_NFAX = 2;              /* fax tones (CNG, CED)                   */
+  static const int REL_MAXFILTERS = 16;       /* filters incl. padding for the vector code */
 
   const int SAMPLERATE;
   /**
@@ -252,32 +256,50 @@ class AmSemsInbandDtmfDetector
    * audio packets were processed and all gave the same result
    */
   static const int DTMF_INTERVAL = 3;
+  /** blocks a fax tone must last to be reported (~300 ms) */
+  static const int FAX_INTERVAL = 12;
 
   /* For DTMF recognition:
    * 2 * cos(2 * PI * k / N) precalculated for all k
+   * (DTMF tones, then fax tones, zero padded)
    */
-  int rel_cos2pik[REL_NCOEFF];
+  int rel_cos2pik[REL_MAXFILTERS];
+  int m_nfilters;
 
   int m_buf[REL_DTMF_NPOINTS];
+  int m_energy;	// sum of the squared samples in m_buf
   char m_last;
   int m_idx;
-  int m_result[16];
+  int m_result[REL_MAXFILTERS];
   int m_lastCode;
   int m_last_ts;	// timestamp representative for the currently analysed filter block
 
   int m_count;
 
+  /* fax tone detection (reported as RFC 4733 events 36/32) */
+  bool m_fax_tones;
+  int m_fax_last;
+  int m_fax_count;
+  struct timeval m_faxStartTime;
+
   void isdn_audio_goertzel_relative();
   void isdn_audio_eval_dtmf_relative();
+  void isdn_audio_eval_fax();
   void isdn_audio_calc_dtmf(const signed short* buf, int len, unsigned int ts);
 
  public:
-  AmSemsInbandDtmfDetector(AmKeyPressSink *keysink, int sample_rate);
+  AmSemsInbandDtmfDetector(AmKeyPressSink *keysink, int sample_rate,
+			   bool fax_tones = false);
   ~AmSemsInbandDtmfDetector();
   /**
    * Entry point for audio stream
    */
   int streamPut(const unsigned char* samples, unsigned int size, unsigned long long system_ts);
+
+  /** set the vector instructions to use (0: none, 1: SSE4.1, 2: AVX2),
+      limited to what the CPU supports; for testing/benchmarking */
+  static void setSimdLevel(int level);
+  static int getSimdLevel();
 };
 
 
@@ -28,6 +28,7 @@
 #include "AmEventQueue.h"
 #include "log.h"
 #include "AmConfig.h"
+#include "AmLatencyStats.h"
 
 #include <typeinfo>
 AmEventQueue::AmEventQueue(AmEventHandler* handler)
@@ -42,7 +43,7 @@ AmEventQueue::~AmEventQueue()
 {
   m_queue.lock();
   while(!ev_queue.empty()){
-    delete ev_queue.front();
+    delete ev_queue.front().first;
     ev_queue.pop();
   }
   m_queue.unlock();
@@ -56,7 +57,7 @@ void AmEventQueue::postEvent(AmEvent* event)
   m_queue.lock();
 
   if(event)
-    ev_queue.push(event);
+    ev_queue.push(QueuedEvent(event, AmLatencyStats::start()));
 
   if(!ev_pending.get()) {
     ev_pending.set(true);
@@ -76,10 +77,13 @@ void AmEventQueue::processEvents()
 
   while(!ev_queue.empty()) {
 	
-    AmEvent* event = ev_queue.front();
+    AmEvent* event = ev_queue.front().first;
+    unsigned long long posted = ev_queue.front().second;
     ev_queue.pop();
     m_queue.unlock();
 
+    AmLatencyStats::recordSince(LAT_EVENT_QUEUE, posted);
+
     if (AmConfig::LogEvents) 
       DBG("before processing event (%s)\n",
 	  typeid(*event).name());
@@ -106,10 +110,13 @@ void AmEventQueue::processSingleEvent()
 
   if (!ev_queue.empty()) {
 
-    AmEvent* event = ev_queue.front();
+    AmEvent* event = ev_queue.front().first;
+    unsigned long long posted = ev_queue.front().second;
     ev_queue.pop();
     m_queue.unlock();
 
+    AmLatencyStats::recordSince(LAT_EVENT_QUEUE, posted);
+
     if (AmConfig::LogEvents) 
       DBG("before processing event\n");
     handler->process(event);
@@ -132,6 +139,13 @@ bool AmEventQueue::eventPending() {
   return res;
 }
 
+unsigned int AmEventQueue::getQueueSize() {
+  m_queue.lock();
+  unsigned int res = ev_queue.size();
+  m_queue.unlock();
+  return res;
+}
+
 void AmEventQueue::setEventNotificationSink(AmEventNotificationSink* 
 					    _wakeup_handler) {
   // locking actually not necessary - if replacing pointer is atomic 
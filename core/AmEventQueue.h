@@ -33,6 +33,7 @@
 #include "atomic_types.h"
 
 #include <queue>
+#include <utility>
 
 class AmEventQueueInterface
 {
@@ -67,7 +68,9 @@ protected:
   AmEventHandler*           handler;
   AmEventNotificationSink*  wakeup_handler;
 
-  std::queue<AmEvent*>      ev_queue;
+  /* events and the time they were posted (AmLatencyStats) */
+  typedef std::pair<AmEvent*, unsigned long long> QueuedEvent;
+  std::queue<QueuedEvent>   ev_queue;
   AmMutex                   m_queue;
   AmCondition<bool>         ev_pending;
 
@@ -82,6 +85,8 @@ public:
   void waitForEvent();
   void processSingleEvent();
   bool eventPending();
+  /** number of events waiting */
+  unsigned int getQueueSize();
 
   void setEventNotificationSink(AmEventNotificationSink* _wakeup_handler);
 
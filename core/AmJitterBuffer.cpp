@@ -30,221 +30,209 @@
 #include "log.h"
 #include "SampleArray.h"
 
-//
-// Warning: 
-// This jitter buffer seems to increase the buffer size, if jitter (delay variation) is 
-// present in the stream, or for example a temporary delay spike is detected, 
-// but it does not adapt the buffer to shrink again if the situation has improved. 
-// The adaptive playout buffer method usually shows much better results
-// in minimizing the total playout delay (using more processing power though).
-//
-
-bool Packet::operator < (const Packet& p) const
+#include <string.h>
+
+#define JB_SLOT(seq) ((seq) & (JB_SLOTS - 1))
+
+AmJitterBuffer::AmJitterBuffer(unsigned int sample_rate,
+			       unsigned int min_delay, unsigned int max_delay)
+  : m_slot_samples(JB_MAX_PACKET_MS * sample_rate / 1000),
+    m_sample_rate(sample_rate),
+    m_min_delay(0), m_max_delay(0),
+    m_inited(false), m_next_seq(0), m_next_ts(0), m_frame(0),
+    m_count(0), m_buffered(0), m_delta(0),
+    m_delay(JB_INITIAL_DELAY * sample_rate / 1000),
+    m_jitter(0), m_transit(0), m_win_min(0), m_win_cnt(0)
 {
-  return ts_less()(m_ts, p.m_ts);
+  memset(m_slots, 0, sizeof(m_slots));
+  m_samples.resize(JB_SLOTS * m_slot_samples);
+  setDelay(min_delay, max_delay);
 }
 
-void Packet::init(const ShortSample *data, unsigned int size, unsigned int ts)
+void AmJitterBuffer::setDelay(unsigned int min_delay, unsigned int max_delay)
 {
-  size = PCM16_S2B(size);
-  if (size > sizeof(m_data))
-    size = sizeof(m_data);
-  m_size = PCM16_B2S(size);
-  memcpy(m_data, data, size);
-  m_ts = ts;
+  if (max_delay < min_delay)
+    max_delay = min_delay;
+
+  m_min_delay = min_delay * m_sample_rate / 1000;
+  m_max_delay = max_delay * m_sample_rate / 1000;
+
+  if (m_delay < m_min_delay)
+    grow(m_min_delay - m_delay);
+  else if (m_delay > m_max_delay)
+    shrink(m_delay - m_max_delay);
 }
 
-PacketAllocator::PacketAllocator()
+void AmJitterBuffer::resync(u_int16_t seq, unsigned int ts, unsigned int arrival_ts)
 {
-  m_free_packets = m_packets;
-  for (int i = 1; i < MAX_JITTER / 80; ++i) {
-    m_packets[i - 1].m_next = &m_packets[i];
-  }
-  m_packets[MAX_JITTER / 80 - 1].m_next = NULL;
+  for (int i = 0; i < JB_SLOTS; i++)
+    m_slots[i].used = false;
+  m_count = m_buffered = 0;
+
+  m_next_seq = seq;
+  m_next_ts = ts;
+  m_delta = ts - arrival_ts - m_delay;
+  m_transit = arrival_ts - ts;
+  m_win_cnt = 0;
+  m_inited = true;
 }
 
-Packet *PacketAllocator::alloc(const ShortSample *data, unsigned int size, unsigned int ts)
+void AmJitterBuffer::grow(unsigned int samples)
 {
-  if (m_free_packets == NULL)
-    return NULL;
-  Packet *retval = m_free_packets;
-  m_free_packets = retval->m_next;
+  if (m_delay + samples > m_max_delay)
+    samples = m_delay < m_max_delay ? m_max_delay - m_delay : 0;
 
-  retval->init(data, size, ts);
+  // play out later, the gap gets concealed
+  m_delay += samples;
+  m_delta -= samples;
+  m_win_cnt = 0;
 
-  retval->m_next = retval->m_prev = NULL;
-  return retval;
+#ifdef DEBUG_PLAYOUTBUF
+  DBG("Jitter buffer delay increased to %u\n", m_delay);
+#endif
 }
 
-void PacketAllocator::free(Packet *p)
+void AmJitterBuffer::shrink(unsigned int samples)
 {
-  p->m_prev = NULL;
-  p->m_next = m_free_packets;
-  m_free_packets = p;
+  if (m_delay < m_min_delay + samples)
+    samples = m_delay > m_min_delay ? m_delay - m_min_delay : 0;
+
+  // play out earlier, skipping the start of the next packet
+  m_delay -= samples;
+  m_delta += samples;
+
+#ifdef DEBUG_PLAYOUTBUF
+  DBG("Jitter buffer delay decreased to %u\n", m_delay);
+#endif
 }
 
-AmJitterBuffer::AmJitterBuffer()
-  : m_tsInited(false), m_tsDeltaInited(false), m_delayCount(0),m_tsDelta(0),
-    m_jitter(INITIAL_JITTER),m_lastAudioTs(0),m_lastResyncTs(0),m_lastTs(0),
-    m_tail(NULL), m_head(NULL), m_forceResync(false)
+/** slack: how long the packet will stay in the buffer */
+void AmJitterBuffer::adapt(int slack)
 {
+  if (slack < 0) {
+    grow(-slack);
+    return;
+  }
+
+  if (!m_win_cnt || slack < m_win_min)
+    m_win_min = slack;
+
+  if (++m_win_cnt < JB_ADAPT_PACKETS)
+    return;
+
+  // all packets of the window were early by more than the jitter
+  int margin = 2 * getJitter();
+  if (m_win_min > margin)
+    shrink(m_win_min - margin < (int)m_frame ? m_win_min - margin : m_frame);
+
+  m_win_cnt = 0;
 }
 
-void AmJitterBuffer::put(const ShortSample *data, unsigned int size, unsigned int ts, bool begin_talk)
+void AmJitterBuffer::put(const ShortSample *data, unsigned int size, unsigned int ts,
+			 u_int16_t seq, unsigned int arrival_ts, bool begin_talk)
 {
-  m_mutex.lock();
-  if (begin_talk)
-    m_forceResync = true;
-  if (m_tsInited && !m_forceResync && ts_less()(m_lastTs + m_jitter, ts))
-    {
-      unsigned int delay = ts - m_lastTs;
-      if (delay > m_jitter && m_jitter < MAX_JITTER)
-       	{
-	  m_jitter += (delay - m_jitter) / 2;
-	  if (m_jitter > MAX_JITTER)
-	    m_jitter = MAX_JITTER;
-#ifdef DEBUG_PLAYOUTBUF
-	  DBG("Jitter buffer delay increased to %u\n", m_jitter);
-#endif
-	}
-      // Packet arrived too late to be put into buffer
-      if (ts_less()(ts + m_jitter, m_lastTs)) {
-	m_mutex.unlock();
-	return;
-      }
-    }
-  Packet *elem = m_allocator.alloc(data, size, ts);
-  if (elem == NULL) {
-    elem = m_head;
-    m_head = m_head->m_next;
-    m_head->m_prev = NULL;
-    elem->init(data, size, ts);
+  if (size > m_slot_samples)
+    size = m_slot_samples;
+  if (!size)
+    return;
+
+  if (!m_inited) {
+    resync(seq, ts, arrival_ts);
   }
-  if (m_tail == NULL)
-    {
-      m_tail = m_head = elem;
-      elem->m_next = elem->m_prev = NULL;
-    }
   else {
-    if (*m_tail < *elem) // elem is later than tail - put it in tail
-      {
-	m_tail->m_next = elem;
-	elem->m_prev = m_tail;
-	m_tail = elem;
-	elem->m_next = NULL;
+    int d = (int16_t)(seq - m_next_seq);
+    int slack = (int)(ts - m_delta - arrival_ts);
+
+    if (d >= JB_SLOTS || d < -JB_SLOTS ||
+	(d >= 0 && (slack < -(int)m_max_delay ||
+		    slack > (int)(m_max_delay + m_slot_samples)))) {
+      // sequence number or timestamp jump
+      DBG("Jitter buffer resync (seq %u, expected %u)\n", seq, m_next_seq);
+      m_stats.resync++;
+      resync(seq, ts, arrival_ts);
+    }
+    else if (d >= 0 && begin_talk && !m_count) {
+      // new talk spurt: restart the playout with the current delay
+      resync(seq, ts, arrival_ts);
+    }
+    else {
+      // RFC 3550 A.8
+      int transit = arrival_ts - ts;
+      int dt = transit - m_transit;
+      m_transit = transit;
+      if (dt < 0) dt = -dt;
+      m_jitter += dt - ((m_jitter + 8) >> 4);
+
+      if (d < 0) {
+	// already played (or skipped)
+	m_stats.late++;
+	grow(m_frame);
+	return;
       }
-    else { // elem is out of order - place it properly
-      Packet *i;
-      for (i = m_tail; i->m_prev && *elem < *(i->m_prev); i = i->m_prev);
-      elem->m_prev = i->m_prev;
-      if (i->m_prev)
-	i->m_prev->m_next = elem;
-      else
-	m_head = elem;
-      i->m_prev = elem;
-      elem->m_next = i;
     }
   }
-  if (!m_tsInited) {
-    m_lastTs = ts;
-    m_tsInited = true;
-  }
-  else if (ts_less()(m_lastTs, ts) || m_forceResync) {
-    m_lastTs = ts;
+
+  unsigned int idx = JB_SLOT(seq);
+  Slot& s = m_slots[idx];
+  if (s.used) {
+    if (s.seq == seq) {
+      m_stats.duplicate++;
+      return;
+    }
+    m_count--;
+    m_buffered -= s.size;
   }
 
-  m_mutex.unlock();
+  memcpy(&m_samples[idx * m_slot_samples], data, PCM16_S2B(size));
+  s.used = true;
+  s.seq = seq;
+  s.ts = ts;
+  s.size = size;
+  m_count++;
+  m_buffered += size;
+  m_frame = size;
+
+  adapt((int)(ts - m_delta - arrival_ts));
 }
 
-/**
- * This method will return from zero to several packets.
- * To get all the packets for the single ts the caller must call this
- * method with the same ts till the return value will become false.
- */
-bool AmJitterBuffer::get(unsigned int ts, unsigned int ms, ShortSample *out_buf, 
+bool AmJitterBuffer::get(unsigned int ts, unsigned int ms, ShortSample *out_buf,
 			 unsigned int *out_size, unsigned int *out_ts)
 {
-  bool retval = true;
-
-  m_mutex.lock();
-  if (!m_tsInited) {
-    m_mutex.unlock();
+  if (!m_inited)
     return false;
-  }
-  if (!m_tsDeltaInited || m_forceResync) {
-    m_tsDelta = m_lastTs - ts + ms;
-    m_tsDeltaInited = true;
-    m_lastAudioTs = ts;
-    m_forceResync = false;
-#ifdef DEBUG_PLAYOUTBUF
-    DBG("Jitter buffer: initialized tsDelta with %u\n", m_tsDelta);
-    m_tsDeltaStart = m_tsDelta;
-#endif
-  }
-  else if (m_lastAudioTs != ts && m_lastResyncTs != m_lastTs) {
-    if (ts_less()(ts + m_tsDelta, m_lastTs)) {
-      /* 
-       * New packet arrived earlier than expected -
-       *  immediate resync required 
-       */
-      m_tsDelta += m_lastTs - ts + ms;
-#ifdef DEBUG_PLAYOUTBUF
-      DBG("Jitter buffer resynced forward (-> %d rel)\n", 
-	  m_tsDelta - m_tsDeltaStart);
-#endif
-      m_delayCount = 0;
-    } else if (ts_less()(m_lastTs, ts + m_tsDelta - m_jitter / 2)) {
-      /* New packet hasn't arrived yet */
-      if (m_delayCount > RESYNC_THRESHOLD) {
-	unsigned int d = m_tsDelta -(m_lastTs - ts + ms);
-	m_tsDelta -= d / 2;
-#ifdef DEBUG_PLAYOUTBUF
-	DBG("Jitter buffer resynced backward (-> %d rel)\n", 
-	    m_tsDelta - m_tsDeltaStart);
-#endif
-      }
-      else
-	++m_delayCount;
-    }
-    else {
-      /* New packet arrived at proper time */
-      m_delayCount = 0;
-    }
-    m_lastResyncTs = m_lastTs;
-  }
-  m_lastAudioTs = ts;
-  unsigned int get_ts = ts + m_tsDelta - m_jitter;
-  //    DBG("Getting pkt at %u, res ts = %u\n", get_ts / m_frameSize, p.timestamp);
-  // First of all throw away all too old packets from the head
-  Packet *tmp;
-  for (tmp = m_head; tmp && ts_less()(tmp->ts() + tmp->size(), get_ts); )
-    {
-      m_head = tmp->m_next;
-      if (m_head == NULL)
-	m_tail = NULL;
-      else
-	m_head->m_prev = NULL;
-      m_allocator.free(tmp);
-      tmp = m_head;
-    }
-  // Get the packet from the head
-  if (m_head && ts_less()(m_head->ts(), get_ts + ms))
-    {
-      tmp = m_head;
-      m_head = tmp->m_next;
-      if (m_head == NULL)
-	m_tail = NULL;
-      else
-	m_head->m_prev = NULL;
-      memcpy(out_buf, tmp->data(), PCM16_S2B(tmp->size()));
+
+  // RTP timestamp up to which packets are due
+  unsigned int end_ts = ts + ms + m_delta;
+
+  while (m_count) {
+    Slot& s = m_slots[JB_SLOT(m_next_seq)];
+
+    if (s.used && s.seq == m_next_seq) {
+      if (!ts_less()(s.ts, end_ts))
+	return false;
+
+      memcpy(out_buf, &m_samples[JB_SLOT(m_next_seq) * m_slot_samples],
+	     PCM16_S2B(s.size));
+      *out_size = s.size;
       // Map RTP timestamp to internal audio timestamp
-      *out_ts = tmp->ts() - m_tsDelta + m_jitter;
-      *out_size = tmp->size();
-      m_allocator.free(tmp);
+      *out_ts = s.ts - m_delta;
+
+      s.used = false;
+      m_count--;
+      m_buffered -= s.size;
+      m_next_seq++;
+      m_next_ts = s.ts + s.size;
+      return true;
     }
-  else
-    retval = false;
 
-  m_mutex.unlock();
-  return retval;
+    // next packet missing: give up on it once it is due
+    if (!ts_less()(m_next_ts, end_ts))
+      return false;
+
+    m_stats.skipped++;
+    m_next_seq++;
+    m_next_ts += m_frame;
+  }
+
+  return false;
 }
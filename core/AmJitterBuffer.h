@@ -30,67 +30,129 @@
 
 #include "amci/amci.h"
 #include "AmAudio.h"
-#include "AmThread.h"
 #include "SampleArray.h"
 
-#define INITIAL_JITTER	    80 * SYSTEM_SAMPLECLOCK_RATE / 1000 // 80 miliseconds
-#define MAX_JITTER	    2  * SYSTEM_SAMPLECLOCK_RATE // 2 seconds
-#define RESYNC_THRESHOLD    5 // resync backward if RESYNC_THRESHOLD packets arrive late
+#include <sys/types.h>
+#include <vector>
+using std::vector;
 
-class Packet {
-  ShortSample m_data[AUDIO_BUFFER_SIZE * 2];
-  unsigned int m_size;
-  unsigned int m_ts;
- public:
-  Packet *m_next;
-  Packet *m_prev;
-  void init(const ShortSample *data, unsigned int size, unsigned int ts);
-
-  unsigned int size() const { return m_size; }
-  unsigned int ts() const { return m_ts; }
-  ShortSample *data() { return m_data; }
+/** number of packets the buffer can hold (power of 2) */
+#define JB_SLOTS            64
+/** longest packet that can be buffered (longer ones are truncated) */
+#define JB_MAX_PACKET_MS    80
+/** playout delay a stream starts with (limited to min/max delay) */
+#define JB_INITIAL_DELAY    60
+/** packets over which the delay is evaluated before shrinking it */
+#define JB_ADAPT_PACKETS    50
 
-  bool operator < (const Packet&) const;
-};
-
-class PacketAllocator
+/** \brief jitter buffer counters */
+struct AmJitterBufferStats
 {
- private:
-  Packet m_packets[MAX_JITTER / 80];
-  Packet *m_free_packets;
+  /** packets arrived after their playout time */
+  unsigned int late;
+  /** packets received more than once */
+  unsigned int duplicate;
+  /** packets missing at their playout time and skipped */
+  unsigned int skipped;
+  /** playout restarted (timestamp or sequence number jumps) */
+  unsigned int resync;
 
- public:
-  PacketAllocator();
-  Packet *alloc(const ShortSample *data, unsigned int size, unsigned int ts);
-  void free(Packet *p);
+  AmJitterBufferStats()
+    : late(0), duplicate(0), skipped(0), resync(0) {}
 };
 
+/**
+ * \brief adaptive jitter buffer
+ *
+ * Packets are kept in a preallocated ring indexed by RTP sequence
+ * number, so that putting and getting a packet is O(1). The playout
+ * delay starts at JB_INITIAL_DELAY, grows as packets arrive late and
+ * shrinks by at most one packet per JB_ADAPT_PACKETS packets if the
+ * packets are constantly early by more than the jitter, always within
+ * [min delay, max delay].
+ *
+ * Not thread safe, put and get are both called from the media processor.
+ */
 class AmJitterBuffer
 {
- private:
-  AmMutex m_mutex;
-  PacketAllocator m_allocator;
-  Packet *m_head;
-  Packet *m_tail;
-  bool m_tsInited;
-  unsigned int m_lastTs;
-  unsigned int m_lastResyncTs;
-  unsigned int m_lastAudioTs;
-  unsigned int m_tsDelta;
-  bool m_tsDeltaInited;
-  int m_delayCount;
+  struct Slot {
+    bool         used;
+    u_int16_t    seq;
+    unsigned int ts;
+    unsigned int size;
+  };
+
+  Slot         m_slots[JB_SLOTS];
+  /** samples of all slots, m_slot_samples per slot */
+  vector<ShortSample> m_samples;
+  unsigned int m_slot_samples;
+  unsigned int m_sample_rate;
+
+  unsigned int m_min_delay;
+  unsigned int m_max_delay;
+
+  bool         m_inited;
+  /** packet to be played next and its (expected) timestamp */
+  u_int16_t    m_next_seq;
+  unsigned int m_next_ts;
+  /** size of the last packet */
+  unsigned int m_frame;
+  /** number of packets and samples in the ring */
+  unsigned int m_count;
+  unsigned int m_buffered;
+
+  /** RTP timestamp - audio timestamp of the playout */
+  unsigned int m_delta;
+  /** current playout delay */
+  unsigned int m_delay;
+
+  /** interarrival jitter, scaled by 16 (RFC 3550 A.8) */
   unsigned int m_jitter;
-  //    AmRtpStream *m_owner;
-  bool m_forceResync;
+  int          m_transit;
+
+  /** shortest time a packet stayed in the buffer in the current window */
+  int          m_win_min;
+  unsigned int m_win_cnt;
+
+  AmJitterBufferStats m_stats;
 
-#ifdef DEBUG_PLAYOUTBUF
-  unsigned int m_tsDeltaStart;
-#endif
+  void resync(u_int16_t seq, unsigned int ts, unsigned int arrival_ts);
+  void grow(unsigned int samples);
+  void shrink(unsigned int samples);
+  void adapt(int slack);
 
  public:
-  AmJitterBuffer();
-  void put(const ShortSample *data, unsigned int size, unsigned int ts, bool begin_talk);
-  bool get(unsigned int ts, unsigned int ms, ShortSample *out, unsigned int *size, unsigned int *out_ts);
+  /** min_delay, max_delay in milliseconds */
+  AmJitterBuffer(unsigned int sample_rate,
+		 unsigned int min_delay, unsigned int max_delay);
+
+  /** set the delay limits (milliseconds) */
+  void setDelay(unsigned int min_delay, unsigned int max_delay);
+
+  /**
+   * Put a packet of size samples with RTP timestamp ts and sequence
+   * number seq, which arrived at the audio timestamp arrival_ts.
+   */
+  void put(const ShortSample *data, unsigned int size, unsigned int ts,
+	   u_int16_t seq, unsigned int arrival_ts, bool begin_talk);
+
+  /**
+   * Get the next packet to be played before audio timestamp ts + ms.
+   * @return false if there is none
+   */
+  bool get(unsigned int ts, unsigned int ms, ShortSample *out,
+	   unsigned int *size, unsigned int *out_ts);
+
+  /** current playout delay in samples */
+  unsigned int getDelay() const { return m_delay; }
+  /** samples waiting in the buffer */
+  unsigned int getBuffered() const { return m_buffered; }
+  /** interarrival jitter in samples */
+  unsigned int getJitter() const { return m_jitter >> 4; }
+  unsigned int getMinDelay() const { return m_min_delay; }
+  unsigned int getMaxDelay() const { return m_max_delay; }
+
+  const AmJitterBufferStats& getStats() const { return m_stats; }
 };
 
 #endif // _AmJitterBuffer_h_
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmLatencyStats.h"
+#include "AmArg.h"
+#include "log.h"
+
+#include <string.h>
+
+AmLatencyHistogram::AmLatencyHistogram()
+  : count(0), sum(0), max(0)
+{
+  memset(counts, 0, sizeof(counts));
+}
+
+unsigned int AmLatencyHistogram::index(unsigned long long us)
+{
+  if (us < (1 << LAT_EXACT_BITS))
+    return (unsigned int)us;
+
+  if (us >> LAT_MAX_BITS)
+    us = (1ULL << LAT_MAX_BITS) - 1;
+
+  unsigned int m = 63 - __builtin_clzll(us); // highest bit set
+  unsigned int sub = (us >> (m - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1);
+
+  return (1 << LAT_EXACT_BITS) + ((m - LAT_EXACT_BITS) << LAT_SUB_BITS) + sub;
+}
+
+unsigned long long AmLatencyHistogram::value(unsigned int idx)
+{
+  if (idx < (1 << LAT_EXACT_BITS))
+    return idx;
+
+  idx -= 1 << LAT_EXACT_BITS;
+  unsigned int m = (idx >> LAT_SUB_BITS) + LAT_EXACT_BITS;
+  unsigned int sub = idx & ((1 << LAT_SUB_BITS) - 1);
+  unsigned int shift = m - LAT_SUB_BITS;
+
+  return ((((1ULL << LAT_SUB_BITS) + sub) << shift) | ((1ULL << shift) - 1));
+}
+
+void AmLatencyHistogram::merge(const AmLatencyHistogram& h)
+{
+  for (unsigned int i = 0; i < LAT_BUCKETS; i++)
+    counts[i] += h.counts[i];
+  count += h.count;
+  sum += h.sum;
+  if (h.max > max) max = h.max;
+}
+
+unsigned long long AmLatencyHistogram::percentile(double p) const
+{
+  // the counters of other threads may be updated while reading
+  unsigned long long total = 0;
+  for (unsigned int i = 0; i < LAT_BUCKETS; i++)
+    total += counts[i];
+  if (!total)
+    return 0;
+
+  unsigned long long rank = (unsigned long long)(p * total + 0.5);
+  if (rank < 1) rank = 1;
+
+  unsigned long long seen = 0;
+  for (unsigned int i = 0; i < LAT_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      unsigned long long v = value(i);
+      return v < max ? v : max;
+    }
+  }
+  return max;
+}
+
+void AmLatencyHistogram::getStats(AmArg& stats) const
+{
+  stats["count"] = (long long)count;
+  stats["avg"] = (long long)(count ? sum / count : 0);
+  stats["max"] = (long long)max;
+  stats["p50"] = (long long)percentile(0.5);
+  stats["p90"] = (long long)percentile(0.9);
+  stats["p99"] = (long long)percentile(0.99);
+  stats["p999"] = (long long)percentile(0.999);
+}
+
+__thread AmLatencyStats::ThreadStats* AmLatencyStats::thread_stats = NULL;
+
+AmMutex                                AmLatencyStats::threads_mut;
+std::list<AmLatencyStats::ThreadStats*> AmLatencyStats::threads;
+AmLatencyStats::ThreadStats            AmLatencyStats::finished;
+
+pthread_key_t  AmLatencyStats::thread_key;
+pthread_once_t AmLatencyStats::key_once = PTHREAD_ONCE_INIT;
+
+void AmLatencyStats::createKey()
+{
+  pthread_key_create(&thread_key, threadExit);
+}
+
+void AmLatencyStats::threadExit(void* p)
+{
+  ThreadStats* t = (ThreadStats*)p;
+
+  threads_mut.lock();
+  threads.remove(t);
+  for (int i = 0; i < LAT_POINTS; i++)
+    finished.h[i].merge(t->h[i]);
+  threads_mut.unlock();
+
+  delete t;
+}
+
+AmLatencyStats::ThreadStats* AmLatencyStats::registerThread()
+{
+  pthread_once(&key_once, createKey);
+
+  ThreadStats* t = new ThreadStats();
+  pthread_setspecific(thread_key, t);
+
+  threads_mut.lock();
+  threads.push_back(t);
+  threads_mut.unlock();
+
+  thread_stats = t;
+  return t;
+}
+
+const char* AmLatencyStats::name(AmLatencyPoint p)
+{
+  switch (p) {
+  case LAT_SIP_DISPATCH:  return "sip_dispatch";
+  case LAT_INVITE_1XX:    return "invite_1xx";
+  case LAT_SESSION_CYCLE: return "session_cycle";
+  case LAT_MEDIA_TICK:    return "media_tick";
+  case LAT_EVENT_QUEUE:   return "event_queue";
+  default: break;
+  }
+  return "unknown";
+}
+
+void AmLatencyStats::getStats(AmArg& stats)
+{
+  // ~4KB per histogram: not on the stack
+  ThreadStats* merged = new ThreadStats();
+
+  threads_mut.lock();
+  for (int i = 0; i < LAT_POINTS; i++) {
+    merged->h[i].merge(finished.h[i]);
+    for (std::list<ThreadStats*>::iterator it = threads.begin();
+	 it != threads.end(); ++it)
+      merged->h[i].merge((*it)->h[i]);
+  }
+  threads_mut.unlock();
+
+  for (int i = 0; i < LAT_POINTS; i++)
+    merged->h[i].getStats(stats[name((AmLatencyPoint)i)]);
+
+  delete merged;
+}
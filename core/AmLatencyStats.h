@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/** @file AmLatencyStats.h */
+#ifndef _AmLatencyStats_h_
+#define _AmLatencyStats_h_
+
+#include "AmThread.h"
+#include "AmConfig.h"
+
+#include <time.h>
+#include <pthread.h>
+#include <list>
+
+class AmArg;
+
+/** measuring points */
+enum AmLatencyPoint {
+  LAT_SIP_DISPATCH = 0, // SIP message received -> passed to AmSipDispatcher
+  LAT_INVITE_1XX,       // INVITE received -> first provisional reply sent
+  LAT_SESSION_CYCLE,    // AmSession::processingCycle
+  LAT_MEDIA_TICK,       // sessions processed in one media processor tick
+  LAT_EVENT_QUEUE,      // event posted -> taken out of the AmEventQueue
+  LAT_POINTS
+};
+
+/* values below 2^LAT_EXACT_BITS us are counted exactly, bigger ones in
+   2^LAT_SUB_BITS buckets per power of 2 (< 6.25% error) */
+#define LAT_SUB_BITS    4
+#define LAT_EXACT_BITS  (LAT_SUB_BITS + 1)
+#define LAT_MAX_BITS    32
+#define LAT_BUCKETS     ((1 << LAT_EXACT_BITS) + \
+			 (LAT_MAX_BITS - LAT_EXACT_BITS) * (1 << LAT_SUB_BITS))
+
+/**
+ * \brief log-linear (HDR style) histogram of latencies in us
+ */
+struct AmLatencyHistogram
+{
+  unsigned long long counts[LAT_BUCKETS];
+  unsigned long long count;
+  unsigned long long sum;
+  unsigned long long max;
+
+  AmLatencyHistogram();
+
+  static unsigned int index(unsigned long long us);
+  /** highest value counted in bucket idx */
+  static unsigned long long value(unsigned int idx);
+
+  void add(unsigned long long us) {
+    counts[index(us)]++;
+    count++;
+    sum += us;
+    if (us > max) max = us;
+  }
+
+  void merge(const AmLatencyHistogram& h);
+
+  /** smallest value at or above p (0..1) of the samples */
+  unsigned long long percentile(double p) const;
+
+  /** count, avg, max, p50, p90, p99, p999 */
+  void getStats(AmArg& stats) const;
+};
+
+/**
+ * \brief latency histograms at points of the SIP and media processing
+ *
+ * Each thread records into its own histograms without locking; the
+ * histograms of all threads are merged when they are read. Histograms
+ * of finished threads are merged into one kept for the process.
+ */
+class AmLatencyStats
+{
+  struct ThreadStats {
+    AmLatencyHistogram h[LAT_POINTS];
+  };
+
+  static __thread ThreadStats* thread_stats;
+
+  static AmMutex                 threads_mut;
+  static std::list<ThreadStats*> threads;
+  static ThreadStats             finished;
+
+  static pthread_key_t  thread_key;
+  static pthread_once_t key_once;
+  static void createKey();
+  static void threadExit(void* p);
+
+  static ThreadStats* registerThread();
+
+public:
+  /** monotonic time in us */
+  static unsigned long long now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  }
+
+  /** start time for recordSince() (0 if not recording) */
+  static unsigned long long start() {
+    return AmConfig::LatencyStats ? now() : 0;
+  }
+
+  static void record(AmLatencyPoint p, unsigned long long us) {
+    if (!AmConfig::LatencyStats)
+      return;
+    ThreadStats* t = thread_stats;
+    if (!t) t = registerThread();
+    t->h[p].add(us);
+  }
+
+  /** record the time since start (from now()) */
+  static void recordSince(AmLatencyPoint p, unsigned long long start) {
+    if (!AmConfig::LatencyStats || !start)
+      return;
+    unsigned long long t = now();
+    record(p, t > start ? t - start : 0);
+  }
+
+  static const char* name(AmLatencyPoint p);
+
+  /** merged histograms of all threads per point */
+  static void getStats(AmArg& stats);
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmMappedFile.h"
+#include "log.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+_AmMappedFiles::_AmMappedFiles()
+  : mapped_bytes(0)
+{
+}
+
+_AmMappedFiles::~_AmMappedFiles()
+{
+  // all mappings in files are still used
+}
+
+AmMappedFile* _AmMappedFiles::map(const string& path, int advice)
+{
+  struct stat sbuf;
+  if (stat(path.c_str(), &sbuf) == -1) {
+    DBG("cannot stat file '%s': %s\n", path.c_str(), strerror(errno));
+    return NULL;
+  }
+
+  AmMappedFile* f = NULL;
+
+  files_mut.lock();
+  std::map<string, AmMappedFile*>::iterator it = files.find(path);
+  if (it != files.end()) {
+    f = it->second;
+    if (f->dev == sbuf.st_dev && f->ino == sbuf.st_ino &&
+	f->size == (size_t)sbuf.st_size && f->mtime == sbuf.st_mtime) {
+      f->refs++;
+      files_mut.unlock();
+      return f;
+    }
+
+    // file has been replaced: map the new one, the old
+    // mapping is removed when it is not used any more
+    DBG("file '%s' changed, mapping it again\n", path.c_str());
+    files.erase(it);
+  }
+
+  f = mapFile(path, advice);
+  if (f) {
+    f->refs = 1;
+    files[path] = f;
+  }
+  files_mut.unlock();
+
+  return f;
+}
+
+AmMappedFile* _AmMappedFiles::mapFile(const string& path, int advice)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    ERROR("while opening file '%s' for mapping: %s\n",
+	  path.c_str(), strerror(errno));
+    return NULL;
+  }
+
+  struct stat sbuf;
+  if (fstat(fd, &sbuf) == -1) {
+    ERROR("cannot stat file '%s': %s\n", path.c_str(), strerror(errno));
+    ::close(fd);
+    return NULL;
+  }
+
+  if (!sbuf.st_size) {
+    ERROR("cannot map empty file '%s'\n", path.c_str());
+    ::close(fd);
+    return NULL;
+  }
+
+  void* data = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    ERROR("cannot mmap file '%s': %s\n", path.c_str(), strerror(errno));
+    return NULL;
+  }
+
+  if (advice != MADV_NORMAL && madvise(data, sbuf.st_size, advice)) {
+    DBG("madvise on '%s' failed: %s\n", path.c_str(), strerror(errno));
+  }
+
+  AmMappedFile* f = new AmMappedFile(path);
+  f->dev = sbuf.st_dev;
+  f->ino = sbuf.st_ino;
+  f->mtime = sbuf.st_mtime;
+  f->data = data;
+  f->size = sbuf.st_size;
+
+  mapped_bytes += f->size;
+  DBG("mapped '%s' (%zd bytes, %lu bytes mapped in total)\n",
+      path.c_str(), f->size, mapped_bytes);
+
+  return f;
+}
+
+void _AmMappedFiles::unmapFile(AmMappedFile* f)
+{
+  if (munmap(f->data, f->size)) {
+    ERROR("while unmapping file '%s': %s\n", f->path.c_str(), strerror(errno));
+  }
+  mapped_bytes -= f->size;
+  delete f;
+}
+
+void _AmMappedFiles::release(AmMappedFile* f)
+{
+  if (!f)
+    return;
+
+  files_mut.lock();
+  if (!--f->refs) {
+    std::map<string, AmMappedFile*>::iterator it = files.find(f->path);
+    if (it != files.end() && it->second == f)
+      files.erase(it);
+    unmapFile(f);
+  }
+  files_mut.unlock();
+}
+
+unsigned long _AmMappedFiles::getMappedBytes()
+{
+  files_mut.lock();
+  unsigned long res = mapped_bytes;
+  files_mut.unlock();
+  return res;
+}
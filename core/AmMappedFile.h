@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmMappedFile.h */
+#ifndef _AmMappedFile_h_
+#define _AmMappedFile_h_
+
+#include "AmThread.h"
+#include "singleton.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <string>
+#include <map>
+using std::string;
+
+/**
+ * \brief read-only memory mapping of a file
+ *
+ * Mappings are shared (see AmMappedFiles), so the pages are
+ * in memory only once, no matter how many sessions (or SEMS
+ * processes) use the file.
+ */
+class AmMappedFile
+{
+  friend class _AmMappedFiles;
+
+  string path;
+  dev_t  dev;
+  ino_t  ino;
+  time_t mtime;
+
+  void*  data;
+  size_t size;
+
+  /* protected by the registry's lock */
+  unsigned int refs;
+
+  AmMappedFile(const string& path)
+    : path(path), data(NULL), size(0), refs(0) {}
+
+public:
+  const string& getPath() const { return path; }
+  void* getData() const { return data; }
+  size_t getSize() const { return size; }
+};
+
+/**
+ * \brief registry of file mappings
+ *
+ * A path is only mapped once, as long as the file is not
+ * replaced (changed inode, size or modification time).
+ */
+class _AmMappedFiles
+{
+  std::map<string, AmMappedFile*> files;
+  AmMutex files_mut;
+
+  unsigned long mapped_bytes;
+
+  AmMappedFile* mapFile(const string& path, int advice);
+  void unmapFile(AmMappedFile* f);
+
+protected:
+  _AmMappedFiles();
+  ~_AmMappedFiles();
+
+  void dispose() {}
+
+public:
+  /**
+   * Get the mapping of path, mapping it if needed.
+   * @param advice madvise() advice if the file is mapped
+   *        (e.g. MADV_WILLNEED, MADV_SEQUENTIAL)
+   * @return NULL on error, the mapping otherwise, which
+   *         has to be released with release()
+   */
+  AmMappedFile* map(const string& path, int advice = MADV_NORMAL);
+
+  /** release a mapping got with map() */
+  void release(AmMappedFile* f);
+
+  /** bytes currently mapped */
+  unsigned long getMappedBytes();
+};
+
+typedef singleton<_AmMappedFiles> AmMappedFiles;
+
+#endif
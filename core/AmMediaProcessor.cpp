@@ -26,6 +26,8 @@
 #include "AmMediaProcessor.h"
 #include "AmSession.h"
 #include "AmRtpStream.h"
+#include "AmConfig.h"
+#include "AmLatencyStats.h"
 
 #include <assert.h>
 #include <sys/time.h>
@@ -216,6 +218,8 @@ void AmMediaProcessor::dispose()
 AmMediaProcessorThread::AmMediaProcessorThread()
   : events(this), stop_requested(false)
 {
+  setThreadName("media");
+  setEventQueue(&events);
 }
 AmMediaProcessorThread::~AmMediaProcessorThread()
 {
@@ -240,6 +244,12 @@ void AmMediaProcessorThread::run()
 
   gettimeofday(&now,NULL);
   timeradd(&tick,&now,&next_tick);
+
+  if (AmConfig::BatchEncoding)
+    codec_batch.setCurrent();
+
+  if (AmRtpPacer::isEnabled())
+    pacer.setCurrent();
     
   while(!stop_requested.get()){
 
@@ -257,7 +267,10 @@ void AmMediaProcessorThread::run()
 	nanosleep(&sdiff,&rem);
     }
 
+    unsigned long long start = AmLatencyStats::start();
     processAudio(ts);
+    AmLatencyStats::recordSince(LAT_MEDIA_TICK, start);
+    pacer.flush(next_tick, tick);
     events.processEvents();
     processDtmfEvents();
 
@@ -296,6 +309,9 @@ void AmMediaProcessorThread::processAudio(unsigned long long ts)
     if ((*it)->writeStreams(ts, buffer) < 0)
       postRequest(new SchedRequest(AmMediaProcessor::ClearSession, *it));
   }
+
+  // encode and send the frames queued by the sessions' streams
+  codec_batch.flush();
 }
 
 void AmMediaProcessorThread::process(AmEvent* e)
@@ -30,6 +30,8 @@
 
 #include "AmEventQueue.h"
 #include "amci/amci.h" // AUDIO_BUFFER_SIZE
+#include "AmCodecBatch.h"
+#include "AmRtpPacer.h"
 
 #include <set>
 using std::set;
@@ -161,6 +163,12 @@ class AmMediaProcessorThread :
   AmEventQueue    events;
   unsigned char   buffer[AUDIO_BUFFER_SIZE];
   set<AmMediaSession*> sessions;
+
+  /** frames to be encoded with batch encoders */
+  AmCodecBatch    codec_batch;
+
+  /** RTP packets spread over the tick (rtp_pacing) */
+  AmRtpPacer      pacer;
   
   void processAudio(unsigned long long ts);
   /**
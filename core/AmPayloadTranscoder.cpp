@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmPayloadTranscoder.h"
+#include "AmSdp.h"
+
+#include <strings.h>
+
+/*
+ * Direct u-law <-> A-law conversion tables (for the magnitudes),
+ * taken from the Sun G.711 reference code (plug-in/adpcm/g711.c),
+ * including the corrections of Borge Lindberg.
+ */
+static const unsigned char _u2a[128] = {
+  1,	1,	2,	2,	3,	3,	4,	4,
+  5,	5,	6,	6,	7,	7,	8,	8,
+  9,	10,	11,	12,	13,	14,	15,	16,
+  17,	18,	19,	20,	21,	22,	23,	24,
+  25,	27,	29,	31,	33,	34,	35,	36,
+  37,	38,	39,	40,	41,	42,	43,	44,
+  46,	48,	49,	50,	51,	52,	53,	54,
+  55,	56,	57,	58,	59,	60,	61,	62,
+  64,	65,	66,	67,	68,	69,	70,	71,
+  72,	73,	74,	75,	76,	77,	78,	79,
+  80,	82,	83,	84,	85,	86,	87,	88,
+  89,	90,	91,	92,	93,	94,	95,	96,
+  97,	98,	99,	100,	101,	102,	103,	104,
+  105,	106,	107,	108,	109,	110,	111,	112,
+  113,	114,	115,	116,	117,	118,	119,	120,
+  121,	122,	123,	124,	125,	126,	127,	128};
+
+static const unsigned char _a2u[128] = {
+  1,	3,	5,	7,	9,	11,	13,	15,
+  16,	17,	18,	19,	20,	21,	22,	23,
+  24,	25,	26,	27,	28,	29,	30,	31,
+  32,	32,	33,	33,	34,	34,	35,	35,
+  36,	37,	38,	39,	40,	41,	42,	43,
+  44,	45,	46,	47,	48,	48,	49,	49,
+  50,	51,	52,	53,	54,	55,	56,	57,
+  58,	59,	60,	61,	62,	63,	64,	64,
+  65,	66,	67,	68,	69,	70,	71,	72,
+  73,	74,	75,	76,	77,	78,	79,	80,
+  80,	81,	82,	83,	84,	85,	86,	87,
+  88,	89,	90,	91,	92,	93,	94,	95,
+  96,	97,	98,	99,	100,	101,	102,	103,
+  104,	105,	106,	107,	108,	109,	110,	111,
+  112,	113,	114,	115,	116,	117,	118,	119,
+  120,	121,	122,	123,	124,	125,	126,	127};
+
+/** full 256 entry tables, filled once on startup */
+struct G711Tables
+{
+  unsigned char alaw2ulaw[256];
+  unsigned char ulaw2alaw[256];
+
+  G711Tables()
+  {
+    for (unsigned int i = 0; i < 256; i++) {
+      unsigned char v = (unsigned char)i;
+
+      alaw2ulaw[i] = (v & 0x80) ?
+	(0xFF ^ _a2u[v ^ 0xD5]) : (0x7F ^ _a2u[v ^ 0x55]);
+
+      ulaw2alaw[i] = (v & 0x80) ?
+	(0xD5 ^ (_u2a[0xFF ^ v] - 1)) : (0x55 ^ (_u2a[0x7F ^ v] - 1));
+    }
+  }
+};
+
+static const G711Tables g711_tables;
+
+const unsigned char* AmPayloadTranscoder::getTable(const string& from_name,
+						   unsigned int from_rate,
+						   const string& to_name,
+						   unsigned int to_rate)
+{
+  if (from_rate != 8000 || to_rate != 8000)
+    return NULL;
+
+  if (!strcasecmp(from_name.c_str(), "PCMA") &&
+      !strcasecmp(to_name.c_str(), "PCMU"))
+    return g711_tables.alaw2ulaw;
+
+  if (!strcasecmp(from_name.c_str(), "PCMU") &&
+      !strcasecmp(to_name.c_str(), "PCMA"))
+    return g711_tables.ulaw2alaw;
+
+  return NULL;
+}
+
+#define TABLE_ID_ALAW2ULAW 1
+#define TABLE_ID_ULAW2ALAW 2
+
+unsigned int AmPayloadTranscoder::getTableId(const unsigned char* table)
+{
+  if (table == g711_tables.alaw2ulaw) return TABLE_ID_ALAW2ULAW;
+  if (table == g711_tables.ulaw2alaw) return TABLE_ID_ULAW2ALAW;
+  return 0;
+}
+
+const unsigned char* AmPayloadTranscoder::getTableById(unsigned int id)
+{
+  switch (id) {
+  case TABLE_ID_ALAW2ULAW: return g711_tables.alaw2ulaw;
+  case TABLE_ID_ULAW2ALAW: return g711_tables.ulaw2alaw;
+  default: break;
+  }
+  return NULL;
+}
+
+static void resolveStaticPayload(const SdpPayload& p,
+				 string& name, unsigned int& rate)
+{
+  name = p.encoding_name;
+  rate = p.clock_rate > 0 ? p.clock_rate : 0;
+  if (!name.empty())
+    return;
+
+  // static payload types may come without rtpmap
+  switch (p.payload_type) {
+  case 0: name = "PCMU"; rate = 8000; break;
+  case 8: name = "PCMA"; rate = 8000; break;
+  default: break;
+  }
+}
+
+const unsigned char* AmPayloadTranscoder::getTable(const SdpPayload& from,
+						   const SdpPayload& to)
+{
+  string from_name, to_name;
+  unsigned int from_rate, to_rate;
+
+  resolveStaticPayload(from, from_name, from_rate);
+  resolveStaticPayload(to, to_name, to_rate);
+
+  return getTable(from_name, from_rate, to_name, to_rate);
+}
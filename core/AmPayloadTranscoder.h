@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmPayloadTranscoder.h */
+#ifndef _AmPayloadTranscoder_h_
+#define _AmPayloadTranscoder_h_
+
+#include <string>
+using std::string;
+
+struct SdpPayload;
+
+/**
+ * \brief Compressed domain transcoding of RTP payloads.
+ *
+ * Some payload formats can be translated into each other byte by byte
+ * (G.711 A-law <-> u-law), without decoding to PCM16 and re-encoding
+ * the audio. Such packets can be relayed directly, only translating
+ * the payload through a 256 entry table.
+ */
+class AmPayloadTranscoder
+{
+public:
+  /**
+   * Get the translation table from one payload to another.
+   * Returns NULL if the payloads can not be translated directly.
+   */
+  static const unsigned char* getTable(const string& from_name,
+				       unsigned int from_rate,
+				       const string& to_name,
+				       unsigned int to_rate);
+
+  /** same as above, static payload types without rtpmap are handled */
+  static const unsigned char* getTable(const SdpPayload& from,
+				       const SdpPayload& to);
+
+  /**
+   * Small ID (> 0) of a table returned by getTable, 0 for NULL;
+   * fits in a word together with a payload type (see AmRtpStream).
+   */
+  static unsigned int getTableId(const unsigned char* table);
+  static const unsigned char* getTableById(unsigned int id);
+
+  /** translate len bytes of data in place */
+  static void translate(const unsigned char* table,
+			unsigned char* data, unsigned int len)
+  {
+    for (unsigned int i = 0; i < len; i++)
+      data[i] = table[data[i]];
+  }
+};
+
+#endif
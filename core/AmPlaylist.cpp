@@ -85,6 +85,33 @@ int AmPlaylist::get(unsigned long long system_ts, unsigned char* buffer,
   return ret;
 }
 
+int AmPlaylist::getEncoded(unsigned long long system_ts, unsigned char* buffer,
+			   int codec_id, unsigned int rate, unsigned int frame_size)
+{
+  int ret = AUDIO_NOT_ENCODED;
+
+  cur_mut.lock();
+  updateCurrentItem();
+
+  while(cur_item && 
+	cur_item->play && 
+	(ret = cur_item->play->getEncoded(system_ts,buffer,codec_id,
+					  rate,frame_size)) <= 0 &&
+	ret != AUDIO_NOT_ENCODED) {
+
+    DBG("getEncoded: gotoNextItem\n");
+    gotoNextItem(true);
+    ret = AUDIO_NOT_ENCODED;
+  }
+
+  // silence is generated by get()
+  if(!cur_item || !cur_item->play)
+    ret = AUDIO_NOT_ENCODED;
+
+  cur_mut.unlock();
+  return ret;
+}
+
 int AmPlaylist::put(unsigned long long system_ts, unsigned char* buffer, 
 		    int input_sample_rate, unsigned int size)
 {
@@ -81,6 +81,9 @@ class AmPlaylist: public AmAudio
 
   int put(unsigned long long system_ts, unsigned char* buffer, 
 	  int input_sample_rate, unsigned int size);
+
+  int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 int codec_id, unsigned int rate, unsigned int frame_size);
 	
   /** from AmAudio */
   void close();
@@ -47,7 +47,7 @@
 AmPlayoutBuffer::AmPlayoutBuffer(AmPLCBuffer *plcbuffer, unsigned int sample_rate)
   : r_ts(0),w_ts(0), sample_rate(sample_rate),
     last_ts_i(false), recv_offset_i(false), 
-    m_plcbuffer(plcbuffer)
+    m_plcbuffer(plcbuffer), concealed(0)
 {
   buffer.clear_all();
 }
@@ -58,7 +58,7 @@ void AmPlayoutBuffer::direct_write_buffer(unsigned int ts, ShortSample* buf, uns
 }
 
 void AmPlayoutBuffer::write(u_int32_t ref_ts, u_int32_t rtp_ts, 
-			    int16_t* buf, u_int32_t len, bool begin_talk)
+			    int16_t* buf, u_int32_t len, bool begin_talk, u_int16_t seq)
 {  
   unsigned int mapped_ts;
   if(!recv_offset_i)
@@ -97,6 +97,7 @@ void AmPlayoutBuffer::write(u_int32_t ref_ts, u_int32_t rtp_ts,
       if (l_size>0)
         {
 	  direct_write_buffer(last_ts, (ShortSample*)tmp, PCM16_B2S(l_size));
+	  concealed += PCM16_B2S(l_size);
         }
     }
   m_plcbuffer->add_to_history(buf, PCM16_S2B(len));
@@ -132,6 +133,10 @@ u_int32_t AmPlayoutBuffer::read(u_int32_t ts, int16_t* buf, u_int32_t len)
   return 0;
 }
 
+unsigned int AmPlayoutBuffer::getDepth() const
+{
+  return ts_less()(r_ts,w_ts) ? w_ts - r_ts : 0;
+}
 
 void AmPlayoutBuffer::buffer_put(unsigned int ts, ShortSample* buf, unsigned int len)
 {
@@ -327,6 +332,7 @@ u_int32_t AmAdaptivePlayout::read(u_int32_t ts, int16_t* buf, u_int32_t len)
 
       buffer_put(w_ts,plc_buf,FRAMESZ);
     }
+    concealed += len/FRAMESZ*FRAMESZ;
 
     buffer_get(ts,buf,len);
   }
@@ -514,8 +520,10 @@ u_int32_t AmAdaptivePlayout::time_scale(u_int32_t ts, float factor,
  *
  *****************************************************************/
 
-AmJbPlayout::AmJbPlayout(AmPLCBuffer *plcbuffer, unsigned int sample_rate)
-  : AmPlayoutBuffer(plcbuffer, sample_rate)
+AmJbPlayout::AmJbPlayout(AmPLCBuffer *plcbuffer, unsigned int sample_rate,
+			 unsigned int min_delay, unsigned int max_delay)
+  : AmPlayoutBuffer(plcbuffer, sample_rate),
+    m_jb(sample_rate, min_delay, max_delay)
 {
 }
 
@@ -531,6 +539,19 @@ void AmJbPlayout::direct_write_buffer(unsigned int ts, ShortSample* buf, unsigne
   buffer_put(ts, buf, len);
 }
 
+void AmJbPlayout::conceal(unsigned int ts, unsigned int len, ShortSample* buf,
+			  unsigned int buf_len)
+{
+  if (len > buf_len)
+    len = buf_len;
+
+  int concealed_size = m_plcbuffer->conceal_loss(len, (unsigned char *)buf);
+  if (concealed_size > 0) {
+    direct_write_buffer(ts, buf, PCM16_B2S(concealed_size));
+    concealed += PCM16_B2S(concealed_size);
+  }
+}
+
 void AmJbPlayout::prepare_buffer(unsigned int audio_buffer_ts, unsigned int ms)
 {
   ShortSample buf[AUDIO_BUFFER_SIZE * 10];
@@ -546,11 +567,7 @@ void AmJbPlayout::prepare_buffer(unsigned int audio_buffer_ts, unsigned int ms)
       m_plcbuffer->add_to_history(buf, PCM16_S2B(nb_samples));
       /* Conceal the gap between previous and current RTP packets */
       if (last_ts_i && ts_less()(m_last_rtp_endts, ts))
-       	{
-	  int concealed_size = m_plcbuffer->conceal_loss(ts - m_last_rtp_endts, (unsigned char *)buf);
-	  if (concealed_size > 0)
-	    direct_write_buffer(m_last_rtp_endts, buf, PCM16_B2S(concealed_size));
-	}
+	conceal(m_last_rtp_endts, ts - m_last_rtp_endts, buf, AUDIO_BUFFER_SIZE * 10);
       m_last_rtp_endts = ts + nb_samples;
       last_ts_i = true;
     }
@@ -560,14 +577,37 @@ void AmJbPlayout::prepare_buffer(unsigned int audio_buffer_ts, unsigned int ms)
   if (ts_less()(m_last_rtp_endts, audio_buffer_ts + ms))
     {
       /* Last packets have been lost. Conceal them */
-      int concealed_size = m_plcbuffer->conceal_loss(audio_buffer_ts + ms - m_last_rtp_endts, (unsigned char *)buf);
-      if (concealed_size > 0)
-	direct_write_buffer(m_last_rtp_endts, buf, PCM16_B2S(concealed_size));
+      conceal(m_last_rtp_endts, audio_buffer_ts + ms - m_last_rtp_endts,
+	      buf, AUDIO_BUFFER_SIZE * 10);
       m_last_rtp_endts = audio_buffer_ts + ms;
     }
 }
 
-void AmJbPlayout::write(u_int32_t ref_ts, u_int32_t rtp_ts, int16_t* buf, u_int32_t len, bool begin_talk)
+void AmJbPlayout::write(u_int32_t ref_ts, u_int32_t rtp_ts, int16_t* buf, u_int32_t len,
+			bool begin_talk, u_int16_t seq)
+{
+  m_jb.put(buf, len, rtp_ts, seq, ref_ts, begin_talk);
+}
+
+void AmJbPlayout::setDelay(unsigned int min_delay, unsigned int max_delay)
+{
+  m_jb.setDelay(min_delay, max_delay);
+}
+
+unsigned int AmJbPlayout::getDepth() const
+{
+  return AmPlayoutBuffer::getDepth() + m_jb.getBuffered();
+}
+
+void AmJbPlayout::getStats(AmArg& stats) const
 {
-  m_jb.put(buf, len, rtp_ts, begin_talk);
+  const AmJitterBufferStats& jb = m_jb.getStats();
+
+  stats["delay_ms"] = (int)(m_jb.getDelay() * 1000 / sample_rate);
+  stats["min_delay_ms"] = (int)(m_jb.getMinDelay() * 1000 / sample_rate);
+  stats["max_delay_ms"] = (int)(m_jb.getMaxDelay() * 1000 / sample_rate);
+  stats["late"] = (int)jb.late;
+  stats["duplicate"] = (int)jb.duplicate;
+  stats["skipped"] = (int)jb.skipped;
+  stats["resync"] = (int)jb.resync;
 }
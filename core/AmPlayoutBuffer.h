@@ -32,6 +32,7 @@
 #include "AmStats.h"
 #include "LowcFE.h"
 #include "AmJitterBuffer.h"
+#include "AmArg.h"
 #include <set>
 using std::multiset;
 
@@ -78,6 +79,9 @@ class AmPlayoutBuffer
   /** the recv_offset initialized ?  */ 
   bool           recv_offset_i;
 
+  /** samples generated by packet loss concealment */
+  unsigned int   concealed;
+
   void buffer_put(unsigned int ts, ShortSample* buf, unsigned int len);
   void buffer_get(unsigned int ts, ShortSample* buf, unsigned int len);
 
@@ -87,10 +91,23 @@ class AmPlayoutBuffer
   AmPlayoutBuffer(AmPLCBuffer *plcbuffer, unsigned int sample_rate);
   virtual ~AmPlayoutBuffer() {}
 
-  virtual void write(u_int32_t ref_ts, u_int32_t ts, int16_t* buf, u_int32_t len, bool begin_talk);
+  /** seq: RTP sequence number of the packet (used by AmJbPlayout only) */
+  virtual void write(u_int32_t ref_ts, u_int32_t ts, int16_t* buf, u_int32_t len,
+		     bool begin_talk, u_int16_t seq = 0);
   virtual u_int32_t read(u_int32_t ts, int16_t* buf, u_int32_t len);
 
   void clearLastTs() { last_ts_i = false; }
+
+  unsigned int getSampleRate() const { return sample_rate; }
+
+  /** samples generated by packet loss concealment */
+  unsigned int getConcealed() const { return concealed; }
+
+  /** samples buffered ahead of the read position */
+  virtual unsigned int getDepth() const;
+
+  /** add playout specific statistics */
+  virtual void getStats(AmArg& stats) const { }
 };
 
 /** \brief adaptive playout buffer */
@@ -146,12 +163,22 @@ class AmJbPlayout : public AmPlayoutBuffer
  protected:
   void direct_write_buffer(unsigned int ts, ShortSample* buf, unsigned int len);
   void prepare_buffer(unsigned int ts, unsigned int ms);
+  /** conceal len samples from ts on (at most buf_len) */
+  void conceal(unsigned int ts, unsigned int len, ShortSample* buf, unsigned int buf_len);
 
  public:
-  AmJbPlayout(AmPLCBuffer *plcbuffer, unsigned int sample_rate);
+  /** min_delay, max_delay: playout delay limits in milliseconds */
+  AmJbPlayout(AmPLCBuffer *plcbuffer, unsigned int sample_rate,
+	      unsigned int min_delay, unsigned int max_delay);
 
   u_int32_t read(u_int32_t ts, int16_t* buf, u_int32_t len);
-  void write(u_int32_t ref_ts, u_int32_t rtp_ts, int16_t* buf, u_int32_t len, bool begin_talk);
+  void write(u_int32_t ref_ts, u_int32_t rtp_ts, int16_t* buf, u_int32_t len,
+	     bool begin_talk, u_int16_t seq = 0);
+
+  void setDelay(unsigned int min_delay, unsigned int max_delay);
+
+  unsigned int getDepth() const;
+  void getStats(AmArg& stats) const;
 };
 
 
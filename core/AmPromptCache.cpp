@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmPromptCache.h"
+#include "AmCachedAudioFile.h"
+#include "AmConfig.h"
+#include "AmUtils.h"
+#include "log.h"
+
+#include <string.h>
+#include <unistd.h>
+
+AmPromptEncoderThread::AmPromptEncoderThread(_AmPromptCache* cache)
+  : cache(cache), stop_requested(false)
+{
+  setThreadName("prompt-enc");
+}
+
+void AmPromptEncoderThread::run()
+{
+  while (!stop_requested.get()) {
+    cache->jobs_ready.wait_for_to(500);
+    while (!stop_requested.get() && cache->encodeNext());
+  }
+}
+
+void AmPromptEncoderThread::on_stop()
+{
+  stop_requested.set(true);
+  cache->jobs_ready.set(true);
+}
+
+_AmPromptCache::_AmPromptCache()
+  : total_size(0), jobs_ready(false), encoder(NULL)
+{
+}
+
+_AmPromptCache::~_AmPromptCache()
+{
+  for (std::map<string, Entry>::iterator it = prompts.begin();
+       it != prompts.end(); it++)
+    dec_ref(it->second.prompt);
+
+  delete encoder;
+}
+
+void _AmPromptCache::dispose()
+{
+  if (!encoder)
+    return;
+
+  // a prompt being encoded is finished first
+  encoder->stop();
+  while (!encoder->is_stopped())
+    usleep(10000); // 10ms
+}
+
+AmEncodedPrompt* _AmPromptCache::get(AmFileCache* file, int codec_id,
+				     unsigned int rate, unsigned int frame_size)
+{
+  string key = file->getFilename() + "|" + int2str(codec_id) + "|"
+    + int2str(rate) + "|" + int2str(frame_size);
+
+  AmLock l(prompts_mut);
+
+  std::map<string, Entry>::iterator it = prompts.find(key);
+  if (it != prompts.end()) {
+    AmEncodedPrompt* p = it->second.prompt;
+    if (p->state != AmEncodedPrompt::Ready)
+      return NULL;
+
+    lru.splice(lru.begin(), lru, it->second.lru_pos);
+    inc_ref(p);
+    return p;
+  }
+
+  // the encoder thread encodes it, sessions
+  // use the file directly in the meantime
+  Entry& e = prompts[key];
+  e.prompt = new AmEncodedPrompt();
+  inc_ref(e.prompt);
+  e.lru_pos = lru.end();
+
+  Job j;
+  j.key = key;
+  j.filename = file->getFilename();
+  j.codec_id = codec_id;
+  j.rate = rate;
+  j.frame_size = frame_size;
+  j.prompt = e.prompt;
+  jobs.push_back(j);
+  jobs_ready.set(true);
+
+  if (!encoder) {
+    encoder = new AmPromptEncoderThread(this);
+    encoder->start();
+  }
+
+  return NULL;
+}
+
+void _AmPromptCache::getSize(unsigned int& num_prompts, unsigned int& bytes)
+{
+  AmLock l(prompts_mut);
+  num_prompts = lru.size();
+  bytes = total_size;
+}
+
+bool _AmPromptCache::encodeNext()
+{
+  prompts_mut.lock();
+  if (jobs.empty()) {
+    jobs_ready.set(false);
+    prompts_mut.unlock();
+    return false;
+  }
+  Job j = jobs.front();
+  jobs.pop_front();
+  prompts_mut.unlock();
+
+  // entries being encoded are not evicted,
+  // so j.prompt stays valid without the lock
+  AmEncodedPrompt* p = j.prompt;
+  int res = -1;
+  AmFileCache file;
+  if (!file.load(j.filename))
+    res = encode(&file, j.codec_id, j.rate, j.frame_size, p);
+
+  if (res) {
+    WARN("could not encode prompt '%s' with codec %d/%u Hz/%u samples\n",
+	 j.filename.c_str(), j.codec_id, j.rate, j.frame_size);
+  }
+  else if (p->size() > AmConfig::PrecodedPromptsMaxSize) {
+    WARN("encoded prompt '%s' with codec %d/%u Hz/%u samples exceeds "
+	 "precoded_prompts_max_size (%u bytes)\n", j.filename.c_str(),
+	 j.codec_id, j.rate, j.frame_size, p->size());
+    res = -1;
+  }
+  else {
+    DBG("encoded prompt '%s' with codec %d/%u Hz/%u samples: "
+	"%u frames, %u bytes\n", j.filename.c_str(),
+	j.codec_id, j.rate, j.frame_size, p->numFrames(), p->size());
+  }
+
+  if (res) {
+    // kept (empty), so that it is not encoded again
+    vector<unsigned char>().swap(p->data);
+    vector<unsigned int>(1, 0).swap(p->offsets);
+  }
+
+  AmLock l(prompts_mut);
+  p->state = res ? AmEncodedPrompt::Failed : AmEncodedPrompt::Ready;
+  lru.push_front(j.key);
+  prompts[j.key].lru_pos = lru.begin();
+  total_size += p->size();
+  evict();
+
+  return true;
+}
+
+void _AmPromptCache::evict()
+{
+  while (total_size > AmConfig::PrecodedPromptsMaxSize && !lru.empty()) {
+    std::map<string, Entry>::iterator it = prompts.find(lru.back());
+    lru.pop_back();
+    if (it == prompts.end())
+      continue;
+
+    AmEncodedPrompt* p = it->second.prompt;
+    DBG("dropping encoded prompt '%s' (%u bytes) from the cache\n",
+	it->first.c_str(), p->size());
+    total_size -= p->size();
+    prompts.erase(it);
+
+    // sessions playing it still hold a reference
+    dec_ref(p);
+  }
+}
+
+int _AmPromptCache::encode(AmFileCache* file, int codec_id, unsigned int rate,
+			   unsigned int frame_size, AmEncodedPrompt* p)
+{
+  if (PCM16_S2B(frame_size) > AUDIO_BUFFER_SIZE)
+    return -1;
+
+  // the same as a session playing the file would get
+  AmCachedAudioFile af(file);
+  if (!af.is_good())
+    return -1;
+
+  AmAudioFormat fmt(codec_id, rate);
+  amci_codec_t* codec = fmt.getCodec();
+  if (!codec)
+    return -1;
+  long h_codec = fmt.getHCodec();
+
+  unsigned char pcm[AUDIO_BUFFER_SIZE];
+  unsigned char out[AUDIO_BUFFER_SIZE];
+  unsigned long long ts = 0;
+
+  while (true) {
+    int size = af.get(ts, pcm, rate, frame_size);
+    if (size <= 0)
+      break;
+    ts += (unsigned long long)frame_size * WALLCLOCK_RATE / rate;
+
+    unsigned char* frame = pcm;
+    if (codec->encode) {
+      size = (*codec->encode)(out, pcm, size, 1, rate, h_codec);
+      if (size < 0)
+	return -1;
+      frame = out;
+    }
+
+    p->data.insert(p->data.end(), frame, frame + size);
+    p->offsets.push_back(p->data.size());
+  }
+
+  return p->numFrames() ? 0 : -1;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmPromptCache.h */
+#ifndef _AmPromptCache_h_
+#define _AmPromptCache_h_
+
+#include "AmThread.h"
+#include "atomic_types.h"
+#include "singleton.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+using std::string;
+using std::vector;
+
+class AmFileCache;
+class _AmPromptCache;
+
+/**
+ * \brief a prompt encoded into RTP payload frames
+ *
+ * Once the prompt is ready, it is not modified any more
+ * and can be read without locking. Sessions playing it hold
+ * a reference, so that it survives being dropped from the cache.
+ */
+class AmEncodedPrompt
+  : public atomic_ref_cnt
+{
+  friend class _AmPromptCache;
+
+  enum State { Encoding, Ready, Failed };
+  State state;
+
+  /** all frames */
+  vector<unsigned char> data;
+  /** start of each frame in data, plus the end of the last one */
+  vector<unsigned int> offsets;
+
+  AmEncodedPrompt() : state(Encoding) { offsets.push_back(0); }
+
+public:
+  unsigned int numFrames() const { return offsets.size() - 1; }
+
+  /** @return frame size in bytes */
+  unsigned int frameSize(unsigned int i) const {
+    return offsets[i + 1] - offsets[i];
+  }
+
+  const unsigned char* frame(unsigned int i) const {
+    return &data[offsets[i]];
+  }
+
+  /** @return size of all frames in bytes */
+  unsigned int size() const { return data.size(); }
+};
+
+/**
+ * \brief encodes the prompts queued by the AmPromptCache
+ */
+class AmPromptEncoderThread
+  : public AmThread
+{
+  _AmPromptCache* cache;
+  AmSharedVar<bool> stop_requested;
+
+protected:
+  void run();
+  void on_stop();
+
+public:
+  AmPromptEncoderThread(_AmPromptCache* cache);
+};
+
+/**
+ * \brief process-wide cache of prompts encoded per codec
+ *
+ * Prompts (see AmPromptCollection) are encoded on first use for
+ * each combination of codec, sample rate and frame size (packetization),
+ * so that sessions playing the same prompt only copy ready
+ * RTP payloads instead of decoding, resampling and encoding the file
+ * on every frame.
+ *
+ * Encoding is done by an encoder thread, the media processor
+ * only looks up the prompts. If the encoded prompts exceed
+ * AmConfig::PrecodedPromptsMaxSize, the least recently used
+ * are dropped.
+ */
+class _AmPromptCache
+{
+  friend class AmPromptEncoderThread;
+
+  struct Entry {
+    AmEncodedPrompt* prompt;
+    /* position in lru, if encoding is finished */
+    std::list<string>::iterator lru_pos;
+  };
+
+  struct Job {
+    string key;
+    string filename;
+    int codec_id;
+    unsigned int rate;
+    unsigned int frame_size;
+    AmEncodedPrompt* prompt;
+  };
+
+  /* key: file name, codec, rate, frame size */
+  std::map<string, Entry> prompts;
+  /* keys of encoded prompts, most recently used first */
+  std::list<string> lru;
+  /* bytes of all encoded prompts */
+  unsigned int total_size;
+
+  /* prompts to be encoded */
+  std::deque<Job> jobs;
+  AmCondition<bool> jobs_ready;
+  AmPromptEncoderThread* encoder;
+
+  /* protects all of the above */
+  AmMutex prompts_mut;
+
+  /** encode the next queued prompt, @return false if none was queued */
+  bool encodeNext();
+
+  /** drop least recently used prompts until they fit in the size limit */
+  void evict();
+
+  int encode(AmFileCache* file, int codec_id, unsigned int rate,
+	     unsigned int frame_size, AmEncodedPrompt* p);
+
+protected:
+  _AmPromptCache();
+  ~_AmPromptCache();
+
+  /** stop the encoder thread */
+  void dispose();
+
+public:
+  /**
+   * Get the prompt cached in file encoded with the codec,
+   * queueing it for encoding if this is the first request.
+   *
+   * @param rate codec sample rate
+   * @param frame_size samples per frame
+   * @return the prompt, referenced for the caller (release with
+   *         dec_ref()), or NULL if it is not (yet) available - while
+   *         it is being encoded or if encoding failed
+   */
+  AmEncodedPrompt* get(AmFileCache* file, int codec_id,
+		       unsigned int rate, unsigned int frame_size);
+
+  /** get the number of cached prompts and their size in bytes */
+  void getSize(unsigned int& num_prompts, unsigned int& bytes);
+};
+
+typedef singleton<_AmPromptCache> AmPromptCache;
+
+#endif
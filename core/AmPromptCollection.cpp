@@ -25,6 +25,7 @@
 
 #include "AmPromptCollection.h"
 #include "AmUtils.h"
+#include "AmConfig.h"
 #include "log.h"
 
 AmPromptCollection::AmPromptCollection() 
@@ -100,7 +101,7 @@ int AudioFileEntry::load(const std::string& filename) {
 AmCachedAudioFile* AudioFileEntry::getAudio(){
   if (!isopen)
     return NULL;
-  return new AmCachedAudioFile(&cache);
+  return new AmCachedAudioFile(&cache, AmConfig::PrecodedPrompts);
 }
 
 bool AmPromptCollection::hasPrompt(const string& name) {
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRecordingWriter.h"
+#include "AmConfig.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+AmRecordingFile::AmRecordingFile(FILE* fp, AmRecordingWriterThread* thread)
+  : fp(fp), thread(thread), buf(NULL), len(0), cap(0),
+    error(false), written(0), dropped(0), done(false), abandoned(false)
+{
+}
+
+AmRecordingFile::~AmRecordingFile()
+{
+  free(buf);
+}
+
+int AmRecordingFile::write(const unsigned char* data, size_t size)
+{
+  if (error)
+    return -1;
+
+  // the frames are not split: a dropped chunk drops whole frames
+  if (buf && len + size > cap)
+    queueChunk();
+
+  if (!buf) {
+    cap = size > REC_WRITER_CHUNK_SIZE ? size : REC_WRITER_CHUNK_SIZE;
+    buf = (unsigned char*)malloc(cap);
+    if (!buf) {
+      ERROR("out of memory\n");
+      return -1;
+    }
+    len = 0;
+  }
+
+  memcpy(buf + len, data, size);
+  len += size;
+
+  if (len == cap)
+    queueChunk();
+
+  return 0;
+}
+
+void AmRecordingFile::queueChunk()
+{
+  if (!buf)
+    return;
+
+  if (!thread->push(AmRecordingWriterThread::Chunk(this, buf, len))) {
+    // dropped
+    if (!dropped)
+      WARN("recording writer too slow, dropping data\n");
+    dropped += len;
+    free(buf);
+  }
+
+  buf = NULL;
+  len = 0;
+}
+
+AmRecordingWriterThread::AmRecordingWriterThread(size_t max_queued_bytes)
+  : queued_bytes(0), queue_ready(false), closed(false),
+    max_queued_bytes(max_queued_bytes),
+    stop_requested(false), max_queued(0)
+{
+}
+
+bool AmRecordingWriterThread::push(const Chunk& c, bool force)
+{
+  queue_mut.lock();
+  if (closed) {
+    queue_mut.unlock();
+    return false;
+  }
+
+  if (!force && queued_bytes + c.len > max_queued_bytes) {
+    queue_mut.unlock();
+    dropped_bytes.inc(c.len);
+    return false;
+  }
+
+  queue.push_back(c);
+  queued_bytes += c.len;
+  if (queued_bytes > max_queued)
+    max_queued = queued_bytes;
+  queue_ready.set(true);
+  queue_mut.unlock();
+
+  return true;
+}
+
+void AmRecordingWriterThread::run()
+{
+  std::deque<Chunk> chunks;
+
+  while (true) {
+    queue_ready.wait_for_to(500);
+
+    queue_mut.lock();
+    chunks.swap(queue);
+    queue_ready.set(false);
+    if (chunks.empty() && stop_requested.get())
+      closed = true;
+    queue_mut.unlock();
+
+    if (chunks.empty()) {
+      if (closed)
+	break;
+      continue;
+    }
+
+    for (std::deque<Chunk>::iterator it = chunks.begin();
+	 it != chunks.end(); it++) {
+      if (it->job) {
+	it->job->run();
+	delete it->job;
+	continue;
+      }
+
+      AmRecordingFile* f = it->file;
+
+      if (!it->data) {
+	// close marker: everything before is written
+	if (fflush(f->fp)) {
+	  write_errors.inc();
+	  f->error = true;
+	}
+
+	queue_mut.lock();
+	bool abandoned = f->abandoned;
+	f->done.set(true);
+	queue_mut.unlock();
+
+	if (abandoned) {
+	  // close() did not wait for it
+	  fclose(f->fp);
+	  if (f->dropped)
+	    WARN("%llu bytes of recorded file have been dropped\n", f->dropped);
+	  delete f;
+	}
+	continue;
+      }
+
+      if (!f->error) {
+	size_t w = fwrite(it->data, 1, it->len, f->fp);
+	if (w != it->len) {
+	  ERROR("writing recorded file: %s\n", strerror(errno));
+	  write_errors.inc();
+	  f->error = true;
+	}
+	f->written += w;
+	written_bytes.inc(w);
+      }
+      free(it->data);
+
+      queue_mut.lock();
+      queued_bytes -= it->len;
+      queue_mut.unlock();
+    }
+    chunks.clear();
+  }
+}
+
+void AmRecordingWriterThread::on_stop()
+{
+  stop_requested.set(true);
+}
+
+_AmRecordingWriter::_AmRecordingWriter()
+{
+}
+
+_AmRecordingWriter::~_AmRecordingWriter()
+{
+  for (std::vector<AmRecordingWriterThread*>::iterator it =
+	 threads.begin(); it != threads.end(); it++)
+    delete *it;
+}
+
+void _AmRecordingWriter::init()
+{
+  DBG("starting %u recording writer threads\n",
+      AmConfig::RecordingWriterThreads);
+
+  for (unsigned int i = 0; i < AmConfig::RecordingWriterThreads; i++) {
+    AmRecordingWriterThread* t =
+      new AmRecordingWriterThread(AmConfig::RecordingWriterMaxQueue);
+    t->start();
+    threads.push_back(t);
+  }
+}
+
+void _AmRecordingWriter::dispose()
+{
+  // the threads write everything queued before stopping
+  for (std::vector<AmRecordingWriterThread*>::iterator it =
+	 threads.begin(); it != threads.end(); it++)
+    (*it)->stop();
+
+  bool threads_stopped;
+  do {
+    usleep(10000); // 10ms
+    threads_stopped = true;
+    for (std::vector<AmRecordingWriterThread*>::iterator it =
+	   threads.begin(); it != threads.end(); it++) {
+      if (!(*it)->is_stopped()) {
+	threads_stopped = false;
+	break;
+      }
+    }
+  } while(!threads_stopped);
+}
+
+AmRecordingFile* _AmRecordingWriter::open(FILE* fp)
+{
+  if (threads.empty())
+    return NULL;
+
+  // the header written by the file format is
+  // written before any data of the writer thread
+  fflush(fp);
+
+  unsigned int i = next_thread.inc() % threads.size();
+  return new AmRecordingFile(fp, threads[i]);
+}
+
+void _AmRecordingWriter::run(AmRecordingJob* job)
+{
+  if (!threads.empty()) {
+    unsigned int i = next_thread.inc() % threads.size();
+    if (threads[i]->push(AmRecordingWriterThread::Chunk(job), true))
+      return;
+  }
+
+  job->run();
+  delete job;
+}
+
+bool _AmRecordingWriter::close(AmRecordingFile* f, unsigned long long& written,
+			       bool may_close)
+{
+  f->queueChunk();
+  if (!f->thread->push(AmRecordingWriterThread::Chunk(f, NULL, 0), true)) {
+    // stopped: everything queued before has been written
+    f->done.set(true);
+  }
+
+  if (!may_close) {
+    f->done.wait_for();
+  }
+  else if (!f->done.wait_for_to(REC_WRITER_CLOSE_TIMEOUT)) {
+    AmLock l(f->thread->queue_mut);
+    if (!f->done.get()) {
+      WARN("recording writer too slow, file will be closed "
+	   "without updating its header\n");
+      f->abandoned = true;
+      return false;
+    }
+  }
+
+  written = f->written;
+  if (f->dropped) {
+    WARN("%llu bytes of recorded file have been dropped\n", f->dropped);
+  }
+  delete f;
+
+  return true;
+}
+
+void _AmRecordingWriter::getStats(AmArg& stats)
+{
+  unsigned long long written = 0, dropped = 0;
+  unsigned int errors = 0;
+  size_t queued = 0, max_queued = 0;
+
+  for (std::vector<AmRecordingWriterThread*>::iterator it =
+	 threads.begin(); it != threads.end(); it++) {
+    AmRecordingWriterThread* t = *it;
+    written += t->written_bytes.get();
+    dropped += t->dropped_bytes.get();
+    errors += t->write_errors.get();
+
+    t->queue_mut.lock();
+    queued += t->queued_bytes;
+    if (t->max_queued > max_queued)
+      max_queued = t->max_queued;
+    t->queue_mut.unlock();
+  }
+
+  stats["threads"] = (int)threads.size();
+  stats["written_bytes"] = (long long)written;
+  stats["dropped_bytes"] = (long long)dropped;
+  stats["write_errors"] = (int)errors;
+  stats["queued_bytes"] = (long long)queued;
+  stats["max_queued_bytes"] = (long long)max_queued;
+}
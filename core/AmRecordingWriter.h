@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmRecordingWriter.h */
+#ifndef _AmRecordingWriter_h_
+#define _AmRecordingWriter_h_
+
+#include "AmThread.h"
+#include "AmArg.h"
+#include "singleton.h"
+#include "atomic_types.h"
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+
+/** data of a file is collected into chunks of (at least) this size */
+#define REC_WRITER_CHUNK_SIZE 32768
+
+/** max. wait for the writer thread when closing a file (ms) */
+#define REC_WRITER_CLOSE_TIMEOUT 500
+
+class AmRecordingWriterThread;
+
+/**
+ * \brief file I/O done by a writer thread (e.g. a packet capture dump)
+ */
+class AmRecordingJob
+{
+public:
+  virtual ~AmRecordingJob() {}
+
+  /** called by the writer thread, deleted afterwards */
+  virtual void run() = 0;
+};
+
+/**
+ * \brief a file written by a writer thread
+ *
+ * Only the thread owning the file (e.g. media processor) calls
+ * write(); after open, the FILE is only used by the writer thread
+ * until the file is closed with AmRecordingWriter::close().
+ *
+ * The data of one write() (whole frames) is never split into two
+ * chunks, so that dropped chunks do not break the framing of the
+ * rest of the file.
+ */
+class AmRecordingFile
+{
+  friend class _AmRecordingWriter;
+  friend class AmRecordingWriterThread;
+
+  FILE* fp;
+  AmRecordingWriterThread* thread;
+
+  /** chunk being filled */
+  unsigned char* buf;
+  size_t len;
+  size_t cap;
+
+  /** set by the writer thread */
+  volatile bool error;
+  unsigned long long written;
+  unsigned long long dropped;
+
+  /** set by the writer thread when all data is written */
+  AmCondition<bool> done;
+
+  /** close() has given up waiting: the writer thread closes fp
+      and deletes the file (protected by the thread's queue_mut) */
+  bool abandoned;
+
+  AmRecordingFile(FILE* fp, AmRecordingWriterThread* thread);
+  ~AmRecordingFile();
+
+  void queueChunk();
+
+public:
+  /**
+   * Queue data to be written, never blocks.
+   * @return -1 if writing the file failed, 0 otherwise
+   */
+  int write(const unsigned char* data, size_t size);
+};
+
+/**
+ * \brief writes the chunks of its files
+ */
+class AmRecordingWriterThread
+  : public AmThread
+{
+  friend class AmRecordingFile;
+  friend class _AmRecordingWriter;
+
+  struct Chunk {
+    AmRecordingFile* file;
+    /* NULL: close marker */
+    unsigned char* data;
+    size_t len;
+    /* instead of file data */
+    AmRecordingJob* job;
+
+    Chunk(AmRecordingFile* file, unsigned char* data, size_t len)
+      : file(file), data(data), len(len), job(NULL) {}
+    Chunk(AmRecordingJob* job)
+      : file(NULL), data(NULL), len(0), job(job) {}
+  };
+
+  std::deque<Chunk> queue;
+  size_t queued_bytes;
+  AmMutex queue_mut;
+  AmCondition<bool> queue_ready;
+  /* stopped: nothing is queued any more (protected by queue_mut) */
+  bool closed;
+
+  size_t max_queued_bytes;
+
+  AmSharedVar<bool> stop_requested;
+
+  /* statistics */
+  atomic_int64 written_bytes;
+  atomic_int64 dropped_bytes;
+  atomic_int   write_errors;
+  size_t       max_queued; // protected by queue_mut
+
+  /** @return false if the chunk has been dropped (or the thread stopped) */
+  bool push(const Chunk& c, bool force = false);
+
+  void run();
+  void on_stop();
+
+public:
+  AmRecordingWriterThread(size_t max_queued_bytes);
+};
+
+/**
+ * \brief writes recorded files outside of the media processing
+ *
+ * AmAudioFile opened for writing hands its data to one of the writer
+ * threads in chunks of REC_WRITER_CHUNK_SIZE bytes, so that media
+ * processor threads never wait for the disk. If a writer thread
+ * can not keep up and has more than recording_writer_max_queue
+ * bytes queued, new chunks are dropped (and counted). A file closed
+ * while its data is still queued is closed by the writer thread if
+ * it is not written within REC_WRITER_CLOSE_TIMEOUT.
+ */
+class _AmRecordingWriter
+{
+  std::vector<AmRecordingWriterThread*> threads;
+  atomic_int next_thread;
+
+protected:
+  _AmRecordingWriter();
+  ~_AmRecordingWriter();
+
+  void dispose();
+
+public:
+  /** start the writer threads (recording_writer_threads) */
+  void init();
+
+  /** @return true if files are written by writer threads */
+  bool enabled() { return !threads.empty(); }
+
+  /** start writing fp with a writer thread */
+  AmRecordingFile* open(FILE* fp);
+
+  /**
+   * Run the job in a writer thread, or right away in the
+   * calling thread if there is none. The job is deleted.
+   */
+  void run(AmRecordingJob* job);
+
+  /**
+   * Write the remaining data and wait until the file has been
+   * written. The file is deleted, fp can be used again.
+   *
+   * @param written    bytes written
+   * @param may_close  wait only REC_WRITER_CLOSE_TIMEOUT ms: if the
+   *                   data is not written by then, the writer thread
+   *                   closes fp later (without the caller updating
+   *                   the file header)
+   * @return false if fp is left to the writer thread
+   */
+  bool close(AmRecordingFile* f, unsigned long long& written,
+	     bool may_close = false);
+
+  /** written/dropped bytes, errors, queue sizes */
+  void getStats(AmArg& stats);
+};
+
+typedef singleton<_AmRecordingWriter> AmRecordingWriter;
+
+#endif
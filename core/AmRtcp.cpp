@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRtcp.h"
+#include "AmRtpStream.h"
+#include "AmConfig.h"
+#include "AmUtils.h"
+#include "log.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <map>
+
+/** seconds from 1900 (NTP) to 1970 */
+#define NTP_EPOCH_OFFSET 2208988800UL
+
+/** RFC 3550 6.2: minimum report interval (ms) */
+#define RTCP_MIN_INTERVAL 5000
+
+/** XR block types (RFC 3611) */
+#define XR_VOIP_METRICS 7
+
+static inline unsigned int get32(const unsigned char* p)
+{
+  unsigned int v;
+  memcpy(&v, p, 4);
+  return ntohl(v);
+}
+
+static inline void put32(unsigned char* p, unsigned int v)
+{
+  v = htonl(v);
+  memcpy(p, &v, 4);
+}
+
+static inline unsigned short get16(const unsigned char* p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static void ntp_time(const struct timeval& tv, unsigned int& sec, unsigned int& frac)
+{
+  sec = tv.tv_sec + NTP_EPOCH_OFFSET;
+  frac = (unsigned int)(((unsigned long long)tv.tv_usec << 32) / 1000000);
+}
+
+/** middle 32 bits of the NTP time (LSR, 1/65536 s) */
+static unsigned int ntp_mid(const struct timeval& tv)
+{
+  unsigned int sec, frac;
+  ntp_time(tv, sec, frac);
+  return (sec << 16) | (frac >> 16);
+}
+
+/** sums per RTP interface, updated a few times per stream and interval */
+struct RtcpTotals
+{
+  unsigned long long sr_received;
+  unsigned long long rr_received;
+  unsigned long long xr_received;
+  unsigned long long bad_received;
+  unsigned long long sent;
+
+  unsigned long long blocks;
+  unsigned long long fraction_lost_sum; // 1/256
+  unsigned long long jitter_us_sum;
+
+  unsigned long long rtt_samples;
+  unsigned long long rtt_ms_sum;
+  unsigned long long rtt_ms_max;
+
+  unsigned long long xr_voip;
+  unsigned long long xr_mos_samples;
+  unsigned long long xr_mos_lq_sum; // *10
+
+  RtcpTotals() { memset(this, 0, sizeof(RtcpTotals)); }
+};
+
+static std::map<int, RtcpTotals> rtcp_totals;
+static AmMutex rtcp_totals_mut;
+
+AmRtcp::Metrics::Metrics()
+  : sr_received(0), rr_received(0), xr_received(0), bad_received(0), sent(0),
+    report(false), fraction_lost(0), cum_lost(0), jitter(0),
+    rtt_ms(-1), rtt_max_ms(0),
+    xr_voip(false), xr_loss_rate(0), xr_discard_rate(0), xr_rtt_ms(0),
+    xr_end_system_delay_ms(0), xr_r_factor(127), xr_mos_lq(127), xr_mos_cq(127)
+{
+}
+
+AmRtcp::AmRtcp()
+  : rtp_if(0), ts_rate(8000),
+    sent_packets(0), sent_octets(0), sent_packets_prior(0),
+    expected_prior(0), received_prior(0), lsr(0)
+{
+  memset(&lsr_time, 0, sizeof(lsr_time));
+}
+
+unsigned int AmRtcp::interval(bool initial)
+{
+  unsigned int t = initial ? RTCP_MIN_INTERVAL / 2 : RTCP_MIN_INTERVAL;
+  // [0.5,1.5] / (e - 3/2)
+  return (unsigned int)((t * (500 + get_random() % 1001) / 1000) / 1.21828);
+}
+
+void AmRtcp::reportBlock(const unsigned char* b, bool relayed)
+{
+  m.report = true;
+  m.fraction_lost = b[4];
+  m.cum_lost = (b[5] << 16) | (b[6] << 8) | b[7];
+  if (m.cum_lost & 0x800000) m.cum_lost -= 0x1000000;
+  m.jitter = get32(b + 12);
+
+  unsigned int b_lsr = get32(b + 16);
+  unsigned int b_dlsr = get32(b + 20);
+  int rtt_ms = -1;
+  if (!relayed && b_lsr) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    unsigned int rtt = ntp_mid(now) - b_lsr - b_dlsr;
+    // ignore nonsense (clock of the peer's DLSR, wrapped)
+    if (rtt < 60 * 65536) {
+      rtt_ms = (int)((unsigned long long)rtt * 1000 / 65536);
+      m.rtt_ms = rtt_ms;
+      if ((unsigned int)rtt_ms > m.rtt_max_ms)
+	m.rtt_max_ms = rtt_ms;
+    }
+  }
+
+  AmLock l(rtcp_totals_mut);
+  RtcpTotals& t = rtcp_totals[rtp_if];
+  t.blocks++;
+  t.fraction_lost_sum += m.fraction_lost;
+  t.jitter_us_sum += (unsigned long long)m.jitter * 1000000 / ts_rate;
+  if (rtt_ms >= 0) {
+    t.rtt_samples++;
+    t.rtt_ms_sum += rtt_ms;
+    if ((unsigned long long)rtt_ms > t.rtt_ms_max)
+      t.rtt_ms_max = rtt_ms;
+  }
+}
+
+void AmRtcp::xrBlocks(const unsigned char* p, const unsigned char* end,
+		      bool relayed)
+{
+  while (p + 4 <= end) {
+    unsigned int block_len = (get16(p + 2) + 1) * 4;
+    if (p + block_len > end)
+      break;
+
+    if (p[0] == XR_VOIP_METRICS && block_len >= 36) {
+      m.xr_voip = true;
+      m.xr_loss_rate = p[8];
+      m.xr_discard_rate = p[9];
+      m.xr_rtt_ms = get16(p + 16);
+      m.xr_end_system_delay_ms = get16(p + 18);
+      m.xr_r_factor = p[24];
+      m.xr_mos_lq = p[26];
+      m.xr_mos_cq = p[27];
+
+      AmLock l(rtcp_totals_mut);
+      RtcpTotals& t = rtcp_totals[rtp_if];
+      t.xr_voip++;
+      if (m.xr_mos_lq != 127) {
+	t.xr_mos_samples++;
+	t.xr_mos_lq_sum += m.xr_mos_lq;
+      }
+    }
+    p += block_len;
+  }
+}
+
+bool AmRtcp::parse(const unsigned char* buf, unsigned int len,
+		   unsigned int l_ssrc, bool relayed)
+{
+  AmLock l(mut);
+
+  const unsigned char* p = buf;
+  const unsigned char* end = buf + len;
+  unsigned int sr = 0, rr = 0, xr = 0;
+  bool bad = len < 8;
+
+  while (!bad && (p + 4 <= end)) {
+    unsigned int count = p[0] & 0x1f;
+    unsigned int pt = p[1];
+    unsigned int plen = (get16(p + 2) + 1) * 4;
+
+    if (((p[0] >> 6) != 2) || (p + plen > end)) {
+      bad = true;
+      break;
+    }
+
+    const unsigned char* blocks = NULL;
+    switch (pt) {
+    case RTCP_SR:
+      if (plen < 28) { bad = true; break; }
+      lsr = (get32(p + 8) << 16) | (get32(p + 12) >> 16);
+      gettimeofday(&lsr_time, NULL);
+      blocks = p + 28;
+      sr++;
+      break;
+
+    case RTCP_RR:
+      if (plen < 8) { bad = true; break; }
+      blocks = p + 8;
+      rr++;
+      break;
+
+    case RTCP_XR:
+      if (plen < 8) { bad = true; break; }
+      xrBlocks(p + 8, p + plen, relayed);
+      xr++;
+      break;
+
+    default:
+      break;
+    }
+
+    for (unsigned int i = 0; blocks && (i < count) &&
+	   (blocks + (i + 1) * 24 <= p + plen); i++) {
+      const unsigned char* b = blocks + i * 24;
+      // relayed: the other leg's SSRC, and only one source usually
+      if (relayed ? (i == 0) : (get32(b) == l_ssrc))
+	reportBlock(b, relayed);
+    }
+
+    p += plen;
+  }
+
+  m.sr_received += sr;
+  m.rr_received += rr;
+  m.xr_received += xr;
+  if (bad) m.bad_received++;
+
+  AmLock tl(rtcp_totals_mut);
+  RtcpTotals& t = rtcp_totals[rtp_if];
+  t.sr_received += sr;
+  t.rr_received += rr;
+  t.xr_received += xr;
+  if (bad) t.bad_received++;
+
+  return !bad;
+}
+
+unsigned int AmRtcp::build(unsigned char* buf, unsigned int size,
+			   unsigned int l_ssrc, unsigned int rtp_ts,
+			   const AmRtpReceiveStats& rs, unsigned int r_ssrc,
+			   const string& cname)
+{
+  unsigned int cname_len = cname.length() > 255 ? 255 : cname.length();
+  // SR with one block + SDES with CNAME, end and padding
+  if (size < 28 + 24 + 10 + cname_len + 4)
+    return 0;
+
+  AmLock l(mut);
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  bool sender = sent_packets != sent_packets_prior;
+  sent_packets_prior = sent_packets;
+
+  unsigned char* p = buf;
+  unsigned int rc = rs.seq_i ? 1 : 0;
+
+  p[0] = 0x80 | rc;
+  p[1] = sender ? RTCP_SR : RTCP_RR;
+  put32(p + 4, l_ssrc);
+  p += 8;
+
+  if (sender) {
+    unsigned int sec, frac;
+    ntp_time(now, sec, frac);
+    put32(p, sec);
+    put32(p + 4, frac);
+    put32(p + 8, rtp_ts);
+    put32(p + 12, sent_packets);
+    put32(p + 16, sent_octets);
+    p += 20;
+  }
+
+  if (rc) {
+    unsigned int expected = rs.expected();
+    unsigned int expected_interval = expected - expected_prior;
+    unsigned int received_interval = rs.received - received_prior;
+    expected_prior = expected;
+    received_prior = rs.received;
+
+    int lost_interval = (int)(expected_interval - received_interval);
+    unsigned int fraction = 0;
+    if (expected_interval && (lost_interval > 0))
+      fraction = ((unsigned int)lost_interval << 8) / expected_interval;
+
+    int cum_lost = (int)(expected - rs.received);
+    if (cum_lost > 0x7fffff) cum_lost = 0x7fffff;
+    else if (cum_lost < -0x800000) cum_lost = -0x800000;
+
+    unsigned int dlsr = 0;
+    if (lsr) {
+      unsigned long long us = (now.tv_sec - lsr_time.tv_sec) * 1000000ULL +
+	now.tv_usec - lsr_time.tv_usec;
+      dlsr = (unsigned int)(us * 65536 / 1000000);
+    }
+
+    put32(p, r_ssrc);
+    put32(p + 4, ((fraction & 0xff) << 24) | (cum_lost & 0xffffff));
+    put32(p + 8, rs.cycles + rs.max_seq);
+    put32(p + 12, rs.jitter >> 4);
+    put32(p + 16, lsr);
+    put32(p + 20, dlsr);
+    p += 24;
+  }
+
+  unsigned int words = (p - buf) / 4 - 1;
+  buf[2] = words >> 8;
+  buf[3] = words & 0xff;
+
+  // SDES: one chunk with CNAME, null item, padded to 32 bits
+  unsigned char* sdes = p;
+  sdes[0] = 0x81;
+  sdes[1] = RTCP_SDES;
+  put32(sdes + 4, l_ssrc);
+  sdes[8] = 1; // CNAME
+  sdes[9] = cname_len;
+  memcpy(sdes + 10, cname.c_str(), cname_len);
+  p = sdes + 10 + cname_len;
+  do { *p++ = 0; } while ((p - sdes) % 4);
+
+  words = (p - sdes) / 4 - 1;
+  sdes[2] = words >> 8;
+  sdes[3] = words & 0xff;
+
+  m.sent++;
+
+  AmLock tl(rtcp_totals_mut);
+  rtcp_totals[rtp_if].sent++;
+
+  return p - buf;
+}
+
+void AmRtcp::getStats(AmArg& stats)
+{
+  AmLock l(mut);
+
+  stats["sr_received"] = (int)m.sr_received;
+  stats["rr_received"] = (int)m.rr_received;
+  stats["xr_received"] = (int)m.xr_received;
+  stats["bad_received"] = (int)m.bad_received;
+  stats["sent"] = (int)m.sent;
+
+  if (m.report) {
+    stats["remote_fraction_lost"] = (double)m.fraction_lost / 256.0;
+    stats["remote_cum_lost"] = m.cum_lost;
+    stats["remote_jitter_ms"] = (double)m.jitter * 1000.0 / ts_rate;
+  }
+  if (m.rtt_ms >= 0) {
+    stats["rtt_ms"] = m.rtt_ms;
+    stats["rtt_max_ms"] = (int)m.rtt_max_ms;
+  }
+
+  if (m.xr_voip) {
+    AmArg& xr = stats["xr"];
+    xr["loss_rate"] = (double)m.xr_loss_rate / 256.0;
+    xr["discard_rate"] = (double)m.xr_discard_rate / 256.0;
+    xr["rtt_ms"] = (int)m.xr_rtt_ms;
+    xr["end_system_delay_ms"] = (int)m.xr_end_system_delay_ms;
+    if (m.xr_r_factor != 127) xr["r_factor"] = (int)m.xr_r_factor;
+    if (m.xr_mos_lq != 127) xr["mos_lq"] = (double)m.xr_mos_lq / 10.0;
+    if (m.xr_mos_cq != 127) xr["mos_cq"] = (double)m.xr_mos_cq / 10.0;
+  }
+}
+
+void AmRtcp::getTotals(AmArg& stats)
+{
+  stats.assertStruct();
+
+  AmLock l(rtcp_totals_mut);
+  for (std::map<int, RtcpTotals>::iterator it = rtcp_totals.begin();
+       it != rtcp_totals.end(); it++) {
+    const RtcpTotals& t = it->second;
+    string name = ((size_t)it->first < AmConfig::RTP_Ifs.size()) ?
+      AmConfig::RTP_Ifs[it->first].name : int2str(it->first);
+    AmArg& s = stats[name];
+
+    s["sr_received"] = (long long)t.sr_received;
+    s["rr_received"] = (long long)t.rr_received;
+    s["xr_received"] = (long long)t.xr_received;
+    s["bad_received"] = (long long)t.bad_received;
+    s["sent"] = (long long)t.sent;
+    s["report_blocks"] = (long long)t.blocks;
+
+    if (t.blocks) {
+      s["avg_fraction_lost"] = (double)t.fraction_lost_sum / 256.0 / t.blocks;
+      s["avg_jitter_ms"] = (double)t.jitter_us_sum / 1000.0 / t.blocks;
+    }
+    if (t.rtt_samples) {
+      s["avg_rtt_ms"] = (double)t.rtt_ms_sum / t.rtt_samples;
+      s["max_rtt_ms"] = (long long)t.rtt_ms_max;
+    }
+    s["xr_voip_blocks"] = (long long)t.xr_voip;
+    if (t.xr_mos_samples)
+      s["avg_mos_lq"] = (double)t.xr_mos_lq_sum / 10.0 / t.xr_mos_samples;
+  }
+}
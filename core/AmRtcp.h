@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmRtcp.h */
+#ifndef _AmRtcp_h_
+#define _AmRtcp_h_
+
+#include "AmThread.h"
+#include "AmArg.h"
+
+#include <sys/time.h>
+#include <string>
+using std::string;
+
+struct AmRtpReceiveStats;
+
+/** RTCP packet types (RFC 3550, RFC 3611) */
+#define RTCP_SR   200
+#define RTCP_RR   201
+#define RTCP_SDES 202
+#define RTCP_BYE  203
+#define RTCP_APP  204
+#define RTCP_XR   207
+
+/** RTCP packet types in rtcp-mux: 192-223 (RFC 5761) */
+#define IS_RTCP_MUX_PT(b) (((b) >= 192) && ((b) <= 223))
+
+/**
+ * \brief RTCP reports and quality metrics of an RTP stream
+ *
+ * Parses the SR, RR and XR (VoIP metrics block, RFC 3611) received
+ * from the peer and builds the SR/RR with SDES CNAME sent for streams
+ * processed locally. The metrics are kept per stream and summed up per
+ * RTP interface (stats command get_rtcpstats).
+ */
+class AmRtcp
+{
+public:
+  /** what the peer reports about the stream it receives from us */
+  struct Metrics
+  {
+    unsigned int sr_received;
+    unsigned int rr_received;
+    unsigned int xr_received;
+    unsigned int bad_received;
+    unsigned int sent;
+
+    /** last report block */
+    bool          report;
+    unsigned char fraction_lost; // 1/256
+    int           cum_lost;
+    unsigned int  jitter;        // timestamp units
+
+    /** round trip time from LSR/DLSR (ms), -1 if unknown */
+    int           rtt_ms;
+    unsigned int  rtt_max_ms;
+
+    /** last XR VoIP metrics block (127: unavailable) */
+    bool          xr_voip;
+    unsigned char xr_loss_rate;    // 1/256
+    unsigned char xr_discard_rate; // 1/256
+    unsigned short xr_rtt_ms;
+    unsigned short xr_end_system_delay_ms;
+    unsigned char xr_r_factor;
+    unsigned char xr_mos_lq;       // *10
+    unsigned char xr_mos_cq;       // *10
+
+    Metrics();
+  };
+
+private:
+  AmMutex mut;
+
+  int rtp_if;
+  unsigned int ts_rate;
+
+  /** RTP sent (SR sender info) */
+  unsigned int sent_packets;
+  unsigned int sent_octets;
+  unsigned int sent_packets_prior;
+
+  /** received at the last report (fraction lost) */
+  unsigned int expected_prior;
+  unsigned int received_prior;
+
+  /** middle 32 bits of the NTP time of the last SR received, and when */
+  unsigned int lsr;
+  struct timeval lsr_time;
+
+  Metrics m;
+
+  void reportBlock(const unsigned char* b, bool relayed);
+  void xrBlocks(const unsigned char* p, const unsigned char* end, bool relayed);
+
+public:
+  AmRtcp();
+
+  /** RTP interface to sum up the metrics on */
+  void setInterface(int _rtp_if) { rtp_if = _rtp_if; }
+  /** RTP timestamp rate (jitter) */
+  void setTSRate(unsigned int rate) { if (rate) ts_rate = rate; }
+
+  /** account an RTP packet sent with octets payload */
+  void sent(unsigned int octets) { sent_packets++; sent_octets += octets; }
+
+  /**
+   * Parse a received compound RTCP packet.
+   * @param l_ssrc our SSRC (report blocks about other sources are ignored)
+   * @param relayed the packet is relayed: the first block is taken
+   *        whatever its SSRC, no round trip time (LSR is not ours)
+   * @return false if malformed
+   */
+  bool parse(const unsigned char* buf, unsigned int len,
+	     unsigned int l_ssrc, bool relayed);
+
+  /**
+   * Build a compound SR (if RTP has been sent since the last
+   * report) or RR, with a report block about r_ssrc if rs has
+   * received packets, and SDES CNAME.
+   * @param rtp_ts RTP timestamp of now
+   * @return length, 0 if size is too small
+   */
+  unsigned int build(unsigned char* buf, unsigned int size,
+		     unsigned int l_ssrc, unsigned int rtp_ts,
+		     const AmRtpReceiveStats& rs, unsigned int r_ssrc,
+		     const string& cname);
+
+  /**
+   * Time to the next report in ms (RFC 3550 6.2, 6.3.1): the minimum
+   * of 5 s (2.5 s for the first report) as two party audio calls are
+   * below it, randomized by [0.5,1.5]/1.21828.
+   */
+  static unsigned int interval(bool initial);
+
+  /** per stream metrics */
+  void getStats(AmArg& stats);
+
+  /** metrics summed up per RTP interface */
+  static void getTotals(AmArg& stats);
+};
+
+#endif
@@ -30,6 +30,8 @@
 #include <assert.h>
 #include "AmSession.h"
 #include "AmPlayoutBuffer.h"
+#include "AmCodecBatch.h"
+#include "AmConfig.h"
 
 AmAudioRtpFormat::AmAudioRtpFormat()
   : AmAudioFormat(-1),
@@ -98,8 +100,12 @@ AmRtpAudio::AmRtpAudio(AmSession* _s, int _if)
     /*last_ts_i(false),*/ use_default_plc(true),
     playout_buffer(NULL),
     m_playout_type(SIMPLE_PLAYOUT),
+    jb_min_delay(AmConfig::JitterBufferMinDelay),
+    jb_max_delay(AmConfig::JitterBufferMaxDelay),
+    concealed_ms(0),
     last_check(0),last_check_i(false),send_int(false),
-    last_send_ts_i(false)
+    last_send_ts_i(false),
+    batch(NULL)
 {
 #ifdef USE_SPANDSP_PLC
   plc_state = plc_init(NULL);
@@ -107,6 +113,7 @@ AmRtpAudio::AmRtpAudio(AmSession* _s, int _if)
 }
 
 AmRtpAudio::~AmRtpAudio() {
+  cancelPendingSends();
 #ifdef USE_SPANDSP_PLC
   plc_release(plc_state);
 #endif // USE_SPANDSP_PLC
@@ -219,6 +226,11 @@ int AmRtpAudio::receive(unsigned long long system_ts)
     AmAudioRtpFormat* rtp_fmt = (AmAudioRtpFormat*)fmt.get();
     unsigned long long adjusted_rtp_ts = rtp_ts;
 
+    unsigned long long ts_rate = rtp_fmt->getTSRate();
+    recv_stats.updateJitter(rtp_ts,
+			    (unsigned int)(last_recv_arrival.tv_sec * ts_rate +
+					   last_recv_arrival.tv_usec * ts_rate / 1000000));
+
     if(rtp_fmt->getRate() != rtp_fmt->getTSRate()) {
       adjusted_rtp_ts =
 	(unsigned long long)rtp_ts *
@@ -228,7 +240,7 @@ int AmRtpAudio::receive(unsigned long long system_ts)
 
     playout_buffer->write(wallclock_ts, adjusted_rtp_ts,
 			  (ShortSample*)((unsigned char *)samples),
-			  PCM16_B2S(size), begin_talk);
+			  PCM16_B2S(size), begin_talk, last_recv_seq);
 
     if(!active) {
       DBG("switching to active-mode\t(ts=%u;stream=%p)\n",
@@ -242,6 +254,9 @@ int AmRtpAudio::receive(unsigned long long system_ts)
 int AmRtpAudio::get(unsigned long long system_ts, unsigned char* buffer, 
 		    int output_sample_rate, unsigned int nb_samples)
 {
+  if (AmConfig::RtcpReports && fmt.get())
+    sendRtcpReport(system_ts, sendTS(system_ts));
+
   if (!(receiving || getPassiveMode())) return 0; // like nothing received
 
   int ret = receive(system_ts);
@@ -275,6 +290,9 @@ int AmRtpAudio::put(unsigned long long system_ts, unsigned char* buffer,
   last_send_ts_i = true;
   last_send_ts = system_ts;
 
+  if (AmConfig::RtcpReports && fmt.get())
+    sendRtcpReport(system_ts, sendTS(system_ts));
+
   if(!size){
     return 0;
   }
@@ -285,11 +303,49 @@ int AmRtpAudio::put(unsigned long long system_ts, unsigned char* buffer,
   size = resampleInput((unsigned char*)samples, size, 
 		       input_sample_rate, getSampleRate());
 
+  amci_codec_t* codec = fmt->getCodec();
+  AmCodecBatch* current_batch = AmCodecBatch::current();
+  if (current_batch && codec && codec->encode_batch) {
+    // encoded and sent with the other streams of the media processor
+    batch = current_batch;
+    batch->add(this, codec, fmt->getHCodec(), fmt->channels, getSampleRate(),
+	       sendTS(system_ts), (unsigned char*)samples, size);
+    return 0;
+  }
+
   int s = encode(size);
   if(s<=0){
     return s;
   }
 
+  return send(sendTS(system_ts),(unsigned char*)samples,s);
+}
+
+void AmRtpAudio::cancelPendingSends()
+{
+  if (batch) {
+    batch->cancel(this);
+    batch = NULL;
+  }
+}
+
+int AmRtpAudio::putEncoded(unsigned long long system_ts, unsigned char* buffer,
+			   unsigned int size)
+{
+  last_send_ts_i = true;
+  last_send_ts = system_ts;
+
+  if(!size){
+    return 0;
+  }
+
+  if (mute) return 0;
+
+  return send(sendTS(system_ts),buffer,size);
+}
+
+unsigned int AmRtpAudio::sendTS(unsigned long long system_ts)
+{
   AmAudioRtpFormat* rtp_fmt = (AmAudioRtpFormat*)fmt.get();
 
   // pre-division by 100 is important
@@ -299,7 +355,15 @@ int AmRtpAudio::put(unsigned long long system_ts, unsigned char* buffer,
     system_ts * ((unsigned long long)rtp_fmt->getTSRate() / 100)
     / (WALLCLOCK_RATE/100);
 
-  return send((unsigned int)user_ts,(unsigned char*)samples,s);
+  return (unsigned int)user_ts;
+}
+
+int AmRtpAudio::getCodecId()
+{
+  if (!fmt.get())
+    return -1;
+
+  return fmt->getCodecId();
 }
 
 void AmRtpAudio::getSdpOffer(unsigned int index, SdpMedia& offer)
@@ -333,17 +397,29 @@ int AmRtpAudio::init(const AmSdp& local,
   }
   fmt_p->setCurrentPayload(payloads[pl_it->second.index]);
   fmt.reset(fmt_p);
+  rtcp.setTSRate(fmt_p->getTSRate());
 
   fec.reset(new LowcFE(getSampleRate()));
 
+  resetPlayoutBuffer();
+  return 0;
+}
+
+void AmRtpAudio::resetPlayoutBuffer()
+{
+  if (playout_buffer.get()) {
+    concealed_ms += (unsigned long long)playout_buffer->getConcealed() * 1000
+      / playout_buffer->getSampleRate();
+  }
+
   if (m_playout_type == SIMPLE_PLAYOUT) {
     playout_buffer.reset(new AmPlayoutBuffer(this,getSampleRate()));
   } else if (m_playout_type == ADAPTIVE_PLAYOUT) {
     playout_buffer.reset(new AmAdaptivePlayout(this,getSampleRate()));
   } else {
-    playout_buffer.reset(new AmJbPlayout(this,getSampleRate()));
+    playout_buffer.reset(new AmJbPlayout(this,getSampleRate(),
+					 jb_min_delay,jb_max_delay));
   }
-  return 0;
 }
 
 unsigned int AmRtpAudio::getFrameSize()
@@ -371,6 +447,7 @@ int AmRtpAudio::setCurrentPayload(int payload)
     }
     
     this->payload = payload;
+    cancelPendingSends();
     return ((AmAudioRtpFormat*)fmt.get())->setCurrentPayload(payloads[index]);
   }
   else {
@@ -453,7 +530,7 @@ void AmRtpAudio::setPlayoutType(PlayoutType type)
 	session->lockAudio();
 	m_playout_type = type;
 	if (fmt.get())
-	  playout_buffer.reset(new AmAdaptivePlayout(this,getSampleRate()));
+	  resetPlayoutBuffer();
 	session->unlockAudio();
 	DBG("Adaptive playout buffer activated\n");
       }
@@ -461,7 +538,7 @@ void AmRtpAudio::setPlayoutType(PlayoutType type)
 	session->lockAudio();
 	m_playout_type = type;
 	if (fmt.get())
-	  playout_buffer.reset(new AmJbPlayout(this,getSampleRate()));
+	  resetPlayoutBuffer();
 	session->unlockAudio();
 	DBG("Adaptive jitter buffer activated\n");
       }
@@ -469,9 +546,49 @@ void AmRtpAudio::setPlayoutType(PlayoutType type)
 	session->lockAudio();
 	m_playout_type = type;
 	if (fmt.get())
-	  playout_buffer.reset(new AmPlayoutBuffer(this,getSampleRate()));
+	  resetPlayoutBuffer();
 	session->unlockAudio();
 	DBG("Simple playout buffer activated\n");
       }
     }
 }
+
+void AmRtpAudio::setJitterBufferDelay(unsigned int min_delay, unsigned int max_delay)
+{
+  jb_min_delay = min_delay;
+  jb_max_delay = max_delay;
+
+  if (m_playout_type == JB_PLAYOUT && playout_buffer.get()) {
+    session->lockAudio();
+    ((AmJbPlayout*)playout_buffer.get())->setDelay(min_delay, max_delay);
+    session->unlockAudio();
+  }
+}
+
+void AmRtpAudio::getStats(AmArg& stats)
+{
+  stats["received"] = (int)recv_stats.received;
+  stats["lost"] = (int)recv_stats.lost();
+  stats["reordered"] = (int)recv_stats.reordered;
+
+  AmAudioRtpFormat* rtp_fmt = (AmAudioRtpFormat*)fmt.get();
+  if (rtp_fmt && rtp_fmt->getTSRate())
+    stats["jitter_ms"] = (double)(recv_stats.jitter >> 4) * 1000.0 / rtp_fmt->getTSRate();
+
+  switch (m_playout_type) {
+  case ADAPTIVE_PLAYOUT: stats["playout"] = "adaptive"; break;
+  case JB_PLAYOUT: stats["playout"] = "jb"; break;
+  default: stats["playout"] = "simple"; break;
+  }
+
+  unsigned int plc_ms = concealed_ms;
+  if (playout_buffer.get()) {
+    unsigned int rate = playout_buffer->getSampleRate();
+    plc_ms += (unsigned long long)playout_buffer->getConcealed() * 1000 / rate;
+    stats["depth_ms"] = (int)(playout_buffer->getDepth() * 1000 / rate);
+    playout_buffer->getStats(stats);
+  }
+  stats["concealed_ms"] = (int)plc_ms;
+
+  getRtcpStats(stats["rtcp"]);
+}
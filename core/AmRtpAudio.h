@@ -38,6 +38,8 @@
 #endif
 
 class AmPlayoutBuffer;
+class AmArg;
+class AmCodecBatch;
 
 enum PlayoutType {
   ADAPTIVE_PLAYOUT,
@@ -100,6 +102,16 @@ class AmRtpAudio: public AmRtpStream, public AmAudio, public AmPLCBuffer
   PlayoutType m_playout_type;
   auto_ptr<AmPlayoutBuffer> playout_buffer;
 
+  /** playout delay limits for JB_PLAYOUT (ms) */
+  unsigned int jb_min_delay;
+  unsigned int jb_max_delay;
+
+  /** concealed by previous playout buffers (ms) */
+  unsigned int concealed_ms;
+
+  /** (re)create the playout buffer of m_playout_type */
+  void resetPlayoutBuffer();
+
 #ifdef USE_SPANDSP_PLC
     plc_state_t* plc_state;
 #else 
@@ -115,9 +127,19 @@ class AmRtpAudio: public AmRtpStream, public AmAudio, public AmPLCBuffer
   unsigned long long last_send_ts;
   bool               last_send_ts_i;
 
+  /** batch a frame is queued to (see AmCodecBatch) */
+  friend class AmCodecBatch;
+  AmCodecBatch*      batch;
+
+  /** drop frames queued for batch encoding (codec or stream changes) */
+  void cancelPendingSends();
+
   //
   // Default packet loss concealment functions
   //
+  /** RTP timestamp for the frame sent at system_ts */
+  unsigned int sendTS(unsigned long long system_ts);
+
   unsigned int default_plc(unsigned char* out_buf,
 			   unsigned int   size,
 			   unsigned int   channels,
@@ -145,6 +167,13 @@ public:
   int put(unsigned long long system_ts, unsigned char* buffer, 
 	  int input_sample_rate, unsigned int size);
 
+  /** send a frame already encoded with the current payload */
+  int putEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 unsigned int size);
+
+  /** @return codec id of the current payload, -1 if none */
+  int getCodecId();
+
   unsigned int bytes2samples(unsigned int) const;
 
   // AmRtpStream interface
@@ -156,6 +185,16 @@ public:
 
   void setPlayoutType(PlayoutType type);
 
+  /** set the playout delay limits (ms) of the jitter buffer (JB_PLAYOUT) */
+  void setJitterBufferDelay(unsigned int min_delay, unsigned int max_delay);
+
+  /**
+   * Get the receive statistics: packets, loss, jitter, concealment
+   * and playout buffer depth. Not locked, call from the media
+   * processing or with the session's audio locked.
+   */
+  void getStats(AmArg& stats);
+
 
   // AmPLCBuffer interface
   void add_to_history(int16_t *buffer, unsigned int size);
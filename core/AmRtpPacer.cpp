@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRtpPacer.h"
+#include "AmRtpStream.h"
+#include "AmConfig.h"
+#include "AmArg.h"
+#include "log.h"
+#include "sip/ip_util.h"
+#include "sip/raw_sender.h"
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+
+#ifdef __linux__
+#define HAVE_SENDMMSG
+#endif
+
+/* packets per sendmmsg call */
+#define RTP_PACER_MMSG 64
+
+/* time kept free before the next tick in us */
+#define RTP_PACER_GUARD_US 1000
+
+/* do not sleep for less than this (us) */
+#define RTP_PACER_MIN_SLEEP_US 100
+
+__thread AmRtpPacer* AmRtpPacer::thread_pacer = NULL;
+
+AmRtpPacer::IfStats* AmRtpPacer::if_stats = NULL;
+unsigned int         AmRtpPacer::num_ifs = 0;
+bool                 AmRtpPacer::enabled = false;
+
+AmRtpPacer::AmRtpPacer()
+  : num_packets(0)
+{
+}
+
+AmRtpPacer::~AmRtpPacer()
+{
+  for (unsigned int i = 0; i < packets.size(); i++)
+    delete packets[i];
+}
+
+void AmRtpPacer::init()
+{
+  num_ifs = AmConfig::RTP_Ifs.size();
+  if_stats = new IfStats[num_ifs];
+
+  for (unsigned int i = 0; i < num_ifs; i++) {
+    if (AmConfig::RTP_Ifs[i].Pacing) {
+      INFO("pacing RTP on interface '%s' (%u slots per tick)\n",
+	   AmConfig::RTP_Ifs[i].name.c_str(), AmConfig::RtpPacingSlots);
+      enabled = true;
+    }
+  }
+}
+
+void AmRtpPacer::setCurrent()
+{
+  thread_pacer = this;
+
+  // the packets of a slot go out with one sendmmsg
+  if (AmConfig::UseRawSockets)
+    raw_sender::batchThread();
+}
+
+bool AmRtpPacer::add(AmRtpStream* stream, int sd, int l_if, unsigned int sys_if_idx,
+		     raw_udp4_tmpl* tmpl, unsigned char tos,
+		     const sockaddr_storage* l_saddr,
+		     const sockaddr_storage* r_saddr,
+		     const unsigned char* buf, unsigned int len)
+{
+  if (len > RTP_PACER_MAX_LEN)
+    return false;
+
+  IfStats* st = (unsigned int)l_if < num_ifs ? &if_stats[l_if] : NULL;
+
+  AmLock l(packets_mut);
+  if (num_packets >= AmConfig::RtpPacingQueue) {
+    if (st) st->dropped.inc();
+    return true;
+  }
+
+  if (num_packets == packets.size())
+    packets.push_back(new Packet());
+
+  Packet* p = packets[num_packets++];
+  p->stream = stream;
+  p->sd = sd;
+  p->l_if = l_if;
+  p->sys_if_idx = sys_if_idx;
+  p->tmpl = tmpl;
+  p->tos = tos;
+  memcpy(&p->l_saddr, l_saddr, sizeof(sockaddr_storage));
+  memcpy(&p->r_saddr, r_saddr, sizeof(sockaddr_storage));
+  memcpy(p->buf, buf, len);
+  p->len = len;
+
+  if (st) {
+    unsigned int depth = st->depth.inc();
+    unsigned int max;
+    while ((max = st->max_depth.get()) < depth &&
+	   !st->max_depth.cas(max, depth));
+  }
+
+  return true;
+}
+
+void AmRtpPacer::cancel(AmRtpStream* stream)
+{
+  packets_mut.lock();
+  for (unsigned int i = 0; i < num_packets; i++) {
+    Packet* p = packets[i];
+    if (p->stream != stream)
+      continue;
+    p->stream = NULL;
+    if ((unsigned int)p->l_if < num_ifs)
+      if_stats[p->l_if].depth.dec();
+  }
+  packets_mut.unlock();
+}
+
+void AmRtpPacer::sent(const Packet* p, bool ok)
+{
+  if ((unsigned int)p->l_if >= num_ifs)
+    return;
+
+  IfStats& st = if_stats[p->l_if];
+  st.depth.dec();
+  if (ok)
+    st.sent.inc();
+  else
+    st.errors.inc();
+}
+
+/** order of the packets of a slot for grouping them by socket */
+struct PacketSdLess
+{
+  const std::vector<int>& sds;
+  PacketSdLess(const std::vector<int>& sds) : sds(sds) {}
+  bool operator()(unsigned int a, unsigned int b) const {
+    return sds[a] < sds[b];
+  }
+};
+
+void AmRtpPacer::sendGroup(unsigned int* idx, unsigned int n)
+{
+  int sd = packets[idx[0]]->sd;
+
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr msgs[RTP_PACER_MMSG];
+#else
+  struct msghdr  msgs[RTP_PACER_MMSG];
+#endif
+  struct iovec   iov[RTP_PACER_MMSG];
+  union {
+    char cmsg4_buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    char cmsg6_buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+  } cmsg_buf[RTP_PACER_MMSG];
+
+  while (n) {
+    unsigned int cnt = n < RTP_PACER_MMSG ? n : RTP_PACER_MMSG;
+
+    memset(msgs, 0, cnt * sizeof(msgs[0]));
+    for (unsigned int i = 0; i < cnt; i++) {
+      Packet* p = packets[idx[i]];
+#ifdef HAVE_SENDMMSG
+      struct msghdr* m = &msgs[i].msg_hdr;
+#else
+      struct msghdr* m = &msgs[i];
+#endif
+      iov[i].iov_base = p->buf;
+      iov[i].iov_len = p->len;
+      m->msg_iov = &iov[i];
+      m->msg_iovlen = 1;
+      m->msg_name = &p->r_saddr;
+      m->msg_namelen = SA_len(&p->r_saddr);
+
+      if (p->sys_if_idx && AmConfig::ForceOutboundIf) {
+	// see AmRtpPacket::sendmsg()
+	memset(&cmsg_buf[i], 0, sizeof(cmsg_buf[i]));
+	m->msg_control = &cmsg_buf[i];
+	m->msg_controllen = sizeof(cmsg_buf[i]);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(m);
+	if (p->r_saddr.ss_family == AF_INET6) {
+	  cmsg->cmsg_level = IPPROTO_IPV6;
+	  cmsg->cmsg_type = IPV6_PKTINFO;
+	  cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+	  ((struct in6_pktinfo*)CMSG_DATA(cmsg))->ipi6_ifindex = p->sys_if_idx;
+	}
+	else {
+	  cmsg->cmsg_level = IPPROTO_IP;
+	  cmsg->cmsg_type = IP_PKTINFO;
+	  cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+	  ((struct in_pktinfo*)CMSG_DATA(cmsg))->ipi_ifindex = p->sys_if_idx;
+	}
+	m->msg_controllen = cmsg->cmsg_len;
+      }
+    }
+
+    unsigned int done = 0;
+    while (done < cnt) {
+#ifdef HAVE_SENDMMSG
+      int res = sendmmsg(sd, &msgs[done], cnt - done, 0);
+#else
+      int res = ::sendmsg(sd, &msgs[done], 0) < 0 ? -1 : 1;
+#endif
+      if (res <= 0) {
+	// skip the packet that failed
+	ERROR("while sending RTP packet: %s\n", strerror(errno));
+	sent(packets[idx[done]], false);
+	done++;
+	continue;
+      }
+
+      for (int i = 0; i < res; i++)
+	sent(packets[idx[done + i]], true);
+      done += res;
+    }
+
+    idx += cnt;
+    n -= cnt;
+  }
+}
+
+void AmRtpPacer::sendRange(unsigned int begin, unsigned int end)
+{
+  AmLock l(packets_mut);
+
+  order.clear();
+  for (unsigned int i = begin; i < end; i++) {
+    Packet* p = packets[i];
+    if (!p->stream)
+      continue; // cancelled
+
+    if (p->sys_if_idx && AmConfig::UseRawSockets) {
+      bool ok = raw_sender::send((const char*)p->buf, p->len, p->sys_if_idx,
+				 &p->l_saddr, &p->r_saddr, p->tmpl, p->tos) >= 0;
+      sent(p, ok);
+      continue;
+    }
+    order.push_back(i);
+  }
+
+  if (AmConfig::UseRawSockets)
+    raw_sender::flush();
+
+  if (order.empty())
+    return;
+
+  // stable: the packets of a stream stay in order
+  order_sd.resize(end);
+  for (unsigned int i = 0; i < order.size(); i++)
+    order_sd[order[i]] = packets[order[i]]->sd;
+  std::stable_sort(order.begin(), order.end(), PacketSdLess(order_sd));
+
+  unsigned int first = 0;
+  for (unsigned int i = 1; i <= order.size(); i++) {
+    if (i == order.size() || order_sd[order[i]] != order_sd[order[first]]) {
+      sendGroup(&order[first], i - first);
+      first = i;
+    }
+  }
+}
+
+static void sleep_until(const struct timeval& t)
+{
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  if (!timercmp(&now, &t, <))
+    return;
+
+  timersub(&t, &now, &diff);
+  if (!diff.tv_sec && diff.tv_usec < RTP_PACER_MIN_SLEEP_US)
+    return;
+
+  struct timespec ts, rem;
+  ts.tv_sec = diff.tv_sec;
+  ts.tv_nsec = diff.tv_usec * 1000;
+  nanosleep(&ts, &rem);
+}
+
+void AmRtpPacer::flush(const struct timeval& tick_start,
+		       const struct timeval& tick)
+{
+  packets_mut.lock();
+  unsigned int n = num_packets;
+  packets_mut.unlock();
+
+  if (!n) {
+    // packets batched by raw_sender without pacing
+    if (AmConfig::UseRawSockets)
+      raw_sender::flush();
+    return;
+  }
+
+  struct timeval start, span, deadline;
+  gettimeofday(&start, NULL);
+  timeradd(&tick_start, &tick, &deadline);
+  timersub(&deadline, &start, &span);
+
+  long span_us = span.tv_sec * 1000000 + span.tv_usec - RTP_PACER_GUARD_US;
+  unsigned int slots = AmConfig::RtpPacingSlots;
+  if (slots > n) slots = n;
+  if (span_us <= 0) slots = 1;
+
+  for (unsigned int k = 0; k < slots; k++) {
+    if (k) {
+      long offset = span_us * k / slots;
+      struct timeval t, off;
+      off.tv_sec = offset / 1000000;
+      off.tv_usec = offset % 1000000;
+      timeradd(&start, &off, &t);
+      sleep_until(t);
+    }
+    sendRange(n * k / slots, n * (k + 1) / slots);
+  }
+
+  // sent; the streams may be destroyed without cancelling
+  packets_mut.lock();
+  for (unsigned int i = 0; i < num_packets; i++) {
+    if (packets[i]->stream)
+      packets[i]->stream->pacer = NULL;
+  }
+  num_packets = 0;
+  packets_mut.unlock();
+}
+
+void AmRtpPacer::getStats(AmArg& stats)
+{
+  for (unsigned int i = 0; i < num_ifs; i++) {
+    if (!AmConfig::RTP_Ifs[i].Pacing)
+      continue;
+
+    AmArg& st = stats[AmConfig::RTP_Ifs[i].name];
+    st["depth"] = (int)if_stats[i].depth.get();
+    st["max_depth"] = (int)if_stats[i].max_depth.get();
+    st["sent"] = (long long)if_stats[i].sent.get();
+    st["dropped"] = (long long)if_stats[i].dropped.get();
+    st["errors"] = (long long)if_stats[i].errors.get();
+  }
+}
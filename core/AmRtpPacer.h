@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/** @file AmRtpPacer.h */
+#ifndef _AmRtpPacer_h_
+#define _AmRtpPacer_h_
+
+#include "AmThread.h"
+#include "atomic_types.h"
+
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <vector>
+
+class AmRtpStream;
+class AmArg;
+struct raw_udp4_tmpl;
+
+/** biggest packet queued, bigger ones are sent directly */
+#define RTP_PACER_MAX_LEN 1500
+
+/**
+ * \brief spreads the RTP packets of a media processor thread over its tick
+ *
+ * All sessions of a media processor thread write their streams at the
+ * start of the 10ms tick, so without pacing their packets leave in one
+ * burst. For RTP interfaces with rtp_pacing=yes, the streams only queue
+ * their packets into the pacer of the thread. After processing the
+ * sessions, the thread sends the queue in rtp_pacing_slots parts evenly
+ * spread over the rest of the tick; the packets of a part are sent with
+ * sendmmsg per socket (raw_sender batches with use_raw_sockets).
+ *
+ * If more than rtp_pacing_queue packets are queued in one tick, the
+ * rest is dropped.
+ */
+class AmRtpPacer
+{
+  struct Packet {
+    AmRtpStream*     stream;
+    int              sd;
+    int              l_if;
+    unsigned int     sys_if_idx;
+    raw_udp4_tmpl*   tmpl;
+    unsigned char    tos;
+    sockaddr_storage l_saddr;
+    sockaddr_storage r_saddr;
+    unsigned int     len;
+    unsigned char    buf[RTP_PACER_MAX_LEN];
+  };
+
+  struct IfStats {
+    atomic_int   depth;
+    atomic_int   max_depth;
+    atomic_int64 sent;
+    atomic_int64 dropped;
+    atomic_int64 errors;
+  };
+
+  /* packets[0..num_packets) are queued, the rest is kept for reuse */
+  std::vector<Packet*> packets;
+  unsigned int num_packets;
+
+  /* held while adding or sending, so that streams can be cancelled
+     from other threads (see cancel()) */
+  AmMutex packets_mut;
+
+  /* packets of one slot grouped by socket */
+  std::vector<unsigned int> order;
+  std::vector<int>          order_sd;
+
+  static __thread AmRtpPacer* thread_pacer;
+
+  static IfStats*     if_stats;
+  static unsigned int num_ifs;
+  static bool         enabled;
+
+  void sendRange(unsigned int begin, unsigned int end);
+  void sendGroup(unsigned int* idx, unsigned int n);
+  void sent(const Packet* p, bool ok);
+
+public:
+  AmRtpPacer();
+  ~AmRtpPacer();
+
+  /** set up the statistics of the RTP interfaces (after the configuration) */
+  static void init();
+
+  /** any RTP interface with pacing? */
+  static bool isEnabled() { return enabled; }
+
+  /** pacer of the calling thread, NULL if not pacing */
+  static AmRtpPacer* current() { return thread_pacer; }
+
+  /** make this the pacer of the calling thread */
+  void setCurrent();
+
+  /** queue a packet of the stream (false: too big, send it directly) */
+  bool add(AmRtpStream* stream, int sd, int l_if, unsigned int sys_if_idx,
+	   raw_udp4_tmpl* tmpl, unsigned char tos,
+	   const sockaddr_storage* l_saddr,
+	   const sockaddr_storage* r_saddr,
+	   const unsigned char* buf, unsigned int len);
+
+  /** drop the packets of a stream (destroyed or closing its sockets) */
+  void cancel(AmRtpStream* stream);
+
+  /**
+   * Send the queued packets, spread over the rest of the tick which
+   * started at tick_start (the media processor's next_tick before it
+   * is advanced).
+   */
+  void flush(const struct timeval& tick_start, const struct timeval& tick);
+
+  /** queue depth, sent/dropped packets and errors per RTP interface */
+  static void getStats(AmArg& stats);
+};
+
+#endif
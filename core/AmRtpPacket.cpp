@@ -251,10 +251,12 @@ int AmRtpPacket::sendmsg(int sd, unsigned int sys_if_idx)
 }
 
 int AmRtpPacket::send(int sd, unsigned int sys_if_idx,
-		      sockaddr_storage* l_saddr)
+		      sockaddr_storage* l_saddr, raw_udp4_tmpl* tmpl,
+		      unsigned char tos)
 {
   if(sys_if_idx && AmConfig::UseRawSockets) {
-    return raw_sender::send((char*)buffer,b_size,sys_if_idx,l_saddr,&addr);
+    return raw_sender::send((char*)buffer,b_size,sys_if_idx,l_saddr,&addr,
+			    tmpl,tos);
   }
 
   if(sys_if_idx && AmConfig::ForceOutboundIf) {
@@ -31,6 +31,9 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <netinet/in.h>
+#include <stddef.h>
+
+struct raw_udp4_tmpl;
 
 class AmRtpPacketTracer;
 class msg_logger;
@@ -69,7 +72,9 @@ public:
   // returns -1 if error, else 0
   int compile_raw(unsigned char* data_buf, unsigned int size);
 
-  int send(int sd, unsigned int sys_if_idx, sockaddr_storage* l_saddr);
+  /** tmpl: prebuilt headers for raw sockets (may be NULL), tos: IP TOS */
+  int send(int sd, unsigned int sys_if_idx, sockaddr_storage* l_saddr,
+	   raw_udp4_tmpl* tmpl = NULL, unsigned char tos = 0);
   int recv(int sd);
 
   int parse();
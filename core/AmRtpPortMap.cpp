@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRtpPortMap.h"
+#include "AmConfig.h"
+#include "AmRtpReceiver.h"
+#include "log.h"
+#include "sip/ip_util.h"
+
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define BITS_PER_WORD (sizeof(unsigned long) * 8)
+
+/** interval for filling the pools if nobody wakes us up (ms) */
+#define POOL_FILL_INTERVAL 500
+
+static unsigned long long now_ms()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (unsigned long long)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static bool same_ip(const struct sockaddr_storage* a, const struct sockaddr_storage* b)
+{
+  if (a->ss_family != b->ss_family)
+    return false;
+
+  if (a->ss_family == AF_INET)
+    return ((const sockaddr_in*)a)->sin_addr.s_addr ==
+      ((const sockaddr_in*)b)->sin_addr.s_addr;
+
+  return !memcmp(&((const sockaddr_in6*)a)->sin6_addr,
+		 &((const sockaddr_in6*)b)->sin6_addr, sizeof(struct in6_addr));
+}
+
+AmRtpPortMap::AmRtpPortMap(unsigned int low_port, unsigned int high_port,
+			   unsigned int quarantine_ms)
+  : low((low_port + 1) & ~1), pairs(0), next(0),
+    quarantine_ms(quarantine_ms), n_used(0),
+    pool_addr_set(false), pool_size(0),
+    allocated(0), alloc_failed(0), bind_failed(0), pool_taken(0)
+{
+  if (high_port > low)
+    pairs = (high_port - low + 1) / 2;
+
+  // bits beyond the last pair are always 'used'
+  used.assign((pairs + BITS_PER_WORD - 1) / BITS_PER_WORD + 1, ~0UL);
+  for (unsigned int i = 0; i < pairs; i++)
+    used[i / BITS_PER_WORD] &= ~(1UL << (i % BITS_PER_WORD));
+
+  memset(&pool_addr, 0, sizeof(pool_addr));
+  memset(&shared_addr, 0, sizeof(shared_addr));
+}
+
+AmRtpPortMap::~AmRtpPortMap()
+{
+  clearPool();
+  clearShared();
+}
+
+void AmRtpPortMap::setUsed(unsigned int idx, bool u)
+{
+  if (u)
+    used[idx / BITS_PER_WORD] |= 1UL << (idx % BITS_PER_WORD);
+  else
+    used[idx / BITS_PER_WORD] &= ~(1UL << (idx % BITS_PER_WORD));
+}
+
+void AmRtpPortMap::expireQuarantine()
+{
+  if (quarantine.empty())
+    return;
+
+  // all have the same quarantine time, i.e. the oldest are in front
+  unsigned long long now = now_ms();
+  while (!quarantine.empty() && quarantine.front().until <= now) {
+    setUsed(quarantine.front().idx, false);
+    n_used--;
+    quarantine.pop_front();
+  }
+}
+
+int AmRtpPortMap::findFree()
+{
+  // round robin: start after the last allocated pair
+  unsigned int words = used.size();
+  unsigned int w = next / BITS_PER_WORD;
+  unsigned long mask = ~0UL << (next % BITS_PER_WORD);
+
+  for (unsigned int i = 0; i <= words; i++) {
+    unsigned long free_bits = ~used[w] & mask;
+    if (free_bits)
+      return w * BITS_PER_WORD + __builtin_ctzl(free_bits);
+
+    mask = ~0UL;
+    if (++w == words)
+      w = 0;
+  }
+
+  return -1;
+}
+
+unsigned short AmRtpPortMap::alloc()
+{
+  AmLock l(mut);
+
+  expireQuarantine();
+
+  int idx = findFree();
+  if (idx < 0) {
+    alloc_failed++;
+    return 0;
+  }
+
+  setUsed(idx, true);
+  n_used++;
+  allocated++;
+  next = idx + 1 < (int)pairs ? idx + 1 : 0;
+
+  return low + 2 * idx;
+}
+
+void AmRtpPortMap::release(unsigned short port, bool failed)
+{
+  if (port < low || port >= low + 2 * pairs) {
+    ERROR("releasing RTP port %u outside of %u-%u\n",
+	  port, low, low + 2 * pairs - 1);
+    return;
+  }
+
+  AmLock l(mut);
+
+  Quarantined q;
+  q.idx = (port - low) / 2;
+  q.until = now_ms() + quarantine_ms;
+  quarantine.push_back(q);
+
+  if (failed)
+    bind_failed++;
+}
+
+int AmRtpPortMap::bindPair(const struct sockaddr_storage* addr, unsigned short port,
+			   int& rtp_sd, int& rtcp_sd)
+{
+  struct sockaddr_storage a;
+  int true_opt = 1;
+  int err;
+
+  rtp_sd = rtcp_sd = -1;
+  memcpy(&a, addr, sizeof(a));
+
+  if ((rtp_sd = socket(a.ss_family, SOCK_DGRAM, 0)) == -1 ||
+      (rtcp_sd = socket(a.ss_family, SOCK_DGRAM, 0)) == -1)
+    goto error;
+
+  if (ioctl(rtp_sd, FIONBIO, &true_opt) == -1 ||
+      ioctl(rtcp_sd, FIONBIO, &true_opt) == -1)
+    goto error;
+
+  am_set_port(&a, port + 1);
+  if (bind(rtcp_sd, (const struct sockaddr*)&a, SA_len(&a)))
+    goto error;
+
+  am_set_port(&a, port);
+  if (bind(rtp_sd, (const struct sockaddr*)&a, SA_len(&a)))
+    goto error;
+
+  if (setsockopt(rtp_sd, SOL_SOCKET, SO_REUSEADDR,
+		 (void*)&true_opt, sizeof(true_opt)) == -1)
+    goto error;
+
+  return 0;
+
+ error:
+  err = errno;
+  if (rtp_sd != -1) close(rtp_sd);
+  if (rtcp_sd != -1) close(rtcp_sd);
+  rtp_sd = rtcp_sd = -1;
+  errno = err;
+  return -1;
+}
+
+void AmRtpPortMap::setPool(const string& ip, unsigned int size)
+{
+  AmLock l(mut);
+
+  pool_addr_set = !ip.empty() && am_inet_pton(ip.c_str(), &pool_addr);
+  pool_size = pool_addr_set ? size : 0;
+}
+
+bool AmRtpPortMap::take(const struct sockaddr_storage* addr, AmRtpSocketPair& p)
+{
+  bool empty;
+  {
+    AmLock l(mut);
+
+    if (pool.empty() || !same_ip(addr, &pool_addr))
+      return false;
+
+    p = pool.back();
+    pool.pop_back();
+    pool_taken++;
+    empty = pool.size() < pool_size / 2 + 1;
+  }
+
+  if (empty)
+    AmRtpSocketPool::instance()->wakeup();
+
+  return true;
+}
+
+void AmRtpPortMap::fillPool()
+{
+  struct sockaddr_storage addr;
+  unsigned int missing;
+
+  mut.lock();
+  missing = pool_size > pool.size() ? pool_size - pool.size() : 0;
+  memcpy(&addr, &pool_addr, sizeof(addr));
+  mut.unlock();
+
+  // bind without holding the lock: alloc() is not blocked meanwhile
+  for (; missing; missing--) {
+    AmRtpSocketPair p;
+
+    if (!(p.port = alloc()))
+      break;
+
+    if (bindPair(&addr, p.port, p.rtp_sd, p.rtcp_sd)) {
+      DBG("bind %u: %s\n", p.port, strerror(errno));
+      release(p.port, true);
+      continue;
+    }
+
+    AmLock l(mut);
+    pool.push_back(p);
+  }
+}
+
+void AmRtpPortMap::clearPool()
+{
+  std::vector<AmRtpSocketPair> p;
+
+  mut.lock();
+  p.swap(pool);
+  mut.unlock();
+
+  for (std::vector<AmRtpSocketPair>::iterator it = p.begin(); it != p.end(); it++) {
+    close(it->rtp_sd);
+    close(it->rtcp_sd);
+    release(it->port);
+  }
+}
+
+void AmRtpPortMap::setShared(const string& ip, unsigned int num)
+{
+  struct sockaddr_storage addr;
+  if (ip.empty() || !am_inet_pton(ip.c_str(), &addr)) {
+    ERROR("no valid IP for shared RTP ports ('%s')\n", ip.c_str());
+    return;
+  }
+
+  std::vector<SharedPair> pairs;
+  while (pairs.size() < num) {
+    unsigned short port = alloc();
+    if (!port) {
+      ERROR("no free RTP ports for %u shared pairs on %s\n", num, ip.c_str());
+      break;
+    }
+
+    int rtp_sd, rtcp_sd;
+    if (bindPair(&addr, port, rtp_sd, rtcp_sd)) {
+      DBG("bind %u: %s\n", port, strerror(errno));
+      release(port, true);
+      continue;
+    }
+
+    SharedPair p;
+    p.rtp = new AmRtpSharedSocket(rtp_sd, port, false);
+    p.rtcp = new AmRtpSharedSocket(rtcp_sd, port + 1, true);
+    AmRtpReceiver::instance()->addSharedSocket(p.rtp);
+    AmRtpReceiver::instance()->addSharedSocket(p.rtcp);
+    pairs.push_back(p);
+  }
+
+  AmLock l(mut);
+  memcpy(&shared_addr, &addr, sizeof(addr));
+  shared.insert(shared.end(), pairs.begin(), pairs.end());
+}
+
+bool AmRtpPortMap::getShared(const struct sockaddr_storage* addr,
+			     AmRtpSharedSocket*& rtp, AmRtpSharedSocket*& rtcp)
+{
+  AmLock l(mut);
+
+  if (shared.empty() || !same_ip(addr, &shared_addr))
+    return false;
+
+  unsigned int best = 0, best_size = shared[0].rtp->size();
+  for (unsigned int i = 1; i < shared.size() && best_size; i++) {
+    unsigned int size = shared[i].rtp->size();
+    if (size < best_size) {
+      best = i;
+      best_size = size;
+    }
+  }
+
+  rtp = shared[best].rtp;
+  rtcp = shared[best].rtcp;
+  return true;
+}
+
+void AmRtpPortMap::clearShared()
+{
+  std::vector<SharedPair> p;
+
+  mut.lock();
+  p.swap(shared);
+  mut.unlock();
+
+  for (std::vector<SharedPair>::iterator it = p.begin(); it != p.end(); it++) {
+    if (AmRtpReceiver::haveInstance()) {
+      AmRtpReceiver::instance()->removeStream(it->rtp->getSd());
+      AmRtpReceiver::instance()->removeStream(it->rtcp->getSd());
+    }
+    close(it->rtp->getSd());
+    close(it->rtcp->getSd());
+    release(it->rtp->getPort());
+    delete it->rtp;
+    delete it->rtcp;
+  }
+}
+
+void AmRtpPortMap::getStats(AmArg& stats)
+{
+  AmLock l(mut);
+
+  stats["low_port"] = (int)low;
+  stats["pairs"] = (int)pairs;
+  stats["used"] = (int)(n_used - quarantine.size());
+  stats["quarantined"] = (int)quarantine.size();
+  stats["pooled"] = (int)pool.size();
+  stats["allocated"] = (long long)allocated;
+  stats["alloc_failed"] = (long long)alloc_failed;
+  stats["bind_failed"] = (long long)bind_failed;
+  stats["pool_taken"] = (long long)pool_taken;
+
+  if (!shared.empty()) {
+    AmArg& sh = stats["shared"];
+    sh.assertArray();
+    for (unsigned int i = 0; i < shared.size(); i++) {
+      AmArg rtp, rtcp;
+      shared[i].rtp->getStats(rtp);
+      shared[i].rtcp->getStats(rtcp);
+      sh.push(rtp);
+      sh.push(rtcp);
+    }
+  }
+}
+
+_AmRtpSocketPool::_AmRtpSocketPool()
+  : fill(false), stop_requested(false)
+{
+}
+
+_AmRtpSocketPool::~_AmRtpSocketPool()
+{
+}
+
+void _AmRtpSocketPool::init()
+{
+  if (AmConfig::RtpSharedPorts) {
+    for (unsigned int i = 0; i < AmConfig::RTP_Ifs.size(); i++) {
+      AmConfig::RTP_Ifs[i].getPortMap()->setShared(AmConfig::RTP_Ifs[i].LocalIP,
+						   AmConfig::RtpSharedPorts);
+    }
+    DBG("%u RTP port pairs per interface shared by the streams\n",
+	AmConfig::RtpSharedPorts);
+  }
+
+  if (!AmConfig::RtpSocketPool)
+    return;
+
+  for (unsigned int i = 0; i < AmConfig::RTP_Ifs.size(); i++) {
+    AmConfig::RTP_Ifs[i].getPortMap()->setPool(AmConfig::RTP_Ifs[i].LocalIP,
+					       AmConfig::RtpSocketPool);
+  }
+
+  DBG("keeping %u bound RTP socket pairs per interface\n",
+      AmConfig::RtpSocketPool);
+  start();
+}
+
+void _AmRtpSocketPool::run()
+{
+  while (!stop_requested.get()) {
+    fill.set(false);
+    for (unsigned int i = 0; i < AmConfig::RTP_Ifs.size(); i++)
+      AmConfig::RTP_Ifs[i].getPortMap()->fillPool();
+
+    fill.wait_for_to(POOL_FILL_INTERVAL);
+  }
+}
+
+void _AmRtpSocketPool::on_stop()
+{
+  stop_requested.set(true);
+  fill.set(true);
+}
+
+void _AmRtpSocketPool::dispose()
+{
+  stop();
+  while (!is_stopped())
+    usleep(10000); // 10ms
+
+  for (unsigned int i = 0; i < AmConfig::RTP_Ifs.size(); i++) {
+    AmConfig::RTP_Ifs[i].getPortMap()->clearPool();
+    AmConfig::RTP_Ifs[i].getPortMap()->clearShared();
+  }
+}
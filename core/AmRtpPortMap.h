@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmRtpPortMap.h */
+#ifndef _AmRtpPortMap_h_
+#define _AmRtpPortMap_h_
+
+#include "AmThread.h"
+#include "AmArg.h"
+#include "singleton.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <deque>
+#include <vector>
+#include <string>
+using std::string;
+
+class AmRtpSharedSocket;
+
+/** bound RTP/RTCP socket pair */
+struct AmRtpSocketPair
+{
+  unsigned short port; // RTP port, RTCP is port+1
+  int rtp_sd;
+  int rtcp_sd;
+};
+
+/**
+ * \brief RTP/RTCP port pairs of an RTP interface
+ *
+ * The pairs in use are tracked in a bitmap, so a free pair is found
+ * without trying to bind busy ports. Released pairs are quarantined
+ * for rtp_port_quarantine seconds, so that late packets of a call do
+ * not reach the next user of the ports; pairs that can not be bound
+ * (used by another process) are quarantined as well.
+ *
+ * With rtp_socket_pool, a number of socket pairs bound to the
+ * interface's address is kept ready (filled by AmRtpSocketPool), so
+ * that streams get their sockets without any system call.
+ *
+ * With rtp_shared_ports, streams use one of a few socket pairs shared
+ * by all streams of the interface (see AmRtpSharedSocket) instead.
+ */
+class AmRtpPortMap
+{
+  AmMutex mut;
+
+  unsigned int low;   // first RTP port (even)
+  unsigned int pairs; // number of RTP/RTCP port pairs
+  std::vector<unsigned long> used;
+  unsigned int next;  // where the search for a free pair starts
+
+  struct Quarantined {
+    unsigned int idx;
+    unsigned long long until; // ms
+  };
+  std::deque<Quarantined> quarantine;
+  unsigned int quarantine_ms;
+
+  unsigned int n_used; // incl. quarantined
+
+  /* bound socket pairs ready to be taken */
+  struct sockaddr_storage pool_addr;
+  bool pool_addr_set;
+  std::vector<AmRtpSocketPair> pool;
+  unsigned int pool_size;
+
+  /* socket pairs shared by the streams */
+  struct SharedPair {
+    AmRtpSharedSocket* rtp;
+    AmRtpSharedSocket* rtcp;
+  };
+  struct sockaddr_storage shared_addr;
+  std::vector<SharedPair> shared;
+
+  /* statistics */
+  unsigned long long allocated;
+  unsigned long long alloc_failed;
+  unsigned long long bind_failed;
+  unsigned long long pool_taken;
+
+  int findFree();
+  void expireQuarantine();
+  void setUsed(unsigned int idx, bool u);
+
+public:
+  /**
+   * @param low_port, high_port port range (RTP and RTCP)
+   * @param quarantine_ms time a released pair is not used again
+   */
+  AmRtpPortMap(unsigned int low_port, unsigned int high_port,
+	       unsigned int quarantine_ms);
+  ~AmRtpPortMap();
+
+  /** @return RTP port of a free pair, 0 if all are in use */
+  unsigned short alloc();
+
+  /**
+   * Return a pair from alloc() (or taken from the pool).
+   * @param bind_failed the pair could not be bound
+   */
+  void release(unsigned short port, bool bind_failed = false);
+
+  /** keep pool_size pairs bound to ip ready (0: no pool) */
+  void setPool(const string& ip, unsigned int pool_size);
+
+  /**
+   * Take a bound socket pair from the pool if
+   * its address matches addr (port ignored).
+   * @return false if none is available
+   */
+  bool take(const struct sockaddr_storage* addr, AmRtpSocketPair& p);
+
+  /** bind pairs until the pool is full (AmRtpSocketPool thread) */
+  void fillPool();
+
+  /** close the pooled sockets */
+  void clearPool();
+
+  /**
+   * Bind num pairs to ip which are shared by the streams
+   * and add them to the RTP receiver.
+   */
+  void setShared(const string& ip, unsigned int num);
+
+  /**
+   * Get the shared pair with the fewest streams
+   * if its address matches addr (port ignored).
+   * @return false if there is none
+   */
+  bool getShared(const struct sockaddr_storage* addr,
+		 AmRtpSharedSocket*& rtp, AmRtpSharedSocket*& rtcp);
+
+  /** remove the shared pairs from the RTP receiver and close them */
+  void clearShared();
+
+  /** pairs in use/quarantined/pooled, failures */
+  void getStats(AmArg& stats);
+
+  /**
+   * Create non-blocking UDP sockets and bind them to addr with
+   * the RTP (port) and RTCP (port+1) port.
+   * @return 0 on success, -1 (errno set) on error
+   */
+  static int bindPair(const struct sockaddr_storage* addr, unsigned short port,
+		      int& rtp_sd, int& rtcp_sd);
+};
+
+/**
+ * \brief fills the socket pools of the RTP interfaces
+ */
+class _AmRtpSocketPool
+  : public AmThread
+{
+  AmCondition<bool> fill;
+  AmSharedVar<bool> stop_requested;
+
+protected:
+  _AmRtpSocketPool();
+  ~_AmRtpSocketPool();
+
+  void run();
+  void on_stop();
+
+  /** stop and close the pooled and shared sockets */
+  void dispose();
+
+public:
+  /**
+   * Set up the shared pairs (rtp_shared_ports) and the
+   * pools (rtp_socket_pool), and start filling the pools.
+   */
+  void init();
+
+  /** fill the pools now (e.g. after one has been taken from) */
+  void wakeup() { fill.set(true); }
+};
+
+typedef singleton<_AmRtpSocketPool> AmRtpSocketPool;
+
+#endif
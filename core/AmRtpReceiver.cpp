@@ -30,8 +30,13 @@
 #include "AmRtpPacket.h"
 #include "log.h"
 #include "AmConfig.h"
+#include "AmUtils.h"
+#include "sip/ip_util.h"
+#include "sip/raw_sender.h"
 
 #include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
 
 // Not on Solaris!
 #if !defined (__SVR4) && !defined (__sun)
@@ -50,8 +55,12 @@ _AmRtpReceiver::~_AmRtpReceiver()
 }
 
 AmRtpReceiverThread::AmRtpReceiverThread()
-  : stop_requested(false)
+  : ev_flush(NULL),
+    flush_pending(false),
+    stop_requested(false)
 {
+  setThreadName("rtp-rx");
+
   // libevent event base
   ev_base = event_base_new();
 }
@@ -96,9 +105,22 @@ void AmRtpReceiverThread::run()
 	      NULL,NULL);
   event_add(ev_default,NULL);
 
+  if(AmConfig::UseRawSockets) {
+    // relayed packets are queued while processing the ready sockets
+    // and sent together once they have all been processed (sendmmsg)
+    raw_sender::batchThread();
+    ev_flush = event_new(ev_base,-1,0,_rtp_receiver_flush_cb,this);
+  }
+
   // run the event loop
   event_base_loop(ev_base,0);
 
+  if(ev_flush) {
+    raw_sender::flush();
+    event_free(ev_flush);
+    ev_flush = NULL;
+  }
+
   // clean-up fake fds/event
   event_free(ev_default);
   close(fake_fds[0]);
@@ -112,16 +134,49 @@ void AmRtpReceiverThread::_rtp_receiver_read_cb(evutil_socket_t sd,
     static_cast<AmRtpReceiverThread::StreamInfo*>(arg);
 
   p_si->thread->streams_mut.lock();
-  if(!p_si->stream) {
-    // we are about to get removed...
-    p_si->thread->streams_mut.unlock();
-    return;
+  if(p_si->shared) {
+    p_si->shared->recvPacket();
+  }
+  else if(p_si->stream) {
+    p_si->stream->recvPacket(sd);
   }
-  p_si->stream->recvPacket(sd);
+  // else: we are about to get removed...
   p_si->thread->streams_mut.unlock();
+
+  p_si->thread->scheduleFlush();
+}
+
+void AmRtpReceiverThread::scheduleFlush()
+{
+  if(!ev_flush || flush_pending)
+    return;
+
+  // activated events run after the ones already active:
+  // all sockets ready in this pass are read before flushing
+  flush_pending = true;
+  event_active(ev_flush,EV_TIMEOUT,0);
+}
+
+void AmRtpReceiverThread::_rtp_receiver_flush_cb(evutil_socket_t, short,
+						 void* arg)
+{
+  AmRtpReceiverThread* t = static_cast<AmRtpReceiverThread*>(arg);
+  t->flush_pending = false;
+  raw_sender::flush();
 }
 
 void AmRtpReceiverThread::addStream(int sd, AmRtpStream* stream)
+{
+  addSocket(sd, stream, NULL);
+}
+
+void AmRtpReceiverThread::addSharedSocket(AmRtpSharedSocket* shared)
+{
+  addSocket(shared->getSd(), NULL, shared);
+}
+
+void AmRtpReceiverThread::addSocket(int sd, AmRtpStream* stream,
+				    AmRtpSharedSocket* shared)
 {
   streams_mut.lock();
   if(streams.find(sd) != streams.end()) {
@@ -133,6 +188,7 @@ void AmRtpReceiverThread::addStream(int sd, AmRtpStream* stream)
 
   StreamInfo& si = streams[sd];
   si.stream = stream;
+  si.shared = shared;
   event* ev_read = event_new(ev_base,sd,EV_READ|EV_PERSIST,
 			     AmRtpReceiverThread::_rtp_receiver_read_cb,&si);
   si.ev_read = ev_read;
@@ -154,12 +210,13 @@ void AmRtpReceiverThread::removeStream(int sd)
   }
 
   StreamInfo& si = sit->second;
-  if(!si.stream || !si.ev_read){
+  if((!si.stream && !si.shared) || !si.ev_read){
     streams_mut.unlock();
     return;
   }
 
   si.stream = NULL;
+  si.shared = NULL;
   event* ev_read = si.ev_read;
   si.ev_read = NULL;
 
@@ -195,3 +252,233 @@ void _AmRtpReceiver::removeStream(int sd)
   unsigned int i = sd % n_receivers;
   receivers[i].removeStream(sd);
 }
+
+void _AmRtpReceiver::addSharedSocket(AmRtpSharedSocket* shared)
+{
+  unsigned int i = shared->getSd() % n_receivers;
+  receivers[i].addSharedSocket(shared);
+}
+
+AmRtpSharedSocket::AddrKey::AddrKey(const struct sockaddr_storage* addr,
+				    bool with_port)
+{
+  memset(ip, 0, sizeof(ip));
+  port = 0;
+
+  if (addr->ss_family == AF_INET) {
+    const struct sockaddr_in* in = (const struct sockaddr_in*)addr;
+    ip[10] = ip[11] = 0xff;
+    memcpy(ip + 12, &in->sin_addr, 4);
+    if (with_port) port = in->sin_port;
+  }
+  else if (addr->ss_family == AF_INET6) {
+    const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)addr;
+    memcpy(ip, &in6->sin6_addr, 16);
+    if (with_port) port = in6->sin6_port;
+  }
+}
+
+bool AmRtpSharedSocket::AddrKey::operator < (const AddrKey& k) const
+{
+  if (port != k.port)
+    return port < k.port;
+  return memcmp(ip, k.ip, sizeof(ip)) < 0;
+}
+
+bool AmRtpSharedSocket::AddrKey::operator == (const AddrKey& k) const
+{
+  return port == k.port && !memcmp(ip, k.ip, sizeof(ip));
+}
+
+// SSRCs learned per stream (RTP sender and maybe retransmissions/relayed)
+#define SHARED_MAX_SSRCS 4
+
+AmRtpSharedSocket::AmRtpSharedSocket(int sd, unsigned short port, bool rtcp)
+  : sd(sd), port(port), rtcp(rtcp), received(0), dropped(0)
+{
+}
+
+AmRtpSharedSocket::~AmRtpSharedSocket()
+{
+  if (!streams.empty())
+    WARN("shared RTP socket %u deleted with %u streams\n",
+	 port, (unsigned int)streams.size());
+}
+
+void AmRtpSharedSocket::attach(AmRtpStream* stream)
+{
+  AmLock l(mut);
+  streams[stream];
+}
+
+void AmRtpSharedSocket::removeRemote(AmRtpStream* stream, Remote& r)
+{
+  if (r.addr_set) {
+    std::map<AddrKey, AmRtpStream*>::iterator it = by_addr.find(AddrKey(&r.addr));
+    if (it != by_addr.end() && it->second == stream)
+      by_addr.erase(it);
+
+    std::pair<std::multimap<AddrKey, AmRtpStream*>::iterator,
+	      std::multimap<AddrKey, AmRtpStream*>::iterator> range =
+      by_ip.equal_range(AddrKey(&r.addr, false));
+    for (std::multimap<AddrKey, AmRtpStream*>::iterator i = range.first;
+	 i != range.second; ++i) {
+      if (i->second == stream) {
+	by_ip.erase(i);
+	break;
+      }
+    }
+    r.addr_set = false;
+  }
+
+  for (std::vector<unsigned int>::iterator s = r.ssrcs.begin(); s != r.ssrcs.end(); ++s) {
+    std::map<unsigned int, AmRtpStream*>::iterator it = by_ssrc.find(*s);
+    if (it != by_ssrc.end() && it->second == stream)
+      by_ssrc.erase(it);
+  }
+  r.ssrcs.clear();
+}
+
+void AmRtpSharedSocket::detach(AmRtpStream* stream)
+{
+  // wait for the stream to finish processing a packet
+  AmLock d(dispatch_mut);
+  AmLock l(mut);
+
+  std::map<AmRtpStream*, Remote>::iterator it = streams.find(stream);
+  if (it == streams.end())
+    return;
+
+  removeRemote(stream, it->second);
+  streams.erase(it);
+}
+
+void AmRtpSharedSocket::setRemote(AmRtpStream* stream,
+				  const struct sockaddr_storage* addr)
+{
+  AmLock l(mut);
+
+  std::map<AmRtpStream*, Remote>::iterator it = streams.find(stream);
+  if (it == streams.end())
+    return; // not receiving
+
+  Remote& r = it->second;
+  if (r.addr_set && !memcmp(&r.addr, addr, sizeof(struct sockaddr_storage)))
+    return;
+
+  // the learned SSRCs are kept: they still belong to the stream
+  std::vector<unsigned int> ssrcs;
+  ssrcs.swap(r.ssrcs);
+  removeRemote(stream, r);
+  r.ssrcs.swap(ssrcs);
+
+  memcpy(&r.addr, addr, sizeof(struct sockaddr_storage));
+  r.addr_set = true;
+
+  AmRtpStream*& s = by_addr[AddrKey(addr)];
+  if (s && s != stream) {
+    DBG("shared RTP socket %u: remote %s:%u moved to stream [%p]\n",
+	port, get_addr_str(addr).c_str(), am_get_port(addr), stream);
+  }
+  s = stream;
+  by_ip.insert(std::make_pair(AddrKey(addr, false), stream));
+}
+
+unsigned int AmRtpSharedSocket::size()
+{
+  AmLock l(mut);
+  return streams.size();
+}
+
+AmRtpStream* AmRtpSharedSocket::find(const struct sockaddr_storage* addr,
+				     const unsigned char* buf, int len, bool is_rtcp)
+{
+  // RTP: SSRC at 8; RTCP: sender SSRC at 4
+  unsigned int ssrc_off = is_rtcp ? 4 : 8;
+  bool has_ssrc = len >= (int)ssrc_off + 4;
+  unsigned int ssrc = 0;
+  if (has_ssrc) {
+    memcpy(&ssrc, buf + ssrc_off, 4);
+    ssrc = ntohl(ssrc);
+  }
+
+  AmLock l(mut);
+
+  std::map<AddrKey, AmRtpStream*>::iterator a = by_addr.find(AddrKey(addr));
+  if (a != by_addr.end()) {
+    if (has_ssrc && by_ssrc.find(ssrc) == by_ssrc.end()) {
+      Remote& r = streams[a->second];
+      if (r.ssrcs.size() < SHARED_MAX_SSRCS) {
+	r.ssrcs.push_back(ssrc);
+	by_ssrc[ssrc] = a->second;
+      }
+    }
+    return a->second;
+  }
+
+  // only from the IP of the stream's remote, so that other
+  // sources can not take over the stream by sending its SSRC
+  if (has_ssrc) {
+    std::map<unsigned int, AmRtpStream*>::iterator s = by_ssrc.find(ssrc);
+    if (s != by_ssrc.end()) {
+      Remote& r = streams[s->second];
+      if (r.addr_set && AddrKey(&r.addr, false) == AddrKey(addr, false))
+	return s->second;
+    }
+  }
+
+  std::pair<std::multimap<AddrKey, AmRtpStream*>::iterator,
+	    std::multimap<AddrKey, AmRtpStream*>::iterator> range =
+    by_ip.equal_range(AddrKey(addr, false));
+  if (range.first != range.second && ++range.first == range.second)
+    return (--range.first)->second;
+
+  return NULL;
+}
+
+void AmRtpSharedSocket::recvPacket()
+{
+  unsigned char buffer[4096];
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+
+  int len = recvfrom(sd, buffer, sizeof(buffer), 0,
+		     (struct sockaddr*)&addr, &addr_len);
+  if (len <= 0) {
+    if (len < 0 && errno != EINTR && errno != EAGAIN)
+      ERROR("shared RTP socket recv(%d): %s\n", sd, strerror(errno));
+    return;
+  }
+
+  // rtcp-mux: RTCP packet types 192-223 (RFC 5761)
+  bool is_rtcp = rtcp || (len >= 2 && IS_RTCP_MUX_PT(buffer[1]));
+
+  AmLock d(dispatch_mut);
+  received++;
+
+  AmRtpStream* stream = find(&addr, buffer, len, is_rtcp);
+  if (!stream) {
+    dropped++;
+    return;
+  }
+
+  stream->recvSharedPacket(buffer, len, &addr, is_rtcp);
+}
+
+void AmRtpSharedSocket::getStats(AmArg& stats)
+{
+  stats["port"] = (int)port;
+  stats["rtcp"] = rtcp;
+
+  unsigned long long r, d;
+  {
+    AmLock l(dispatch_mut);
+    r = received;
+    d = dropped;
+  }
+  stats["received"] = (long long)r;
+  stats["dropped"] = (long long)d;
+
+  AmLock l(mut);
+  stats["streams"] = (int)streams.size();
+}
@@ -29,17 +29,101 @@
 #define _AmRtpReceiver_h_
 
 #include "AmThread.h"
+#include "AmArg.h"
 #include "atomic_types.h"
 #include "singleton.h"
 
 #include <event2/event.h>
 
+#include <sys/socket.h>
+#include <string.h>
 #include <map>
+#include <vector>
 using std::greater;
 
 class AmRtpStream;
 class _AmRtpReceiver;
 
+/**
+ * \brief socket shared by many RTP streams (rtp_shared_ports)
+ *
+ * A received packet is passed to the stream whose remote address
+ * matches the source address, else to the stream which has received
+ * packets with the same SSRC from its remote address before (if the
+ * source has the IP of that remote address), else to
+ * the only stream with the source's IP (remote behind NAT, until
+ * symmetric RTP has updated the remote address). Other packets are
+ * dropped.
+ */
+class AmRtpSharedSocket
+{
+public:
+  /** IP (IPv4 mapped to IPv6) and port */
+  struct AddrKey
+  {
+    unsigned char ip[16];
+    unsigned short port;
+
+    AddrKey(const struct sockaddr_storage* addr, bool with_port = true);
+    bool operator < (const AddrKey& k) const;
+    bool operator == (const AddrKey& k) const;
+  };
+
+private:
+  struct Remote
+  {
+    bool addr_set;
+    struct sockaddr_storage addr;
+    std::vector<unsigned int> ssrcs;
+
+    Remote() : addr_set(false) { memset(&addr, 0, sizeof(addr)); }
+  };
+
+  int sd;
+  unsigned short port;
+  bool rtcp; // RTCP of streams without rtcp-mux
+
+  // held while a stream processes a packet
+  AmMutex dispatch_mut;
+
+  AmMutex mut;
+  std::map<AmRtpStream*, Remote> streams;
+  std::map<AddrKey, AmRtpStream*> by_addr;
+  std::multimap<AddrKey, AmRtpStream*> by_ip;
+  std::map<unsigned int, AmRtpStream*> by_ssrc;
+
+  unsigned long long received;
+  unsigned long long dropped;
+
+  void removeRemote(AmRtpStream* stream, Remote& r);
+  AmRtpStream* find(const struct sockaddr_storage* addr,
+		    const unsigned char* buf, int len, bool is_rtcp);
+
+public:
+  AmRtpSharedSocket(int sd, unsigned short port, bool rtcp);
+  ~AmRtpSharedSocket();
+
+  int getSd() const { return sd; }
+  unsigned short getPort() const { return port; }
+  bool isRtcp() const { return rtcp; }
+
+  /** receive packets for stream (from the remote set with setRemote) */
+  void attach(AmRtpStream* stream);
+  /** stop receiving for stream; waits until it processes no packet */
+  void detach(AmRtpStream* stream);
+  /** set the remote address of an attached stream */
+  void setRemote(AmRtpStream* stream, const struct sockaddr_storage* addr);
+
+  /** number of attached streams */
+  unsigned int size();
+
+  /** read a packet and pass it to its stream (receiver thread) */
+  void recvPacket();
+
+  /** streams, received/dropped packets */
+  void getStats(AmArg& stats);
+};
+
 /**
  * \brief receiver for RTP for all streams.
  *
@@ -53,11 +137,13 @@ class AmRtpReceiverThread
   struct StreamInfo 
   {
     AmRtpStream* stream;
+    AmRtpSharedSocket* shared;
     struct event* ev_read;
     AmRtpReceiverThread* thread;
 
     StreamInfo()
       : stream(NULL),
+	shared(NULL),
 	ev_read(NULL),
 	thread(NULL)
     {}
@@ -68,12 +154,21 @@ class AmRtpReceiverThread
   struct event_base* ev_base;
   struct event*      ev_default;
 
+  /* sends the queued raw packets (use_raw_sockets) */
+  struct event*      ev_flush;
+  bool               flush_pending;
+
   Streams  streams;
   AmMutex  streams_mut;
 
   AmSharedVar<bool> stop_requested;
 
   static void _rtp_receiver_read_cb(evutil_socket_t sd, short what, void* arg);
+  static void _rtp_receiver_flush_cb(evutil_socket_t sd, short what, void* arg);
+
+  void scheduleFlush();
+
+  void addSocket(int sd, AmRtpStream* stream, AmRtpSharedSocket* shared);
 
 public:    
   AmRtpReceiverThread();
@@ -83,6 +178,7 @@ public:
   void on_stop();
 
   void addStream(int sd, AmRtpStream* stream);
+  void addSharedSocket(AmRtpSharedSocket* shared);
   void removeStream(int sd);
 
   void stop_and_wait();
@@ -105,6 +201,7 @@ public:
   void start();
 
   void addStream(int sd, AmRtpStream* stream);
+  void addSharedSocket(AmRtpSharedSocket* shared);
   void removeStream(int sd);
 };
 
@@ -38,6 +38,9 @@
 #include "rtp/telephone_event.h"
 #include "amci/codecs.h"
 #include "AmJitterBuffer.h"
+#include "AmPayloadTranscoder.h"
+#include "AmRtpPortMap.h"
+#include "AmRtpPacer.h"
 
 #include "sip/resolver.h"
 #include "sip/ip_util.h"
@@ -90,6 +93,78 @@ PayloadMask::PayloadMask(const PayloadMask &src)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// sequence number jump treated as restart of the sender (RFC 3550 A.1)
+#define RTP_MAX_DROPOUT  3000
+#define RTP_MAX_MISORDER 100
+
+AmRtpReceiveStats::AmRtpReceiveStats()
+  : seq_i(false), max_seq(0), cycles(0), base_seq(0), prior_expected(0),
+    received(0), reordered(0),
+    jitter(0), transit_i(false), transit(0)
+{
+}
+
+void AmRtpReceiveStats::update(unsigned short seq)
+{
+  received++;
+
+  if (!seq_i) {
+    seq_i = true;
+    base_seq = max_seq = seq;
+    return;
+  }
+
+  unsigned short udelta = seq - max_seq;
+  if (!udelta) {
+    // duplicate
+    reordered++;
+  }
+  else if (udelta < RTP_MAX_DROPOUT) {
+    // in order, with permissible gap
+    if (seq < max_seq)
+      cycles += 1 << 16;
+    max_seq = seq;
+  }
+  else if (udelta <= (1 << 16) - RTP_MAX_MISORDER) {
+    // restarted sequence
+    prior_expected += cycles + max_seq - base_seq + 1;
+    cycles = 0;
+    base_seq = max_seq = seq;
+  }
+  else {
+    // duplicate or reordered
+    reordered++;
+  }
+}
+
+void AmRtpReceiveStats::updateJitter(unsigned int rtp_ts, unsigned int arrival_ts)
+{
+  int t = arrival_ts - rtp_ts;
+  if (transit_i) {
+    int d = t - transit;
+    if (d < 0) d = -d;
+    jitter += d - ((jitter + 8) >> 4);
+  }
+  transit = t;
+  transit_i = true;
+}
+
+unsigned int AmRtpReceiveStats::expected() const
+{
+  if (!seq_i)
+    return prior_expected;
+
+  return prior_expected + cycles + max_seq - base_seq + 1;
+}
+
+unsigned int AmRtpReceiveStats::lost() const
+{
+  unsigned int e = expected();
+  return e > received ? e - received : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /*
  * This function must be called before setLocalPort, because
  * setLocalPort will bind the socket and it will be not
@@ -146,6 +221,8 @@ void AmRtpStream::setLocalPort(unsigned short p)
 {
   if(l_port)
     return;
+
+  cancelPendingSends();
   
   if(l_if < 0) {
     if (session) l_if = session->getRtpInterface();
@@ -155,68 +232,162 @@ void AmRtpStream::setLocalPort(unsigned short p)
     }
   }
   
-  int retry = 10;
-  unsigned short port = 0;
-  for(;retry; --retry){
-
-    if (!getLocalSocket())
-      return;
+  rtcp.setInterface(l_if);
 
-    if(!p)
-      port = AmConfig::RTP_Ifs[l_if].getNextRtpPort();
-    else
-      port = p;
+  AmRtpPortMap* ports = AmConfig::RTP_Ifs[l_if].getPortMap();
+  AmRtpSocketPair pair;
+  unsigned short port = 0;
 
-    am_set_port(&l_saddr,port+1);
-    if(bind(l_rtcp_sd,(const struct sockaddr*)&l_saddr,SA_len(&l_saddr))) {
-      DBG("bind: %s\n",strerror(errno));		
-      goto try_another_port;
-    }
+  // unbound sockets from getLocalSocket()
+  if (l_sd) {
+    cancelPaced();
+    close(l_sd);
+    close(l_rtcp_sd);
+    l_sd = l_rtcp_sd = 0;
+  }
 
-    am_set_port(&l_saddr,port);
-    if(bind(l_sd,(const struct sockaddr*)&l_saddr,SA_len(&l_saddr))) {
-      DBG("bind: %s\n",strerror(errno));		
-      goto try_another_port;
+  if (!p && ports->getShared(&l_saddr, l_shared, l_rtcp_shared)) {
+    l_sd = l_shared->getSd();
+    l_port = l_shared->getPort();
+    if (!rtcp_mux) {
+      l_rtcp_sd = l_rtcp_shared->getSd();
+      l_rtcp_shared->attach(this);
     }
+    l_rtcp_port = l_port+1;
+    l_shared->attach(this);
+    if (r_port)
+      setSharedRemote();
 
-    // both bind() succeeded!
-    break;
+    DBG("stream [%p] uses shared RTP ports (%s:%i/%i)\n", this,
+	get_addr_str((sockaddr_storage*)&l_saddr).c_str(),l_port,l_rtcp_port);
 
-  try_another_port:
-      close(l_sd);
-      l_sd = 0;
-      close(l_rtcp_sd);
-      l_rtcp_sd = 0;
+    memcpy(&l_rtcp_saddr, &l_saddr, sizeof(l_saddr));
+    am_set_port(&l_rtcp_saddr, l_rtcp_port);
+    applyQoS();
+    return;
   }
 
-  int true_opt = 1;
-  if (!retry){
-    ERROR("could not find a free RTP port\n");
-    throw string("could not find a free RTP port");
+  if (!p && ports->take(&l_saddr, pair)) {
+    port = pair.port;
   }
+  else {
+    for (int retry = 10; retry; --retry) {
+      unsigned short try_port = p;
+      if (!p && !(try_port = ports->alloc()))
+	break; // all in use
+
+      if (!AmRtpPortMap::bindPair(&l_saddr, try_port, pair.rtp_sd, pair.rtcp_sd)) {
+	port = try_port;
+	break;
+      }
+      DBG("bind: %s\n",strerror(errno));
 
-  // rco: does that make sense after bind() ????
-  if(setsockopt(l_sd, SOL_SOCKET, SO_REUSEADDR,
-		(void*)&true_opt, sizeof (true_opt)) == -1) {
+      if (p)
+	break;
+      // used by someone else
+      ports->release(try_port, true);
+    }
+  }
 
-    ERROR("%s\n",strerror(errno));
-    close(l_sd);
-    l_sd = 0;
-    throw string ("while setting local address reusable.");
+  if (!port){
+    ERROR("could not find a free RTP port\n");
+    throw string("could not find a free RTP port");
   }
 
+  l_sd = pair.rtp_sd;
+  l_rtcp_sd = pair.rtcp_sd;
+  if (!p)
+    l_port_map = ports;
   l_port = port;
   l_rtcp_port = port+1;
 
+  if (rtcp_mux) {
+    // negotiated before the port was needed
+    close(l_rtcp_sd);
+    l_rtcp_sd = 0;
+  }
+
   if(!p) {
     AmRtpReceiver::instance()->addStream(l_sd, this);
-    AmRtpReceiver::instance()->addStream(l_rtcp_sd, this);
+    if (l_rtcp_sd > 0) AmRtpReceiver::instance()->addStream(l_rtcp_sd, this);
     DBG("added stream [%p] to RTP receiver (%s:%i/%i)\n", this,
 	get_addr_str((sockaddr_storage*)&l_saddr).c_str(),l_port,l_rtcp_port);
   }
 
   memcpy(&l_rtcp_saddr, &l_saddr, sizeof(l_saddr));
   am_set_port(&l_rtcp_saddr, l_rtcp_port);
+  applyQoS();
+}
+
+void AmRtpStream::applyQoS()
+{
+  if (l_if < 0 || (size_t)l_if >= AmConfig::RTP_Ifs.size())
+    return;
+
+  const AmConfig::RTP_interface& intf = AmConfig::RTP_Ifs[l_if];
+  int dscp = relay_enabled ? intf.RelayDscp : intf.Dscp;
+  int prio = relay_enabled ? intf.RelayPriority : intf.Priority;
+
+  // pooled sockets may have been marked for the other class
+  if (dscp < 0 && (intf.Dscp >= 0 || intf.RelayDscp >= 0))
+    dscp = 0;
+  if (prio < 0 && (intf.Priority >= 0 || intf.RelayPriority >= 0))
+    prio = 0;
+
+  // the templates are rebuilt by the threads sending with them
+  if (dscp >= 0)
+    raw_tos = dscp << 2;
+
+  // shared sockets are used by streams of both classes
+  if (!l_sd || l_shared)
+    return;
+
+  int sds[2] = { l_sd, l_rtcp_sd };
+  for (int i = 0; i < 2; i++) {
+    if (sds[i] <= 0)
+      continue;
+
+    if (dscp >= 0) {
+      int tos = dscp << 2;
+      int err;
+      if (l_saddr.ss_family == AF_INET6)
+	err = setsockopt(sds[i], IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+      else
+	err = setsockopt(sds[i], IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+      if (err)
+	WARN("could not set DSCP %i: %s\n", dscp, strerror(errno));
+    }
+
+#ifdef SO_PRIORITY
+    if (prio >= 0 &&
+	setsockopt(sds[i], SOL_SOCKET, SO_PRIORITY, &prio, sizeof(prio)))
+      WARN("could not set socket priority %i: %s\n", prio, strerror(errno));
+#endif
+  }
+}
+
+void AmRtpStream::cancelPaced()
+{
+  if (pacer) {
+    pacer->cancel(this);
+    pacer = NULL;
+  }
+}
+
+int AmRtpStream::sendPacket(AmRtpPacket& rp, raw_udp4_tmpl* tmpl)
+{
+  const AmConfig::RTP_interface& intf = AmConfig::RTP_Ifs[l_if];
+
+  AmRtpPacer* current_pacer;
+  if (intf.Pacing && (current_pacer = AmRtpPacer::current()) &&
+      current_pacer->add(this, l_sd, l_if, intf.NetIfIdx, tmpl, raw_tos,
+			 &l_saddr, &rp.addr, rp.getBuffer(), rp.getBufferSize())) {
+    // sent by the media processor later in this tick
+    pacer = current_pacer;
+    return 0;
+  }
+
+  return rp.send(l_sd, intf.NetIfIdx, &l_saddr, tmpl, raw_tos);
 }
 
 int AmRtpStream::ping()
@@ -288,12 +459,13 @@ int AmRtpStream::compile_and_send(const int payload, bool marker, unsigned int t
   }
 #endif
 
-  if(rp.send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr) < 0){
+  if(sendPacket(rp, &raw_send_tmpl) < 0){
     ERROR("while sending RTP packet.\n");
     return -1;
   }
  
   if (logger) rp.logSent(logger, &l_saddr);
+  rtcp.sent(size);
  
   return size;
 }
@@ -327,7 +499,7 @@ int AmRtpStream::send_raw( char* packet, unsigned int length )
   rp.compile_raw((unsigned char*)packet, length);
   rp.setAddr(&r_saddr);
 
-  if(rp.send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr) < 0){
+  if(sendPacket(rp, &raw_send_tmpl) < 0){
     ERROR("while sending raw RTP packet.\n");
     return -1;
   }
@@ -360,6 +532,12 @@ int AmRtpStream::receive( unsigned char* buffer, unsigned int size,
   begin_talk = ((last_payload == 13) || rp->marker);
   last_payload = rp->payload;
 
+  last_recv_seq = rp->sequence;
+  last_recv_arrival = rp->recv_time;
+  recv_stats.update(rp->sequence);
+  r_ssrc = rp->ssrc;
+  r_ssrc_i = true;
+
   if(!rp->getDataSize()) {
     mem.freePacket(rp);
     return RTP_EMPTY;
@@ -392,7 +570,16 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
   : r_port(0),
     l_if(_if),
     l_port(0),
+    l_port_map(NULL),
     l_sd(0), 
+    l_rtcp_port(0),
+    l_rtcp_sd(0),
+    l_shared(NULL),
+    l_rtcp_shared(NULL),
+    rtcp_mux(false),
+    raw_tos(0),
+    pacer(NULL),
+    rtcp_next_ts(0),
     r_ssrc_i(false),
     session(_s),
     logger(NULL),
@@ -411,11 +598,16 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
     relay_transparent_ssrc(true),
     relay_transparent_seqno(true),
     relay_filter_dtmf(false),
-    force_receive_dtmf(false)
+    force_receive_dtmf(false),
+    last_recv_seq(0)
 {
 
   memset(&r_saddr,0,sizeof(struct sockaddr_storage));
   memset(&l_saddr,0,sizeof(struct sockaddr_storage));
+  memset(&last_recv_arrival,0,sizeof(struct timeval));
+
+  for (int pt = 0; pt < RELAY_TRANSCODING_PTS; pt++)
+    relay_transcoding[pt] = 0;
 
   l_ssrc = get_random();
   sequence = get_random();
@@ -427,14 +619,23 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
 
 AmRtpStream::~AmRtpStream()
 {
-  if(l_sd){
+  cancelPaced();
+
+  if(l_shared){
+    // the shared sockets stay open
+    l_shared->detach(this);
+    l_rtcp_shared->detach(this);
+  }
+  else if(l_sd){
     if (AmRtpReceiver::haveInstance()){
       AmRtpReceiver::instance()->removeStream(l_sd);
-      AmRtpReceiver::instance()->removeStream(l_rtcp_sd);
+      if (l_rtcp_sd > 0) AmRtpReceiver::instance()->removeStream(l_rtcp_sd);
     }
     close(l_sd);
-    close(l_rtcp_sd);
+    if (l_rtcp_sd > 0) close(l_rtcp_sd);
   }
+  if (l_port_map)
+    l_port_map->release(l_port);
   if (logger) dec_ref(logger);
 }
 
@@ -473,6 +674,8 @@ void AmRtpStream::setRAddr(const string& addr, unsigned short port,
   DBG("RTP remote address set to %s:(%u/%u)\n",
       addr.c_str(),port,rtcp_port);
 
+  cancelPendingSends();
+
   struct sockaddr_storage ss;
   memset (&ss, 0, sizeof (ss));
 
@@ -496,6 +699,69 @@ void AmRtpStream::setRAddr(const string& addr, unsigned short port,
 	  (SAv4(&r_saddr)->sin_addr.s_addr == INADDR_ANY)) ||
     ((r_saddr.ss_family == AF_INET6) && 
      IN6_IS_ADDR_UNSPECIFIED(&SAv6(&r_saddr)->sin6_addr));
+
+  if (l_shared)
+    setSharedRemote();
+}
+
+void AmRtpStream::setSharedRemote()
+{
+  l_shared->setRemote(this, &r_saddr);
+
+  if (l_rtcp_sd > 0) {
+    struct sockaddr_storage rtcp_raddr;
+    memcpy(&rtcp_raddr, &r_saddr, sizeof(rtcp_raddr));
+    am_set_port(&rtcp_raddr, r_rtcp_port);
+    l_rtcp_shared->setRemote(this, &rtcp_raddr);
+  }
+}
+
+void AmRtpStream::setRtcpMux(bool mux)
+{
+  if (mux == rtcp_mux)
+    return;
+
+  DBG("rtcp-mux %sabled for RTP stream instance [%p]\n", mux ? "en":"dis", this);
+  rtcp_mux = mux;
+
+  // not bound yet: done in setLocalPort
+  if (!l_port)
+    return;
+
+  if (mux && (l_rtcp_sd > 0)) {
+    // RTCP comes in on the RTP port now
+    if (l_shared) {
+      l_rtcp_shared->detach(this);
+    }
+    else {
+      if (AmRtpReceiver::haveInstance())
+	AmRtpReceiver::instance()->removeStream(l_rtcp_sd);
+      close(l_rtcp_sd);
+    }
+    l_rtcp_sd = 0;
+  }
+  else if (!mux && (l_rtcp_sd <= 0)) {
+    if (l_shared) {
+      l_rtcp_sd = l_rtcp_shared->getSd();
+      l_rtcp_shared->attach(this);
+      if (r_port) setSharedRemote();
+      return;
+    }
+
+    // the port pair is still ours: bind the RTCP port again
+    int sd = socket(l_rtcp_saddr.ss_family, SOCK_DGRAM, 0);
+    int true_opt = 1;
+    if ((sd == -1) || (ioctl(sd, FIONBIO, &true_opt) == -1) ||
+	(bind(sd, (const struct sockaddr*)&l_rtcp_saddr, SA_len(&l_rtcp_saddr)) == -1)) {
+      ERROR("could not bind RTCP port %u again: %s\n", l_rtcp_port, strerror(errno));
+      if (sd != -1) close(sd);
+      return;
+    }
+
+    l_rtcp_sd = sd;
+    AmRtpReceiver::instance()->addStream(l_rtcp_sd, this);
+    applyQoS();
+  }
 }
 
 void AmRtpStream::handleSymmetricRtp(struct sockaddr_storage* recv_addr, bool rtcp) {
@@ -565,6 +831,8 @@ void AmRtpStream::getSdpOffer(unsigned int index, SdpMedia& offer)
   getSdp(offer);
   offer.payloads.clear();
   payload_provider->getPayloads(offer.payloads);
+  if (AmConfig::RtcpMux)
+    offer.setRtcpMux(true);
 }
 
 void AmRtpStream::getSdpAnswer(unsigned int index, const SdpMedia& offer, SdpMedia& answer)
@@ -572,6 +840,8 @@ void AmRtpStream::getSdpAnswer(unsigned int index, const SdpMedia& offer, SdpMed
   sdp_media_index = index;
   getSdp(answer);
   offer.calcAnswer(payload_provider,answer);
+  // rtcp-mux only if offered
+  answer.setRtcpMux(offer.hasRtcpMux() && AmConfig::RtcpMux);
 }
 
 int AmRtpStream::init(const AmSdp& local,
@@ -589,6 +859,8 @@ int AmRtpStream::init(const AmSdp& local,
   const SdpMedia& local_media = local.media[sdp_media_index];
   const SdpMedia& remote_media = remote.media[sdp_media_index];
 
+  cancelPendingSends();
+
   payloads.clear();
   pl_map.clear();
   payloads.resize(local_media.payloads.size());
@@ -696,6 +968,7 @@ int AmRtpStream::init(const AmSdp& local,
   }
 
   setPassiveMode(remote_media.dir == SdpMedia::DirActive || force_passive_mode);
+  setRtcpMux(local_media.hasRtcpMux() && remote_media.hasRtcpMux());
 
   // set remote address - media c-line having precedence over session c-line
   if (remote.conn.address.empty() && remote_media.conn.address.empty()) {
@@ -829,8 +1102,12 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 
     bool is_dtmf_packet = (p->payload == getLocalTelephoneEventPT()); 
 
-      if (relay_raw || (is_dtmf_packet && !active) ||
-	  relay_payloads.get(p->payload)) {
+    // single read: the entry may be changed by the session thread
+    unsigned int transcoding =
+      relay_raw ? 0 : relay_transcoding[p->payload & 0x7f];
+
+    if (relay_raw || (is_dtmf_packet && !active) ||
+	relay_payloads.get(p->payload) || transcoding) {
 
       if(active){
 	DBG("switching to relay-mode\t(ts=%u;stream=%p)\n",
@@ -841,6 +1118,16 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 
       if (NULL != relay_stream &&
 	  (!(relay_filter_dtmf && is_dtmf_packet))) {
+	if (transcoding) {
+	  // translate the payload directly, no decoding/playout buffer
+	  unsigned char out_pt = RelayTranscodingTable::outPt(transcoding);
+	  AmPayloadTranscoder::translate(
+	    AmPayloadTranscoder::getTableById(
+	      RelayTranscodingTable::tableId(transcoding)),
+	    p->getData(), p->getDataSize());
+	  ((rtp_hdr_t*)p->getBuffer())->pt = out_pt;
+	  p->payload = out_pt;
+	}
         relay_stream->relay(p);
       }
 
@@ -1027,27 +1314,61 @@ void AmRtpStream::recvPacket(int fd)
   }
   
   if(p->recv(l_sd) > 0){
-    int parse_res = 0;
-
-    if (logger) p->logReceived(logger, &l_saddr);
-
-    gettimeofday(&p->recv_time,NULL);
-    
-    if(!relay_raw)
-      parse_res = p->parse();
- 
-    if (parse_res == -1) {
-      DBG("error while parsing RTP packet.\n");
-      clearRTPTimeout(&p->recv_time);
-      mem.freePacket(p);	  
-    } else {
-      bufferPacket(p);
+    // rtcp-mux: RTCP packet types 192-223 (RFC 5761)
+    unsigned char* b = p->getBuffer();
+    if (rtcp_mux && (p->getBufferSize() >= 2) && IS_RTCP_MUX_PT(b[1])) {
+      processRtcpPacket(b, p->getBufferSize(), &p->addr);
+      mem.freePacket(p);
+      return;
     }
+    processPacket(p);
   } else {
     mem.freePacket(p);
   }
 }
 
+void AmRtpStream::recvSharedPacket(unsigned char* buffer, int len,
+				   struct sockaddr_storage* recv_addr, bool rtcp)
+{
+  if (rtcp) {
+    processRtcpPacket(buffer, len, recv_addr);
+    return;
+  }
+
+  AmRtpPacket* p = mem.newPacket();
+  if (!p) p = reuseBufferedPacket();
+  if (!p) {
+    DBG("out of buffers for RTP packets, dropping (stream [%p])\n",
+	this);
+    return;
+  }
+
+  memcpy(p->getBuffer(), buffer, len);
+  p->setBufferSize(len);
+  memcpy(&p->addr, recv_addr, sizeof(struct sockaddr_storage));
+  processPacket(p);
+}
+
+void AmRtpStream::processPacket(AmRtpPacket* p)
+{
+  int parse_res = 0;
+
+  if (logger) p->logReceived(logger, &l_saddr);
+
+  gettimeofday(&p->recv_time,NULL);
+
+  if(!relay_raw)
+    parse_res = p->parse();
+
+  if (parse_res == -1) {
+    DBG("error while parsing RTP packet.\n");
+    clearRTPTimeout(&p->recv_time);
+    mem.freePacket(p);
+  } else {
+    bufferPacket(p);
+  }
+}
+
 void AmRtpStream::recvRtcpPacket()
 {
   struct sockaddr_storage recv_addr;
@@ -1068,37 +1389,53 @@ void AmRtpStream::recvRtcpPacket()
   else
     if(!recved_bytes) return;
 
+  processRtcpPacket(buffer, recved_bytes, &recv_addr);
+}
+
+void AmRtpStream::processRtcpPacket(unsigned char* buffer, int recved_bytes,
+				    struct sockaddr_storage* recv_addr)
+{
   static const cstring empty;
   if (logger)
-    logger->log((const char *)buffer, recved_bytes, &recv_addr, &l_rtcp_saddr, empty);
+    logger->log((const char *)buffer, recved_bytes, recv_addr,
+		rtcp_mux ? &l_saddr : &l_rtcp_saddr, empty);
+
+  rtcp.parse(buffer, recved_bytes, l_ssrc, relay_enabled && relay_stream);
 
   // clear RTP timer
   clearRTPTimeout();
 
-  handleSymmetricRtp(&recv_addr,true);
+  // with rtcp-mux, the RTP packets update the remote address
+  if (!rtcp_mux)
+    handleSymmetricRtp(recv_addr,true);
 
   if(!relay_enabled || !relay_stream ||
      !relay_stream->l_sd)
     return;
 
-  if((size_t)recved_bytes > sizeof(buffer)) {
-    ERROR("recved huge RTCP packet (%d)",recved_bytes);
+  // rtcp-mux on the other side: to its RTP port
+  int sd = relay_stream->rtcp_mux ? relay_stream->l_sd : relay_stream->l_rtcp_sd;
+  struct sockaddr_storage* laddr = relay_stream->rtcp_mux ?
+    &relay_stream->l_saddr : &relay_stream->l_rtcp_saddr;
+  if (sd <= 0)
     return;
-  }
 
   struct sockaddr_storage rtcp_raddr;
   memcpy(&rtcp_raddr,&relay_stream->r_saddr,sizeof(rtcp_raddr));
-  am_set_port(&rtcp_raddr, relay_stream->r_rtcp_port);
+  am_set_port(&rtcp_raddr, relay_stream->rtcp_mux ?
+	      relay_stream->r_port : relay_stream->r_rtcp_port);
 
   int err;
   if(AmConfig::UseRawSockets) {
     err = raw_sender::send((char*)buffer,recved_bytes,
 			   AmConfig::RTP_Ifs[l_if].NetIfIdx,
-			   &relay_stream->l_saddr,
-			   &rtcp_raddr);
+			   laddr,
+			   &rtcp_raddr,
+			   &relay_stream->raw_rtcp_tmpl,
+			   relay_stream->raw_tos);
   }
   else {
-    err = sendto(relay_stream->l_rtcp_sd,buffer,recved_bytes,0,
+    err = sendto(sd,buffer,recved_bytes,0,
 		 (const struct sockaddr *)&rtcp_raddr,
 		 SA_len(&rtcp_raddr));
   }
@@ -1109,8 +1446,53 @@ void AmRtpStream::recvRtcpPacket()
   }
 
   if (logger)
-    logger->log((const char *)buffer, recved_bytes, &relay_stream->l_rtcp_saddr, &rtcp_raddr, empty);
+    logger->log((const char *)buffer, recved_bytes, laddr, &rtcp_raddr, empty);
+
+}
+
+void AmRtpStream::sendRtcpReport(unsigned long long system_ts, unsigned int rtp_ts)
+{
+  if (system_ts < rtcp_next_ts)
+    return;
+
+  bool initial = !rtcp_next_ts;
+  rtcp_next_ts = system_ts +
+    (unsigned long long)AmRtcp::interval(initial) * WALLCLOCK_RATE / 1000;
+  if (initial)
+    return;
+
+  // relayed: the peer's reports are passed on
+  if (relay_enabled && relay_stream)
+    return;
+
+  int sd = rtcp_mux ? l_sd : l_rtcp_sd;
+  unsigned short port = rtcp_mux ? r_port : r_rtcp_port;
+  if (!l_port || (sd <= 0) || !port ||
+      ((r_saddr.ss_family == AF_INET) && (SAv4(&r_saddr)->sin_addr.s_addr == INADDR_ANY)) ||
+      ((r_saddr.ss_family == AF_INET6) && IN6_IS_ADDR_UNSPECIFIED(&SAv6(&r_saddr)->sin6_addr)))
+    return;
+
+  unsigned char buffer[512];
+  string cname = "sems@" + get_addr_str(&l_saddr);
+  unsigned int len = rtcp.build(buffer, sizeof(buffer), l_ssrc, rtp_ts,
+				recv_stats, r_ssrc, cname);
+  if (!len)
+    return;
+
+  struct sockaddr_storage rtcp_raddr;
+  memcpy(&rtcp_raddr, &r_saddr, sizeof(rtcp_raddr));
+  am_set_port(&rtcp_raddr, port);
+
+  if (sendto(sd, buffer, len, 0, (const struct sockaddr *)&rtcp_raddr,
+	     SA_len(&rtcp_raddr)) < 0) {
+    DBG("could not send RTCP report: %s\n", strerror(errno));
+    return;
+  }
 
+  static const cstring empty;
+  if (logger)
+    logger->log((const char *)buffer, len,
+		rtcp_mux ? &l_saddr : &l_rtcp_saddr, &rtcp_raddr, empty);
 }
 
 void AmRtpStream::relay(AmRtpPacket* p)
@@ -1130,7 +1512,8 @@ void AmRtpStream::relay(AmRtpPacket* p)
     hdr->ssrc = htonl(l_ssrc);
   p->setAddr(&r_saddr);
 
-  if(p->send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr) < 0){
+  if(p->send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr,
+	     &raw_tmpl, raw_tos) < 0){
     ERROR("while sending RTP packet to '%s':%i\n",
 	  get_addr_str(&r_saddr).c_str(),am_get_port(&r_saddr));
   }
@@ -1164,6 +1547,7 @@ void AmRtpStream::sendDtmf(int event, unsigned int duration_ms) {
 }
 
 void AmRtpStream::setRelayStream(AmRtpStream* stream) {
+  cancelPendingSends();
   relay_stream = stream;
   DBG("set relay stream [%p] for RTP instance [%p]\n",
       stream, this);
@@ -1174,14 +1558,33 @@ void AmRtpStream::setRelayPayloads(const PayloadMask &_relay_payloads)
   relay_payloads = _relay_payloads;
 }
 
+void AmRtpStream::setRelayTranscoding(const RelayTranscodingTable& table)
+{
+  for (int pt = 0; pt < RELAY_TRANSCODING_PTS; pt++) {
+    unsigned int e = table.entries[pt];
+    if (relay_transcoding[pt] == e)
+      continue;
+
+    if (e) {
+      DBG("relaying payload %i as %i for RTP stream instance [%p]\n",
+	  pt, RelayTranscodingTable::outPt(e), this);
+    }
+    relay_transcoding[pt] = e;
+  }
+}
+
 void AmRtpStream::enableRtpRelay() {
   DBG("enabled RTP relay for RTP stream instance [%p]\n", this);
+  cancelPendingSends();
   relay_enabled = true;
+  applyQoS();
 }
 
 void AmRtpStream::disableRtpRelay() {
   DBG("disabled RTP relay for RTP stream instance [%p]\n", this);
+  cancelPendingSends();
   relay_enabled = false;
+  applyQoS();
 }
 
 void AmRtpStream::enableRawRelay()
@@ -1216,7 +1619,12 @@ void AmRtpStream::setRtpRelayFilterRtpDtmf(bool filter) {
 
 void AmRtpStream::stopReceiving()
 {
-  if (hasLocalSocket()){
+  if (l_shared){
+    DBG("detach stream [%p] from shared RTP ports\n", this);
+    l_shared->detach(this);
+    if (l_rtcp_sd > 0) l_rtcp_shared->detach(this);
+  }
+  else if (hasLocalSocket()){
     DBG("remove stream [%p] from RTP receiver\n", this);
     AmRtpReceiver::instance()->removeStream(getLocalSocket());
     if (l_rtcp_sd > 0) AmRtpReceiver::instance()->removeStream(l_rtcp_sd);
@@ -1225,7 +1633,13 @@ void AmRtpStream::stopReceiving()
 
 void AmRtpStream::resumeReceiving()
 {
-  if (hasLocalSocket()){
+  if (l_shared){
+    DBG("attach stream [%p] to shared RTP ports\n", this);
+    l_shared->attach(this);
+    if (l_rtcp_sd > 0) l_rtcp_shared->attach(this);
+    if (r_port) setSharedRemote();
+  }
+  else if (hasLocalSocket()){
     DBG("add/resume stream [%p] into RTP receiver\n",this);
     AmRtpReceiver::instance()->addStream(getLocalSocket(), this);
     if (l_rtcp_sd > 0) AmRtpReceiver::instance()->addStream(l_rtcp_sd, this);
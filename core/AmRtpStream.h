@@ -35,6 +35,8 @@
 #include "AmRtpPacket.h"
 #include "AmEvent.h"
 #include "AmDtmfSender.h"
+#include "AmRtcp.h"
+#include "sip/raw_sock.h"
 
 #include <netinet/in.h>
 
@@ -64,6 +66,9 @@ class  AmSession;
 struct SdpPayload;
 struct amci_payload_t;
 class msg_logger;
+class AmRtpPortMap;
+class AmRtpSharedSocket;
+class AmRtpPacer;
 
 /**
  * This provides the memory for the receive buffer.
@@ -87,6 +92,38 @@ private:
   unsigned int n_used;
 };
 
+/**
+ * \brief receive statistics of an RTP stream (RFC 3550 A.3, A.8)
+ */
+struct AmRtpReceiveStats
+{
+  bool           seq_i;
+  unsigned short max_seq;
+  unsigned int   cycles;
+  unsigned int   base_seq;
+  /** packets expected before the last sequence number restart */
+  unsigned int   prior_expected;
+
+  unsigned int   received;
+  /** packets received out of order or duplicated */
+  unsigned int   reordered;
+
+  /** interarrival jitter in timestamp units, scaled by 16 */
+  unsigned int   jitter;
+  bool           transit_i;
+  int            transit;
+
+  AmRtpReceiveStats();
+
+  /** account a received packet */
+  void update(unsigned short seq);
+  /** account the transit time of a received packet (timestamp units) */
+  void updateJitter(unsigned int rtp_ts, unsigned int arrival_ts);
+
+  unsigned int expected() const;
+  unsigned int lost() const;
+};
+
 /** \brief event fired on RTP timeout */
 class AmRtpTimeoutEvent
   : public AmEvent
@@ -100,6 +137,34 @@ public:
 
 /** helper class for assigning boolean floag to a payload ID
  * it is used to check if the payload should be relayed or not */
+#define RELAY_TRANSCODING_PTS 128
+
+/**
+ * \brief per received payload type: relayed as which payload type and
+ * translated through which table (see AmPayloadTranscoder)
+ *
+ * entry: out_pt | table ID << 8, 0 if not transcoded
+ */
+struct RelayTranscodingTable
+{
+  unsigned int entries[RELAY_TRANSCODING_PTS];
+
+  RelayTranscodingTable() { clear(); }
+
+  void clear() {
+    for (int i = 0; i < RELAY_TRANSCODING_PTS; i++)
+      entries[i] = 0;
+  }
+
+  void set(int in_pt, int out_pt, unsigned int table_id) {
+    if ((in_pt < 0) || (in_pt >= RELAY_TRANSCODING_PTS)) return;
+    entries[in_pt] = (out_pt & 0x7f) | (table_id << 8);
+  }
+
+  static unsigned char outPt(unsigned int entry) { return entry & 0x7f; }
+  static unsigned int tableId(unsigned int entry) { return entry >> 8; }
+};
+
 class PayloadMask
 {
   private:
@@ -207,15 +272,53 @@ protected:
   /** Local port */
   unsigned short     l_port;
 
+  /** port map l_port has been allocated from (NULL if given) */
+  AmRtpPortMap*      l_port_map;
+
   /** Local socket */
   int                l_sd;
 
   /** Local RTCP port */
   unsigned int l_rtcp_port;
 
-  /** Local RTCP socket */
+  /** Local RTCP socket (0 with rtcp-mux) */
   int          l_rtcp_sd;
 
+  /** shared sockets l_sd/l_rtcp_sd belong to (rtp_shared_ports) */
+  AmRtpSharedSocket* l_shared;
+  AmRtpSharedSocket* l_rtcp_shared;
+
+  /** RTCP is received and sent on the RTP port (RFC 5761) */
+  bool           rtcp_mux;
+
+  /** headers of relayed RTP/RTCP packets (use_raw_sockets) */
+  raw_udp4_tmpl  raw_tmpl;
+  raw_udp4_tmpl  raw_rtcp_tmpl;
+  /** headers of packets sent by the media processor (use_raw_sockets) */
+  raw_udp4_tmpl  raw_send_tmpl;
+  /** IP TOS of the raw packets (set by applyQoS) */
+  volatile unsigned char raw_tos;
+
+  /** pacer a packet is queued to (see AmRtpPacer) */
+  friend class AmRtpPacer;
+  AmRtpPacer*    pacer;
+
+  /** drop the packets queued for pacing */
+  void cancelPaced();
+
+  /** set DSCP/SO_PRIORITY of the sockets for relayed or local streams */
+  void applyQoS();
+
+  /** send the packet now, or queue it in the pacer of the thread */
+  int sendPacket(AmRtpPacket& rp, raw_udp4_tmpl* tmpl);
+
+  /**
+   * Drop the frames queued to be sent by another thread (see
+   * AmRtpAudio). Called with the stream's media lock held, before
+   * anything send() uses (payloads, addresses, sockets) changes.
+   */
+  virtual void cancelPendingSends() {}
+
   /** Timestamp of the last received RTP packet */
   struct timeval last_recv_time;
 
@@ -234,6 +337,18 @@ protected:
   /** marker flag */
   bool           begin_talk;
 
+  /** sequence number and arrival time of the last received packet */
+  unsigned short last_recv_seq;
+  struct timeval last_recv_arrival;
+
+  /** statistics of the received packets */
+  AmRtpReceiveStats recv_stats;
+
+  /** RTCP reports and quality metrics */
+  AmRtcp         rtcp;
+  /** wallclock time of the next RTCP report, 0 if not scheduled yet */
+  unsigned long long rtcp_next_ts;
+
   /** do check rtp timeout */
   bool           monitor_rtp_timeout;
 
@@ -294,6 +409,16 @@ protected:
 
   void relay(AmRtpPacket* p);
 
+  /** handle a received RTP packet */
+  void processPacket(AmRtpPacket* p);
+
+  /** handle a received RTCP packet (relay it) */
+  void processRtcpPacket(unsigned char* buffer, int len,
+			 struct sockaddr_storage* recv_addr);
+
+  /** set the remote addresses on the shared sockets */
+  void setSharedRemote();
+
   /** Sets generic parameters on SDP media */
   void getSdp(SdpMedia& m);
 
@@ -301,6 +426,14 @@ protected:
   void clearRTPTimeout(struct timeval* recv_time);
 
   PayloadMask relay_payloads;
+
+  /**
+   * Payloads relayed with compressed domain transcoding, per received
+   * payload type (see RelayTranscodingTable). Entries are single words,
+   * written by the session thread and read by the RTP receiver thread.
+   */
+  volatile unsigned int relay_transcoding[RELAY_TRANSCODING_PTS];
+
   bool offer_answer_used;
 
   /** set to true if any data received */
@@ -358,6 +491,10 @@ public:
 
   void recvRtcpPacket();
 
+  /** packet received on a shared socket (AmRtpSharedSocket) */
+  void recvSharedPacket(unsigned char* buffer, int len,
+			struct sockaddr_storage* recv_addr, bool rtcp);
+
   /** ping the remote side, to open NATs and enable symmetric RTP */
   int ping();
 
@@ -375,8 +512,9 @@ public:
   void setLocalIP(const string& ip);
 	    
   /** 
-   * Initializes with a new random local port if 'p' is 0,
-   * else binds the given port, and sets own attributes properly. 
+   * Initializes with a new local port if 'p' is 0 (a pooled socket
+   * pair if there is one for the local IP), else binds the given
+   * port, and sets own attributes properly.
    */
   void setLocalPort(unsigned short p = 0);
 
@@ -410,6 +548,14 @@ public:
   void setRAddr(const string& addr, unsigned short port,
 		unsigned short rtcp_port = 0);
 
+  /**
+   * Use rtcp-mux (RFC 5761): RTCP is sent to the remote RTP port and
+   * received on the local RTP port. The RTCP socket is closed (or
+   * bound again if rtcp-mux is switched off).
+   */
+  void setRtcpMux(bool mux);
+  bool getRtcpMux() { return rtcp_mux; }
+
   /** Symmetric RTP & RTCP: passive mode ? */
   void setPassiveMode(bool p);
   bool getPassiveMode() { return passive || passive_rtcp; }
@@ -425,6 +571,19 @@ public:
   void forceSdpMediaIndex(int idx) { sdp_media_index = idx; offer_answer_used = false; }
   int getPayloadType() { return payload; }
   int getLastPayload() { return last_payload; }
+  const AmRtpReceiveStats& getReceiveStats() const { return recv_stats; }
+
+  /** RTCP reports received/sent and the quality reported by the peer */
+  void getRtcpStats(AmArg& stats) { rtcp.getStats(stats); }
+
+  /**
+   * Send an RTCP report (SR/RR) to the peer if one is due.
+   * Streams relaying RTP pass on the peer's reports instead.
+   * @param system_ts wallclock time
+   * @param rtp_ts RTP timestamp of system_ts
+   */
+  void sendRtcpReport(unsigned long long system_ts, unsigned int rtp_ts);
+
   string getPayloadName(int payload_type);
 
   /**
@@ -480,6 +639,13 @@ public:
   /** set relay payloads for  RTP relaying */
   void setRelayPayloads(const PayloadMask &_relay_payloads);
 
+  /**
+   * Set the payloads relayed with compressed domain transcoding.
+   * Entries not changed are not touched, so packets being relayed
+   * meanwhile see either the old or the new entry.
+   */
+  void setRelayTranscoding(const RelayTranscodingTable& table);
+
   /** ensable RTP relaying through relay stream */
   void enableRtpRelay();
 
@@ -550,6 +550,31 @@ void SdpMedia::calcAnswer(const AmPayloadProvider* payload_prov,
   }
 }
 
+bool SdpMedia::hasRtcpMux() const
+{
+  for (vector<SdpAttribute>::const_iterator a = attributes.begin();
+       a != attributes.end(); ++a) {
+    if (a->attribute == "rtcp-mux")
+      return true;
+  }
+  return false;
+}
+
+void SdpMedia::setRtcpMux(bool mux)
+{
+  vector<SdpAttribute>::iterator a = attributes.begin();
+  while (a != attributes.end()) {
+    if (a->attribute == "rtcp-mux") {
+      if (mux) return;
+      a = attributes.erase(a);
+    }
+    else ++a;
+  }
+
+  if (mux)
+    attributes.push_back(SdpAttribute("rtcp-mux"));
+}
+
 //parser
 static bool parse_sdp_line_ex(AmSdp* sdp_msg, char*& s)
 {
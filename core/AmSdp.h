@@ -203,6 +203,10 @@ struct SdpMedia
    */
   void calcAnswer(const AmPayloadProvider* payload_prov, 
 		  SdpMedia& answer) const;
+
+  /** a=rtcp-mux (RFC 5761): RTCP is sent to the RTP port */
+  bool hasRtcpMux() const;
+  void setRtcpMux(bool mux);
 };
 
 /**
@@ -37,6 +37,7 @@
 #include "AmDtmfDetector.h"
 #include "AmPlayoutBuffer.h"
 #include "AmAppTimer.h"
+#include "AmLatencyStats.h"
 
 #ifdef WITH_ZRTP
 #include "AmZRTP.h"
@@ -86,6 +87,10 @@ AmSession::AmSession(AmSipDialog* p_dlg)
   DBG("dlg = %p",dlg);
   if(!dlg) dlg = new AmSipDialog(this);
   else dlg->setEventhandler(this);
+
+#ifndef SESSION_THREADPOOL
+  setThreadName("session");
+#endif
 }
 
 AmSession::~AmSession()
@@ -268,7 +273,10 @@ void AmSession::run() {
   DBG("running session event loop\n");
   while (true) {
     waitForEvent();
-    if (!processingCycle())
+    unsigned long long start = AmLatencyStats::start();
+    bool running = processingCycle();
+    AmLatencyStats::recordSince(LAT_SESSION_CYCLE, start);
+    if (!running)
       break;
   }
 
@@ -1379,7 +1387,21 @@ int AmSession::writeStreams(unsigned long long ts, unsigned char *buffer)
   if (stream->sendIntReached()) { // FIXME: shouldn't depend on checkInterval call before!
     unsigned int f_size = stream->getFrameSize();
     int got = 0;
-    if (output) got = output->get(ts, buffer, stream->getSampleRate(), f_size);
+
+    if (output) {
+      // pre-encoded frames (prompt cache)
+      got = output->getEncoded(ts, buffer, stream->getCodecId(),
+			       stream->getSampleRate(), f_size);
+      if (got != AUDIO_NOT_ENCODED) {
+	if (got < 0) res = -1;
+	if (got > 0) res = stream->putEncoded(ts, buffer, got);
+	unlockAudio();
+	return res;
+      }
+
+      got = output->get(ts, buffer, stream->getSampleRate(), f_size);
+    }
+
     if (got < 0) res = -1;
     if (got > 0) res = stream->put(ts, buffer, stream->getSampleRate(), got);
   }
@@ -31,6 +31,7 @@
 
 #include "AmSessionProcessor.h"
 #include "AmSession.h"
+#include "AmLatencyStats.h"
 
 #include <vector>
 #include <list>
@@ -75,6 +76,8 @@ void AmSessionProcessor::addThreads(unsigned int num_threads) {
 AmSessionProcessorThread::AmSessionProcessorThread() 
   : events(this), runcond(false)
 {
+  setThreadName("session-proc");
+  setEventQueue(&events);
 }
 
 AmSessionProcessorThread::~AmSessionProcessorThread() {
@@ -134,9 +137,15 @@ void AmSessionProcessorThread::run() {
 
     std::list<AmSession*>::iterator it=sessions.begin();
     while (it != sessions.end()) {
-      if ((pending_process_sessions.find(*it)!=
-	      pending_process_sessions.end()) &&
-	  (!(*it)->processingCycle())) {
+      bool running = true;
+      if (pending_process_sessions.find(*it)!=
+	  pending_process_sessions.end()) {
+	unsigned long long start = AmLatencyStats::start();
+	running = (*it)->processingCycle();
+	AmLatencyStats::recordSince(LAT_SESSION_CYCLE, start);
+      }
+
+      if (!running) {
 	fin_sessions.push_back(*it);
 	std::list<AmSession*>::iterator d_it = it;
 	it++;
@@ -26,11 +26,21 @@
  */
 
 #include "AmThread.h"
+#include "AmEventQueue.h"
+#include "AmArg.h"
 #include "log.h"
 
 #include <unistd.h>
 #include "errno.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <cxxabi.h>
+#include <typeinfo>
 #include <string>
+#include <map>
+#include <vector>
 using std::string;
 
 AmMutex::AmMutex() 
@@ -53,19 +63,53 @@ void AmMutex::unlock()
   pthread_mutex_unlock(&m);
 }
 
+/*
+ * Registry entry of a running thread. getThreadStats() holds a
+ * reference while it reads the statistics without _threads_mut,
+ * so that the entry outlives the thread object if necessary.
+ */
+struct AmThread::ThreadEntry
+{
+  string    role;
+  char      name[16];
+  /* kernel thread ID and CPU time clock */
+  pid_t     tid;
+  clockid_t cpu_clock;
+
+  /* the thread and getThreadStats() calls (protected by _threads_mut),
+     the last one deletes the entry */
+  unsigned int refs;
+
+  /* protects the members below */
+  AmMutex       mut;
+  /* reset when the thread ends */
+  AmEventQueue* queue;
+  /* CPU time at the last getThreadStats() */
+  unsigned long long last_cpu;
+  unsigned long long last_sample;
+};
+
+AmMutex                          AmThread::_threads_mut;
+std::set<AmThread::ThreadEntry*> AmThread::_threads;
+
 AmThread::AmThread()
-  : _stopped(true)
+  : _stopped(true),
+    _queue(NULL),
+    _entry(NULL)
 {
+  _name[0] = '\0';
 }
 
 void * AmThread::_start(void * _t)
 {
   AmThread* _this = (AmThread*)_t;
   _this->_pid = (unsigned long) _this->_td;
+  _this->registerThread();
   DBG("Thread %lu is starting.\n", (unsigned long) _this->_pid);
   _this->run();
 
   DBG("Thread %lu is ending.\n", (unsigned long) _this->_pid);
+  _this->unregisterThread();
   _this->_stopped.set(true);
     
   return NULL;
@@ -181,6 +225,202 @@ int AmThread::setRealtime() {
 }
 
 
+void AmThread::setThreadName(const char* name)
+{
+  strncpy(_name, name, sizeof(_name) - 1);
+  _name[sizeof(_name) - 1] = '\0';
+}
+
+/** class name of the thread object */
+static string thread_role(AmThread* t)
+{
+  const char* mangled = typeid(*t).name();
+  int status = 0;
+  char* name = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+  if (!name)
+    return mangled;
+
+  string res = name;
+  free(name);
+  return res;
+}
+
+static unsigned long long monotonic_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void AmThread::registerThread()
+{
+  if (!_name[0]) {
+    string role = thread_role(this);
+    setThreadName(role.c_str() + role.find_first_not_of('_'));
+  }
+  pthread_setname_np(pthread_self(), _name);
+
+  if (!_queue)
+    _queue = dynamic_cast<AmEventQueue*>(this);
+
+  ThreadEntry* e = new ThreadEntry();
+  e->role = thread_role(this);
+  memcpy(e->name, _name, sizeof(e->name));
+  e->tid = (pid_t)syscall(SYS_gettid);
+  if (pthread_getcpuclockid(pthread_self(), &e->cpu_clock))
+    e->cpu_clock = (clockid_t)-1;
+  e->refs = 1;
+  e->queue = _queue;
+  e->last_cpu = 0;
+  e->last_sample = monotonic_us();
+
+  _threads_mut.lock();
+  _entry = e;
+  _threads.insert(e);
+  _threads_mut.unlock();
+}
+
+void AmThread::unregisterThread()
+{
+  ThreadEntry* e = _entry;
+
+  // waits for a getThreadStats() reading the queue
+  e->mut.lock();
+  e->queue = NULL;
+  e->mut.unlock();
+
+  _threads_mut.lock();
+  _threads.erase(e);
+  _entry = NULL;
+  bool last = !--e->refs;
+  _threads_mut.unlock();
+
+  if (last)
+    delete e;
+}
+
+/* voluntary/involuntary context switches of a thread of this process */
+static void read_ctxt_switches(pid_t tid, unsigned long long& vol,
+			       unsigned long long& invol)
+{
+  char path[64];
+  char line[128];
+
+  vol = invol = 0;
+  snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)tid);
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return;
+
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "voluntary_ctxt_switches: %llu", &vol) == 1)
+      continue;
+    sscanf(line, "nonvoluntary_ctxt_switches: %llu", &invol);
+  }
+  fclose(f);
+}
+
+// called without _threads_mut: the thread may have ended
+void AmThread::getEntryStats(ThreadEntry* e, AmArg& stats,
+			     unsigned long long now)
+{
+  unsigned long long cpu = 0;
+  struct timespec ts;
+  if ((e->cpu_clock != (clockid_t)-1) && !clock_gettime(e->cpu_clock, &ts))
+    cpu = (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+
+  unsigned long long vol, invol;
+  read_ctxt_switches(e->tid, vol, invol);
+
+  e->mut.lock();
+  double cpu_pct = 0.0;
+  if ((now > e->last_sample) && (cpu >= e->last_cpu))
+    cpu_pct = (double)(cpu - e->last_cpu) * 100.0 / (double)(now - e->last_sample);
+  e->last_cpu = cpu;
+  e->last_sample = now;
+
+  bool has_queue = e->queue != NULL;
+  unsigned int queue = has_queue ? e->queue->getQueueSize() : 0;
+  e->mut.unlock();
+
+  stats["role"]      = e->role.c_str();
+  stats["name"]      = e->name;
+  stats["tid"]       = (int)e->tid;
+  stats["cpu_ms"]    = (long long)(cpu / 1000);
+  stats["cpu_pct"]   = cpu_pct;
+  stats["wakeups"]   = (long long)vol;
+  stats["preempted"] = (long long)invol;
+  if (has_queue)
+    stats["queue"]   = (int)queue;
+}
+
+struct thread_role_stats
+{
+  int                threads;
+  unsigned long long cpu_ms;
+  double             cpu_pct;
+  unsigned long long queue;
+
+  thread_role_stats() : threads(0), cpu_ms(0), cpu_pct(0.0), queue(0) {}
+};
+
+void AmThread::getThreadStats(AmArg& stats)
+{
+  std::map<string, thread_role_stats> roles;
+
+  stats["threads"].assertArray();
+  stats["roles"].assertStruct();
+
+  // the /proc files and event queues are read without the lock
+  std::vector<ThreadEntry*> entries;
+  _threads_mut.lock();
+  for (std::set<ThreadEntry*>::iterator it = _threads.begin();
+       it != _threads.end(); ++it) {
+    (*it)->refs++;
+    entries.push_back(*it);
+  }
+  _threads_mut.unlock();
+
+  unsigned long long now = monotonic_us();
+  for (std::vector<ThreadEntry*>::iterator it = entries.begin();
+       it != entries.end(); ++it) {
+
+    AmArg t;
+    getEntryStats(*it, t, now);
+
+    thread_role_stats& r = roles[t["role"].asCStr()];
+    r.threads++;
+    r.cpu_ms  += t["cpu_ms"].asLongLong();
+    r.cpu_pct += t["cpu_pct"].asDouble();
+    if (t.hasMember("queue"))
+      r.queue += t["queue"].asInt();
+
+    stats["threads"].push(t);
+  }
+
+  std::vector<ThreadEntry*> ended;
+  _threads_mut.lock();
+  for (std::vector<ThreadEntry*>::iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    if (!--(*it)->refs)
+      ended.push_back(*it);
+  }
+  _threads_mut.unlock();
+
+  for (std::vector<ThreadEntry*>::iterator it = ended.begin();
+       it != ended.end(); ++it)
+    delete *it;
+
+  for (std::map<string, thread_role_stats>::iterator it = roles.begin();
+       it != roles.end(); ++it) {
+    AmArg& r = stats["roles"][it->first];
+    r["threads"] = it->second.threads;
+    r["cpu_ms"]  = (long long)it->second.cpu_ms;
+    r["cpu_pct"] = it->second.cpu_pct;
+    r["queue"]   = (long long)it->second.queue;
+  }
+}
+
 AmThreadWatcher* AmThreadWatcher::_instance=0;
 AmMutex AmThreadWatcher::_inst_mut;
 
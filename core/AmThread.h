@@ -33,7 +33,14 @@
 #include <time.h>
 #include <errno.h>
 
+#include <sys/types.h>
+
 #include <queue>
+#include <set>
+#include <string>
+
+class AmArg;
+class AmEventQueue;
 
 /**
  * \brief C++ Wrapper class for pthread mutex
@@ -186,6 +193,10 @@ public:
 
 /**
  * \brief C++ Wrapper class for pthread
+ *
+ * Running threads are registered with their role (class name),
+ * name, CPU time, context switches and the backlog of their event
+ * queue (see getThreadStats).
  */
 class AmThread
 {
@@ -194,8 +205,25 @@ class AmThread
 
   AmSharedVar<bool> _stopped;
 
+  /* thread name (pthread_setname_np: max. 15 chars) */
+  char          _name[16];
+  /* event queue processed by the thread, if any */
+  AmEventQueue* _queue;
+
+  /* registry entry while the thread is running */
+  struct ThreadEntry;
+  ThreadEntry*  _entry;
+
+  static AmMutex                _threads_mut;
+  static std::set<ThreadEntry*> _threads;
+
   static void* _start(void*);
 
+  void registerThread();
+  void unregisterThread();
+  static void getEntryStats(ThreadEntry* e, AmArg& stats,
+			    unsigned long long now);
+
 protected:
   virtual void run()=0;
   virtual void on_stop()=0;
@@ -219,6 +247,20 @@ public:
   void cancel();
 
   int setRealtime();
+
+  /** set the thread's name (before start()) */
+  void setThreadName(const char* name);
+  /** set the event queue processed by the thread (before start(),
+      threads derived from AmEventQueue are found automatically) */
+  void setEventQueue(AmEventQueue* q) { _queue = q; }
+
+  /**
+   * All running threads: role, name, tid, cpu_ms, cpu_pct (since
+   * the previous call), wakeups/preempted (voluntary/involuntary
+   * context switches), queue (event queue backlog); and per role
+   * the sums.
+   */
+  static void getThreadStats(AmArg& stats);
 };
 
 /**
@@ -57,6 +57,7 @@
 #include "AmSipDispatcher.h"
 #include "AmEventDispatcher.h"
 #include "AmSipEvent.h"
+#include "AmLatencyStats.h"
 
 bool _SipCtrlInterface::log_parsed_messages = true;
 int _SipCtrlInterface::udp_rcvbuf = -1;
@@ -782,6 +783,7 @@ void _SipCtrlInterface::handle_sip_request(const trans_ticket& tt, sip_msg* msg)
 	DBG("body-ct = <%s>\n",req.body.getCTStr().c_str());
     }
 
+    AmLatencyStats::recordSince(LAT_SIP_DISPATCH, msg->recv_time);
     AmSipDispatcher::instance()->handleSipMsg(req);
 
     DBG("^^ M [%s|%s] Ru SIP request %s handled ^^\n",
@@ -821,6 +823,7 @@ void _SipCtrlInterface::handle_sip_reply(const string& dialog_id, sip_msg* msg)
     DBG("hdrs = <%s>\n",reply.hdrs.c_str());
     DBG("body-ct = <%s>\n",reply.body.getCTStr().c_str());
 
+    AmLatencyStats::recordSince(LAT_SIP_DISPATCH, msg->recv_time);
     AmSipDispatcher::instance()->handleSipMsg(dialog_id, reply);
 
     DBG("^^ M [%s|%s] ru SIP reply %u %s handled ^^\n",
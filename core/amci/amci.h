@@ -132,6 +132,38 @@ typedef int (*amci_converter_t)( unsigned char* out,
 				 long           h_codec
                                );
 
+/**
+ * \brief Batch sound converter function pointer.
+ *
+ * Converts n independent buffers (e.g. of different calls), each
+ * with its own codec instance, in one call. Other than the number of
+ * calls saved, the codec may process several buffers at once.
+ *
+ * @param out      [out] output buffers
+ * @param in       [in] input buffers
+ * @param size     [in/out] sizes of the input buffers; on return, the
+ *                 bytes written in each output buffer or err < 0
+ * @param n        [in] number of buffers
+ * @param channels [in] number of channels (same for all buffers)
+ * @param rate     [in] sampling rate (same for all buffers)
+ * @param h_codecs [in] codec handles
+ * @return
+ *     <ul>
+ *     <li>if sucess:  0 (see size for the single buffers)
+ *     <li>if failure: err < 0 (nothing converted)
+ *     </ul>
+ * @see amci_codec_t::encode_batch
+ * @see amci_codec_t::decode_batch
+ */
+typedef int (*amci_batch_converter_t)( unsigned char** out,
+				       unsigned char** in,
+				       int*            size,
+				       unsigned int    n,
+				       unsigned int    channels,
+				       unsigned int    rate,
+				       long*           h_codecs
+				     );
+
 /**
  * \brief Codec specific packet loss concealment function pointer.
  * @param out      [out] output buffer
@@ -302,6 +334,12 @@ struct amci_codec_t {
 
     /** Function for calculating the number of samples from bytes. */
     amci_codec_samples2bytes_t samples2bytes;
+
+    /** Batch version of encode, can be NULL (see CODEC_BATCH). */
+    amci_batch_converter_t encode_batch;
+
+    /** Batch version of decode, can be NULL (see CODEC_BATCH). */
+    amci_batch_converter_t decode_batch;
 };
   
   /** \brief supported subtypes for a file */
@@ -464,7 +502,7 @@ struct amci_exports_t {
  * @hideinitializer
  */
 #define END_CODECS \
-                    { -1, 0, 0, 0, 0, 0, 0, 0 } \
+                    { -1, 0, 0, 0, 0, 0, 0, 0, 0, 0 } \
                 },
 
 /**
@@ -473,7 +511,17 @@ struct amci_exports_t {
  * @hideinitializer
  */
 #define CODEC(id, intern2type,type2intern,plc,init,destroy,bytes2samples,samples2bytes) \
-                    { id, intern2type, type2intern, plc, init, destroy, bytes2samples, samples2bytes },
+                    { id, intern2type, type2intern, plc, init, destroy, bytes2samples, samples2bytes, 0, 0 },
+
+/**
+ * Portable export definition macro for codecs with batch converters
+ * see media plug-in 'wav' (plug-in/wav/wav.c).
+ * @hideinitializer
+ */
+#define CODEC_BATCH(id, intern2type,type2intern,plc,init,destroy,bytes2samples,samples2bytes, \
+		    intern2type_batch,type2intern_batch)			\
+                    { id, intern2type, type2intern, plc, init, destroy, bytes2samples, samples2bytes, \
+		      intern2type_batch, type2intern_batch },
 
 /**
  * Portable export definition macro
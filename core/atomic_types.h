@@ -65,6 +65,11 @@ public:
   unsigned int dec(unsigned int sub=1) {
     return __sync_sub_and_fetch(&i,sub);
   }
+
+  // if (i == oldval) { i = newval; return true; } return false;
+  bool cas(unsigned int oldval, unsigned int newval) {
+    return __sync_bool_compare_and_swap(&i,oldval,newval);
+  }
 #else // if HAVE_ATOMIC_CAS
   // ++i;
   unsigned int inc(unsigned int add=1) {
@@ -83,8 +88,35 @@ public:
     unlock();
     return res;
   }
+
+  // if (i == oldval) { i = newval; return true; } return false;
+  bool cas(unsigned int oldval, unsigned int newval) {
+    bool res = false;
+    lock();
+    if(i == oldval) {
+      i = newval;
+      res = true;
+    }
+    unlock();
+    return res;
+  }
 #endif
 
+  // ++i if i < limit; returns whether incremented
+  bool inc_if_below(unsigned int limit, unsigned int& res) {
+    unsigned int old_i;
+    do {
+      old_i = i;
+      if(old_i >= limit) {
+	res = old_i;
+	return false;
+      }
+    } while(!cas(old_i, old_i+1));
+
+    res = old_i+1;
+    return true;
+  }
+
   // return --ll != 0;
   bool dec_and_test() {
     return dec() == 0;
@@ -139,6 +171,11 @@ public:
     return __sync_sub_and_fetch(&ll,sub);
   }
 
+  // if (ll == oldval) { ll = newval; return true; } return false;
+  bool cas(unsigned long long oldval, unsigned long long newval) {
+    return __sync_bool_compare_and_swap(&ll,oldval,newval);
+  }
+
 #else // if HAVE_ATOMIC_CAS
 
   void set(unsigned long long val) {
@@ -180,6 +217,18 @@ public:
     unlock();
     return res;
   }
+
+  // if (ll == oldval) { ll = newval; return true; } return false;
+  bool cas(unsigned long long oldval, unsigned long long newval) {
+    bool res = false;
+    lock();
+    if(ll == oldval) {
+      ll = newval;
+      res = true;
+    }
+    unlock();
+    return res;
+  }
 #endif
 
   // return --ll == 0;
@@ -36,6 +36,13 @@ int Pcm16_2_G722NB( unsigned char* out_buf, unsigned char* in_buf, unsigned int
 int G722NB_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 		     unsigned int channels, unsigned int rate, long h_codec );
 
+int Pcm16_2_G722NB_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			  unsigned int n, unsigned int channels, unsigned int rate,
+			  long* h_codecs );
+int G722NB_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			  unsigned int n, unsigned int channels, unsigned int rate,
+			  long* h_codecs );
+
 long G722NB_create(const char* format_parameters, amci_codec_fmt_info_t* format_description);
 void G722NB_destroy(long handle);
 
@@ -45,9 +52,10 @@ static unsigned int G722NB_samples2bytes(long, unsigned int);
 BEGIN_EXPORTS("g722", AMCI_NO_MODULEINIT, AMCI_NO_MODULEDESTROY)
 
   BEGIN_CODECS
-    CODEC(CODEC_G722_NB, Pcm16_2_G722NB, G722NB_2_Pcm16, AMCI_NO_CODEC_PLC,
+    CODEC_BATCH(CODEC_G722_NB, Pcm16_2_G722NB, G722NB_2_Pcm16, AMCI_NO_CODEC_PLC,
           G722NB_create, G722NB_destroy,
-          G722NB_bytes2samples, G722NB_samples2bytes)
+          G722NB_bytes2samples, G722NB_samples2bytes,
+          Pcm16_2_G722NB_batch, G722NB_2_Pcm16_batch)
   END_CODECS
   
   BEGIN_PAYLOADS
@@ -180,3 +188,54 @@ int G722NB_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned int
 
   return g722_decode(gs->decode_state, (signed short*)out_buf, in_buf, size) << 1;
 }
+
+/*
+  The spandsp coder state is opaque, so the channels are still coded
+  one after the other; the batch versions only save the per frame
+  calls and checks.
+*/
+int Pcm16_2_G722NB_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			  unsigned int n, unsigned int channels, unsigned int rate,
+			  long* h_codecs )
+{
+  unsigned int i;
+
+  if (channels!=1) {
+    ERROR("only supports 1 channel\n");
+    return -1;
+  }
+
+  if (rate != 16000 /* 8000 */) {
+    ERROR("only supports NB (8khz)\n");
+    return -1;
+  }
+
+  for (i = 0; i < n; i++) {
+    size[i] = g722_encode(((G722State*)h_codecs[i])->encode_state, out_buf[i],
+			  (signed short*)in_buf[i], size[i] >> 1);
+  }
+  return 0;
+}
+
+int G722NB_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			  unsigned int n, unsigned int channels, unsigned int rate,
+			  long* h_codecs )
+{
+  unsigned int i;
+
+  if (channels!=1) {
+    ERROR("only supports 1 channel\n");
+    return -1;
+  }
+
+  if (rate != 16000 /* 8000 */) {
+    ERROR("only supports NB (8khz)\n");
+    return -1;
+  }
+
+  for (i = 0; i < n; i++) {
+    size[i] = g722_decode(((G722State*)h_codecs[i])->decode_state,
+			  (signed short*)out_buf[i], in_buf[i], size[i]) << 1;
+  }
+  return 0;
+}
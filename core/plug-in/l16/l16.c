@@ -41,6 +41,7 @@
 
 #include "amci.h"
 #include "codecs.h"
+#include "l16_swap.h"
 #include "../../log.h"
 
 static int Pcm16_2_L16(unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
@@ -49,15 +50,20 @@ static int Pcm16_2_L16(unsigned char* out_buf, unsigned char* in_buf, unsigned i
 static int L16_2_Pcm16(unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 		       unsigned int channels, unsigned int rate, long h_codec);
 
+static int Pcm16_2_L16_batch(unsigned char** out_buf, unsigned char** in_buf, int* size,
+			     unsigned int n, unsigned int channels, unsigned int rate,
+			     long* h_codecs);
+
 static unsigned int L16_bytes2samples(long, unsigned int);
 static unsigned int L16_samples2bytes(long, unsigned int);
 
 BEGIN_EXPORTS( "l16" , AMCI_NO_MODULEINIT, AMCI_NO_MODULEDESTROY )
 
   BEGIN_CODECS
-    CODEC( CODEC_L16, Pcm16_2_L16, L16_2_Pcm16,
+    CODEC_BATCH( CODEC_L16, Pcm16_2_L16, L16_2_Pcm16,
            AMCI_NO_CODEC_PLC, AMCI_NO_CODECCREATE, AMCI_NO_CODECDESTROY,
-           L16_bytes2samples, L16_samples2bytes )
+           L16_bytes2samples, L16_samples2bytes,
+           Pcm16_2_L16_batch, Pcm16_2_L16_batch )
   END_CODECS
 
   BEGIN_PAYLOADS
@@ -88,13 +94,7 @@ static unsigned int L16_samples2bytes(long h_codec, unsigned int num_samples)
 static int L16_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 			 unsigned int channels, unsigned int rate, long h_codec )
 {
-  short* out_b = (short*)out_buf;
-  short* in_b  = (short*)in_buf;
-  short* end   = in_b + size / 2;
-
-  while(in_b != end)
-    *(out_b++) = ntohs(*(in_b++));
-  
+  l16_swap((uint16_t*)out_buf, (uint16_t*)in_buf, size / 2);
   return size;
 }
 
@@ -102,14 +102,17 @@ static int L16_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned
 static int Pcm16_2_L16( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 			unsigned int channels, unsigned int rate, long h_codec )
 {
-  short* out_b         = (short*)out_buf;
-  short* in_b          = (short*)(in_buf);
-  short* end           = in_b + size / 2;
-
-  while(in_b != end)
-    *(out_b++) = htons(*(in_b++));
-
+  l16_swap((uint16_t*)out_buf, (uint16_t*)in_buf, size / 2);
   return size;
 }
 
 
+
+/* byte swapping in both directions */
+static int Pcm16_2_L16_batch(unsigned char** out_buf, unsigned char** in_buf, int* size,
+			     unsigned int n, unsigned int channels, unsigned int rate,
+			     long* h_codecs)
+{
+  l16_swap_batch((uint16_t**)out_buf, (uint16_t**)in_buf, size, n);
+  return 0;
+}
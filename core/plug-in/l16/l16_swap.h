@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Host <-> network byte order conversion of 16 bit sample buffers,
+ * with SSSE3/AVX2 byte shuffles on x86 (selected at runtime).
+ */
+
+#ifndef _l16_swap_h_
+#define _l16_swap_h_
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define L16_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define L16_SIMD_NONE  0
+#define L16_SIMD_SSSE3 1
+#define L16_SIMD_AVX2  2
+
+static int l16_simd = -1;
+
+static inline int l16_simd_level(void)
+{
+  if (l16_simd < 0) {
+#ifdef L16_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      l16_simd = L16_SIMD_AVX2;
+    else if (__builtin_cpu_supports("ssse3"))
+      l16_simd = L16_SIMD_SSSE3;
+    else
+#endif
+      l16_simd = L16_SIMD_NONE;
+  }
+  return l16_simd;
+}
+
+/** limit the vector instructions used (for testing/benchmarking) */
+static inline void l16_simd_set_level(int level)
+{
+  int max;
+
+  l16_simd = -1;
+  max = l16_simd_level();
+  l16_simd = level < max ? level : max;
+}
+
+static inline void l16_swap_c(uint16_t* out, const uint16_t* in, unsigned int n)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++)
+    out[i] = htons(in[i]);
+}
+
+#ifdef L16_X86_SIMD
+
+#define L16_SWAP_MASK 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14
+
+static __attribute__((target("ssse3")))
+void l16_swap_ssse3(uint16_t* out, const uint16_t* in, unsigned int n)
+{
+  const __m128i m = _mm_setr_epi8(L16_SWAP_MASK);
+  unsigned int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+    _mm_storeu_si128((__m128i*)(out + i), _mm_shuffle_epi8(x, m));
+  }
+  l16_swap_c(out + i, in + i, n - i);
+}
+
+static __attribute__((target("avx2")))
+void l16_swap_avx2(uint16_t* out, const uint16_t* in, unsigned int n)
+{
+  const __m256i m = _mm256_setr_epi8(L16_SWAP_MASK, L16_SWAP_MASK);
+  unsigned int i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_shuffle_epi8(x, m));
+  }
+  l16_swap_c(out + i, in + i, n - i);
+}
+
+#endif
+
+/**
+ * Convert n samples between host and network byte order
+ * (out may be the same as in).
+ */
+static inline void l16_swap(uint16_t* out, const uint16_t* in, unsigned int n)
+{
+#ifdef L16_X86_SIMD
+  switch (l16_simd_level()) {
+  case L16_SIMD_AVX2:  l16_swap_avx2(out, in, n);  return;
+  case L16_SIMD_SSSE3: l16_swap_ssse3(out, in, n); return;
+  default: break;
+  }
+#endif
+  l16_swap_c(out, in, n);
+}
+
+/**
+ * Convert count buffers of size[i] bytes each,
+ * with the vector code selected once for all of them.
+ */
+static inline void l16_swap_batch(uint16_t** out, uint16_t** in, const int* size,
+				  unsigned int count)
+{
+  unsigned int i;
+
+#ifdef L16_X86_SIMD
+  switch (l16_simd_level()) {
+  case L16_SIMD_AVX2:
+    for (i = 0; i < count; i++)
+      l16_swap_avx2(out[i], in[i], size[i] / 2);
+    return;
+  case L16_SIMD_SSSE3:
+    for (i = 0; i < count; i++)
+      l16_swap_ssse3(out[i], in[i], size[i] / 2);
+    return;
+  default: break;
+  }
+#endif
+  for (i = 0; i < count; i++)
+    l16_swap_c(out[i], in[i], size[i] / 2);
+}
+
+#endif
@@ -35,6 +35,15 @@
 #include "log.h"
 #include "AmPlugIn.h"
 #include "AmApi.h"
+#include "AmRecordingWriter.h"
+#include "sip/msg_log_writer.h"
+#include "sip/raw_sender.h"
+#include "sip/tr_blacklist.h"
+#include "AmRtpPacer.h"
+#include "AmCodecStats.h"
+#include "AmRtpPortMap.h"
+#include "AmRtcp.h"
+#include "AmLatencyStats.h"
 
 #include <string>
 using std::string;
@@ -299,6 +308,16 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
       "get_callsmax                       -  get maximum of active calls since the last query\n"
       "get_cpsavg                         -  get calls per second (5 sec average)\n"
       "get_cpsmax                         -  get maximum of CPS since the last query\n"
+      "get_recwriter                      -  get recording writer statistics\n"
+      "get_msglogger                      -  get message log writer statistics (written/dropped)\n"
+      "get_codecstats                     -  get time spent encoding/decoding per codec and thread\n"
+      "get_rtpports                       -  get RTP ports in use/quarantined/pooled per interface\n"
+      "get_rtcpstats                      -  get RTCP reports and reported loss/jitter/RTT per interface\n"
+      "get_rawsender                      -  get raw socket packets/syscalls/errors (use_raw_sockets)\n"
+      "get_blacklist                      -  get transport blacklist entries and hits/misses\n"
+      "get_rtppacing                      -  get RTP pacing queue depth/sent/dropped per interface\n"
+      "get_latency                        -  get latency percentiles (us) of SIP dispatch, INVITE->1xx, session cycle, media tick, event queue\n"
+      "get_threads                        -  get CPU time, context switches and event queue backlog per thread\n"
 
       "DI <factory> <function> (<args>)*  -  invoke DI command\n"
       "\n"
@@ -360,6 +379,57 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
       reply = "Average calls per second: " + int2str(sc->getAvgCPS()) + "\n";
     else if(cmd_str.substr(4, 6) == "cpsmax")
       reply = "Maximum calls per second: " + int2str(sc->getMaxCPS()) + "\n";
+    else if(cmd_str.substr(4, 9) == "recwriter") {
+      AmArg stats;
+      AmRecordingWriter::instance()->getStats(stats);
+      reply = "Recording writer: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 9) == "msglogger") {
+      AmArg stats;
+      msg_log_writer::instance()->getStats(stats);
+      reply = "Message log writer: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 10) == "codecstats") {
+      AmArg stats;
+      AmCodecStats::getStats(stats);
+      reply = "Codec statistics: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 8) == "rtpports") {
+      AmArg stats;
+      for (unsigned int i = 0; i < AmConfig::RTP_Ifs.size(); i++)
+	AmConfig::RTP_Ifs[i].getPortMap()->getStats(stats[AmConfig::RTP_Ifs[i].name]);
+      reply = "RTP ports: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 9) == "rtcpstats") {
+      AmArg stats;
+      AmRtcp::getTotals(stats);
+      reply = "RTCP statistics: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 9) == "rawsender") {
+      AmArg stats;
+      raw_sender::getStats(stats);
+      reply = "Raw sender: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 9) == "blacklist") {
+      AmArg stats;
+      tr_blacklist::instance()->getStats(stats);
+      reply = "Transport blacklist: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 9) == "rtppacing") {
+      AmArg stats;
+      AmRtpPacer::getStats(stats);
+      reply = "RTP pacing: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 7) == "latency") {
+      AmArg stats;
+      AmLatencyStats::getStats(stats);
+      reply = "Latency: " + AmArg::print(stats) + "\n";
+    }
+    else if(cmd_str.substr(4, 7) == "threads") {
+      AmArg stats;
+      AmThread::getThreadStats(stats);
+      reply = "Threads: " + AmArg::print(stats) + "\n";
+    }
     else if(cmd_str.substr(4, 8) == "cpslimit")
       reply = "CPS hard limit: " + int2str(sc->getCPSLimit().first) + ", CPS limit: " +
         int2str(sc->getCPSLimit().second) + "\n";
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checks the G.711 and L16 buffer conversions against the per sample
+ * lookup tables and compares their throughput.
+ *
+ * usage: g711_bench [frames]   (frames of 160 samples, default 1000000)
+ */
+
+#include "../g711.h"
+#include "../../l16/l16_swap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define FRAME 160
+
+static const char* level_names[] = { "C", "SSSE3", "AVX2" };
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* the conversion loops used by wav.c and l16.c before */
+
+static void ref_alaw_dec(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  const uint8_t* end = in + n;
+  while (in != end) *(out++) = st_alaw2linear16(*(in++));
+}
+
+static void ref_ulaw_dec(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  const uint8_t* end = in + n;
+  while (in != end) *(out++) = st_ulaw2linear16(*(in++));
+}
+
+static void ref_alaw_enc(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  const int16_t* end = in + n;
+  while (in != end) { short s = *(in++) >> 3; *(out++) = st_13linear2alaw(s); }
+}
+
+static void ref_ulaw_enc(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  const int16_t* end = in + n;
+  while (in != end) { short s = *(in++) >> 2; *(out++) = st_14linear2ulaw(s); }
+}
+
+static void ref_l16(uint16_t* out, const uint16_t* in, unsigned int n)
+{
+  const uint16_t* end = in + n;
+  while (in != end) *(out++) = htons(*(in++));
+}
+
+typedef void (*dec_fn)(int16_t*, const uint8_t*, unsigned int);
+typedef void (*enc_fn)(uint8_t*, const int16_t*, unsigned int);
+typedef void (*swap_fn)(uint16_t*, const uint16_t*, unsigned int);
+
+static int16_t pcm[FRAME * 64];
+static uint8_t g711[FRAME * 64];
+static int16_t pcm_out[FRAME];
+static uint8_t g711_out[FRAME];
+
+#define BUFS 64
+
+static double bench_dec(dec_fn f, long frames)
+{
+  double start = now();
+  long i;
+  for (i = 0; i < frames; i++)
+    f(pcm_out, g711 + (i % BUFS) * FRAME, FRAME);
+  return frames * (double)FRAME / (now() - start) / 1e6;
+}
+
+static double bench_enc(enc_fn f, long frames)
+{
+  double start = now();
+  long i;
+  for (i = 0; i < frames; i++)
+    f(g711_out, pcm + (i % BUFS) * FRAME, FRAME);
+  return frames * (double)FRAME / (now() - start) / 1e6;
+}
+
+static double bench_swap(swap_fn f, long frames)
+{
+  double start = now();
+  long i;
+  for (i = 0; i < frames; i++)
+    f((uint16_t*)pcm_out, (uint16_t*)pcm + (i % BUFS) * FRAME, FRAME);
+  return frames * (double)FRAME / (now() - start) / 1e6;
+}
+
+/* batches of BUFS frames (one per channel) */
+static int16_t pcm_batch_out[FRAME * BUFS];
+static uint8_t g711_batch_out[FRAME * BUFS];
+static int16_t* pcm_in_bufs[BUFS];
+static int16_t* pcm_out_bufs[BUFS];
+static uint8_t* g711_in_bufs[BUFS];
+static uint8_t* g711_out_bufs[BUFS];
+static int batch_sizes[BUFS];
+
+typedef void (*dec_batch_fn)(int16_t**, uint8_t**, const int*, unsigned int);
+typedef void (*enc_batch_fn)(uint8_t**, int16_t**, const int*, unsigned int);
+
+static void init_batch(void)
+{
+  int i;
+  for (i = 0; i < BUFS; i++) {
+    pcm_in_bufs[i] = pcm + i * FRAME;
+    pcm_out_bufs[i] = pcm_batch_out + i * FRAME;
+    g711_in_bufs[i] = g711 + i * FRAME;
+    g711_out_bufs[i] = g711_batch_out + i * FRAME;
+    batch_sizes[i] = FRAME;
+  }
+}
+
+static double bench_dec_batch(dec_batch_fn f, long frames)
+{
+  double start = now();
+  long i;
+  for (i = 0; i < frames; i += BUFS)
+    f(pcm_out_bufs, g711_in_bufs, batch_sizes, BUFS);
+  return i * (double)FRAME / (now() - start) / 1e6;
+}
+
+static double bench_enc_batch(enc_batch_fn f, long frames)
+{
+  double start = now();
+  long i;
+  for (i = 0; i < frames; i += BUFS)
+    f(g711_out_bufs, pcm_in_bufs, batch_sizes, BUFS);
+  return i * (double)FRAME / (now() - start) / 1e6;
+}
+
+static int check_batch(void)
+{
+  int i, err = 0;
+
+  st_linear16_2alaw_batch(g711_out_bufs, pcm_in_bufs, batch_sizes, BUFS);
+  st_linear16_2alaw_buf(g711_out, pcm + (BUFS - 1) * FRAME, FRAME);
+  if (memcmp(g711_out, g711_out_bufs[BUFS - 1], FRAME)) err++;
+
+  st_ulaw2linear16_batch(pcm_out_bufs, g711_in_bufs, batch_sizes, BUFS);
+  for (i = 0; i < BUFS; i++) {
+    st_ulaw2linear16_buf(pcm_out, g711 + i * FRAME, FRAME);
+    if (memcmp(pcm_out, pcm_out_bufs[i], FRAME * 2)) { err++; break; }
+  }
+
+  return err;
+}
+
+static int check(void)
+{
+  static int16_t all16[65536];
+  static uint8_t all8[256];
+  static int16_t dec[65536];
+  static uint8_t enc[65536];
+  int i, err = 0;
+
+  for (i = 0; i < 65536; i++) all16[i] = (int16_t)(i - 32768);
+  for (i = 0; i < 256; i++) all8[i] = i;
+
+  /* odd lengths to also run the scalar tails */
+  st_alaw2linear16_buf(dec, all8, 255);
+  for (i = 0; i < 255; i++)
+    if (dec[i] != st_alaw2linear16(all8[i])) { err++; break; }
+
+  st_ulaw2linear16_buf(dec, all8, 255);
+  for (i = 0; i < 255; i++)
+    if (dec[i] != st_ulaw2linear16(all8[i])) { err++; break; }
+
+  st_linear16_2alaw_buf(enc, all16, 65535);
+  for (i = 0; i < 65535; i++)
+    if (enc[i] != st_13linear2alaw((all16[i] >> 3))) { err++; break; }
+
+  st_linear16_2ulaw_buf(enc, all16, 65535);
+  for (i = 0; i < 65535; i++)
+    if (enc[i] != st_14linear2ulaw((all16[i] >> 2))) { err++; break; }
+
+  l16_swap((uint16_t*)dec, (uint16_t*)all16, 65535);
+  for (i = 0; i < 65535; i++)
+    if ((uint16_t)dec[i] != htons((uint16_t)all16[i])) { err++; break; }
+
+  return err;
+}
+
+int main(int argc, char** argv)
+{
+  long frames = 1000000;
+  int max_level, level, i, res = 0;
+
+  if (argc > 1) frames = atol(argv[1]);
+
+  /* speech-like test signal */
+  srand(1);
+  for (i = 0; i < FRAME * BUFS; i++)
+    pcm[i] = (int16_t)((rand() % 20001) - 10000);
+  ref_alaw_enc(g711, pcm, FRAME * BUFS);
+  init_batch();
+
+  max_level = g711_simd_level();
+
+  for (level = 0; level <= max_level; level++) {
+    g711_simd_set_level(level);
+    l16_simd_set_level(level);
+    if (check() || check_batch()) {
+      printf("%-6s: conversion results differ from the tables!\n",
+	     level_names[level]);
+      res = 1;
+    }
+  }
+
+  printf("%ld frames of %d samples, Msamples/s:\n\n", frames, FRAME);
+  printf("%-10s %10s %10s %10s %10s %10s\n",
+	 "", "alaw dec", "ulaw dec", "alaw enc", "ulaw enc", "l16");
+
+  printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", "reference",
+	 bench_dec(ref_alaw_dec, frames), bench_dec(ref_ulaw_dec, frames),
+	 bench_enc(ref_alaw_enc, frames), bench_enc(ref_ulaw_enc, frames),
+	 bench_swap(ref_l16, frames));
+
+  for (level = 0; level <= max_level; level++) {
+    g711_simd_set_level(level);
+    l16_simd_set_level(level);
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", level_names[level],
+	   bench_dec(st_alaw2linear16_buf, frames),
+	   bench_dec(st_ulaw2linear16_buf, frames),
+	   bench_enc(st_linear16_2alaw_buf, frames),
+	   bench_enc(st_linear16_2ulaw_buf, frames),
+	   bench_swap(l16_swap, frames));
+  }
+
+  printf("\nbatches of %d frames:\n\n", BUFS);
+  for (level = 0; level <= max_level; level++) {
+    g711_simd_set_level(level);
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", level_names[level],
+	   bench_dec_batch(st_alaw2linear16_batch, frames),
+	   bench_dec_batch(st_ulaw2linear16_batch, frames),
+	   bench_enc_batch(st_linear16_2alaw_batch, frames),
+	   bench_enc_batch(st_linear16_2ulaw_batch, frames));
+  }
+
+  return res;
+}
@@ -36,3 +36,30 @@ int16_t st_ulaw2linear16(unsigned char); /*  REGPARM(1); */
 #endif
 
 
+
+/*
+ * Buffer conversions (g711_simd.c): n samples, 16 bit linear PCM in host
+ * byte order. Same results as the single sample conversions above.
+ */
+void st_alaw2linear16_buf(int16_t* out, const uint8_t* in, unsigned int n);
+void st_ulaw2linear16_buf(int16_t* out, const uint8_t* in, unsigned int n);
+void st_linear16_2alaw_buf(uint8_t* out, const int16_t* in, unsigned int n);
+void st_linear16_2ulaw_buf(uint8_t* out, const int16_t* in, unsigned int n);
+
+/*
+ * Batch conversions: count independent buffers of n[i] samples each,
+ * with the vector code selected once for all of them.
+ */
+void st_alaw2linear16_batch(int16_t** out, uint8_t** in, const int* n, unsigned int count);
+void st_ulaw2linear16_batch(int16_t** out, uint8_t** in, const int* n, unsigned int count);
+void st_linear16_2alaw_batch(uint8_t** out, int16_t** in, const int* n, unsigned int count);
+void st_linear16_2ulaw_batch(uint8_t** out, int16_t** in, const int* n, unsigned int count);
+
+#define G711_SIMD_NONE  0
+#define G711_SIMD_SSSE3 1
+#define G711_SIMD_AVX2  2
+
+/** vector instructions used for the buffer conversions */
+int g711_simd_level(void);
+/** limit the vector instructions used (for testing/benchmarking) */
+void g711_simd_set_level(int level);
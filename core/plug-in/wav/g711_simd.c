@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Buffer conversions between G.711 and 16 bit linear PCM.
+ *
+ * The vector versions compute the same values as the lookup tables
+ * in g711.c (see g711_bench), but without any table gathers: the
+ * segment/exponent is computed with compares, and the only lookups
+ * are 8 entry tables done with PSHUFB. The vector code is selected
+ * at runtime depending on the CPU (AVX2, SSSE3, plain C otherwise).
+ */
+
+#include "g711.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define G711_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static int simd_level = -1;
+
+int g711_simd_level(void)
+{
+  if (simd_level < 0) {
+#ifdef G711_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      simd_level = G711_SIMD_AVX2;
+    else if (__builtin_cpu_supports("ssse3"))
+      simd_level = G711_SIMD_SSSE3;
+    else
+#endif
+      simd_level = G711_SIMD_NONE;
+  }
+  return simd_level;
+}
+
+void g711_simd_set_level(int level)
+{
+  int max;
+
+  simd_level = -1;
+  max = g711_simd_level();
+  simd_level = level < max ? level : max;
+}
+
+/* plain C */
+
+static void alaw2linear16_c(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++)
+    out[i] = st_alaw2linear16(in[i]);
+}
+
+static void ulaw2linear16_c(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++)
+    out[i] = st_ulaw2linear16(in[i]);
+}
+
+static void linear16_2alaw_c(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++) {
+    int16_t s = in[i] >> 3;
+    out[i] = st_13linear2alaw(s);
+  }
+}
+
+static void linear16_2ulaw_c(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++) {
+    int16_t s = in[i] >> 2;
+    out[i] = st_14linear2ulaw(s);
+  }
+}
+
+#ifdef G711_X86_SIMD
+
+/*
+ * All kernels work on 16 bit lanes. Lookups into 8 entry byte tables
+ * use PSHUFB with the index in the low byte and 0x80 (-> 0) in the
+ * high byte of each lane.
+ */
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2  __attribute__((target("avx2")))
+
+/* 1 << exponent (u-law) */
+#define ULAW_DEC_POW  1,2,4,8,16,32,64,128
+/* 1 << (seg - 1), seg 0 like seg 1 (A-law) */
+#define ALAW_DEC_POW  1,1,2,4,8,16,32,64
+/* 1 << (15 - seg) >> 8 (u-law: mag >> (seg + 1)) */
+#define ULAW_ENC_SHR  128,64,32,16,8,4,2,1
+/* 1 << (16 - max(seg,1)) >> 8 (A-law: mag >> max(seg,1)) */
+#define ALAW_ENC_SHR  128,128,64,32,16,8,4,2
+
+#define TBL8(...) __VA_ARGS__,0,0,0,0,0,0,0,0
+
+/* u-law */
+
+static inline SSSE3 __m128i ulaw_dec_128(__m128i x)
+{
+  const __m128i pow = _mm_setr_epi8(TBL8(ULAW_DEC_POW));
+  __m128i u = _mm_xor_si128(x, _mm_set1_epi16(0xFF));
+  __m128i e = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(7));
+  __m128i p = _mm_shuffle_epi8(pow, _mm_or_si128(e, _mm_set1_epi16((short)0x8000)));
+  __m128i t = _mm_and_si128(u, _mm_set1_epi16(0x0F));
+  __m128i s = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)),
+			      _mm_set1_epi16(0x80));
+  t = _mm_add_epi16(_mm_slli_epi16(t, 3), _mm_set1_epi16(0x84));
+  t = _mm_sub_epi16(_mm_mullo_epi16(t, p), _mm_set1_epi16(0x84));
+  return _mm_sub_epi16(_mm_xor_si128(t, s), s);
+}
+
+static inline SSSE3 __m128i ulaw_enc_128(__m128i x)
+{
+  const __m128i shr = _mm_setr_epi8(TBL8(ULAW_ENC_SHR));
+  __m128i v = _mm_srai_epi16(x, 2);
+  __m128i neg = _mm_srai_epi16(v, 15);
+  __m128i mag = _mm_min_epi16(_mm_abs_epi16(v), _mm_set1_epi16(8159));
+  __m128i seg = _mm_setzero_si128();
+  __m128i q;
+
+  mag = _mm_min_epi16(_mm_add_epi16(mag, _mm_set1_epi16(0x21)),
+		      _mm_set1_epi16(0x1FFF));
+
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x3F)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x7F)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0xFF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x1FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x3FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x7FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0xFFF)));
+
+  q = _mm_shuffle_epi8(shr, _mm_or_si128(_mm_slli_epi16(seg, 8),
+					 _mm_set1_epi16(0x80)));
+  q = _mm_and_si128(_mm_mulhi_epu16(mag, q), _mm_set1_epi16(0x0F));
+  q = _mm_or_si128(q, _mm_slli_epi16(seg, 4));
+  q = _mm_xor_si128(q, _mm_set1_epi16(0xFF));
+  return _mm_xor_si128(q, _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+}
+
+/* A-law */
+
+static inline SSSE3 __m128i alaw_dec_128(__m128i x)
+{
+  const __m128i pow = _mm_setr_epi8(TBL8(ALAW_DEC_POW));
+  __m128i a = _mm_xor_si128(x, _mm_set1_epi16(0x55));
+  __m128i seg = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(7));
+  __m128i p = _mm_shuffle_epi8(pow, _mm_or_si128(seg, _mm_set1_epi16((short)0x8000)));
+  __m128i t = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0F)), 4);
+  __m128i s = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)),
+			      _mm_setzero_si128());
+  __m128i nz = _mm_cmpgt_epi16(seg, _mm_setzero_si128());
+
+  t = _mm_add_epi16(t, _mm_set1_epi16(8));
+  t = _mm_add_epi16(t, _mm_and_si128(nz, _mm_set1_epi16(0x100)));
+  t = _mm_mullo_epi16(t, p);
+  return _mm_sub_epi16(_mm_xor_si128(t, s), s);
+}
+
+static inline SSSE3 __m128i alaw_enc_128(__m128i x)
+{
+  const __m128i shr = _mm_setr_epi8(TBL8(ALAW_ENC_SHR));
+  __m128i v = _mm_srai_epi16(x, 3);
+  __m128i neg = _mm_srai_epi16(v, 15);
+  __m128i mag = _mm_xor_si128(v, neg); /* -v - 1 for negative values */
+  __m128i seg = _mm_setzero_si128();
+  __m128i q;
+
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x1F)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x3F)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x7F)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0xFF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x1FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x3FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(mag, _mm_set1_epi16(0x7FF)));
+
+  q = _mm_shuffle_epi8(shr, _mm_or_si128(_mm_slli_epi16(seg, 8),
+					 _mm_set1_epi16(0x80)));
+  q = _mm_and_si128(_mm_mulhi_epu16(mag, q), _mm_set1_epi16(0x0F));
+  q = _mm_or_si128(q, _mm_slli_epi16(seg, 4));
+  q = _mm_xor_si128(q, _mm_set1_epi16(0xD5));
+  return _mm_xor_si128(q, _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+}
+
+#define SSSE3_DECODE(name, kernel, scalar)				\
+  static SSSE3 void name(int16_t* out, const uint8_t* in, unsigned int n) \
+  {									\
+    unsigned int i = 0;							\
+    for (; i + 8 <= n; i += 8) {					\
+      __m128i x = _mm_loadl_epi64((const __m128i*)(in + i));		\
+      x = _mm_unpacklo_epi8(x, _mm_setzero_si128());			\
+      _mm_storeu_si128((__m128i*)(out + i), kernel(x));			\
+    }									\
+    scalar(out + i, in + i, n - i);					\
+  }
+
+#define SSSE3_ENCODE(name, kernel, scalar)				\
+  static SSSE3 void name(uint8_t* out, const int16_t* in, unsigned int n) \
+  {									\
+    unsigned int i = 0;							\
+    for (; i + 16 <= n; i += 16) {					\
+      __m128i lo = kernel(_mm_loadu_si128((const __m128i*)(in + i)));	\
+      __m128i hi = kernel(_mm_loadu_si128((const __m128i*)(in + i + 8))); \
+      _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));	\
+    }									\
+    scalar(out + i, in + i, n - i);					\
+  }
+
+SSSE3_DECODE(alaw2linear16_ssse3, alaw_dec_128, alaw2linear16_c)
+SSSE3_DECODE(ulaw2linear16_ssse3, ulaw_dec_128, ulaw2linear16_c)
+SSSE3_ENCODE(linear16_2alaw_ssse3, alaw_enc_128, linear16_2alaw_c)
+SSSE3_ENCODE(linear16_2ulaw_ssse3, ulaw_enc_128, linear16_2ulaw_c)
+
+/* AVX2: same as above, 16 lanes (PSHUFB tables repeated per 128 bit lane) */
+
+#define TBL8_256(...) TBL8(__VA_ARGS__),TBL8(__VA_ARGS__)
+
+static inline AVX2 __m256i ulaw_dec_256(__m256i x)
+{
+  const __m256i pow = _mm256_setr_epi8(TBL8_256(ULAW_DEC_POW));
+  __m256i u = _mm256_xor_si256(x, _mm256_set1_epi16(0xFF));
+  __m256i e = _mm256_and_si256(_mm256_srli_epi16(u, 4), _mm256_set1_epi16(7));
+  __m256i p = _mm256_shuffle_epi8(pow, _mm256_or_si256(e, _mm256_set1_epi16((short)0x8000)));
+  __m256i t = _mm256_and_si256(u, _mm256_set1_epi16(0x0F));
+  __m256i s = _mm256_cmpeq_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x80)),
+				 _mm256_set1_epi16(0x80));
+  t = _mm256_add_epi16(_mm256_slli_epi16(t, 3), _mm256_set1_epi16(0x84));
+  t = _mm256_sub_epi16(_mm256_mullo_epi16(t, p), _mm256_set1_epi16(0x84));
+  return _mm256_sub_epi16(_mm256_xor_si256(t, s), s);
+}
+
+static inline AVX2 __m256i ulaw_enc_256(__m256i x)
+{
+  const __m256i shr = _mm256_setr_epi8(TBL8_256(ULAW_ENC_SHR));
+  __m256i v = _mm256_srai_epi16(x, 2);
+  __m256i neg = _mm256_srai_epi16(v, 15);
+  __m256i mag = _mm256_min_epi16(_mm256_abs_epi16(v), _mm256_set1_epi16(8159));
+  __m256i seg = _mm256_setzero_si256();
+  __m256i q;
+
+  mag = _mm256_min_epi16(_mm256_add_epi16(mag, _mm256_set1_epi16(0x21)),
+			 _mm256_set1_epi16(0x1FFF));
+
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x3F)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x7F)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0xFF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x1FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x3FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x7FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0xFFF)));
+
+  q = _mm256_shuffle_epi8(shr, _mm256_or_si256(_mm256_slli_epi16(seg, 8),
+					       _mm256_set1_epi16(0x80)));
+  q = _mm256_and_si256(_mm256_mulhi_epu16(mag, q), _mm256_set1_epi16(0x0F));
+  q = _mm256_or_si256(q, _mm256_slli_epi16(seg, 4));
+  q = _mm256_xor_si256(q, _mm256_set1_epi16(0xFF));
+  return _mm256_xor_si256(q, _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+}
+
+static inline AVX2 __m256i alaw_dec_256(__m256i x)
+{
+  const __m256i pow = _mm256_setr_epi8(TBL8_256(ALAW_DEC_POW));
+  __m256i a = _mm256_xor_si256(x, _mm256_set1_epi16(0x55));
+  __m256i seg = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(7));
+  __m256i p = _mm256_shuffle_epi8(pow, _mm256_or_si256(seg, _mm256_set1_epi16((short)0x8000)));
+  __m256i t = _mm256_slli_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x0F)), 4);
+  __m256i s = _mm256_cmpeq_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x80)),
+				 _mm256_setzero_si256());
+  __m256i nz = _mm256_cmpgt_epi16(seg, _mm256_setzero_si256());
+
+  t = _mm256_add_epi16(t, _mm256_set1_epi16(8));
+  t = _mm256_add_epi16(t, _mm256_and_si256(nz, _mm256_set1_epi16(0x100)));
+  t = _mm256_mullo_epi16(t, p);
+  return _mm256_sub_epi16(_mm256_xor_si256(t, s), s);
+}
+
+static inline AVX2 __m256i alaw_enc_256(__m256i x)
+{
+  const __m256i shr = _mm256_setr_epi8(TBL8_256(ALAW_ENC_SHR));
+  __m256i v = _mm256_srai_epi16(x, 3);
+  __m256i neg = _mm256_srai_epi16(v, 15);
+  __m256i mag = _mm256_xor_si256(v, neg);
+  __m256i seg = _mm256_setzero_si256();
+  __m256i q;
+
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x1F)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x3F)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x7F)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0xFF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x1FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x3FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16(0x7FF)));
+
+  q = _mm256_shuffle_epi8(shr, _mm256_or_si256(_mm256_slli_epi16(seg, 8),
+					       _mm256_set1_epi16(0x80)));
+  q = _mm256_and_si256(_mm256_mulhi_epu16(mag, q), _mm256_set1_epi16(0x0F));
+  q = _mm256_or_si256(q, _mm256_slli_epi16(seg, 4));
+  q = _mm256_xor_si256(q, _mm256_set1_epi16(0xD5));
+  return _mm256_xor_si256(q, _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+}
+
+#define AVX2_DECODE(name, kernel, scalar)				\
+  static AVX2 void name(int16_t* out, const uint8_t* in, unsigned int n) \
+  {									\
+    unsigned int i = 0;							\
+    for (; i + 16 <= n; i += 16) {					\
+      __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in + i))); \
+      _mm256_storeu_si256((__m256i*)(out + i), kernel(x));		\
+    }									\
+    scalar(out + i, in + i, n - i);					\
+  }
+
+#define AVX2_ENCODE(name, kernel, scalar)				\
+  static AVX2 void name(uint8_t* out, const int16_t* in, unsigned int n) \
+  {									\
+    unsigned int i = 0;							\
+    for (; i + 16 <= n; i += 16) {					\
+      __m256i r = kernel(_mm256_loadu_si256((const __m256i*)(in + i)));	\
+      _mm_storeu_si128((__m128i*)(out + i),				\
+		       _mm_packus_epi16(_mm256_castsi256_si128(r),	\
+					_mm256_extracti128_si256(r, 1))); \
+    }									\
+    scalar(out + i, in + i, n - i);					\
+  }
+
+AVX2_DECODE(alaw2linear16_avx2, alaw_dec_256, alaw2linear16_c)
+AVX2_DECODE(ulaw2linear16_avx2, ulaw_dec_256, ulaw2linear16_c)
+AVX2_ENCODE(linear16_2alaw_avx2, alaw_enc_256, linear16_2alaw_c)
+AVX2_ENCODE(linear16_2ulaw_avx2, ulaw_enc_256, linear16_2ulaw_c)
+
+#define DISPATCH(fn, out, in, n)				\
+  switch (g711_simd_level()) {					\
+  case G711_SIMD_AVX2:  fn##_avx2(out, in, n);  return;		\
+  case G711_SIMD_SSSE3: fn##_ssse3(out, in, n); return;		\
+  default:              fn##_c(out, in, n);     return;		\
+  }
+
+#define BATCH(kernel, out, in, n, count)			\
+  for (i = 0; i < count; i++)					\
+    kernel(out[i], in[i], n[i])
+
+#define DISPATCH_BATCH(fn, out, in, n, count)			\
+  unsigned int i;						\
+  switch (g711_simd_level()) {					\
+  case G711_SIMD_AVX2:  BATCH(fn##_avx2, out, in, n, count);  return; \
+  case G711_SIMD_SSSE3: BATCH(fn##_ssse3, out, in, n, count); return; \
+  default:              BATCH(fn##_c, out, in, n, count);     return; \
+  }
+
+#else
+
+#define DISPATCH(fn, out, in, n) fn##_c(out, in, n)
+
+#define DISPATCH_BATCH(fn, out, in, n, count)			\
+  unsigned int i;						\
+  for (i = 0; i < count; i++)					\
+    fn##_c(out[i], in[i], n[i])
+
+#endif /* G711_X86_SIMD */
+
+void st_alaw2linear16_buf(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  DISPATCH(alaw2linear16, out, in, n);
+}
+
+void st_ulaw2linear16_buf(int16_t* out, const uint8_t* in, unsigned int n)
+{
+  DISPATCH(ulaw2linear16, out, in, n);
+}
+
+void st_linear16_2alaw_buf(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  DISPATCH(linear16_2alaw, out, in, n);
+}
+
+void st_linear16_2ulaw_buf(uint8_t* out, const int16_t* in, unsigned int n)
+{
+  DISPATCH(linear16_2ulaw, out, in, n);
+}
+
+void st_alaw2linear16_batch(int16_t** out, uint8_t** in, const int* n, unsigned int count)
+{
+  DISPATCH_BATCH(alaw2linear16, out, in, n, count);
+}
+
+void st_ulaw2linear16_batch(int16_t** out, uint8_t** in, const int* n, unsigned int count)
+{
+  DISPATCH_BATCH(ulaw2linear16, out, in, n, count);
+}
+
+void st_linear16_2alaw_batch(uint8_t** out, int16_t** in, const int* n, unsigned int count)
+{
+  DISPATCH_BATCH(linear16_2alaw, out, in, n, count);
+}
+
+void st_linear16_2ulaw_batch(uint8_t** out, int16_t** in, const int* n, unsigned int count)
+{
+  DISPATCH_BATCH(linear16_2ulaw, out, in, n, count);
+}
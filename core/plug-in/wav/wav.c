@@ -89,18 +89,36 @@ static int Pcm16_2_ULaw( unsigned char* out_buf, unsigned char* in_buf, unsigned
 static int Pcm16_2_ALaw( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 			 unsigned int channels, unsigned int rate, long h_codec );
 
+static int ULaw_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs );
+
+static int ALaw_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs );
+
+static int Pcm16_2_ULaw_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs );
+
+static int Pcm16_2_ALaw_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs );
+
 static unsigned int g711_bytes2samples(long, unsigned int);
 static unsigned int g711_samples2bytes(long, unsigned int);
 
 BEGIN_EXPORTS( "wav" , AMCI_NO_MODULEINIT, AMCI_NO_MODULEDESTROY )
 
      BEGIN_CODECS
-      CODEC( CODEC_ULAW, Pcm16_2_ULaw, ULaw_2_Pcm16,
+      CODEC_BATCH( CODEC_ULAW, Pcm16_2_ULaw, ULaw_2_Pcm16,
              AMCI_NO_CODEC_PLC, AMCI_NO_CODECCREATE, AMCI_NO_CODECDESTROY,
-             g711_bytes2samples, g711_samples2bytes )
-      CODEC( CODEC_ALAW, Pcm16_2_ALaw, ALaw_2_Pcm16,
+             g711_bytes2samples, g711_samples2bytes,
+             Pcm16_2_ULaw_batch, ULaw_2_Pcm16_batch )
+      CODEC_BATCH( CODEC_ALAW, Pcm16_2_ALaw, ALaw_2_Pcm16,
 	     AMCI_NO_CODEC_PLC, AMCI_NO_CODECCREATE, AMCI_NO_CODECDESTROY,
-	     g711_bytes2samples, g711_samples2bytes )
+	     g711_bytes2samples, g711_samples2bytes,
+	     Pcm16_2_ALaw_batch, ALaw_2_Pcm16_batch )
      END_CODECS
     
      BEGIN_PAYLOADS
@@ -135,60 +153,75 @@ static unsigned int g711_samples2bytes(long h_codec, unsigned int num_samples)
 static int ULaw_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 			 unsigned int channels, unsigned int rate, long h_codec )
 {
-  unsigned short* out_b = (unsigned short*)out_buf;
-  unsigned char*  in_b  = in_buf;
-  unsigned char*  end   = in_b + size;
-
-  while(in_b != end){
-    //	int i = st_ulaw2linear16(*(in_b++));
-    //	*(out_b++) = i;
-    *(out_b++) = st_ulaw2linear16(*(in_b++));
-  }
+  st_ulaw2linear16_buf((int16_t*)out_buf, in_buf, size);
   return size*2;
 }
 
 static int ALaw_2_Pcm16( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 			 unsigned int channels, unsigned int rate, long h_codec )
 {
-  unsigned short* out_b = (unsigned short*)out_buf;
-  unsigned char*  in_b  = in_buf;
-  unsigned char*  end   = in_b + size;
-
-  while(in_b != end){
-    //	int i = st_alaw2linear16(*(in_b++));
-    //	*(out_b++) = i;
-    *(out_b++) = st_alaw2linear16(*(in_b++));
-  }
+  st_alaw2linear16_buf((int16_t*)out_buf, in_buf, size);
   return size*2;
 }
 
 int Pcm16_2_ULaw( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 		  unsigned int channels, unsigned int rate, long h_codec )
 {
-  unsigned char* out_b = out_buf;
-  short* in_b          = (short*)(in_buf);
-  short* end           = (short*)((unsigned char*)in_buf + size);
-
-  while(in_b != end){
-    short s = *(in_b++) >> 2;
-    *(out_b++) = st_14linear2ulaw(s);
-  }
+  st_linear16_2ulaw_buf(out_buf, (int16_t*)in_buf, size/2);
   return size/2;
 }
 
 int Pcm16_2_ALaw( unsigned char* out_buf, unsigned char* in_buf, unsigned int size,
 		  unsigned int channels, unsigned int rate, long h_codec )
 {
-  unsigned char* out_b = out_buf;
-  short* in_b          = (short*)(in_buf);
-  short* end           = (short*)((unsigned char*)in_buf + size);
+  st_linear16_2alaw_buf(out_buf, (int16_t*)in_buf, size/2);
+  return size/2;
+}
 
-  while(in_b != end){
-    short s = (*(in_b++)) >> 3;
-    *(out_b++) = st_13linear2alaw(s);
-  }
+static int ULaw_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs )
+{
+  unsigned int i;
 
-  return size/2;
+  st_ulaw2linear16_batch((int16_t**)out_buf, in_buf, size, n);
+  for (i = 0; i < n; i++)
+    size[i] *= 2;
+  return 0;
+}
+
+static int ALaw_2_Pcm16_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs )
+{
+  unsigned int i;
+
+  st_alaw2linear16_batch((int16_t**)out_buf, in_buf, size, n);
+  for (i = 0; i < n; i++)
+    size[i] *= 2;
+  return 0;
 }
 
+static int Pcm16_2_ULaw_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs )
+{
+  unsigned int i;
 
+  for (i = 0; i < n; i++)
+    size[i] /= 2;
+  st_linear16_2ulaw_batch(out_buf, (int16_t**)in_buf, size, n);
+  return 0;
+}
+
+static int Pcm16_2_ALaw_batch( unsigned char** out_buf, unsigned char** in_buf, int* size,
+			       unsigned int n, unsigned int channels, unsigned int rate,
+			       long* h_codecs )
+{
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+    size[i] /= 2;
+  st_linear16_2alaw_batch(out_buf, (int16_t**)in_buf, size, n);
+  return 0;
+}
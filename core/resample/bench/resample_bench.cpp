@@ -0,0 +1,233 @@
+/*****************************************************************************
+ * resampler quality and throughput comparison
+ *
+ * placed into the public domain
+ *****************************************************************************/
+
+/*
+For each of the common rate conversions, a 1 kHz tone is resampled with
+the internal sinc resampler, the polyphase resampler (each vector
+instruction set) and, if compiled in, libsamplerate, in 20 ms frames.
+
+  snr   - tone to noise+distortion ratio of the output (dB)
+  alias - attenuation of a tone above the output Nyquist frequency
+          (downsampling only, dB)
+  speed - realtime channels one core can resample
+
+usage: resample_bench [seconds of audio per measurement, default 20]
+*/
+
+#include "../resample.h"
+#include "../polyphase.h"
+
+#ifdef USE_LIBSAMPLERATE
+#include <samplerate.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* one resampler instance: 20 ms frame in, samples out */
+class Resampler
+{
+public:
+	virtual ~Resampler() {}
+	virtual unsigned int run(short *in, unsigned int n, short *out) = 0;
+};
+
+class InternalResampler : public Resampler
+{
+	Resample *r;
+	double ratio;
+public:
+	InternalResampler(double ratio) : ratio(ratio) {
+		r = ResampleFactory::createResampleObj(true, 4.0, ResampleFactory::INTERPOL_SINC,
+						       ResampleFactory::SAMPLE_MONO);
+	}
+	~InternalResampler() { ResampleFactory::destroyResampleObj(r); }
+	unsigned int run(short *in, unsigned int n, short *out) {
+		r->put_samples(in, n);
+		return r->resample(out, ratio, n * ratio);
+	}
+};
+
+class PolyResampler : public Resampler
+{
+	PolyphaseResampler *r;
+public:
+	PolyResampler(double ratio) { r = PolyphaseResampler::create(ratio); }
+	~PolyResampler() { delete r; }
+	unsigned int run(short *in, unsigned int n, short *out) {
+		return r->resample(in, n, out);
+	}
+};
+
+#ifdef USE_LIBSAMPLERATE
+class SrcResampler : public Resampler
+{
+	SRC_STATE *s;
+	double ratio;
+	vector<float> fin, fout;
+public:
+	SrcResampler(double ratio) : ratio(ratio) {
+		int err;
+		s = src_new(SRC_SINC_BEST_QUALITY, 1, &err);
+	}
+	~SrcResampler() { src_delete(s); }
+	unsigned int run(short *in, unsigned int n, short *out) {
+		fin.resize(n);
+		fout.resize(n * ratio + 16);
+		src_short_to_float_array(in, &fin[0], n);
+		SRC_DATA d;
+		d.data_in = &fin[0];
+		d.input_frames = n;
+		d.data_out = &fout[0];
+		d.output_frames = fout.size();
+		d.src_ratio = ratio;
+		d.end_of_input = 0;
+		src_process(s, &d);
+		src_float_to_short_array(&fout[0], out, d.output_frames_gen);
+		return d.output_frames_gen;
+	}
+};
+#endif
+
+static Resampler *create(const string &name, double ratio)
+{
+	if (name == "internal") return new InternalResampler(ratio);
+#ifdef USE_LIBSAMPLERATE
+	if (name == "libsamplerate") return new SrcResampler(ratio);
+#endif
+	return new PolyResampler(ratio);
+}
+
+/* resample a tone of freq Hz, returns the output */
+static void resample_tone(const string &name, int in_rate, int out_rate, double freq,
+			  double seconds, vector<short> &res, double *speed)
+{
+	double ratio = (double)out_rate / in_rate;
+	unsigned int frame = in_rate / 50;
+	unsigned int frames = seconds * 50;
+
+	vector<short> in(frame * 50);
+	for (unsigned int i = 0; i < in.size(); i++)
+		in[i] = (short)(16000.0 * sin(2 * PI * freq * i / in_rate));
+
+	vector<short> out(frame * 6 + 16);
+	Resampler *r = create(name, ratio);
+
+	res.clear();
+	double start = now();
+	for (unsigned int f = 0; f < frames; f++) {
+		unsigned int n = r->run(&in[(f % 50) * frame], frame, &out[0]);
+		if (f < 50) res.insert(res.end(), out.begin(), out.begin() + n);
+	}
+	if (speed) *speed = seconds / (now() - start);
+	delete r;
+}
+
+/* energy of the fitted tone vs. energy of the rest */
+static double snr(const vector<short> &y, int rate, double freq)
+{
+	/* skip the filters' start-up */
+	unsigned int start = rate / 10, n = y.size() - start;
+	double w = 2 * PI * freq / rate, a = 0, b = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		a += y[start + i] * sin(w * i);
+		b += y[start + i] * cos(w * i);
+	}
+	a *= 2.0 / n;
+	b *= 2.0 / n;
+
+	double sig = 0, noise = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		double s = a * sin(w * i) + b * cos(w * i);
+		double e = y[start + i] - s;
+		sig += s * s;
+		noise += e * e;
+	}
+	return 10 * log10(sig / (noise + 1e-9));
+}
+
+static double rms_db(const vector<short> &y, int rate)
+{
+	unsigned int start = rate / 10;
+	double e = 0;
+	for (unsigned int i = start; i < y.size(); i++)
+		e += (double)y[i] * y[i];
+	e /= (y.size() - start);
+	/* relative to the input tone */
+	return 10 * log10((e + 1e-9) / (16000.0 * 16000.0 / 2));
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = 20;
+	if (argc > 1) seconds = atof(argv[1]);
+
+	static const int conv[][2] = {
+		{ 8000, 16000 }, { 16000, 8000 }, { 8000, 48000 }, { 48000, 8000 },
+		{ 16000, 48000 }, { 48000, 16000 }, { 32000, 48000 }, { 48000, 32000 }
+	};
+
+	vector<string> impls;
+	impls.push_back("internal");
+	int max_level = PolyphaseResampler::get_simd_level();
+	impls.push_back("polyphase C");
+	if (max_level >= 1) impls.push_back("polyphase SSE2");
+	if (max_level >= 2) impls.push_back("polyphase AVX2");
+#ifdef USE_LIBSAMPLERATE
+	impls.push_back("libsamplerate");
+#endif
+
+	printf("%-14s %-13s %8s %8s %10s\n", "", "", "snr", "alias", "channels");
+	for (unsigned int c = 0; c < sizeof(conv) / sizeof(conv[0]); c++) {
+		int in_rate = conv[c][0], out_rate = conv[c][1];
+
+		for (unsigned int i = 0; i < impls.size(); i++) {
+			const string &name = impls[i];
+			if (name == "polyphase C") PolyphaseResampler::set_simd_level(0);
+			else if (name == "polyphase SSE2") PolyphaseResampler::set_simd_level(1);
+			else if (name == "polyphase AVX2") PolyphaseResampler::set_simd_level(2);
+
+			vector<short> y;
+			double speed;
+			resample_tone(name, in_rate, out_rate, 1000.0, seconds, y, &speed);
+			double s = snr(y, out_rate, 1000.0);
+
+			char alias[16] = "-";
+			if (out_rate < in_rate) {
+				/* tone at 3/4 of the way from output Nyquist to input Nyquist */
+				double f = out_rate / 2.0 + (in_rate - out_rate) / 2.0 * 0.25;
+				resample_tone(name, in_rate, out_rate, f, 1, y, NULL);
+				snprintf(alias, sizeof(alias), "%.1f", -rms_db(y, out_rate));
+			}
+
+			char conv_name[32];
+			snprintf(conv_name, sizeof(conv_name), "%d->%d", in_rate / 1000, out_rate / 1000);
+			printf("%-14s %-13s %8.1f %8s %10.0f\n", i ? "" : conv_name, name.c_str(),
+			       s, alias, speed);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,267 @@
+/*****************************************************************************
+ * fixed ratio polyphase FIR resampling
+ *
+ * placed into the public domain
+ *****************************************************************************/
+
+/*
+Resampling by L/M is upsampling by L (inserting L-1 zeros after each
+sample), low-pass filtering at the lower of both Nyquist frequencies and
+taking every M-th sample. The polyphase form only computes the samples
+that are kept: output sample n is at position n*M (in the upsampled
+signal), which is input sample (n*M)/L and filter phase (n*M)%L. Each
+phase of the prototype filter has (filter length)/L taps, which are
+applied to the last input samples.
+*/
+
+#include "polyphase.h"
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POLYPHASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifndef PI		/* Sometimes in math.h */
+#define PI		3.14159265358979323846
+#endif
+
+/* prototype filter length per max(L,M) */
+#define TAPS_PER_RATIO 24
+/* Kaiser window beta (~80 dB stop band attenuation) */
+#define KAISER_BETA    8.0
+/* cut off relative to the lower Nyquist frequency */
+#define CUTOFF         0.92
+/* taps per phase are padded to multiples of this (AVX2 register) */
+#define TAP_ALIGN      16
+
+struct PolyphaseResampler::Filter
+{
+	unsigned int L, M;
+	unsigned int taps;   /* per phase (padded) */
+	vector<short> coeff; /* L phases, taps each, reversed (oldest first) */
+
+	Filter(unsigned int L, unsigned int M);
+};
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+PolyphaseResampler::Filter::Filter(unsigned int _L, unsigned int _M)
+	: L(_L), M(_M)
+{
+	unsigned int max_lm = L > M ? L : M;
+	unsigned int n = TAPS_PER_RATIO * max_lm;
+	if (n % L) n += L - (n % L);
+
+	unsigned int phase_taps = n / L;
+	taps = (phase_taps + TAP_ALIGN - 1) / TAP_ALIGN * TAP_ALIGN;
+	coeff.assign(L * taps, 0);
+
+	/* cut off in cycles per (upsampled) sample */
+	double fc = CUTOFF * 0.5 / max_lm;
+	double center = (n - 1) / 2.0;
+	double i0_beta = bessel_i0(KAISER_BETA);
+
+	for (unsigned int k = 0; k < n; k++) {
+		double t = k - center;
+		double h = (t == 0.0) ? 2 * fc : sin(2 * PI * fc * t) / (PI * t);
+		double r = t / center;
+		h *= bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta;
+
+		/* gain L for the zeros inserted by upsampling */
+		double q = floor(h * L * 32768.0 + 0.5);
+		if (q > 32767.0) q = 32767.0;
+		if (q < -32768.0) q = -32768.0;
+
+		/* tap k belongs to phase k%L and is applied to the
+		   input sample k/L samples before the current one */
+		unsigned int phase = k % L;
+		unsigned int j = taps - 1 - k / L;
+		coeff[phase * taps + j] = (short)q;
+	}
+}
+
+/* all rational ratios between 8, 16, 32 and 48 kHz */
+static const unsigned int ratios[][2] = {
+	{ 2, 1 }, { 1, 2 }, { 4, 1 }, { 1, 4 }, { 6, 1 }, { 1, 6 },
+	{ 3, 1 }, { 1, 3 }, { 3, 2 }, { 2, 3 }
+};
+
+#define NUM_RATIOS (sizeof(ratios) / sizeof(ratios[0]))
+
+struct PolyphaseFilters
+{
+	vector<PolyphaseResampler::Filter*> filters;
+
+	PolyphaseFilters() {
+		for (unsigned int i = 0; i < NUM_RATIOS; i++)
+			filters.push_back(new PolyphaseResampler::Filter(ratios[i][0], ratios[i][1]));
+	}
+
+	~PolyphaseFilters() {
+		for (unsigned int i = 0; i < filters.size(); i++)
+			delete filters[i];
+	}
+
+	const PolyphaseResampler::Filter* find(double ratio) const {
+		for (unsigned int i = 0; i < filters.size(); i++) {
+			if (fabs((double)filters[i]->L / filters[i]->M - ratio) < 1e-6)
+				return filters[i];
+		}
+		return NULL;
+	}
+};
+
+static PolyphaseFilters polyphase_filters;
+
+/* dot products of n (multiple of TAP_ALIGN) Q15 coefficients and samples */
+
+static int dot_c(const short *c, const short *x, unsigned int n)
+{
+	int acc = 0;
+	for (unsigned int i = 0; i < n; i++)
+		acc += c[i] * x[i];
+	return acc;
+}
+
+#ifdef POLYPHASE_X86_SIMD
+
+__attribute__((target("sse2")))
+static int dot_sse2(const short *c, const short *x, unsigned int n)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (unsigned int i = 0; i < n; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(c + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(x + i));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+	}
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2")))
+static int dot_avx2(const short *c, const short *x, unsigned int n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (unsigned int i = 0; i < n; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(c + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(x + i));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+	}
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+				  _mm256_extracti128_si256(acc, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(s);
+}
+
+#endif
+
+typedef int (*dot_fn)(const short *, const short *, unsigned int);
+
+static int simd_level = -1;
+static dot_fn dot = dot_c;
+
+static int cpu_simd_level()
+{
+#ifdef POLYPHASE_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return 2;
+	if (__builtin_cpu_supports("sse2")) return 1;
+#endif
+	return 0;
+}
+
+void PolyphaseResampler::set_simd_level(int level)
+{
+	int max = cpu_simd_level();
+	simd_level = level < max ? level : max;
+
+	switch (simd_level) {
+#ifdef POLYPHASE_X86_SIMD
+	case 2: dot = dot_avx2; break;
+	case 1: dot = dot_sse2; break;
+#endif
+	default: dot = dot_c; break;
+	}
+}
+
+int PolyphaseResampler::get_simd_level()
+{
+	if (simd_level < 0) set_simd_level(2);
+	return simd_level;
+}
+
+PolyphaseResampler* PolyphaseResampler::create(double ratio)
+{
+	const Filter *f = polyphase_filters.find(ratio);
+	if (!f) return NULL;
+
+	get_simd_level();
+	return new PolyphaseResampler(f);
+}
+
+bool PolyphaseResampler::supports(double ratio)
+{
+	return polyphase_filters.find(ratio) != NULL;
+}
+
+PolyphaseResampler::PolyphaseResampler(const Filter *_filter)
+	: filter(_filter), pos(0)
+{
+	buf.assign(filter->taps - 1, 0);
+}
+
+unsigned int PolyphaseResampler::max_output(unsigned int num_samples) const
+{
+	return (num_samples * filter->L) / filter->M + 1;
+}
+
+unsigned int PolyphaseResampler::resample(const signed short *src, unsigned int num_samples,
+					  signed short *dst)
+{
+	const unsigned int L = filter->L;
+	const unsigned int M = filter->M;
+	const unsigned int taps = filter->taps;
+	const unsigned int hist = taps - 1;
+
+	buf.resize(hist + num_samples);
+	memcpy(&buf[hist], src, num_samples * sizeof(short));
+
+	const short *x = &buf[0];
+	const short *coeff = &filter->coeff[0];
+	unsigned int out = 0;
+
+	/* input sample i is at x[i + hist], the taps for it start at x[i] */
+	while (pos < num_samples * L) {
+		unsigned int i = pos / L;
+		unsigned int phase = pos % L;
+
+		int acc = dot(coeff + phase * taps, x + i, taps);
+		acc = (acc + (1 << 14)) >> 15;
+		if (acc > 32767) acc = 32767;
+		else if (acc < -32768) acc = -32768;
+		dst[out++] = (short)acc;
+
+		pos += M;
+	}
+	pos -= num_samples * L;
+
+	/* keep the history for the next call */
+	memmove(&buf[0], &buf[num_samples], hist * sizeof(short));
+	buf.resize(hist);
+
+	return out;
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************
+ * fixed ratio polyphase FIR resampling
+ *
+ * placed into the public domain
+ *****************************************************************************/
+
+#ifndef _POLYPHASE_H
+#define _POLYPHASE_H
+
+#include <vector>
+
+using std::vector;
+
+/*
+ * Polyphase FIR resampler for the rational ratios between 8, 16, 32 and
+ * 48 kHz (up/down L/M with L,M <= 6).
+ *
+ * The coefficient tables (Kaiser windowed sinc, Q15) are computed once
+ * on startup for all supported ratios. Each output sample is one dot
+ * product of a phase's coefficients with the input history, done with
+ * PMADDWD (SSE2/AVX2, selected at runtime) where available.
+ */
+class PolyphaseResampler
+{
+public:
+	struct Filter;
+
+private:
+	const Filter *filter;
+
+	/* input history followed by the new input */
+	vector<short> buf;
+	/* position of the next output sample in 1/L input samples,
+	   relative to the start of the new input */
+	unsigned int pos;
+
+public:
+	/* returns NULL if there is no filter for the ratio (out rate/in rate) */
+	static PolyphaseResampler* create(double ratio);
+
+	/* true if create() would succeed for this ratio */
+	static bool supports(double ratio);
+
+	PolyphaseResampler(const Filter *filter);
+
+	/* maximum number of output samples for num_samples input samples */
+	unsigned int max_output(unsigned int num_samples) const;
+
+	/*
+	 * resample num_samples from src to dst (dst must have room for
+	 * max_output(num_samples) samples)
+	 *
+	 * returns number of samples put into dst
+	 */
+	unsigned int resample(const signed short *src, unsigned int num_samples,
+			      signed short *dst);
+
+	/* set the vector instructions to use (0: none, 1: SSE2, 2: AVX2),
+	   limited to what the CPU supports; for testing/benchmarking */
+	static void set_simd_level(int level);
+	static int get_simd_level();
+};
+
+#endif
@@ -35,6 +35,10 @@
 #include "AmEventDispatcher.h"
 #include "AmSessionProcessor.h"
 #include "AmAppTimer.h"
+#include "AmRecordingWriter.h"
+#include "AmPromptCache.h"
+#include "AmRtpPortMap.h"
+#include "AmRtpPacer.h"
 
 #ifdef WITH_ZRTP
 # include "AmZRTP.h"
@@ -42,6 +46,7 @@
 
 #include "SipCtrlInterface.h"
 #include "sip/trans_table.h"
+#include "sip/msg_log_writer.h"
 
 #include "log.h"
 
@@ -569,9 +574,17 @@ int main(int argc, char* argv[])
   AmSessionProcessor::addThreads(AmConfig::SessionProcessorThreads);
 #endif 
 
+  AmRtpPacer::init();
+
   INFO("Starting media processor\n");
   AmMediaProcessor::instance()->init();
 
+  INFO("Starting recording writer\n");
+  AmRecordingWriter::instance()->init();
+
+  INFO("Starting message log writer\n");
+  msg_log_writer::instance()->init();
+
   // init thread usage with libevent
   // before it's too late
   if(evthread_use_pthreads() != 0) {
@@ -582,6 +595,9 @@ int main(int argc, char* argv[])
   INFO("Starting RTP receiver\n");
   AmRtpReceiver::instance()->start();
 
+  INFO("Starting RTP socket pool\n");
+  AmRtpSocketPool::instance()->init();
+
   INFO("Starting SIP stack (control interface)\n");
   if(sip_ctrl.load()) {
     goto error;
@@ -619,9 +635,15 @@ int main(int argc, char* argv[])
   INFO("Disposing RTP receiver\n");
   AmRtpReceiver::dispose();
 
+  INFO("Disposing RTP socket pool\n");
+  AmRtpSocketPool::dispose();
+
   INFO("Disposing media processor\n");
   AmMediaProcessor::dispose();
 
+  INFO("Disposing prompt cache\n");
+  AmPromptCache::dispose();
+
   INFO("Disposing event dispatcher\n");
   AmEventDispatcher::dispose();
 
@@ -629,6 +651,12 @@ int main(int argc, char* argv[])
   INFO("Disposing plug-ins\n");
   AmPlugIn::dispose();
 
+  INFO("Disposing recording writer\n");
+  AmRecordingWriter::dispose();
+
+  INFO("Disposing message log writer\n");
+  msg_log_writer::dispose();
+
 #ifndef DISABLE_DAEMON_MODE
   if (AmConfig::DaemonMode) {
     unlink(AmConfig::DaemonPidFile.c_str());
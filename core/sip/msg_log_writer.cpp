@@ -0,0 +1,264 @@
+#include "msg_log_writer.h"
+#include "msg_logger.h"
+
+#include "AmConfig.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define RECORD_ALIGN(l) (((l) + 7) & ~7U)
+
+msg_log_ring::msg_log_ring(unsigned int _size)
+  : size(1024), head(0), tail(0), orphaned(false)
+{
+  while (size < _size) size <<= 1;
+  buf = (unsigned char*)malloc(size);
+}
+
+msg_log_ring::~msg_log_ring()
+{
+  free(buf);
+}
+
+_msg_log_writer* _msg_log_writer::active = NULL;
+__thread msg_log_ring* _msg_log_writer::thread_ring = NULL;
+
+_msg_log_writer::_msg_log_writer()
+  : ready(false), stop_requested(false)
+{
+  pthread_key_create(&ring_key, threadExit);
+}
+
+_msg_log_writer::~_msg_log_writer()
+{
+  // the threads still running keep their (dangling) ring pointer,
+  // but do not use it anymore as the writer is not active
+  pthread_key_delete(ring_key);
+  for (std::vector<msg_log_ring*>::iterator it = rings.begin();
+       it != rings.end(); it++)
+    delete *it;
+}
+
+void _msg_log_writer::init()
+{
+  if (!AmConfig::MsgLoggerAsync)
+    return;
+
+  DBG("starting message log writer\n");
+  start();
+  active = this;
+}
+
+void _msg_log_writer::dispose()
+{
+  if (!active)
+    return;
+
+  // new records are written directly from now on
+  active = NULL;
+
+  // everything queued is written before stopping
+  stop();
+  while (!is_stopped())
+    usleep(10000); // 10ms
+}
+
+msg_log_ring* _msg_log_writer::registerThread()
+{
+  msg_log_ring* r = new msg_log_ring(AmConfig::MsgLoggerRingSize);
+  if (!r->buf) {
+    ERROR("out of memory\n");
+    delete r;
+    return NULL;
+  }
+
+  rings_mut.lock();
+  rings.push_back(r);
+  rings_mut.unlock();
+
+  pthread_setspecific(ring_key, r);
+  thread_ring = r;
+  return r;
+}
+
+void _msg_log_writer::threadExit(void* ring)
+{
+  __sync_synchronize();
+  ((msg_log_ring*)ring)->orphaned = true;
+}
+
+int _msg_log_writer::append(file_msg_logger* logger,
+			    const struct iovec* iov, int iovcnt)
+{
+  msg_log_ring* r = thread_ring;
+  if (!r && !(r = registerThread()))
+    return -1;
+
+  unsigned int len = 0;
+  for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+
+  unsigned int need = RECORD_ALIGN(sizeof(msg_log_ring::record) + len);
+  unsigned int head = r->head;
+  unsigned int tail = r->tail;
+  __sync_synchronize();
+
+  // records must be contiguous: skip the end of the ring if needed
+  unsigned int pos = head & (r->size - 1);
+  unsigned int skip = r->size - pos < need ? r->size - pos : 0;
+
+  if (need + skip > r->size - (head - tail)) {
+    r->dropped_records.inc();
+    r->dropped_bytes.inc(len);
+    return 0;
+  }
+
+  if (skip) {
+    if (skip >= sizeof(msg_log_ring::record))
+      ((msg_log_ring::record*)(r->buf + pos))->logger = NULL;
+    pos = 0;
+  }
+
+  msg_log_ring::record* rec = (msg_log_ring::record*)(r->buf + pos);
+  inc_ref(logger); // released by the writer
+  rec->logger = logger;
+  rec->len = len;
+
+  unsigned char* p = r->buf + pos + sizeof(msg_log_ring::record);
+  for (int i = 0; i < iovcnt; i++) {
+    memcpy(p, iov[i].iov_base, iov[i].iov_len);
+    p += iov[i].iov_len;
+  }
+
+  __sync_synchronize();
+  r->head = head + skip + need;
+
+  // wake up the writer when the ring gets half full
+  unsigned int half = r->size / 2;
+  if (head - tail <= half && head + skip + need - tail > half)
+    ready.set(true);
+
+  return 0;
+}
+
+void _msg_log_writer::drain(msg_log_ring* r)
+{
+  unsigned int head = r->head;
+  __sync_synchronize();
+  unsigned int tail = r->tail;
+
+  while (tail != head) {
+    unsigned int pos = tail & (r->size - 1);
+    msg_log_ring::record* rec = (msg_log_ring::record*)(r->buf + pos);
+
+    if (r->size - pos < sizeof(msg_log_ring::record) || !rec->logger) {
+      tail += r->size - pos;
+      continue;
+    }
+
+    pending& f = files[rec->logger];
+    f.data.append((const char*)(rec + 1), rec->len);
+    f.records++;
+
+    tail += RECORD_ALIGN(sizeof(msg_log_ring::record) + rec->len);
+  }
+
+  __sync_synchronize();
+  r->tail = tail;
+}
+
+void _msg_log_writer::flush()
+{
+  rings_mut.lock();
+  for (std::vector<msg_log_ring*>::iterator it = rings.begin();
+       it != rings.end();) {
+    msg_log_ring* r = *it;
+    bool orphaned = r->orphaned;
+    __sync_synchronize();
+
+    drain(r);
+
+    if (orphaned) {
+      orphaned_dropped_records.inc(r->dropped_records.get());
+      orphaned_dropped_bytes.inc(r->dropped_bytes.get());
+      delete r;
+      it = rings.erase(it);
+    }
+    else {
+      it++;
+    }
+  }
+  rings_mut.unlock();
+
+  for (std::map<file_msg_logger*, pending>::iterator it = files.begin();
+       it != files.end(); it++) {
+    file_msg_logger* l = it->first;
+    const std::string& data = it->second.data;
+
+    l->fd_mut.lock();
+    l->check_rotation(data.length());
+    if (l->fd >= 0) {
+      int res = l->write(data.c_str(), data.length());
+      writes.inc();
+      if (res != (int)data.length())
+	write_errors.inc();
+      if (res > 0)
+	written_bytes.inc(res);
+    }
+    l->fd_mut.unlock();
+
+    written_records.inc(it->second.records);
+    for (unsigned int i = 0; i < it->second.records; i++)
+      dec_ref(l);
+  }
+  files.clear();
+}
+
+void _msg_log_writer::run()
+{
+  while (true) {
+    ready.wait_for_to(AmConfig::MsgLoggerFlushInterval);
+    ready.set(false);
+
+    // the last records are written after stop has been requested
+    bool stopping = stop_requested.get();
+    flush();
+    if (stopping)
+      break;
+  }
+}
+
+void _msg_log_writer::on_stop()
+{
+  stop_requested.set(true);
+  ready.set(true);
+}
+
+void _msg_log_writer::getStats(AmArg& stats)
+{
+  unsigned long long dropped_records = orphaned_dropped_records.get();
+  unsigned long long dropped_bytes = orphaned_dropped_bytes.get();
+  unsigned long long queued = 0;
+
+  rings_mut.lock();
+  for (std::vector<msg_log_ring*>::iterator it = rings.begin();
+       it != rings.end(); it++) {
+    dropped_records += (*it)->dropped_records.get();
+    dropped_bytes += (*it)->dropped_bytes.get();
+    queued += (*it)->head - (*it)->tail;
+  }
+  stats["rings"] = (int)rings.size();
+  rings_mut.unlock();
+
+  stats["active"] = active != NULL;
+  stats["queued_bytes"] = (long long)queued;
+  stats["written_records"] = (long long)written_records.get();
+  stats["written_bytes"] = (long long)written_bytes.get();
+  stats["writes"] = (long long)writes.get();
+  stats["write_errors"] = (int)write_errors.get();
+  stats["dropped_records"] = (long long)dropped_records;
+  stats["dropped_bytes"] = (long long)dropped_bytes;
+}
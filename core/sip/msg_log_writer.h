@@ -0,0 +1,128 @@
+#ifndef _msg_log_writer_h_
+#define _msg_log_writer_h_
+
+#include "AmThread.h"
+#include "AmArg.h"
+#include "singleton.h"
+#include "atomic_types.h"
+
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct iovec;
+class file_msg_logger;
+
+/**
+ * Ring of log records written by one thread (single producer)
+ * and read by the message log writer (single consumer).
+ */
+struct msg_log_ring
+{
+  struct record {
+    /* NULL: skip to the start of the ring */
+    file_msg_logger* logger;
+    unsigned int     len;
+  };
+
+  unsigned char* buf;
+  unsigned int   size; // power of 2
+
+  /* free running byte counters (position: & (size-1)) */
+  volatile unsigned int head; // written by the producer
+  volatile unsigned int tail; // written by the consumer
+
+  /* the thread has exited, freed by the writer when empty */
+  volatile bool orphaned;
+
+  atomic_int64 dropped_records;
+  atomic_int64 dropped_bytes;
+
+  msg_log_ring(unsigned int size);
+  ~msg_log_ring();
+};
+
+/**
+ * \brief writes message logs (SIP/RTP pcap) in the background
+ *
+ * With msg_logger_async=yes, threads sending or receiving messages
+ * copy the log records into their own ring buffer without taking any
+ * lock. The writer thread collects the records of all rings every
+ * msg_logger_flush_interval ms (or earlier if a ring is half full)
+ * and writes all records of a file with one write. If a ring is
+ * full, records are dropped and counted.
+ */
+class _msg_log_writer
+  : public AmThread
+{
+  /* set while the writer thread is running */
+  static _msg_log_writer* active;
+  friend bool msg_log_writer_active();
+
+  static __thread msg_log_ring* thread_ring;
+  pthread_key_t ring_key;
+
+  std::vector<msg_log_ring*> rings;
+  AmMutex rings_mut;
+
+  AmCondition<bool> ready;
+  AmSharedVar<bool> stop_requested;
+
+  struct pending {
+    std::string data;
+    unsigned int records;
+    pending() : records(0) {}
+  };
+
+  /* used by the writer thread only */
+  std::map<file_msg_logger*, pending> files;
+
+  /* statistics */
+  atomic_int64 written_bytes;
+  atomic_int64 written_records;
+  atomic_int64 writes;
+  atomic_int   write_errors;
+  /* of the freed rings */
+  atomic_int64 orphaned_dropped_records;
+  atomic_int64 orphaned_dropped_bytes;
+
+  msg_log_ring* registerThread();
+  static void threadExit(void* ring);
+
+  void drain(msg_log_ring* r);
+  void flush();
+
+  void run();
+  void on_stop();
+
+protected:
+  _msg_log_writer();
+  ~_msg_log_writer();
+
+  void dispose();
+
+public:
+  /** start the writer thread (if msg_logger_async is set) */
+  void init();
+
+  /**
+   * Queue a record of the logger from the calling thread.
+   * Never blocks; if the thread's ring is full, the record is dropped.
+   * @return 0 (also if dropped), -1 on error
+   */
+  int append(file_msg_logger* logger, const struct iovec* iov, int iovcnt);
+
+  /** written/dropped records and bytes, rings */
+  void getStats(AmArg& stats);
+};
+
+typedef singleton<_msg_log_writer> msg_log_writer;
+
+/** true if message logs are written by the writer thread */
+inline bool msg_log_writer_active()
+{
+  return _msg_log_writer::active != NULL;
+}
+
+#endif
@@ -1,8 +1,12 @@
 #include "msg_logger.h"
 
+#include "msg_log_writer.h"
 #include "AmUtils.h"
+#include "AmConfig.h"
 
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -16,39 +20,107 @@ file_msg_logger::~file_msg_logger()
 
 int file_msg_logger::open(const char* filename)
 {
-  fd_mut.lock();
+  AmLock _l(fd_mut);
   if(fd != -1) {
     ERROR("file already open\n");
-    fd_mut.unlock();
     return -1;
   }
-  
-  fd = ::open(filename,O_WRONLY | O_CREAT | O_APPEND,
+
+  this->filename = filename;
+  return open_file();
+}
+
+int file_msg_logger::open_file()
+{
+  fd = ::open(filename.c_str(),O_WRONLY | O_CREAT | O_APPEND,
 	      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
   if(fd < 0) {
-    ERROR("could not open file '%s': %s", filename, strerror(errno));
-    fd_mut.unlock();
+    ERROR("could not open file '%s': %s", filename.c_str(), strerror(errno));
     return -1;
   }
 
   // need not to work for 100% (the access will not to be locked if opened from
   // another logger instance)
   off_t pos = lseek(fd, 0, SEEK_END);
+  file_size = pos > 0 ? pos : 0;
+  file_opened = time(NULL);
   if (pos == 0) write_file_header();
 
-  fd_mut.unlock();
   return 0;
 }
 
+void file_msg_logger::rotate()
+{
+  char ts[32];
+  struct tm t;
+  localtime_r(&file_opened, &t);
+  strftime(ts, sizeof(ts), ".%Y%m%d-%H%M%S", &t);
+
+  string rotated = filename + ts;
+  for (int i = 1; access(rotated.c_str(), F_OK) == 0; i++)
+    rotated = filename + ts + "-" + int2str(i);
+
+  close(fd);
+  fd = -1;
+
+  if (rename(filename.c_str(), rotated.c_str()) != 0) {
+    ERROR("could not rename '%s' to '%s': %s\n",
+	  filename.c_str(), rotated.c_str(), strerror(errno));
+  }
+  else {
+    DBG("message log rotated to '%s'\n", rotated.c_str());
+  }
+
+  // written into the new file
+  file_size = 0;
+  open_file();
+  on_rotate();
+}
+
+void file_msg_logger::check_rotation(unsigned int len)
+{
+  if (fd < 0 || !file_size)
+    return;
+
+  if ((AmConfig::MsgLoggerMaxFileSize &&
+       file_size + len > AmConfig::MsgLoggerMaxFileSize) ||
+      (AmConfig::MsgLoggerRotateInterval &&
+       time(NULL) - file_opened >= (time_t)AmConfig::MsgLoggerRotateInterval)) {
+    rotate();
+  }
+}
+
 int file_msg_logger::write(const void *buf, int len)
 {
   int res = ::write(fd, buf, len);
   if (res != len) {
     ERROR("while writing to message log: %s\n",strerror(errno));
   }
+  if (res > 0) file_size += res;
   return res;
 }
 
+int file_msg_logger::write_record(const struct iovec* iov, int iovcnt)
+{
+  if (msg_log_writer_active())
+    return msg_log_writer::instance()->append(this, iov, iovcnt);
+
+  int len = 0;
+  for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+
+  AmLock _l(fd_mut);
+  check_rotation(len);
+  if (fd < 0) return -1;
+
+  int res = ::writev(fd, iov, iovcnt);
+  if (res != len) {
+    ERROR("while writing to message log: %s\n",strerror(errno));
+    return -1;
+  }
+  file_size += res;
+  return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 
 static string addr2str(sockaddr_storage* addr)
@@ -76,31 +148,23 @@ static string addr2str(sockaddr_storage* addr)
   return string(ntop_buffer) + ":" + int2str(ntohs(sin6->sin6_port));
 }
 
-#define WRITE_CSTSTR(str)                                           \
-  if(write(str,sizeof(str)-1) != sizeof(str)-1) {                   \
-    return -1;                                                      \
-  }
-
-#define WRITE_STLSTR(str)                                           \
-  if(write(str.c_str(),str.length()) != (ssize_t)str.length())  {   \
-    return -1;                                                      \
-  }
-
-
-int cf_msg_logger::write_src_dst(const string& obj)
+int cf_msg_logger::write_src_dst(const string& obj, string& rec)
 {
   if (known_destinations.find(obj) == known_destinations.end()) {
     known_destinations.insert(obj);
-    WRITE_CSTSTR("<object name='");
-    WRITE_STLSTR(obj);
-    WRITE_CSTSTR("' desc='");
-    WRITE_STLSTR(obj);
-    WRITE_CSTSTR("'/>\n");
+    rec += "<object name='" + obj + "' desc='" + obj + "'/>\n";
   }
 
   return 0;
 }
 
+void cf_msg_logger::on_rotate()
+{
+  // the objects are defined again in the new file
+  AmLock _l(known_destinations_mut);
+  known_destinations.clear();
+}
+
 int cf_msg_logger::log(const char* buf, int len,
 			 sockaddr_storage* src_ip,
 			 sockaddr_storage* dst_ip,
@@ -109,28 +173,28 @@ int cf_msg_logger::log(const char* buf, int len,
   string src = addr2str(src_ip);
   string dst = addr2str(dst_ip);
 
-  AmLock _l(fd_mut);
-
-  write_src_dst(src);
-  write_src_dst(dst);
-  
   string what = c2stlstr(method);
   if(reply_code > 0) {
     what = int2str(reply_code) + " / " + what;
   }
 
-  WRITE_CSTSTR("<call src='");
-  WRITE_STLSTR(src);
-  WRITE_CSTSTR("' dst='");
-  WRITE_STLSTR(dst);
-  WRITE_CSTSTR("' desc='");
-  WRITE_STLSTR(what);
-  WRITE_CSTSTR("'>\n");
-
-  if(write(buf,len) != len) return -1;
-
-  WRITE_CSTSTR("</call>\n");
- 
-  return 0;
+  // the whole record is written at once
+  string head;
+  known_destinations_mut.lock();
+  write_src_dst(src, head);
+  write_src_dst(dst, head);
+  known_destinations_mut.unlock();
+
+  head += "<call src='" + src + "' dst='" + dst + "' desc='" + what + "'>\n";
+
+  static const char tail[] = "</call>\n";
+  struct iovec iov[3];
+  iov[0].iov_base = (void*)head.c_str();
+  iov[0].iov_len = head.length();
+  iov[1].iov_base = (void*)buf;
+  iov[1].iov_len = len;
+  iov[2].iov_base = (void*)tail;
+  iov[2].iov_len = sizeof(tail) - 1;
+
+  return write_record(iov, 3);
 }
-
@@ -10,8 +10,10 @@
 using std::set;
 using std::string;
 
+#include <time.h>
 
 struct sockaddr_storage;
+struct iovec;
 
 class msg_logger
   : public atomic_ref_cnt
@@ -28,16 +30,40 @@ public:
 class file_msg_logger
   : public msg_logger
 {
+  friend class _msg_log_writer;
+
   int      fd;
+  string   filename;
+
+  /* for rotation (protected by fd_mut) */
+  unsigned long long file_size;
+  time_t   file_opened;
+
+  int  open_file();
+  void rotate();
+  void check_rotation(unsigned int len);
 
 protected:
   AmMutex  fd_mut;
 
+  /** write directly into the file */
   int write(const void *buf, int len);
+
+  /**
+   * Write one record (e.g. a message with its headers) at once:
+   * queued to the message log writer thread if msg_logger_async
+   * is enabled, written with a single syscall otherwise.
+   * @return 0 on success (or if the record has been dropped)
+   */
+  int write_record(const struct iovec* iov, int iovcnt);
+
   virtual int write_file_header() = 0;
 
+  /** called after the file has been rotated (fd_mut held) */
+  virtual void on_rotate() {}
+
 public:
-  file_msg_logger() : fd(-1) {}
+  file_msg_logger() : fd(-1), file_size(0), file_opened(0) {}
   ~file_msg_logger();
 
   int  open(const char* filename);
@@ -51,11 +77,14 @@ class cf_msg_logger
   : public file_msg_logger
 {
   std::set<string> known_destinations;
+  /* protects known_destinations (fd_mut is held while writing) */
+  AmMutex known_destinations_mut;
 
-  int write_src_dst(const string& obj);
+  int write_src_dst(const string& obj, string& rec);
 
 protected:
   int write_file_header() { return 0; }
+  void on_rotate();
 
 public:
   int log(const char* buf, int len,
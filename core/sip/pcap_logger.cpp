@@ -6,6 +6,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include <netinet/ip.h>
+#include <sys/uio.h>
 
 using namespace std;
 
@@ -98,7 +99,8 @@ int pcap_logger::log(const char* buf, int len,
   return log(buf, len, (sockaddr*)src_ip, (sockaddr*)dst_ip, sizeof(sockaddr_storage));
 }
 
-int pcap_logger::log(const char *data, int data_len, struct sockaddr *src, struct sockaddr *dst, size_t addr_len)
+int pcap_logger::log(const char *data, int data_len, struct sockaddr *src, struct sockaddr *dst, size_t addr_len,
+                     const struct timeval* ts)
 {
   if (((sockaddr_in*)src)->sin_family != AF_INET) {
     ERROR("writing only IPv4 is supported\n");
@@ -108,7 +110,8 @@ int pcap_logger::log(const char *data, int data_len, struct sockaddr *src, struc
   // generate fake IP packet to be written
   packet_header hdr;
   struct timeval t;
-  gettimeofday(&t, NULL);
+  if (ts) t = *ts;
+  else gettimeofday(&t, NULL);
 
   memset(&hdr, 0, sizeof(hdr));
   unsigned size = data_len + sizeof(hdr) - sizeof(hdr.pcap);
@@ -140,15 +143,11 @@ int pcap_logger::log(const char *data, int data_len, struct sockaddr *src, struc
 
   hdr.udp.chksum = ipv4_chksum(sum(&hdr.ip.ip_src, 8) + sum(&hdr.udp, 8) + htons(udp_size) + 0x1100 + sum(data, data_len));
 
-  AmLock _l(fd_mut);
+  struct iovec iov[2];
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = (void*)data;
+  iov[1].iov_len = data_len;
 
-  if (write(&hdr, sizeof(hdr)) != sizeof(hdr)) {
-    // TODO: close the file (is broken anyway)
-    return -1;
-  }
-  if (write(data, data_len) != data_len) {
-    // TODO: close the file (is broken anyway)
-    return -1;
-  }
-  return 0;
+  return write_record(iov, 2);
 }
@@ -1,13 +1,64 @@
 #include "raw_sender.h"
 #include "raw_sock.h"
+#include "ip_util.h"
 #include "AmConfig.h"
+#include "AmArg.h"
+#include "atomic_types.h"
 
 #include "log.h"
 
 #include <errno.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifdef __linux__
+#define HAVE_SENDMMSG
+#endif
+
+/** packets queued per thread before they are sent anyway */
+#define RAW_BATCH_SIZE   32
+/** bigger packets are not queued */
+#define RAW_BATCH_MAX_LEN 1500
+
+struct raw_send_batch
+{
+  unsigned int n;
+
+  unsigned char   hdr[RAW_BATCH_SIZE][RAW_UDP4_HDR_LEN];
+  char            data[RAW_BATCH_SIZE][RAW_BATCH_MAX_LEN];
+  sockaddr_storage to[RAW_BATCH_SIZE];
+  struct iovec    iov[RAW_BATCH_SIZE][2];
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr  msgs[RAW_BATCH_SIZE];
+#else
+  struct msghdr   msgs[RAW_BATCH_SIZE];
+#endif
+
+  raw_send_batch() : n(0) {
+    memset(msgs, 0, sizeof(msgs));
+    for (unsigned int i = 0; i < RAW_BATCH_SIZE; i++) {
+#ifdef HAVE_SENDMMSG
+      struct msghdr* m = &msgs[i].msg_hdr;
+#else
+      struct msghdr* m = &msgs[i];
+#endif
+      iov[i][0].iov_base = hdr[i];
+      iov[i][0].iov_len = RAW_UDP4_HDR_LEN;
+      iov[i][1].iov_base = data[i];
+      m->msg_name = &to[i];
+      m->msg_iov = iov[i];
+      m->msg_iovlen = 2;
+    }
+  }
+};
 
 int raw_sender::rsock = -1;
+__thread raw_send_batch* raw_sender::thread_batch = NULL;
+
+static atomic_int64 raw_packets;
+static atomic_int64 raw_syscalls;
+static atomic_int64 raw_errors;
 
 int raw_sender::init()
 {
@@ -32,16 +83,56 @@ int raw_sender::init()
   return 0;
 }
 
+void raw_sender::batchThread()
+{
+  if (!thread_batch)
+    thread_batch = new raw_send_batch();
+}
+
 int raw_sender::send(const char* buf, unsigned int len, int sys_if_idx,
-		     const sockaddr_storage* from, const sockaddr_storage* to)
+		     const sockaddr_storage* from, const sockaddr_storage* to,
+		     raw_udp4_tmpl* tmpl, unsigned char tos)
 {
   //TODO: grab the MTU from the interface def
-  int ret = raw_iphdr_udp4_send(rsock,buf,len,from,to,
-				AmConfig::SysIfs[sys_if_idx].mtu);
+  unsigned short mtu = AmConfig::SysIfs[sys_if_idx].mtu;
+  raw_send_batch* b = thread_batch;
+
+  if (b && len <= RAW_BATCH_MAX_LEN &&
+      (!mtu || len + RAW_UDP4_HDR_LEN <= mtu)) {
+    // not fragmented: queue it
+    raw_udp4_tmpl local;
+    if (!tmpl) tmpl = &local;
+    if (!raw_udp4_tmpl_match(tmpl, from, to, tos))
+      raw_udp4_tmpl_init(tmpl, from, to, tos);
+
+    unsigned int i = b->n++;
+    raw_udp4_tmpl_fill(tmpl, b->hdr[i], buf, len);
+    memcpy(b->data[i], buf, len);
+    b->iov[i][1].iov_len = len;
+    memcpy(&b->to[i], to, sizeof(sockaddr_storage));
+#ifdef HAVE_SENDMMSG
+    b->msgs[i].msg_hdr.msg_namelen = SA_len(to);
+#else
+    b->msgs[i].msg_namelen = SA_len(to);
+#endif
+
+    if (b->n == RAW_BATCH_SIZE)
+      flush();
+    return 0;
+  }
+
+  // keep the order
+  if (b && b->n)
+    flush();
+
+  int ret = raw_iphdr_udp4_send(rsock,buf,len,from,to,mtu);
+  raw_syscalls.inc();
   if(ret < 0) {
     ERROR("send(): %s",strerror(errno));
+    raw_errors.inc();
     return ret;
   }
+  raw_packets.inc();
 
   // if((unsigned int)ret < len) {
   //   ERROR("incomplete udp send (%i instead of %i)",ret,len);
@@ -50,3 +141,41 @@ int raw_sender::send(const char* buf, unsigned int len, int sys_if_idx,
 
   return 0;
 }
+
+void raw_sender::flush()
+{
+  raw_send_batch* b = thread_batch;
+  if (!b || !b->n)
+    return;
+
+  unsigned int sent = 0;
+  while (sent < b->n) {
+#ifdef HAVE_SENDMMSG
+    int ret = sendmmsg(rsock, b->msgs + sent, b->n - sent, 0);
+#else
+    int ret = sendmsg(rsock, b->msgs + sent, 0);
+    if (ret >= 0) ret = 1;
+#endif
+    raw_syscalls.inc();
+    if (ret <= 0) {
+      if (ret < 0 && errno == EINTR)
+	continue;
+      // skip the packet failing
+      ERROR("send(): %s",strerror(errno));
+      raw_errors.inc();
+      sent++;
+      continue;
+    }
+    raw_packets.inc(ret);
+    sent += ret;
+  }
+
+  b->n = 0;
+}
+
+void raw_sender::getStats(AmArg& stats)
+{
+  stats["packets"] = (long long)raw_packets.get();
+  stats["syscalls"] = (long long)raw_syscalls.get();
+  stats["errors"] = (long long)raw_errors.get();
+}
@@ -1,19 +1,46 @@
 #ifndef _raw_sender_h_
 #define _raw_sender_h_
 
+#include <stddef.h>
+
 struct sockaddr_storage;
+struct raw_udp4_tmpl;
+struct raw_send_batch;
+class AmArg;
 
 class raw_sender
 {
   static int rsock;
 
+  /* packets queued by the calling thread (if batching) */
+  static __thread raw_send_batch* thread_batch;
+
   raw_sender() {}
   ~raw_sender() {}
 
 public:
   static int init();
+
+  /**
+   * Send a packet, or queue it until flush() if the calling thread
+   * batches its packets.
+   * @param tmpl headers prebuilt for from/to (e.g. per stream; rebuilt
+   *             if the addresses or tos changed), may be NULL;
+   *             only used by the calling thread
+   * @param tos  IP TOS of batched packets
+   */
   static int send(const char* buf, unsigned int len, int sys_if_idx,
-		  const sockaddr_storage* from, const sockaddr_storage* to);
+		  const sockaddr_storage* from, const sockaddr_storage* to,
+		  raw_udp4_tmpl* tmpl = NULL, unsigned char tos = 0);
+
+  /** queue the packets sent from the calling thread until flush() */
+  static void batchThread();
+
+  /** send the packets queued by the calling thread (sendmmsg) */
+  static void flush();
+
+  /** packets sent, syscalls and errors */
+  static void getStats(AmArg& stats);
 };
 
 #endif
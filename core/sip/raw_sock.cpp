@@ -374,6 +374,10 @@ inline unsigned short udpv4_vhdr_sum(struct udphdr* uh,
 
 
 
+inline static unsigned short udpv4_data_chksum(unsigned sum,
+					       const unsigned char* data,
+					       unsigned short length);
+
 /** compute the udp over ipv4 checksum.
  * @param u - filled udp header (except checksum).
  * @param src - source ip v4 address, in _network_ byte order.
@@ -389,9 +393,20 @@ inline static unsigned short udpv4_chksum(struct udphdr* u,
 					  unsigned char* data,
 					  unsigned short length)
 {
-	unsigned sum;
-	unsigned char* end;
-	sum=udpv4_vhdr_sum(u, src, dst, length);
+	return udpv4_data_chksum(udpv4_vhdr_sum(u, src, dst, length),
+				 data, length);
+}
+
+
+
+/** add the payload to a partial udp checksum and complement it.
+ * @param sum - partial checksum of the (pseudo-)headers, in host order
+ * @return the checksum in _host_ order */
+inline static unsigned short udpv4_data_chksum(unsigned sum,
+					       const unsigned char* data,
+					       unsigned short length)
+{
+	const unsigned char* end;
 	end=data+(length&(~0x1)); /* make sure it's even */
 	/* TODO: 16 & 32 bit aligned version */
 		/* not aligned */
@@ -669,3 +684,76 @@ end:
 #endif /* RAW_IPHDR_INC_AUTO_FRAG */
 	return ret;
 }
+
+
+
+/** build the headers template for packets from -> to.
+ * The ip and udp length fields and the udp checksum are filled per
+ * packet by raw_udp4_tmpl_fill().
+ */
+void raw_udp4_tmpl_init(struct raw_udp4_tmpl* t,
+			const sockaddr_storage* from,
+			const sockaddr_storage* to,
+			unsigned char tos)
+{
+	struct ip_udp_hdr {
+		struct ip ip;
+		struct udphdr udp;
+	} *hdr = (struct ip_udp_hdr*)t->hdr;
+	unsigned sum;
+
+	memset(t->hdr, 0, sizeof(t->hdr));
+	mk_ip_hdr(&hdr->ip, &SAv4(from)->sin_addr, &SAv4(to)->sin_addr,
+		  0, IPPROTO_UDP);
+	hdr->ip.ip_tos = tos;
+	t->tos = tos;
+	hdr->udp.uh_sport = SAv4(from)->sin_port;
+	hdr->udp.uh_dport = SAv4(to)->sin_port;
+	hdr->udp.uh_sum = 0;
+
+	t->src_ip = SAv4(from)->sin_addr.s_addr;
+	t->dst_ip = SAv4(to)->sin_addr.s_addr;
+	t->src_port = SAv4(from)->sin_port;
+	t->dst_port = SAv4(to)->sin_port;
+
+	/* pseudo header and ports, see udpv4_vhdr_sum() */
+	sum=(t->src_ip>>16)+(t->src_ip&0xffff)+
+		(t->dst_ip>>16)+(t->dst_ip&0xffff)+
+		htons(IPPROTO_UDP)+t->src_port+t->dst_port;
+	t->sum = sum;
+	t->valid = 1;
+}
+
+int raw_udp4_tmpl_match(const struct raw_udp4_tmpl* t,
+			const sockaddr_storage* from,
+			const sockaddr_storage* to,
+			unsigned char tos)
+{
+	return t->valid &&
+		t->tos == tos &&
+		t->src_ip == SAv4(from)->sin_addr.s_addr &&
+		t->dst_ip == SAv4(to)->sin_addr.s_addr &&
+		t->src_port == SAv4(from)->sin_port &&
+		t->dst_port == SAv4(to)->sin_port;
+}
+
+void raw_udp4_tmpl_fill(const struct raw_udp4_tmpl* t, unsigned char* dst,
+			const char* buf, unsigned int len)
+{
+	struct ip_udp_hdr {
+		struct ip ip;
+		struct udphdr udp;
+	} *hdr = (struct ip_udp_hdr*)dst;
+	unsigned sum;
+
+	memcpy(dst, t->hdr, sizeof(t->hdr));
+	hdr->ip.ip_len = RAW_IPHDR_IP_LEN(len + sizeof(*hdr));
+	hdr->udp.uh_ulen = htons((unsigned short)len+sizeof(struct udphdr));
+
+	/* the udp length is part of the pseudo header and the udp header */
+	sum = t->sum + 2*hdr->udp.uh_ulen;
+	sum=(sum>>16)+(sum&0xffff);
+	sum+=(sum>>16);
+	hdr->udp.uh_sum=htons(udpv4_data_chksum(ntohs((unsigned short)sum),
+						(const unsigned char*)buf, len));
+}
@@ -29,6 +29,8 @@
 #ifndef _raw_sock_h
 #define _raw_sock_h
 
+struct sockaddr_storage;
+
 int raw_udp_socket(int iphdr_incl);
 
 int raw_udp4_send(int rsock, char* buf, unsigned int len,
@@ -39,4 +41,36 @@ int raw_iphdr_udp4_send(int rsock, const char* buf, unsigned int len,
 			const sockaddr_storage* to,
 			unsigned short mtu);
 
+/** size of the IP + UDP headers sent on IP_HDRINCL raw sockets */
+#define RAW_UDP4_HDR_LEN 28
+
+/** IP/UDP headers prebuilt for packets from one address to another:
+ *  only the lengths and the UDP checksum change per packet. */
+struct raw_udp4_tmpl
+{
+	unsigned char  hdr[RAW_UDP4_HDR_LEN];
+	unsigned int   sum;   /* partial UDP checksum without the lengths */
+	unsigned int   src_ip, dst_ip;     /* network byte order */
+	unsigned short src_port, dst_port; /* network byte order */
+	unsigned char  tos;   /* IP TOS the headers have been built with */
+	int            valid;
+
+	raw_udp4_tmpl() : tos(0), valid(0) {}
+};
+
+void raw_udp4_tmpl_init(struct raw_udp4_tmpl* t,
+			const sockaddr_storage* from,
+			const sockaddr_storage* to,
+			unsigned char tos);
+
+/** @return 1 if t has been built for from/to and tos */
+int raw_udp4_tmpl_match(const struct raw_udp4_tmpl* t,
+			const sockaddr_storage* from,
+			const sockaddr_storage* to,
+			unsigned char tos);
+
+/** fill hdr (RAW_UDP4_HDR_LEN bytes) for a packet with len bytes payload */
+void raw_udp4_tmpl_fill(const struct raw_udp4_tmpl* t, unsigned char* hdr,
+			const char* buf, unsigned int len);
+
 #endif /* _raw_sock_h */
@@ -778,7 +778,7 @@ int sip_target_set::get_next(sockaddr_storage* ss, cstring& next_trsp,
 	    next_trsp = cstring("udp");
 
     } while(!(flags & TR_FLAG_DISABLE_BL) &&
-	    tr_blacklist::instance()->exist(ss));
+	    tr_blacklist_exist(ss));
 
     return 0;
 }
@@ -846,6 +846,7 @@ bool _resolver::disable_srv = false;
 _resolver::_resolver()
     : cache(DNS_CACHE_SIZE)
 {
+    setThreadName("sip-dns");
     start();
 }
 
@@ -0,0 +1,149 @@
+#include "ring_msg_logger.h"
+#include "pcap_logger.h"
+#include "AmRecordingWriter.h"
+
+#include "log.h"
+
+#include <string.h>
+
+ring_msg_logger::ring_msg_logger(unsigned int max_packets, bool headers_only,
+				 const string& dump_path)
+  : first(0), count(0), max_packets(max_packets ? max_packets : 1),
+    headers_only(headers_only), dump_path(dump_path)
+{
+}
+
+/* length of SIP headers / RTP header, or the whole packet */
+static int headers_len(const char* buf, int len)
+{
+  if (len < 12)
+    return len;
+
+  if ((buf[0] & 0xC0) == 0x80) {
+    unsigned char pt = buf[1];
+    if (pt >= 192 && pt <= 223)
+      return len; // RTCP: keep it
+    int hdr_len = 12 + (buf[0] & 0x0F) * 4;
+    return hdr_len < len ? hdr_len : len;
+  }
+
+  // SIP: up to the empty line
+  for (int i = 0; i + 3 < len; i++) {
+    if (buf[i] == '\r' && buf[i+1] == '\n' &&
+	buf[i+2] == '\r' && buf[i+3] == '\n')
+      return i + 4;
+  }
+  return len;
+}
+
+int ring_msg_logger::log(const char* buf, int len,
+			 sockaddr_storage* src_ip,
+			 sockaddr_storage* dst_ip,
+			 cstring method, int reply_code)
+{
+  if (headers_only)
+    len = headers_len(buf, len);
+
+  AmLock _l(mut);
+
+  // the oldest packet's buffer is reused
+  unsigned int i;
+  if (count < max_packets) {
+    i = (first + count) % max_packets;
+    if (ring.size() <= i) ring.resize(i + 1);
+    count++;
+  }
+  else {
+    i = first;
+    first = (first + 1) % max_packets;
+  }
+
+  packet& p = ring[i];
+  gettimeofday(&p.ts, NULL);
+  memcpy(&p.src, src_ip, sizeof(sockaddr_storage));
+  memcpy(&p.dst, dst_ip, sizeof(sockaddr_storage));
+  p.data.assign(buf, len);
+
+  return 0;
+}
+
+struct ring_msg_logger::dump_job
+  : public AmRecordingJob
+{
+  string path;
+
+  /* the logger's ring, oldest at 'first' */
+  vector<packet> ring;
+  unsigned int   first;
+  unsigned int   count;
+  unsigned int   max_packets;
+
+  void run();
+};
+
+void ring_msg_logger::dump_job::run()
+{
+  pcap_logger* pcap = new pcap_logger();
+  inc_ref(pcap);
+  if (pcap->open(path.c_str()) != 0) {
+    dec_ref(pcap);
+    return;
+  }
+
+  for (unsigned int n = 0; n < count; n++) {
+    packet& p = ring[(first + n) % max_packets];
+    pcap->log(p.data.c_str(), p.data.length(),
+	      (sockaddr*)&p.src, (sockaddr*)&p.dst,
+	      sizeof(sockaddr_storage), &p.ts);
+  }
+  dec_ref(pcap);
+
+  DBG("dumped %u captured packets into '%s'\n", count, path.c_str());
+}
+
+int ring_msg_logger::dump()
+{
+  dump_job* job = new dump_job();
+
+  // the ring is handed over without copying the packets
+  mut.lock();
+  job->ring.swap(ring);
+  job->first = first;
+  job->count = count;
+  first = count = 0;
+  mut.unlock();
+
+  if (!job->count) {
+    delete job;
+    return 0;
+  }
+
+  job->path = dump_path;
+  job->max_packets = max_packets;
+
+  int n = job->count;
+  AmRecordingWriter::instance()->run(job);
+  return n;
+}
+
+void ring_msg_logger::trigger(const string& reason)
+{
+  AmLock _l(mut);
+  if (trigger_reason.empty()) {
+    DBG("packet capture triggered (%s), will be written to '%s'\n",
+	reason.c_str(), dump_path.c_str());
+    trigger_reason = reason;
+  }
+}
+
+bool ring_msg_logger::triggered()
+{
+  AmLock _l(mut);
+  return !trigger_reason.empty();
+}
+
+void ring_msg_logger::on_destroy()
+{
+  if (triggered())
+    dump();
+}
@@ -0,0 +1,73 @@
+#ifndef _ring_msg_logger_h_
+#define _ring_msg_logger_h_
+
+#include "msg_logger.h"
+
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include <vector>
+using std::vector;
+
+/**
+ * Keeps the last packets (SIP and RTP) in memory, without any I/O,
+ * and writes them into a pcap file only if needed: on dump(), or
+ * when the logger is destroyed after trigger() has been called
+ * (e.g. because the call failed). The file is written by a recording
+ * writer thread (see AmRecordingWriter), not by the media or session
+ * thread releasing the logger.
+ */
+class ring_msg_logger
+  : public msg_logger
+{
+  struct packet {
+    struct timeval   ts;
+    sockaddr_storage src;
+    sockaddr_storage dst;
+    string           data;
+  };
+
+  /* the last max_packets packets, oldest at 'first' */
+  vector<packet> ring;
+  unsigned int   first;
+  unsigned int   count;
+  unsigned int   max_packets;
+
+  bool   headers_only;
+  string dump_path;
+  string trigger_reason;
+
+  AmMutex mut;
+
+  /* writes the packets of a ring (see dump()) */
+  struct dump_job;
+
+protected:
+  void on_destroy();
+
+public:
+  /**
+   * @param headers_only  keep only the SIP headers (without body)
+   *                      and RTP headers (without payload)
+   * @param dump_path     the pcap file written (appended to)
+   */
+  ring_msg_logger(unsigned int max_packets, bool headers_only,
+		  const string& dump_path);
+
+  int log(const char* buf, int len,
+	  sockaddr_storage* src_ip,
+	  sockaddr_storage* dst_ip,
+	  cstring method, int reply_code=0);
+
+  /**
+   * Write the packets in the background (and forget them).
+   * @return number of packets
+   */
+  int dump();
+
+  /** write the packets when the logger is destroyed (end of call) */
+  void trigger(const string& reason);
+  bool triggered();
+};
+
+#endif
@@ -68,6 +68,7 @@ sip_msg::sip_msg(const char* msg_buf, int msg_len)
 
     memset(&local_ip,0,sizeof(sockaddr_storage));
     memset(&remote_ip,0,sizeof(sockaddr_storage));
+    recv_time = 0;
 }
 
 sip_msg::sip_msg()
@@ -93,6 +94,7 @@ sip_msg::sip_msg()
 
     memset(&local_ip,0,sizeof(sockaddr_storage));
     memset(&remote_ip,0,sizeof(sockaddr_storage));
+    recv_time = 0;
 }
 
 sip_msg::~sip_msg()
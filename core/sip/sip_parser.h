@@ -137,6 +137,9 @@ struct sip_msg
 
     sockaddr_storage   remote_ip;
 
+    /* receipt time (AmLatencyStats::now(), 0 if unknown) */
+    unsigned long long recv_time;
+
     sip_msg();
     sip_msg(const char* msg_buf, int msg_len);
     ~sip_msg();
@@ -6,6 +6,7 @@
 #include "hash.h"
 
 #include "AmUtils.h"
+#include "AmLatencyStats.h"
 
 #include <netdb.h>
 #include <event2/event.h>
@@ -397,6 +398,7 @@ int tcp_trsp_socket::parse_input()
     DBG("received msg:\n%.*s",msg_len,pst.orig_buf);
 
     sip_msg* s_msg = new sip_msg((const char*)pst.orig_buf,msg_len);
+    s_msg->recv_time = AmLatencyStats::start();
 
     copy_peer_addr(&s_msg->remote_ip);
     copy_addr_to(&s_msg->local_ip);
@@ -479,6 +481,7 @@ void tcp_trsp_socket::on_write(short ev)
 tcp_server_worker::tcp_server_worker(tcp_server_socket* server_sock)
   : server_sock(server_sock)
 {
+  setThreadName("sip-tcp");
   evbase = event_base_new();
 }
 
@@ -780,6 +783,7 @@ struct timeval* tcp_server_socket::get_idle_timeout()
 tcp_trsp::tcp_trsp(tcp_server_socket* sock)
     : transport(sock)
 {
+  setThreadName("sip-tcp-srv");
   evbase = event_base_new();
   sock->add_event(evbase);
 }
@@ -1,129 +1,320 @@
 #include "tr_blacklist.h"
 #include <string.h>
+#include <netinet/in.h>
 
 #include "hash.h"
+#include "AmArg.h"
+#include "log.h"
 
-#define BLACKLIST_HT_POWER 6
-#define BLACKLIST_HT_SIZE  (1 << BLACKLIST_HT_POWER)
-#define BLACKLIST_HT_MASK  (BLACKLIST_HT_SIZE - 1)
+#define BL_KEY_EMPTY   0
+#define BL_KEY_DELETED 1
+
+/* sweep every 2s */
+#define BLACKLIST_SWEEP_TICKS (2000000 / TIMER_RESOLUTION)
 
 #define DBG_BL INFO
 
-bl_addr::bl_addr()
+_tr_blacklist* _tr_blacklist::active = NULL;
+
+__thread bl_thread_counters* _tr_blacklist::thread_counters = NULL;
+std::list<bl_thread_counters*> _tr_blacklist::all_counters;
+bl_thread_counters             _tr_blacklist::finished_counters;
+AmMutex                        _tr_blacklist::all_counters_mut;
+
+pthread_key_t  _tr_blacklist::counters_key;
+pthread_once_t _tr_blacklist::counters_key_once = PTHREAD_ONCE_INIT;
+
+void bl_sweep_timer::fire()
 {
-  ss_family = AF_INET;
+  _tr_blacklist* bl = _tr_blacklist::active;
+  if(!bl)
+    return;
+
+  bl->sweep();
+
+  expires = bl->wt->wall_clock + BLACKLIST_SWEEP_TICKS;
+  bl->wt->insert_timer(this);
 }
 
-bl_addr::bl_addr(const bl_addr& addr)
+_tr_blacklist::_tr_blacklist()
+  : wt(wheeltimer::instance())
 {
-  memcpy(this,&addr,SA_len(&addr));
+  sweep_timer = new bl_sweep_timer(wt->wall_clock + BLACKLIST_SWEEP_TICKS);
+  wt->insert_timer(sweep_timer);
+
+  __sync_synchronize();
+  active = this;
 }
 
-bl_addr::bl_addr(const sockaddr_storage* p_addr)
+_tr_blacklist::~_tr_blacklist()
 {
-  memcpy((sockaddr_storage*)this,p_addr,SA_len(p_addr));
+  active = NULL;
+  wt->remove_timer(sweep_timer);
 }
 
-unsigned int bl_addr::hash()
+void _tr_blacklist::createCountersKey()
 {
-  return hashlittle((sockaddr_storage*)this, SA_len(this), 0)
-    & BLACKLIST_HT_MASK;
+  pthread_key_create(&counters_key, threadExit);
 }
 
-bool bl_addr_less::operator() (const bl_addr& l, const bl_addr& r) const
+// e.g. session threads: the counters are added to the finished ones
+void _tr_blacklist::threadExit(void* p)
 {
-  if(l.ss_family != r.ss_family)
-    return l.ss_family < r.ss_family;
+  bl_thread_counters* c = (bl_thread_counters*)p;
 
-  return memcmp(&l,&r,SA_len(&l));
+  all_counters_mut.lock();
+  all_counters.remove(c);
+  finished_counters.hits += c->hits;
+  finished_counters.misses += c->misses;
+  all_counters_mut.unlock();
+
+  thread_counters = NULL;
+  delete c;
 }
 
-void bl_timer::fire()
+bl_thread_counters* _tr_blacklist::registerThread()
 {
-  DBG_BL("blacklist: %s/%i expired",
-	 am_inet_ntop(&addr).c_str(),am_get_port(&addr));
-  tr_blacklist::instance()->remove(&addr);
+  pthread_once(&counters_key_once, createCountersKey);
+
+  bl_thread_counters* c = new bl_thread_counters();
+  pthread_setspecific(counters_key, c);
+
+  all_counters_mut.lock();
+  all_counters.push_back(c);
+  all_counters_mut.unlock();
+
+  thread_counters = c;
+  return c;
 }
 
-bool blacklist_bucket::insert(const bl_addr& addr, unsigned int duration /* ms */,
-			      const char* reason)
+u_int64_t _tr_blacklist::hash(const sockaddr_storage* addr)
 {
-  wheeltimer* wt = wheeltimer::instance();
-  unsigned int expires = duration / (TIMER_RESOLUTION/1000);
-  expires += wt->wall_clock;
+  // only the relevant fields (sin_zero & co. might not be zeroed)
+  unsigned char k[2 + 2 + 16];
+  size_t len;
 
-  bl_timer* t = new bl_timer(addr,expires);
-  bl_entry* bl_e = new bl_entry(t);
+  unsigned short family = addr->ss_family;
+  memcpy(k,&family,2);
 
-  if(!bl_bucket_base::insert(addr,bl_e)) {
-    delete t;
-    return false;
+  if(addr->ss_family == AF_INET6) {
+    const sockaddr_in6* sin6 = (const sockaddr_in6*)addr;
+    memcpy(k+2,&sin6->sin6_port,2);
+    memcpy(k+4,&sin6->sin6_addr,16);
+    len = 4 + 16;
+  }
+  else {
+    const sockaddr_in* sin = (const sockaddr_in*)addr;
+    memcpy(k+2,&sin->sin_port,2);
+    memcpy(k+4,&sin->sin_addr,4);
+    len = 4 + 4;
   }
 
-  DBG_BL("blacklist: added %s/%i (%s/TTL=%.1fs)",
-	 am_inet_ntop(&addr).c_str(),am_get_port(&addr),
-	 reason,(float)duration/1000.0);
+  uint32_t h1=0, h2=0;
+  hashlittle2(k,len,&h1,&h2);
 
-  wt->insert_timer(t);
-  return true;
+  u_int64_t key = ((u_int64_t)h1 << 32) | h2;
+  if(key <= BL_KEY_DELETED)
+    key += 2;
+
+  return key;
 }
 
-bool blacklist_bucket::remove(const bl_addr& addr)
+bool _tr_blacklist::exist(const sockaddr_storage* addr)
 {
-  value_map::iterator it = find(addr);
-
-  if(it != elmts.end()){
-    bl_entry* v = it->second;
-    wheeltimer::instance()->remove_timer(v->t);
-    elmts.erase(it);
-    allocator().dispose(v);
-    return true;
+  u_int64_t key = hash(addr);
+  u_int32_t now = wt->wall_clock;
+  unsigned int pos = (unsigned int)key;
+
+  bl_thread_counters* c = thread_counters;
+  if(!c) c = registerThread();
+
+  for(unsigned int i=0; i < BLACKLIST_MAX_PROBE; i++, pos++) {
+
+    const bl_slot& s = slots[pos & BLACKLIST_SLOTS_MASK];
+    u_int64_t k = s.key;
+
+    if(k == BL_KEY_EMPTY)
+      break;
+
+    if(k != key)
+      continue;
+
+    // the writer sets expires before the key:
+    // re-check the key in case the slot has been reused meanwhile
+    __sync_synchronize();
+    u_int32_t expires = s.expires;
+    __sync_synchronize();
+
+    if(s.key == key && !is_expired(expires,now)) {
+      c->hits++;
+      return true;
+    }
+    break;
   }
 
+  c->misses++;
   return false;
 }
 
-_tr_blacklist::_tr_blacklist()
-  : blacklist_ht(BLACKLIST_HT_SIZE)
+void _tr_blacklist::insert(const sockaddr_storage* addr, unsigned int duration,
+			   const char* reason)
 {
-}
+  if(!duration)
+    return;
 
-_tr_blacklist::~_tr_blacklist()
-{ 
+  u_int64_t key = hash(addr);
+  unsigned int pos = (unsigned int)key;
+
+  AmLock l(slots_mut);
+  u_int32_t now = wt->wall_clock;
+  u_int32_t expires = now + duration / (TIMER_RESOLUTION/1000);
+
+  bl_slot* free_slot = NULL;
+  bl_slot* expired_slot = NULL;
+
+  for(unsigned int i=0; i < BLACKLIST_MAX_PROBE; i++, pos++) {
+
+    bl_slot* s = &slots[pos & BLACKLIST_SLOTS_MASK];
+
+    if(s->key == key) {
+      if(!is_expired(s->expires,now))
+	return;
+
+      // expired, not swept yet: same address
+      s->expires = expires;
+      inserted.inc();
+      goto added;
+    }
+
+    if(s->key == BL_KEY_EMPTY) {
+      if(!free_slot) free_slot = s;
+      break;
+    }
+
+    if(s->key == BL_KEY_DELETED) {
+      if(!free_slot) free_slot = s;
+    }
+    else if(!expired_slot && is_expired(s->expires,now)) {
+      expired_slot = s;
+    }
+  }
+
+  if(!free_slot && expired_slot) {
+    // hide the old entry before changing the expiry
+    expired_slot->key = BL_KEY_DELETED;
+    __sync_synchronize();
+    entries.dec();
+    expired.inc();
+    free_slot = expired_slot;
+  }
+
+  if(!free_slot) {
+    dropped.inc();
+    WARN("blacklist full: %s/%i (%s) not added",
+	 am_inet_ntop(addr).c_str(),am_get_port(addr),reason);
+    return;
+  }
+
+  free_slot->expires = expires;
+  __sync_synchronize();
+  free_slot->key = key;
+
+  entries.inc();
+  inserted.inc();
+
+ added:
+  DBG_BL("blacklist: added %s/%i (%s/TTL=%.1fs)",
+	 am_inet_ntop(addr).c_str(),am_get_port(addr),
+	 reason,(float)duration/1000.0);
 }
 
-bool _tr_blacklist::exist(const sockaddr_storage* addr)
+void _tr_blacklist::remove(const sockaddr_storage* addr)
 {
-  bool res;
-  blacklist_bucket* bucket = get_bucket(hashlittle(addr, SA_len(addr), 0)
-					& BLACKLIST_HT_MASK);
-  bucket->lock();
-  res = bucket->exist(*(const bl_addr*)addr);
-  bucket->unlock();
-
-  return res;
+  u_int64_t key = hash(addr);
+  unsigned int pos = (unsigned int)key;
+
+  AmLock l(slots_mut);
+
+  for(unsigned int i=0; i < BLACKLIST_MAX_PROBE; i++, pos++) {
+
+    bl_slot* s = &slots[pos & BLACKLIST_SLOTS_MASK];
+
+    if(s->key == BL_KEY_EMPTY)
+      return;
+
+    if(s->key == key) {
+      s->key = BL_KEY_DELETED;
+      entries.dec();
+      return;
+    }
+  }
 }
 
-void _tr_blacklist::insert(const sockaddr_storage* addr, unsigned int duration,
-			   const char* reason)
+void _tr_blacklist::sweep()
 {
-  if(!duration)
+  AmLock l(slots_mut);
+  u_int32_t now = wt->wall_clock;
+  unsigned int n_expired = 0;
+  int empty = -1;
+
+  for(unsigned int i=0; i < BLACKLIST_SLOTS; i++) {
+
+    bl_slot& s = slots[i];
+
+    if(s.key == BL_KEY_EMPTY) {
+      empty = i;
+    }
+    else if(s.key != BL_KEY_DELETED &&
+	    is_expired(s.expires,now)) {
+      s.key = BL_KEY_DELETED;
+      n_expired++;
+    }
+  }
+
+  if(n_expired) {
+    entries.dec(n_expired);
+    expired.inc(n_expired);
+    DBG_BL("blacklist: %u entries expired",n_expired);
+  }
+
+  if(empty < 0)
     return;
 
-  blacklist_bucket* bucket = get_bucket(hashlittle(addr, SA_len(addr), 0)
-					& BLACKLIST_HT_MASK);
-  bucket->lock();
-  if(!bucket->exist(*(const bl_addr*)addr)) {
-    bucket->insert(*(const bl_addr*)addr,duration,reason);
+  // Deleted slots followed by an empty slot are not part of any probe
+  // sequence anymore: going backwards around the table from an empty
+  // slot, they can be emptied.
+  bool before_empty = true;
+  for(unsigned int i=1; i < BLACKLIST_SLOTS; i++) {
+    bl_slot& s = slots[(empty - i) & BLACKLIST_SLOTS_MASK];
+    if(s.key == BL_KEY_EMPTY)
+      before_empty = true;
+    else if(s.key == BL_KEY_DELETED) {
+      if(before_empty)
+	s.key = BL_KEY_EMPTY;
+    }
+    else
+      before_empty = false;
   }
-  bucket->unlock();
 }
 
-void _tr_blacklist::remove(const sockaddr_storage* addr)
+void _tr_blacklist::getStats(AmArg& stats)
 {
-  blacklist_bucket* bucket = get_bucket(hashlittle(addr, SA_len(addr), 0)
-					& BLACKLIST_HT_MASK);
-  bucket->lock();
-  bucket->remove(*(const bl_addr*)addr);
-  bucket->unlock();
+  stats["entries"]  = (int)entries.get();
+  stats["slots"]    = BLACKLIST_SLOTS;
+
+  all_counters_mut.lock();
+  unsigned long long hits = finished_counters.hits;
+  unsigned long long misses = finished_counters.misses;
+  for(std::list<bl_thread_counters*>::iterator it = all_counters.begin();
+      it != all_counters.end(); ++it) {
+    hits += (*it)->hits;
+    misses += (*it)->misses;
+  }
+  all_counters_mut.unlock();
+
+  stats["hits"]     = (long long)hits;
+  stats["misses"]   = (long long)misses;
+  stats["inserted"] = (long long)inserted.get();
+  stats["expired"]  = (long long)expired.get();
+  stats["dropped"]  = (long long)dropped.get();
 }
@@ -1,102 +1,146 @@
 #ifndef _tr_blacklist_h_
 #define _tr_blacklist_h_
 
-#include "hash_table.h"
 #include "singleton.h"
+#include "atomic_types.h"
+#include "AmThread.h"
 
 #include "ip_util.h"
 #include "wheeltimer.h"
 
+#include <sys/types.h>
+#include <pthread.h>
+#include <list>
+
+class AmArg;
+
+/* slots of the blacklist table (power of 2) */
+#define BLACKLIST_SLOTS_POWER 12
+#define BLACKLIST_SLOTS       (1 << BLACKLIST_SLOTS_POWER)
+#define BLACKLIST_SLOTS_MASK  (BLACKLIST_SLOTS - 1)
+
+/* max. slots probed from the home slot of an address */
+#define BLACKLIST_MAX_PROBE 64
+
 /**
- * Blacklist bucket: key type
+ * Blacklist slot: 64 bit hash of the address (0: empty, 1: deleted)
+ * and wall clock ticks at which the entry expires.
  */
-struct bl_addr: public sockaddr_storage
+struct bl_slot
 {
-  bl_addr();
-  bl_addr(const bl_addr&);
-  bl_addr(const sockaddr_storage*);
+  volatile u_int64_t key;
+  volatile u_int32_t expires;
 
-  unsigned int hash();
+  bl_slot() : key(0), expires(0) {}
 };
 
-struct bl_addr_less
-{
-  bool operator() (const bl_addr& l, const bl_addr& r) const;
-};
-
-struct bl_entry;
-
-typedef ht_map_bucket<bl_addr,bl_entry,
-		      ht_delete<bl_entry>,
-		      bl_addr_less> bl_bucket_base;
-
-class blacklist_bucket
-  : public bl_bucket_base
+/**
+ * Lookup counters of one thread (only written by the thread itself).
+ */
+struct bl_thread_counters
 {
-protected:
-  bool insert(const bl_addr& k, bl_entry* v) {
-    return bl_bucket_base::insert(k,v);
-  }
-
-public:
-  blacklist_bucket(unsigned long id)
-  : bl_bucket_base(id)
-  {}
+  unsigned long long hits;
+  unsigned long long misses;
 
-  bool insert(const bl_addr& addr, unsigned int duration /* ms */,
-	      const char* reason);
-  bool remove(const bl_addr& addr);
+  bl_thread_counters() : hits(0), misses(0) {}
 };
 
-typedef blacklist_bucket::value_map::iterator blacklist_elmt;
-
-struct bl_timer
+/**
+ * Removes the expired entries of the blacklist
+ * (all at once every few seconds).
+ */
+struct bl_sweep_timer
   : public timer
 {
-  bl_addr addr;
-
-  bl_timer()
-    : timer(), addr()
-  {}
-
-  bl_timer(const bl_addr& addr, unsigned int expires)
-    : timer(expires), addr(addr)
+  bl_sweep_timer(unsigned int expires)
+    : timer(expires)
   {}
 
   void fire();
 };
 
 /**
- * Blacklist bucket: value type
+ * \brief transport blacklist
+ *
+ * Open addressed table of address hashes (linear probing). Lookups do
+ * not take any lock: the expiry is checked by the reader, and the
+ * key is checked again after reading the expiry to detect a slot being
+ * reused at the same time. Insert/remove/sweep are serialized by a
+ * mutex, deleted slots are marked and reused.
+ *
+ * Addresses are only compared by their 64 bit hash.
  */
-struct bl_entry
+class _tr_blacklist
 {
-  bl_timer* t;
+  /* set once the blacklist has been created */
+  static _tr_blacklist* active;
 
-  bl_entry() {}
+  bl_slot slots[BLACKLIST_SLOTS];
 
-  bl_entry(bl_timer* t)
-    : t(t)
-  {}
-};
+  /* serializes the writers */
+  AmMutex slots_mut;
 
-typedef hash_table<blacklist_bucket> blacklist_ht;
+  _wheeltimer* wt;
+  bl_sweep_timer* sweep_timer;
+
+  atomic_int   entries;
+  atomic_int64 inserted;
+  atomic_int64 expired;
+  atomic_int64 dropped;
+
+  /* hits/misses: per thread, summed up by getStats() */
+  static __thread bl_thread_counters* thread_counters;
+  static std::list<bl_thread_counters*> all_counters;
+  /* of the threads which have exited */
+  static bl_thread_counters finished_counters;
+  static AmMutex all_counters_mut;
+
+  /* frees the counters when the thread exits */
+  static pthread_key_t  counters_key;
+  static pthread_once_t counters_key_once;
+  static void createCountersKey();
+  static void threadExit(void* c);
+
+  static bl_thread_counters* registerThread();
+
+  bool is_expired(u_int32_t expires, u_int32_t now) const {
+    return (int)(now - expires) >= 0;
+  }
+
+  friend struct bl_sweep_timer;
+  friend bool tr_blacklist_exist(const sockaddr_storage* addr);
+
+  void sweep();
 
-class _tr_blacklist
-  : protected blacklist_ht
-{
 protected:
   _tr_blacklist();
   ~_tr_blacklist();
 
+  void dispose() {}
+
 public:
+  static u_int64_t hash(const sockaddr_storage* addr);
+
   // public blacklist API:
   bool exist(const sockaddr_storage* addr);
   void insert(const sockaddr_storage* addr, unsigned int duration /* ms */,
 	      const char* reason);
   void remove(const sockaddr_storage* addr);
+
+  /** entries, hits/misses, inserted/expired/dropped (table full) */
+  void getStats(AmArg& stats);
 };
 
 typedef singleton<_tr_blacklist> tr_blacklist;
 
+/**
+ * Lock-free check for hot paths (does not create the blacklist,
+ * which would need the singleton's mutex).
+ */
+inline bool tr_blacklist_exist(const sockaddr_storage* addr)
+{
+  _tr_blacklist* bl = _tr_blacklist::active;
+  return bl && bl->exist(addr);
+}
+
 #endif
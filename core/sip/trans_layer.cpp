@@ -56,6 +56,7 @@
 #include "AmUtils.h"
 #include "AmConfig.h"
 #include "AmSipEvent.h"
+#include "AmLatencyStats.h"
 
 #include <netdb.h>
 #include <sys/socket.h>
@@ -2105,6 +2106,11 @@ int _trans_layer::update_uas_reply(trans_bucket* bucket, sip_trans* t, int reply
 {
     DBG("update_uas_reply(t=%p)\n", t);
 
+    if(!t->reply_status && (reply_code < 200) && t->msg &&
+       (t->msg->u.request->method == sip_request::INVITE)) {
+	AmLatencyStats::recordSince(LAT_INVITE_1XX, t->msg->recv_time);
+    }
+
     t->reply_status = reply_code;
     bool reliable_trsp = t->retr_socket->is_reliable();
 
@@ -37,6 +37,7 @@
 #include "trans_layer.h"
 #include "log.h"
 #include "AmUtils.h"
+#include "AmLatencyStats.h"
 
 #include <sys/param.h>
 #include <arpa/inet.h>
@@ -274,6 +275,7 @@ int udp_trsp_socket::send(const sockaddr_storage* sa,
 udp_trsp::udp_trsp(udp_trsp_socket* sock)
     : transport(sock)
 {
+    setThreadName("sip-udp");
 }
 
 udp_trsp::~udp_trsp()
@@ -340,6 +342,7 @@ void udp_trsp::run()
 	}
 
 	sip_msg* s_msg = new sip_msg(buf,buf_len);
+	s_msg->recv_time = AmLatencyStats::start();
 	memcpy(&s_msg->remote_ip,msg.msg_name,msg.msg_namelen);
 
 	if (trsp_socket::log_level_raw_msgs >= 0) {
@@ -45,6 +45,8 @@ timer::~timer()
 _wheeltimer::_wheeltimer()
     : wall_clock(0)
 {
+    setThreadName("sip-timer");
+
     struct timeval now;
     gettimeofday(&now,NULL);
     unix_clock.set(now.tv_sec);
@@ -27,6 +27,23 @@ FCT_BGN() {
   FCTMF_SUITE_CALL(test_uriparser);
   FCTMF_SUITE_CALL(test_jsonarg);
   FCTMF_SUITE_CALL(test_replaces);
+  FCTMF_SUITE_CALL(test_regcache);
+  FCTMF_SUITE_CALL(test_sdpfilter);
+  FCTMF_SUITE_CALL(test_counterstore);
+  FCTMF_SUITE_CALL(test_payloadtranscoder);
+  FCTMF_SUITE_CALL(test_mappedfile);
+  FCTMF_SUITE_CALL(test_recordingwriter);
+  FCTMF_SUITE_CALL(test_jitterbuffer);
+  FCTMF_SUITE_CALL(test_dtmfdetector);
+  FCTMF_SUITE_CALL(test_rtpportmap);
+  FCTMF_SUITE_CALL(test_rtcp);
+  FCTMF_SUITE_CALL(test_msglogger);
+  FCTMF_SUITE_CALL(test_blacklist);
+  FCTMF_SUITE_CALL(test_rtppacer);
+  FCTMF_SUITE_CALL(test_latency);
+  FCTMF_SUITE_CALL(test_threads);
+  FCTMF_SUITE_CALL(test_promptcache);
+  FCTMF_SUITE_CALL(test_blredis);
 } FCT_END();
 
 
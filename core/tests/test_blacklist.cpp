@@ -0,0 +1,118 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmArg.h"
+#include "sip/tr_blacklist.h"
+
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static void bl_addr4(sockaddr_storage& ss, unsigned int ip, unsigned short port)
+{
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in* sin = (sockaddr_in*)&ss;
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(port);
+  sin->sin_addr.s_addr = htonl(ip);
+}
+
+/* looks up an address n times */
+class BlacklistLookupThread
+  : public AmThread
+{
+  sockaddr_storage addr;
+  unsigned int n;
+
+public:
+  BlacklistLookupThread(const sockaddr_storage& addr, unsigned int n)
+    : addr(addr), n(n) {}
+
+  void run() {
+    for (unsigned int i = 0; i < n; i++)
+      tr_blacklist_exist(&addr);
+  }
+  void on_stop() {}
+};
+
+FCTMF_SUITE_BGN(test_blacklist) {
+
+  FCT_TEST_BGN(blacklist_insert_remove) {
+    sockaddr_storage a, b;
+    bl_addr4(a, 0x0a000001, 5060);
+    bl_addr4(b, 0x0a000001, 5061);
+
+    tr_blacklist::instance()->insert(&a, 60000, "test");
+    fct_chk(tr_blacklist_exist(&a));
+    fct_chk(!tr_blacklist_exist(&b));
+
+    // garbage in sin_zero is ignored
+    memset(((sockaddr_in*)&a)->sin_zero, 0xff, 8);
+    fct_chk(tr_blacklist_exist(&a));
+
+    tr_blacklist::instance()->remove(&a);
+    fct_chk(!tr_blacklist_exist(&a));
+  } FCT_TEST_END();
+
+  FCT_TEST_BGN(blacklist_many) {
+    sockaddr_storage a;
+    unsigned int n = BLACKLIST_SLOTS / 2;
+
+    for (unsigned int i = 0; i < n; i++) {
+      bl_addr4(a, 0xc0a80000 + i, 5060);
+      tr_blacklist::instance()->insert(&a, 60000, "test");
+    }
+
+    bool all = true;
+    for (unsigned int i = 0; i < n; i++) {
+      bl_addr4(a, 0xc0a80000 + i, 5060);
+      all = all && tr_blacklist_exist(&a);
+      if (i & 1) tr_blacklist::instance()->remove(&a);
+    }
+    fct_chk(all);
+
+    // removed ones are gone, the others are still found
+    bool ok = true;
+    for (unsigned int i = 0; i < n; i++) {
+      bl_addr4(a, 0xc0a80000 + i, 5060);
+      ok = ok && (tr_blacklist_exist(&a) == !(i & 1));
+    }
+    fct_chk(ok);
+
+    AmArg stats;
+    tr_blacklist::instance()->getStats(stats);
+    fct_chk(stats["entries"].asInt() == (int)(n / 2));
+
+    for (unsigned int i = 0; i < n; i += 2) {
+      bl_addr4(a, 0xc0a80000 + i, 5060);
+      tr_blacklist::instance()->remove(&a);
+    }
+  } FCT_TEST_END();
+
+  FCT_TEST_BGN(blacklist_thread_counters) {
+    sockaddr_storage a, b;
+    bl_addr4(a, 0x0a000002, 5060);
+    bl_addr4(b, 0x0a000002, 5061);
+    tr_blacklist::instance()->insert(&a, 60000, "test");
+
+    AmArg before;
+    tr_blacklist::instance()->getStats(before);
+
+    // counted per thread, summed up by getStats()
+    BlacklistLookupThread t1(a, 100), t2(b, 50);
+    t1.start();
+    t2.start();
+    t1.join();
+    t2.join();
+    fct_chk(tr_blacklist_exist(&a));
+
+    AmArg after;
+    tr_blacklist::instance()->getStats(after);
+    fct_chk(after["hits"].asLongLong() - before["hits"].asLongLong() == 101);
+    fct_chk(after["misses"].asLongLong() - before["misses"].asLongLong() == 50);
+
+    tr_blacklist::instance()->remove(&a);
+  } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,321 @@
+#include "fct.h"
+
+#include "log.h"
+
+#ifdef WITH_BL_REDIS
+
+#include "../../apps/sbc/call_control/bl_redis/RedisAsyncPipeline.h"
+#include "../../apps/sbc/call_control/bl_redis/BLRedis.h"
+#include "AmUtils.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <event2/thread.h>
+
+/**
+ * REDIS server answering EXISTS <key> queries:
+ *  - 'bad...': 1, others: 0
+ *  - 'silent': no reply
+ *  - 'close': connection closed without reply
+ * Replies are held back until hold_replies commands have been received.
+ */
+class FakeRedisServer
+  : public AmThread
+{
+  int lsd;
+  int csd;
+  string buf;
+  vector<string> held;
+
+  AmSharedVar<bool> stop_requested;
+
+  /* one complete command from buf, @return false if incomplete */
+  bool parseCommand(vector<string>& args)
+  {
+    size_t pos = 0;
+    if (buf.empty() || buf[0] != '*')
+      return false;
+    size_t eol = buf.find("\r\n", pos);
+    if (eol == string::npos)
+      return false;
+    int argc = atoi(buf.c_str() + 1);
+    pos = eol + 2;
+
+    args.clear();
+    for (int i = 0; i < argc; i++) {
+      if (pos >= buf.length() || buf[pos] != '$')
+	return false;
+      eol = buf.find("\r\n", pos);
+      if (eol == string::npos)
+	return false;
+      size_t len = atoi(buf.c_str() + pos + 1);
+      pos = eol + 2;
+      if (buf.length() < pos + len + 2)
+	return false;
+      args.push_back(buf.substr(pos, len));
+      pos += len + 2;
+    }
+
+    buf.erase(0, pos);
+    return true;
+  }
+
+  void closeClient()
+  {
+    close(csd);
+    csd = -1;
+    buf.clear();
+    held.clear();
+  }
+
+  void handleCommand(const vector<string>& args)
+  {
+    commands.inc();
+    string key = args.size() > 1 ? args[1] : "";
+
+    if (key == "silent")
+      return;
+    if (key == "close") {
+      closeClient();
+      return;
+    }
+
+    held.push_back(key.compare(0, 3, "bad") ? ":0\r\n" : ":1\r\n");
+    if ((int)held.size() > max_held.get())
+      max_held.set(held.size());
+    if (held.size() < hold_replies.get())
+      return;
+
+    string out;
+    for (vector<string>::iterator it = held.begin(); it != held.end(); it++)
+      out += *it;
+    held.clear();
+    (void)write(csd, out.data(), out.length());
+  }
+
+public:
+  unsigned short port;
+  AmSharedVar<unsigned int> hold_replies;
+
+  atomic_int connections;
+  atomic_int commands;
+  AmSharedVar<int> max_held;
+
+  FakeRedisServer()
+    : csd(-1), stop_requested(false), port(0),
+      hold_replies(1), max_held(0)
+  {
+    lsd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t sa_len = sizeof(sa);
+    if (bind(lsd, (struct sockaddr*)&sa, sa_len) ||
+	listen(lsd, 4) ||
+	getsockname(lsd, (struct sockaddr*)&sa, &sa_len)) {
+      ERROR("fake REDIS server: %s\n", strerror(errno));
+      return;
+    }
+    port = ntohs(sa.sin_port);
+  }
+
+  ~FakeRedisServer()
+  {
+    if (csd >= 0)
+      close(csd);
+    close(lsd);
+  }
+
+  void run()
+  {
+    while (!stop_requested.get()) {
+      struct pollfd fds[2];
+      fds[0].fd = lsd;
+      fds[0].events = POLLIN;
+      fds[1].fd = csd;
+      fds[1].events = POLLIN;
+      if (poll(fds, csd >= 0 ? 2 : 1, 10) <= 0)
+	continue;
+
+      if (fds[0].revents & POLLIN) {
+	int sd = accept(lsd, NULL, NULL);
+	if (sd >= 0) {
+	  if (csd >= 0)
+	    closeClient();
+	  csd = sd;
+	  connections.inc();
+	}
+	continue;
+      }
+
+      if (csd < 0 || !(fds[1].revents & (POLLIN | POLLHUP)))
+	continue;
+
+      char rbuf[1024];
+      int len = read(csd, rbuf, sizeof(rbuf));
+      if (len <= 0) {
+	closeClient();
+	continue;
+      }
+      buf.append(rbuf, len);
+
+      vector<string> args;
+      while (csd >= 0 && parseCommand(args))
+	handleCommand(args);
+    }
+  }
+
+  void on_stop() { stop_requested.set(true); }
+};
+
+class RedisQueryThread
+  : public AmThread
+{
+  RedisAsyncPipeline* pipeline;
+  string key;
+
+public:
+  int res;
+  bool hit;
+
+  RedisQueryThread(RedisAsyncPipeline* pipeline, const string& key)
+    : pipeline(pipeline), key(key), res(RWT_E_WRITE), hit(false) {}
+
+  void run()
+  {
+    const char* argv[2] = { "EXISTS", key.c_str() };
+    size_t argvlen[2] = { 6, key.length() };
+    res = pipeline->query(2, argv, argvlen, 2000, hit);
+  }
+  void on_stop() {}
+};
+
+static int test_reply_handler(redisContext* c, redisReply* reply, bool& hit)
+{
+  hit = reply->type == REDIS_REPLY_INTEGER && reply->integer == 1;
+  return RWT_E_OK;
+}
+
+static int test_query(RedisAsyncPipeline& p, const string& key,
+		      unsigned int timeout_ms, bool& hit)
+{
+  const char* argv[2] = { "EXISTS", key.c_str() };
+  size_t argvlen[2] = { 6, key.length() };
+  return p.query(2, argv, argvlen, timeout_ms, hit);
+}
+
+static void stop_thread(AmThread* t)
+{
+  t->stop();
+  while (!t->is_stopped())
+    usleep(1000);
+}
+
+#endif
+
+FCTMF_SUITE_BGN(test_blredis) {
+
+#ifdef WITH_BL_REDIS
+    FCT_TEST_BGN(blredis_async_pipeline) {
+      // the pipeline's event loop is stopped from this thread
+      evthread_use_pthreads();
+
+      FakeRedisServer server;
+      fct_req(server.port != 0);
+      server.start();
+
+      RedisAsyncPipeline pipeline;
+      vector<unsigned int> timers;
+      timers.push_back(10);
+      pipeline.set_config("127.0.0.1", server.port, timers, test_reply_handler);
+      pipeline.start();
+
+      // pipelining: the server replies only after it has
+      // received all queries, over the same connection
+      server.hold_replies.set(4);
+      RedisQueryThread* q[4];
+      for (int i = 0; i < 4; i++) {
+	q[i] = new RedisQueryThread(&pipeline, i % 2 ? "bad" + int2str(i) : "good");
+	q[i]->start();
+      }
+      bool ok = true;
+      for (int i = 0; i < 4; i++) {
+	q[i]->join();
+	ok = ok && q[i]->res == RWT_E_OK && q[i]->hit == (i % 2 == 1);
+	delete q[i];
+      }
+      fct_chk(ok);
+      fct_chk(server.max_held.get() == 4);
+      fct_chk(server.connections.get() == 1);
+      server.hold_replies.set(1);
+
+      map<string,unsigned long long> stats;
+      pipeline.getStats(stats);
+      fct_chk(stats["queries"] == 4);
+      fct_chk(stats["batches"] >= 1 && stats["batches"] <= 4);
+      fct_chk(stats["connected"] == 1);
+
+      // reconnect: the query on the lost connection fails,
+      // later ones are sent on a new connection
+      bool hit = true;
+      fct_chk(test_query(pipeline, "close", 1000, hit) == RWT_E_CONNECTION);
+
+      int res = RWT_E_CONNECTION;
+      for (int i = 0; i < 100 && res != RWT_E_OK; i++) {
+	usleep(10000);
+	res = test_query(pipeline, "bad", 1000, hit);
+      }
+      fct_chk(res == RWT_E_OK && hit);
+      fct_chk(server.connections.get() == 2);
+
+      // timeout: no reply within the maximum wait time
+      struct timeval start, end, diff;
+      gettimeofday(&start, NULL);
+      fct_chk(test_query(pipeline, "silent", 100, hit) == RWT_E_CONNECTION);
+      gettimeofday(&end, NULL);
+      timersub(&end, &start, &diff);
+      fct_chk(diff.tv_sec * 1000 + diff.tv_usec / 1000 >= 100);
+      fct_chk(diff.tv_sec < 1);
+
+      stop_thread(&pipeline);
+      stop_thread(&server);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(blredis_result_cache_evict) {
+      BLRedisResultCache cache;
+      cache.set_config(60000, 1000, 3);
+
+      cache.put("a", true);
+      cache.put("b", false);
+      cache.put("c", true);
+
+      // full: the entry expiring first (the miss) is dropped
+      cache.put("d", true);
+
+      bool hit = false;
+      fct_chk(cache.get("a", hit) && hit);
+      fct_chk(!cache.get("b", hit));
+      fct_chk(cache.get("c", hit) && hit);
+      fct_chk(cache.get("d", hit) && hit);
+
+      // updated: expires later than the others now
+      cache.put("a", true);
+      cache.put("e", true);
+      fct_chk(cache.get("a", hit) && hit);
+      fct_chk(!cache.get("c", hit));
+
+      map<string,unsigned long long> stats;
+      cache.getStats(stats);
+      fct_chk(stats["cache_entries"] == 3);
+    } FCT_TEST_END();
+#endif
+
+} FCTMF_SUITE_END();
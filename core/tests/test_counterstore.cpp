@@ -0,0 +1,55 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../../apps/sbc/CounterStore.h"
+
+FCTMF_SUITE_BGN(test_counterstore) {
+
+    FCT_TEST_BGN(counterstore_inc_if_below) {
+      unsigned int v = 0;
+      bool res = CounterStore::instance()->incIfBelow("test::a", 2, v);
+      fct_chk(res && v == 1);
+      res = CounterStore::instance()->incIfBelow("test::a", 2, v);
+      fct_chk(res && v == 2);
+      res = CounterStore::instance()->incIfBelow("test::a", 2, v);
+      fct_chk(!res && v == 2);
+
+      // other keys are independent
+      res = CounterStore::instance()->incIfBelow("test::b", 2, v);
+      fct_chk(res && v == 1);
+
+      v = CounterStore::instance()->dec("test::a");
+      fct_chk(v == 1);
+      res = CounterStore::instance()->incIfBelow("test::a", 2, v);
+      fct_chk(res && v == 2);
+
+      // never below 0
+      CounterStore::instance()->dec("test::b");
+      v = CounterStore::instance()->dec("test::b");
+      fct_chk(v == 0);
+
+      AmArg counters, limiters;
+      CounterStore::instance()->getCounters(counters, limiters);
+      fct_chk(counters.hasMember("test::a") && counters["test::a"].asInt() == 2);
+      fct_chk(counters.hasMember("test::b") && counters["test::b"].asInt() == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(counterstore_limit) {
+      AmAppTimer::instance()->wall_clock = 1000;
+
+      // 3 units per second
+      bool limited = false;
+      for (int i=0; i<3; i++)
+	limited |= CounterStore::instance()->limit("test::cps", 3, 3);
+      fct_chk(!limited);
+      limited = CounterStore::instance()->limit("test::cps", 3, 3);
+      fct_chk(limited);
+
+      // one second later (wall clock: 20ms ticks)
+      AmAppTimer::instance()->wall_clock = 1051;
+      limited = CounterStore::instance()->limit("test::cps", 3, 3);
+      fct_chk(!limited);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
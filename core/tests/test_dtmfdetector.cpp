@@ -0,0 +1,125 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmDtmfDetector.h"
+#include "AmAudio.h"
+
+#include <math.h>
+#include <vector>
+
+#define RATE  8000
+#define FRAME 160 /* 20 ms */
+
+struct KeySink : public AmKeyPressSink
+{
+  std::vector<int> released;
+  int pressed;
+
+  KeySink() : pressed(0) {}
+
+  void registerKeyReleased(int event, Dtmf::EventSource source,
+			   const struct timeval& start, const struct timeval& stop,
+			   bool has_eventid, unsigned int event_id) {
+    released.push_back(event);
+  }
+
+  void registerKeyPressed(int event, Dtmf::EventSource source,
+			  bool has_eventid, unsigned int event_id) {
+    pressed++;
+  }
+
+  void flushKey(unsigned int event_id) {}
+};
+
+// sum of two sines (f2 may be 0), amplitude per tone
+static void tone(std::vector<short>& out, double f1, double f2, int ms, double amp)
+{
+  unsigned int n = RATE * ms / 1000;
+  for (unsigned int i = 0; i < n; i++) {
+    double s = amp * sin(2 * M_PI * f1 * i / RATE);
+    if (f2 > 0)
+      s += amp * sin(2 * M_PI * f2 * i / RATE);
+    out.push_back((short)s);
+  }
+}
+
+static void run(KeySink& sink, const std::vector<short>& pcm, bool fax)
+{
+  AmSemsInbandDtmfDetector det(&sink, RATE, fax);
+  unsigned long long ts = 0;
+
+  for (unsigned int i = 0; i + FRAME <= pcm.size(); i += FRAME) {
+    det.streamPut((const unsigned char*)&pcm[i], FRAME * sizeof(short), ts);
+    ts += FRAME * (WALLCLOCK_RATE / RATE);
+  }
+}
+
+FCTMF_SUITE_BGN(test_dtmfdetector) {
+
+    FCT_TEST_BGN(dtmfdetector_digits) {
+      // '5', '#' and '1' (~ -16 dBFS per tone) with pauses and noise
+      std::vector<short> pcm;
+      unsigned int seed = 1;
+      tone(pcm, 770, 1336, 100, 5000);
+      tone(pcm, 0, 0, 100, 0);
+      tone(pcm, 941, 1477, 100, 5000);
+      tone(pcm, 0, 0, 100, 0);
+      for (int i = 0; i < RATE / 10; i++) {
+	seed = seed * 1103515245 + 12345;
+	pcm.push_back((short)(((seed >> 16) & 0x7fff) - 16384) / 4);
+      }
+      tone(pcm, 697, 1209, 100, 5000);
+      tone(pcm, 0, 0, 100, 0);
+
+      int max = AmSemsInbandDtmfDetector::getSimdLevel();
+      for (int level = 0; level <= max; level++) {
+	AmSemsInbandDtmfDetector::setSimdLevel(level);
+	KeySink sink;
+	run(sink, pcm, false);
+	fct_chk(sink.released.size() == 3);
+	if (sink.released.size() == 3)
+	  fct_chk(sink.released[0] == 5 && sink.released[1] == 11 &&
+		  sink.released[2] == 1);
+	fct_chk(sink.pressed > 0);
+      }
+      AmSemsInbandDtmfDetector::setSimdLevel(max);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(dtmfdetector_silence) {
+      // below the energy gate
+      std::vector<short> pcm;
+      tone(pcm, 770, 1336, 200, 100);
+      KeySink sink;
+      run(sink, pcm, false);
+      fct_chk(sink.released.empty() && !sink.pressed);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(dtmfdetector_fax) {
+      // CNG: 500 ms 1100 Hz, then CED: 2100 Hz
+      std::vector<short> pcm;
+      tone(pcm, 1100, 0, 500, 8000);
+      tone(pcm, 0, 0, 500, 0);
+      tone(pcm, 2100, 0, 1000, 8000);
+      tone(pcm, 0, 0, 100, 0);
+
+      KeySink off;
+      run(off, pcm, false);
+      fct_chk(off.released.empty());
+
+      KeySink on;
+      run(on, pcm, true);
+      fct_chk(on.released.size() == 2);
+      if (on.released.size() == 2)
+	fct_chk(on.released[0] == 36 && on.released[1] == 32);
+
+      // a DTMF digit is no fax tone
+      pcm.clear();
+      tone(pcm, 852, 1209, 600, 5000);
+      tone(pcm, 0, 0, 100, 0);
+      KeySink digit;
+      run(digit, pcm, true);
+      fct_chk(digit.released.size() == 1 && digit.released[0] == 7);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,101 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmJitterBuffer.h"
+
+#define RATE  8000
+#define FRAME 160 /* 20 ms */
+
+// packet i of a stream with constant network delay
+#define PKT_TS(i)  (1000 + (i) * FRAME)
+#define PKT_SEQ(i) (65530 + (i))
+#define PKT_ARR(i) (5000 + (i) * FRAME)
+
+static ShortSample pkt[FRAME];
+static ShortSample out[FRAME * 8];
+
+static void put(AmJitterBuffer& jb, int i, unsigned int arrival)
+{
+  for (int k = 0; k < FRAME; k++)
+    pkt[k] = i;
+  jb.put(pkt, FRAME, PKT_TS(i), PKT_SEQ(i), arrival, false);
+}
+
+FCTMF_SUITE_BGN(test_jitterbuffer) {
+
+    FCT_TEST_BGN(jitterbuffer_order) {
+      AmJitterBuffer jb(RATE, 20, 500);
+      unsigned int size, ts;
+
+      // initial delay 60 ms, packet 1 reordered
+      put(jb, 0, PKT_ARR(0));
+      put(jb, 2, PKT_ARR(2));
+      put(jb, 1, PKT_ARR(2));
+      fct_chk(jb.getBuffered() == 3 * FRAME);
+
+      fct_chk(!jb.get(PKT_ARR(0) + 480 - FRAME, FRAME, out, &size, &ts));
+      fct_chk(jb.get(PKT_ARR(0) + 480, FRAME, out, &size, &ts));
+      fct_chk(size == FRAME && ts == PKT_ARR(0) + 480 && out[0] == 0);
+      fct_chk(!jb.get(PKT_ARR(0) + 480, FRAME, out, &size, &ts));
+
+      fct_chk(jb.get(PKT_ARR(1) + 480, FRAME, out, &size, &ts));
+      fct_chk(ts == PKT_ARR(1) + 480 && out[0] == 1);
+      fct_chk(jb.get(PKT_ARR(2) + 480, FRAME, out, &size, &ts));
+      fct_chk(ts == PKT_ARR(2) + 480 && out[0] == 2);
+      fct_chk(jb.getBuffered() == 0);
+
+      // duplicate
+      put(jb, 3, PKT_ARR(3));
+      put(jb, 3, PKT_ARR(3));
+      fct_chk(jb.getStats().duplicate == 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(jitterbuffer_loss) {
+      AmJitterBuffer jb(RATE, 20, 500);
+      unsigned int size, ts;
+
+      put(jb, 0, PKT_ARR(0));
+      put(jb, 2, PKT_ARR(2));
+      fct_chk(jb.get(PKT_ARR(0) + 480, FRAME, out, &size, &ts) && out[0] == 0);
+
+      // packet 1 is skipped when due
+      fct_chk(!jb.get(PKT_ARR(1) + 480, FRAME, out, &size, &ts));
+      fct_chk(jb.getStats().skipped == 1);
+
+      // and counted as late if it arrives afterwards, increasing the delay
+      put(jb, 1, PKT_ARR(1) + 500);
+      fct_chk(jb.getStats().late == 1);
+      fct_chk(jb.getDelay() == 480 + FRAME);
+      fct_chk(jb.get(PKT_ARR(2) + 480 + FRAME, FRAME, out, &size, &ts) && out[0] == 2);
+
+      // sequence number jump
+      put(jb, 1000, PKT_ARR(1000));
+      fct_chk(jb.getStats().resync == 1);
+      fct_chk(jb.get(PKT_ARR(1000) + jb.getDelay(), FRAME, out, &size, &ts));
+      fct_chk(out[0] == (ShortSample)1000);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(jitterbuffer_shrink) {
+      AmJitterBuffer jb(RATE, 20, 500);
+      unsigned int size, ts;
+      unsigned int played = 0;
+
+      // no jitter: the delay goes down to the minimum, one frame per window
+      for (int i = 0; i < 3 * JB_ADAPT_PACKETS; i++) {
+	put(jb, i, PKT_ARR(i));
+	while (jb.get(PKT_ARR(i), FRAME, out, &size, &ts))
+	  played++;
+	if (i == JB_ADAPT_PACKETS)
+	  fct_chk(jb.getDelay() == 480 - FRAME);
+      }
+      fct_chk(jb.getDelay() == 20 * RATE / 1000);
+      fct_chk(jb.getStats().late == 0 && jb.getStats().skipped == 0);
+      fct_chk(played + jb.getBuffered() / FRAME == 3 * JB_ADAPT_PACKETS);
+
+      // limits changed
+      jb.setDelay(100, 200);
+      fct_chk(jb.getDelay() == 100 * RATE / 1000);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,52 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmLatencyStats.h"
+#include "AmArg.h"
+
+FCTMF_SUITE_BGN(test_latency) {
+
+    FCT_TEST_BGN(latency_buckets) {
+      // exact below 32us, < 6.25% above
+      for (unsigned long long v = 0; v < 32; v++)
+	fct_chk(AmLatencyHistogram::value(AmLatencyHistogram::index(v)) == v);
+
+      unsigned long long vals[] = { 32, 47, 1000, 20000, 999999, 123456789 };
+      for (unsigned int i = 0; i < sizeof(vals)/sizeof(vals[0]); i++) {
+	unsigned int idx = AmLatencyHistogram::index(vals[i]);
+	unsigned long long up = AmLatencyHistogram::value(idx);
+	fct_chk(up >= vals[i]);
+	fct_chk(up - vals[i] <= vals[i] / 16);
+	fct_chk(AmLatencyHistogram::value(idx - 1) < vals[i]);
+      }
+
+      // clamped to the last bucket
+      fct_chk(AmLatencyHistogram::index(~0ULL) == LAT_BUCKETS - 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(latency_percentile_merge) {
+      AmLatencyHistogram a, b;
+      for (unsigned long long v = 1; v <= 900; v++)
+	a.add(v);
+      for (unsigned long long v = 0; v < 100; v++)
+	b.add(100000);
+
+      fct_chk(a.percentile(0.0) == 1);
+      unsigned long long p50 = a.percentile(0.5);
+      fct_chk(p50 >= 450 && p50 <= 450 + 450/16);
+
+      a.merge(b);
+      fct_chk(a.count == 1000);
+      fct_chk(a.max == 100000);
+      // p99 in b's values, not above the max
+      fct_chk(a.percentile(0.99) == 100000);
+      fct_chk(a.percentile(0.5) <= 500 + 500/16);
+
+      AmArg stats;
+      a.getStats(stats);
+      fct_chk(stats["count"].asLongLong() == 1000);
+      fct_chk(stats["max"].asLongLong() == 100000);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,60 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../AmMappedFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static void write_file(const char* path, const char* content)
+{
+  FILE* f = fopen(path, "w");
+  fputs(content, f);
+  fclose(f);
+}
+
+FCTMF_SUITE_BGN(test_mappedfile) {
+
+    FCT_TEST_BGN(mappedfile_shared) {
+      const char* path = "/tmp/sems_test_mappedfile";
+      write_file(path, "hello");
+
+      AmMappedFile* a = AmMappedFiles::instance()->map(path);
+      AmMappedFile* b = AmMappedFiles::instance()->map(path);
+      fct_chk(a != NULL && a == b);
+      fct_chk(a->getSize() == 5 && !memcmp(a->getData(), "hello", 5));
+
+      AmMappedFiles::instance()->release(a);
+      AmMappedFiles::instance()->release(b);
+      fct_chk(AmMappedFiles::instance()->getMappedBytes() == 0);
+
+      unlink(path);
+      fct_chk(AmMappedFiles::instance()->map(path) == NULL);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mappedfile_replaced) {
+      const char* path = "/tmp/sems_test_mappedfile";
+      const char* tmp_path = "/tmp/sems_test_mappedfile.new";
+      write_file(path, "hello");
+
+      AmMappedFile* a = AmMappedFiles::instance()->map(path);
+      fct_chk(a != NULL);
+
+      // replacing the file does not change the old mapping
+      write_file(tmp_path, "hello world");
+      rename(tmp_path, path);
+
+      AmMappedFile* b = AmMappedFiles::instance()->map(path);
+      fct_chk(b != NULL && b != a);
+      fct_chk(b->getSize() == 11);
+      fct_chk(a->getSize() == 5 && !memcmp(a->getData(), "hello", 5));
+
+      AmMappedFiles::instance()->release(a);
+      AmMappedFiles::instance()->release(b);
+      fct_chk(AmMappedFiles::instance()->getMappedBytes() == 0);
+      unlink(path);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,226 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmConfig.h"
+#include "sip/pcap_logger.h"
+#include "sip/msg_logger.h"
+#include "sip/msg_log_writer.h"
+#include "sip/ring_msg_logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* pcap file header, record header + IP + UDP header */
+#define PCAP_HDR_LEN 24
+#define PCAP_REC_LEN (16 + 20 + 8)
+
+static void fill_addr(sockaddr_storage& ss, const char* ip, unsigned short port)
+{
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in* sin = (sockaddr_in*)&ss;
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(port);
+  inet_aton(ip, &sin->sin_addr);
+}
+
+static long file_size(const string& path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st)) return -1;
+  return st.st_size;
+}
+
+/* file size once written by a writer thread (max. 2s) */
+static long wait_file_size(const string& path, long size)
+{
+  long s = file_size(path);
+  for (int i = 0; i < 200 && s != size; i++) {
+    usleep(10000);
+    s = file_size(path);
+  }
+  return s;
+}
+
+static int count_files(const char* dir)
+{
+  int n = 0;
+  DIR* d = opendir(dir);
+  if (!d) return -1;
+  struct dirent* e;
+  while ((e = readdir(d)) != NULL)
+    if (e->d_name[0] != '.') n++;
+  closedir(d);
+  return n;
+}
+
+static void remove_dir(const char* dir)
+{
+  DIR* d = opendir(dir);
+  if (!d) return;
+  struct dirent* e;
+  while ((e = readdir(d)) != NULL)
+    if (e->d_name[0] != '.') unlink((string(dir) + "/" + e->d_name).c_str());
+  closedir(d);
+  rmdir(dir);
+}
+
+FCTMF_SUITE_BGN(test_msglogger) {
+
+    FCT_TEST_BGN(msglogger_async) {
+      char dir[] = "/tmp/sems_msglog_XXXXXX";
+      fct_req(mkdtemp(dir) != NULL);
+      string path = string(dir) + "/test.pcap";
+
+      AmConfig::MsgLoggerAsync = true;
+      AmConfig::MsgLoggerRingSize = 64 * 1024;
+      msg_log_writer::instance()->init();
+      fct_req(msg_log_writer_active());
+
+      pcap_logger* l = new pcap_logger();
+      inc_ref(l);
+      fct_req(l->open(path.c_str()) == 0);
+
+      sockaddr_storage src, dst;
+      fill_addr(src, "127.0.0.1", 5060);
+      fill_addr(dst, "127.0.0.2", 5080);
+
+      // the ring holds ~400 of them, more may be dropped
+      // (depending on when the writer wakes up)
+      char msg[100];
+      memset(msg, 'x', sizeof(msg));
+      for (int i = 0; i < 1000; i++)
+	fct_chk(l->log(msg, sizeof(msg), &src, &dst, cstring("INVITE")) == 0);
+
+      AmArg stats;
+      msg_log_writer::instance()->getStats(stats);
+      long long dropped = stats["dropped_records"].asLongLong();
+      fct_chk(dropped >= 0 && dropped < 1000);
+
+      // all queued records written on dispose
+      dec_ref(l);
+      msg_log_writer::dispose();
+      AmConfig::MsgLoggerAsync = false;
+
+      fct_chk(file_size(path) ==
+	      PCAP_HDR_LEN + (1000 - dropped) * (PCAP_REC_LEN + (long)sizeof(msg)));
+
+      remove_dir(dir);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(msglogger_rotate_size) {
+      char dir[] = "/tmp/sems_msglog_XXXXXX";
+      fct_req(mkdtemp(dir) != NULL);
+      string path = string(dir) + "/test.pcap";
+
+      AmConfig::MsgLoggerMaxFileSize = 1000;
+
+      pcap_logger* l = new pcap_logger();
+      inc_ref(l);
+      fct_req(l->open(path.c_str()) == 0);
+
+      sockaddr_storage src, dst;
+      fill_addr(src, "127.0.0.1", 5060);
+      fill_addr(dst, "127.0.0.2", 5080);
+
+      // 6 records per file
+      char msg[100];
+      memset(msg, 'x', sizeof(msg));
+      for (int i = 0; i < 20; i++)
+	fct_chk(l->log(msg, sizeof(msg), &src, &dst, cstring("INVITE")) == 0);
+      dec_ref(l);
+      AmConfig::MsgLoggerMaxFileSize = 0;
+
+      // current file + rotated ones, each starting with the pcap header
+      fct_chk(count_files(dir) == 4);
+      fct_chk(file_size(path) == PCAP_HDR_LEN + 2 * (PCAP_REC_LEN + (long)sizeof(msg)));
+
+      remove_dir(dir);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(msglogger_rotate_cf_objects) {
+      char dir[] = "/tmp/sems_msglog_XXXXXX";
+      fct_req(mkdtemp(dir) != NULL);
+      string path = string(dir) + "/test.cf";
+
+      // 3 records per file
+      AmConfig::MsgLoggerMaxFileSize = 600;
+
+      cf_msg_logger* l = new cf_msg_logger();
+      inc_ref(l);
+      fct_req(l->open(path.c_str()) == 0);
+
+      sockaddr_storage src, dst;
+      fill_addr(src, "127.0.0.1", 5060);
+      fill_addr(dst, "127.0.0.2", 5080);
+
+      char msg[100];
+      memset(msg, 'x', sizeof(msg));
+      for (int i = 0; i < 4; i++)
+	fct_chk(l->log(msg, sizeof(msg), &src, &dst, cstring("INVITE")) == 0);
+      dec_ref(l);
+      AmConfig::MsgLoggerMaxFileSize = 0;
+
+      // the objects are defined again in the new file
+      fct_chk(count_files(dir) == 2);
+      FILE* fp = fopen(path.c_str(), "r");
+      fct_req(fp != NULL);
+      char buf[2048];
+      size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+      buf[len] = '\0';
+      fclose(fp);
+      fct_chk(strstr(buf, "<object name='127.0.0.1:5060'") != NULL);
+      fct_chk(strstr(buf, "<object name='127.0.0.2:5080'") != NULL);
+
+      remove_dir(dir);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(msglogger_ring_dump) {
+      char dir[] = "/tmp/sems_msglog_XXXXXX";
+      fct_req(mkdtemp(dir) != NULL);
+      string path = string(dir) + "/capture.pcap";
+
+      ring_msg_logger* l = new ring_msg_logger(4, true, path);
+      inc_ref(l);
+
+      sockaddr_storage src, dst;
+      fill_addr(src, "127.0.0.1", 5060);
+      fill_addr(dst, "127.0.0.2", 5080);
+
+      // SIP with body (headers kept) and RTP with 160 bytes payload
+      const char sip[] = "INVITE sip:a@b SIP/2.0\r\nCSeq: 1 INVITE\r\n\r\nv=0\r\n";
+      char rtp[12 + 160];
+      memset(rtp, 0, sizeof(rtp));
+      rtp[0] = (char)0x80;
+      for (int i = 0; i < 3; i++)
+	l->log(sip, sizeof(sip) - 1, &src, &dst, cstring("INVITE"));
+      for (int i = 0; i < 3; i++)
+	l->log(rtp, sizeof(rtp), &src, &dst, cstring());
+
+      // nothing written before dumped
+      fct_chk(file_size(path) == -1);
+
+      // last SIP message and the RTP packets (written in the background)
+      fct_chk(l->dump() == 4);
+      long sip_hdrs = sizeof(sip) - 1 - 5;
+      long size = PCAP_HDR_LEN + 4 * PCAP_REC_LEN + sip_hdrs + 3 * 12;
+      fct_chk(wait_file_size(path, size) == size);
+
+      // triggered: written when destroyed
+      l->log(rtp, sizeof(rtp), &src, &dst, cstring());
+      l->trigger("test");
+      fct_chk(l->triggered());
+      dec_ref(l);
+      size += PCAP_REC_LEN + 12;
+      fct_chk(wait_file_size(path, size) == size);
+
+      remove_dir(dir);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
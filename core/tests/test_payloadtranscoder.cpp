@@ -0,0 +1,128 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmPayloadTranscoder.h"
+#include "AmSdp.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+// G.711 reference decoders (Sun g711.c)
+static int alaw2linear(unsigned char a)
+{
+  a ^= 0x55;
+  int t = (a & 0x0F) << 4;
+  int seg = (a & 0x70) >> 4;
+  switch (seg) {
+  case 0: t += 8; break;
+  case 1: t += 0x108; break;
+  default: t += 0x108; t <<= seg - 1;
+  }
+  return (a & 0x80) ? t : -t;
+}
+
+static int ulaw2linear(unsigned char u)
+{
+  u = ~u;
+  int t = ((u & 0x0F) << 3) + 0x84;
+  t <<= (u & 0x70) >> 4;
+  return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+// magnitude of the code word (increasing with the sample value)
+static int alaw_mag(unsigned char a) { return (a ^ 0x55) & 0x7F; }
+static int ulaw_mag(unsigned char u) { return (~u) & 0x7F; }
+
+FCTMF_SUITE_BGN(test_payloadtranscoder) {
+
+    FCT_TEST_BGN(payloadtranscoder_tables) {
+      fct_chk(AmPayloadTranscoder::getTable("PCMA", 8000, "PCMU", 8000) != NULL);
+      fct_chk(AmPayloadTranscoder::getTable("pcmu", 8000, "pcma", 8000) != NULL);
+      fct_chk(AmPayloadTranscoder::getTable("PCMA", 8000, "PCMA", 8000) == NULL);
+      fct_chk(AmPayloadTranscoder::getTable("PCMA", 16000, "PCMU", 16000) == NULL);
+      fct_chk(AmPayloadTranscoder::getTable("G729", 8000, "PCMU", 8000) == NULL);
+
+      // static payload types without rtpmap
+      SdpPayload pcmu(0), pcma(8), gsm(3);
+      fct_chk(AmPayloadTranscoder::getTable(pcma, pcmu) ==
+	      AmPayloadTranscoder::getTable("PCMA", 8000, "PCMU", 8000));
+      fct_chk(AmPayloadTranscoder::getTable(pcmu, gsm) == NULL);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(payloadtranscoder_alaw_ulaw) {
+      const unsigned char* a2u =
+	AmPayloadTranscoder::getTable("PCMA", 8000, "PCMU", 8000);
+      const unsigned char* u2a =
+	AmPayloadTranscoder::getTable("PCMU", 8000, "PCMA", 8000);
+
+      bool sign_ok = true, monotonic = true;
+      for (int i = 1; i < 256; i++) {
+	unsigned char c = i, p = i - 1;
+	if ((a2u[c] & 0x80) != (c & 0x80)) sign_ok = false;
+	if ((u2a[c] & 0x80) != (c & 0x80)) sign_ok = false;
+
+	if ((c & 0x80) == (p & 0x80)) {
+	  if ((alaw_mag(c) > alaw_mag(p)) && (ulaw_mag(a2u[c]) < ulaw_mag(a2u[p])))
+	    monotonic = false;
+	  if ((ulaw_mag(c) > ulaw_mag(p)) && (alaw_mag(u2a[c]) < alaw_mag(u2a[p])))
+	    monotonic = false;
+	}
+      }
+      fct_chk(sign_ok);
+      fct_chk(monotonic);
+
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(payloadtranscoder_frame) {
+      // a sine frame encoded with the G.711 reference code (linear2alaw /
+      // linear2ulaw), and its translation by the reference alaw2ulaw /
+      // ulaw2alaw functions
+      unsigned char alaw[16] = {
+	0xD5, 0x84, 0xB5, 0xD3, 0xB2, 0xB0, 0xD0, 0x84,
+	0xD5, 0x57, 0x35, 0x30, 0x52, 0x30, 0x35, 0x57 };
+      const unsigned char alaw2ulaw[16] = {
+	0xFE, 0xAE, 0x9F, 0xF2, 0x98, 0x9A, 0xF4, 0xAE,
+	0xFE, 0x7A, 0x1F, 0x1A, 0x70, 0x1A, 0x1F, 0x7A };
+      unsigned char ulaw[16] = {
+	0xFF, 0xAD, 0x9F, 0xF1, 0x98, 0x9A, 0xF4, 0xAD,
+	0xFF, 0x79, 0x1F, 0x1A, 0x70, 0x1A, 0x1F, 0x79 };
+      const unsigned char ulaw2alaw[16] = {
+	0xD5, 0x87, 0xB5, 0xD2, 0xB2, 0xB0, 0xD0, 0x87,
+	0xD5, 0x56, 0x35, 0x30, 0x52, 0x30, 0x35, 0x56 };
+
+      int alaw_lin[16], ulaw_lin[16];
+      for (int i = 0; i < 16; i++) {
+	alaw_lin[i] = alaw2linear(alaw[i]);
+	ulaw_lin[i] = ulaw2linear(ulaw[i]);
+      }
+
+      AmPayloadTranscoder::translate(
+	AmPayloadTranscoder::getTable("PCMA", 8000, "PCMU", 8000), alaw, 16);
+      fct_chk(memcmp(alaw, alaw2ulaw, 16) == 0);
+
+      AmPayloadTranscoder::translate(
+	AmPayloadTranscoder::getTable("PCMU", 8000, "PCMA", 8000), ulaw, 16);
+      fct_chk(memcmp(ulaw, ulaw2alaw, 16) == 0);
+
+      // decoding the translated frame gives the same audio
+      // (within the quantization step of the target law)
+      bool close = true;
+      for (int i = 0; i < 16; i++) {
+	int d1 = ulaw2linear(alaw[i]) - alaw_lin[i];
+	int d2 = alaw2linear(ulaw[i]) - ulaw_lin[i];
+	if (abs(d1) > 8 + abs(alaw_lin[i]) / 16) close = false;
+	if (abs(d2) > 8 + abs(ulaw_lin[i]) / 16) close = false;
+      }
+      fct_chk(close);
+
+      // table IDs
+      const unsigned char* a2u =
+	AmPayloadTranscoder::getTable("PCMA", 8000, "PCMU", 8000);
+      unsigned int id = AmPayloadTranscoder::getTableId(a2u);
+      fct_chk(id > 0);
+      fct_chk(AmPayloadTranscoder::getTableById(id) == a2u);
+      fct_chk(AmPayloadTranscoder::getTableId(NULL) == 0);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,166 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../AmPromptCache.h"
+#include "../AmCachedAudioFile.h"
+#include "../AmPlugIn.h"
+#include "../AmConfig.h"
+#include "../amci/codecs.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_CODEC_8BIT 100
+
+/* 8 bit "codec": keeps the upper byte of each sample */
+static int test_8bit_encode(unsigned char* out, unsigned char* in,
+			    unsigned int size, unsigned int channels,
+			    unsigned int rate, long h_codec)
+{
+  short* pcm = (short*)in;
+  for (unsigned int i = 0; i < size / 2; i++)
+    out[i] = (pcm[i] >> 8) & 0xff;
+  return size / 2;
+}
+
+static unsigned int test_8bit_bytes2samples(long h_codec, unsigned int num_bytes)
+{
+  return num_bytes;
+}
+
+static unsigned int test_8bit_samples2bytes(long h_codec, unsigned int num_samples)
+{
+  return num_samples;
+}
+
+static amci_codec_t test_codec_8bit = {
+  TEST_CODEC_8BIT,
+  test_8bit_encode,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  test_8bit_bytes2samples,
+  test_8bit_samples2bytes
+};
+
+/* headerless 8 kHz PCM16 files */
+static int test_raw_mem_open(unsigned char* mptr, unsigned long size,
+			     unsigned long* pos, struct amci_file_desc_t* fmt_desc,
+			     int options, long h_codec)
+{
+  fmt_desc->subtype = 1;
+  fmt_desc->rate = 8000;
+  fmt_desc->channels = 1;
+  *pos = 0;
+  return 0;
+}
+
+static amci_subtype_t test_raw_subtypes[] = {
+  { 1, "PCM16", 8000, 1, CODEC_PCM16 },
+  { -1, NULL, 0, 0, -1 }
+};
+
+static amci_inoutfmt_t test_raw_format = {
+  (char*)"PromptCacheTest",
+  (char*)"pctest",
+  (char*)"audio/x-test",
+  NULL,
+  NULL,
+  test_raw_mem_open,
+  NULL,
+  test_raw_subtypes
+};
+
+static AmEncodedPrompt* wait_encoded(AmFileCache* f, int codec_id,
+				     unsigned int rate, unsigned int frame_size)
+{
+  for (int i = 0; i < 200; i++) {
+    AmEncodedPrompt* p =
+      AmPromptCache::instance()->get(f, codec_id, rate, frame_size);
+    if (p)
+      return p;
+    usleep(10000);
+  }
+  return NULL;
+}
+
+FCTMF_SUITE_BGN(test_promptcache) {
+
+    FCT_TEST_BGN(promptcache_encode) {
+      if (!AmPlugIn::instance()->codec(CODEC_PCM16))
+	AmPlugIn::instance()->init();
+      AmPlugIn::instance()->addCodec(&test_codec_8bit);
+      AmPlugIn::instance()->addFileFormat(&test_raw_format);
+
+      // 5.5 frames of 160 samples, upper byte counting up
+      char fname[64];
+      sprintf(fname, "/tmp/sems_test_prompt_%d.pctest", (int)getpid());
+      FILE* fp = fopen(fname, "w");
+      fct_req(fp != NULL);
+      for (unsigned int i = 0; i < 880; i++) {
+	short s = (short)((i % 100) << 8);
+	fwrite(&s, sizeof(s), 1, fp);
+      }
+      fclose(fp);
+
+      AmFileCache file;
+      fct_req(file.load(fname) == 0);
+
+      unsigned int max_size = AmConfig::PrecodedPromptsMaxSize;
+      AmConfig::PrecodedPromptsMaxSize = 1500;
+
+      // miss: played from the file while being encoded
+      fct_chk(AmPromptCache::instance()->get(&file, TEST_CODEC_8BIT, 8000, 160)
+	      == NULL);
+
+      AmEncodedPrompt* p = wait_encoded(&file, TEST_CODEC_8BIT, 8000, 160);
+      fct_req(p != NULL);
+
+      // the last frame is filled up with silence
+      fct_chk(p->numFrames() == 6);
+      fct_chk(p->size() == 6 * 160);
+      bool ok = true;
+      for (unsigned int i = 0; i < p->numFrames(); i++)
+	ok = ok && p->frameSize(i) == 160;
+      fct_chk(ok);
+      fct_chk(p->frame(0)[1] == 1 && p->frame(1)[0] == 60);
+      fct_chk(p->frame(5)[79] == 79 && p->frame(5)[80] == 0);
+
+      // hit: the same frames
+      AmEncodedPrompt* p2 =
+	AmPromptCache::instance()->get(&file, TEST_CODEC_8BIT, 8000, 160);
+      fct_chk(p2 == p);
+      if (p2)
+	dec_ref(p2);
+
+      unsigned int num, bytes;
+      AmPromptCache::instance()->getSize(num, bytes);
+      fct_chk(num == 1 && bytes == 6 * 160);
+
+      // another packetization exceeds the size limit:
+      // the least recently used one is dropped
+      AmEncodedPrompt* p3 = wait_encoded(&file, TEST_CODEC_8BIT, 8000, 80);
+      fct_req(p3 != NULL);
+      fct_chk(p3->frameSize(0) == 80);
+
+      AmPromptCache::instance()->getSize(num, bytes);
+      fct_chk(num == 1 && bytes == p3->size());
+
+      // still usable while referenced
+      fct_chk(p->frame(0)[1] == 1);
+
+      fct_chk(AmPromptCache::instance()->get(&file, TEST_CODEC_8BIT, 8000, 160)
+	      == NULL);
+
+      dec_ref(p);
+      dec_ref(p3);
+
+      AmPromptCache::dispose();
+      AmConfig::PrecodedPromptsMaxSize = max_size;
+      unlink(fname);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,87 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../AmRecordingWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+FCTMF_SUITE_BGN(test_recordingwriter) {
+
+    FCT_TEST_BGN(recordingwriter_write) {
+      AmRecordingWriter::instance()->init();
+      fct_req(AmRecordingWriter::instance()->enabled());
+
+      FILE* fp = tmpfile();
+      fputs("header", fp);
+
+      AmRecordingFile* f = AmRecordingWriter::instance()->open(fp);
+      fct_req(f != NULL);
+
+      // several chunks, in frames of 320 bytes
+      unsigned char frame[320];
+      for (unsigned int i = 0; i < 1000; i++) {
+	memset(frame, i & 0xff, sizeof(frame));
+	fct_chk(f->write(frame, sizeof(frame)) == 0);
+      }
+
+      unsigned long long written = 0;
+      fct_chk(AmRecordingWriter::instance()->close(f, written));
+      fct_chk(written == 1000 * sizeof(frame));
+
+      // everything in order after the header
+      fct_chk(ftell(fp) == (long)(6 + 1000 * sizeof(frame)));
+      rewind(fp);
+      char header[6];
+      fct_chk(fread(header, 1, 6, fp) == 6 && !memcmp(header, "header", 6));
+
+      bool ok = true;
+      for (unsigned int i = 0; i < 1000 && ok; i++) {
+	ok = fread(frame, 1, sizeof(frame), fp) == sizeof(frame) &&
+	  frame[0] == (i & 0xff) && frame[sizeof(frame) - 1] == (i & 0xff);
+      }
+      fct_chk(ok);
+      fclose(fp);
+
+      AmArg stats;
+      AmRecordingWriter::instance()->getStats(stats);
+      fct_chk(stats["written_bytes"].asLongLong() == 1000 * sizeof(frame));
+      fct_chk(stats["dropped_bytes"].asLongLong() == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(recordingwriter_frames) {
+      fct_req(AmRecordingWriter::instance()->enabled());
+
+      FILE* fp = tmpfile();
+      AmRecordingFile* f = AmRecordingWriter::instance()->open(fp);
+      fct_req(f != NULL);
+
+      // GSM frames (33 bytes) are not split into two chunks,
+      // writes larger than a chunk are kept together
+      unsigned char frame[33];
+      for (unsigned int i = 0; i < 2000; i++) {
+	memset(frame, i & 0xff, sizeof(frame));
+	fct_chk(f->write(frame, sizeof(frame)) == 0);
+      }
+      unsigned char* big = new unsigned char[REC_WRITER_CHUNK_SIZE + 100];
+      memset(big, 0xaa, REC_WRITER_CHUNK_SIZE + 100);
+      fct_chk(f->write(big, REC_WRITER_CHUNK_SIZE + 100) == 0);
+      delete [] big;
+
+      // written in time: fp is not closed by the writer thread
+      unsigned long long written = 0;
+      fct_chk(AmRecordingWriter::instance()->close(f, written, true));
+      fct_chk(written == 2000 * sizeof(frame) + REC_WRITER_CHUNK_SIZE + 100);
+
+      rewind(fp);
+      bool ok = true;
+      for (unsigned int i = 0; i < 2000 && ok; i++) {
+	ok = fread(frame, 1, sizeof(frame), fp) == sizeof(frame) &&
+	  frame[0] == (i & 0xff) && frame[sizeof(frame) - 1] == (i & 0xff);
+      }
+      fct_chk(ok);
+      fclose(fp);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,80 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../../apps/sbc/RegisterCache.h"
+#include "../../apps/sbc/RegisterCacheStorage.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+static AliasEntry make_alias_entry(const string& aor, const string& contact,
+				   const string& alias, const string& ip)
+{
+  AliasEntry ae;
+  ae.aor = aor;
+  ae.contact_uri = contact;
+  ae.alias = alias;
+  ae.source_ip = ip;
+  ae.source_port = 5060;
+  ae.trsp = "udp";
+  ae.remote_ua = "test-ua";
+  return ae;
+}
+
+FCTMF_SUITE_BGN(test_regcache) {
+
+    FCT_TEST_BGN(regcache_snapshot_reload) {
+      char dir_tmpl[] = "/tmp/sems_regcache_XXXXXX";
+      char* dir = mkdtemp(dir_tmpl);
+      fct_req(dir != NULL);
+
+      long int now = time(NULL);
+      RegisterCache* reg_cache = RegisterCache::instance();
+
+      RegCacheStorage* storage = new RegCacheStorage(dir, 0);
+      list<RegCacheBinding> bindings;
+      int loaded = storage->load(now, bindings);
+      fct_chk_eq_int(loaded, 0);
+      reg_cache->setStorageHandler(storage);
+      fct_chk(storage->snapshot(now));
+
+      // in snapshot
+      reg_cache->update("alias1", now + 3600,
+			make_alias_entry("sip:a@example.com","sip:a@10.0.0.1",
+					 "alias1","1.2.3.4"));
+      fct_chk(storage->snapshot(now));
+
+      // in journal only
+      reg_cache->update("alias2", now + 3600,
+			make_alias_entry("sip:b@example.com","sip:b@10.0.0.2",
+					 "alias2","1.2.3.5"));
+      reg_cache->update("alias3", now + 1,
+			make_alias_entry("sip:c@example.com","sip:c@10.0.0.3",
+					 "alias3","1.2.3.6"));
+      reg_cache->updateAliasExpires("alias2", now + 60);
+      reg_cache->remove("sip:a@example.com");
+
+      // alias3 is expired by now
+      RegCacheStorage reload(dir, 0);
+      loaded = reload.load(now + 2, bindings);
+      fct_chk_eq_int(loaded, 1);
+      fct_req(bindings.size() == 1);
+      const AliasEntry& ae = bindings.front().alias_entry;
+      fct_chk_eq_str(ae.alias.c_str(), "alias2");
+      fct_chk_eq_str(ae.aor.c_str(), "sip:b@example.com");
+      fct_chk_eq_str(ae.contact_uri.c_str(), "sip:b@10.0.0.2");
+      fct_chk_eq_str(ae.source_ip.c_str(), "1.2.3.5");
+      fct_chk_eq_int(ae.source_port, 5060);
+      fct_chk_eq_int(ae.ua_expire, now + 60);
+      fct_chk_eq_int(bindings.front().reg_expire, now + 3600);
+
+      reg_cache->remove("sip:b@example.com");
+      reg_cache->remove("sip:c@example.com");
+      reg_cache->setStorageHandler(new RegCacheStorageHandler());
+
+      string cmd = string("rm -rf ") + dir;
+      system(cmd.c_str());
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
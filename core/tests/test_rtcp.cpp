@@ -0,0 +1,120 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtcp.h"
+#include "AmRtpStream.h"
+
+#include <string.h>
+
+#define SSRC_A 0x11111111
+#define SSRC_B 0x22222222
+
+FCTMF_SUITE_BGN(test_rtcp) {
+
+    FCT_TEST_BGN(rtcp_rr_loss) {
+      AmRtcp a, b;
+      AmRtpReceiveStats rs;
+      for (unsigned short seq = 1; seq <= 10; seq++)
+	if (seq != 5) rs.update(seq);
+
+      // nothing sent: RR with one block and SDES
+      unsigned char buf[512];
+      unsigned int len = a.build(buf, sizeof(buf), SSRC_A, 0, rs, SSRC_B, "sems@127.0.0.1");
+      fct_chk(len > 0);
+      fct_chk(buf[1] == RTCP_RR);
+      fct_chk((buf[0] & 0x1f) == 1);
+      fct_chk(len % 4 == 0);
+
+      fct_chk(b.parse(buf, len, SSRC_B, false));
+
+      AmArg stats;
+      b.getStats(stats);
+      fct_chk(stats["rr_received"].asInt() == 1);
+      fct_chk(stats["bad_received"].asInt() == 0);
+      fct_chk(stats["remote_cum_lost"].asInt() == 1);
+      fct_chk(stats["remote_fraction_lost"].asDouble() == 25.0 / 256.0);
+      // no SR received by a: no RTT
+      fct_chk(!stats.hasMember("rtt_ms"));
+
+      // not about us
+      AmRtcp c;
+      fct_chk(c.parse(buf, len, SSRC_A, false));
+      AmArg c_stats;
+      c.getStats(c_stats);
+      fct_chk(!c_stats.hasMember("remote_cum_lost"));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtcp_sr_rtt) {
+      AmRtcp a, b;
+      AmRtpReceiveStats rs_a, rs_b;
+      rs_b.update(100);
+
+      unsigned char buf[512];
+      a.sent(160);
+      unsigned int len = a.build(buf, sizeof(buf), SSRC_A, 8000, rs_a, SSRC_B, "a");
+      fct_chk(buf[1] == RTCP_SR);
+      fct_chk((buf[0] & 0x1f) == 0);
+      fct_chk(b.parse(buf, len, SSRC_B, false));
+
+      // b's RR carries LSR/DLSR of a's SR
+      len = b.build(buf, sizeof(buf), SSRC_B, 0, rs_b, SSRC_A, "b");
+      fct_chk(a.parse(buf, len, SSRC_A, false));
+
+      AmArg stats;
+      a.getStats(stats);
+      fct_chk(stats.hasMember("rtt_ms"));
+      fct_chk(stats["rtt_ms"].asInt() >= 0 && stats["rtt_ms"].asInt() < 100);
+
+      // relayed: LSR is not ours
+      AmRtcp r;
+      fct_chk(r.parse(buf, len, 0, true));
+      AmArg r_stats;
+      r.getStats(r_stats);
+      fct_chk(r_stats.hasMember("remote_cum_lost"));
+      fct_chk(!r_stats.hasMember("rtt_ms"));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtcp_xr_voip) {
+      // RR without blocks + XR with VoIP metrics block
+      unsigned char buf[8 + 8 + 36];
+      memset(buf, 0, sizeof(buf));
+      buf[0] = 0x80; buf[1] = RTCP_RR; buf[3] = 1;
+      buf[8] = 0x80; buf[9] = RTCP_XR; buf[11] = 10;
+      unsigned char* x = buf + 16;
+      x[0] = 7; x[3] = 8;
+      x[8] = 64;             // loss rate 1/4
+      x[16] = 0; x[17] = 80; // RTT 80ms
+      x[24] = 80;            // R factor
+      x[26] = 41;            // MOS-LQ 4.1
+      x[27] = 127;           // MOS-CQ unavailable
+
+      AmRtcp a;
+      fct_chk(a.parse(buf, sizeof(buf), SSRC_A, false));
+
+      AmArg stats;
+      a.getStats(stats);
+      fct_chk(stats["xr_received"].asInt() == 1);
+      fct_chk(stats["xr"]["loss_rate"].asDouble() == 0.25);
+      fct_chk(stats["xr"]["rtt_ms"].asInt() == 80);
+      fct_chk(stats["xr"]["r_factor"].asInt() == 80);
+      fct_chk(stats["xr"]["mos_lq"].asDouble() == 4.1);
+      fct_chk(!stats["xr"].hasMember("mos_cq"));
+
+      // truncated
+      buf[3] = 20;
+      fct_chk(!a.parse(buf, sizeof(buf), SSRC_A, false));
+      a.getStats(stats);
+      fct_chk(stats["bad_received"].asInt() == 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtcp_interval) {
+      for (int i = 0; i < 100; i++) {
+	unsigned int t = AmRtcp::interval(false);
+	fct_chk(t >= 2050 && t <= 6160);
+	t = AmRtcp::interval(true);
+	fct_chk(t >= 1025 && t <= 3080);
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
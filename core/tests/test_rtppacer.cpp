@@ -0,0 +1,142 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtpPacer.h"
+#include "AmRtpStream.h"
+#include "sip/ip_util.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <netinet/in.h>
+
+static int bind_local(struct sockaddr_storage& addr)
+{
+  socklen_t len = sizeof(addr);
+  am_inet_pton("127.0.0.1", &addr);
+  am_set_port(&addr, 0);
+
+  int sd = socket(AF_INET, SOCK_DGRAM, 0);
+  bind(sd, (struct sockaddr*)&addr, SA_len(&addr));
+  getsockname(sd, (struct sockaddr*)&addr, &len);
+  return sd;
+}
+
+static unsigned int recv_all(int sd)
+{
+  char buf[2048];
+  unsigned int n = 0;
+  while (recv(sd, buf, sizeof(buf), MSG_DONTWAIT) > 0) n++;
+  return n;
+}
+
+FCTMF_SUITE_BGN(test_rtppacer) {
+
+    FCT_TEST_BGN(rtppacer_spread) {
+      struct sockaddr_storage l_addr, r_addr;
+      int l_sd = bind_local(l_addr);
+      int r_sd = bind_local(r_addr);
+
+      AmRtpStream s1(NULL, 0), s2(NULL, 0);
+      AmRtpPacer pacer;
+      unsigned char pkt[172];
+      memset(pkt, 0, sizeof(pkt));
+
+      for (int i = 0; i < 8; i++)
+	fct_chk(pacer.add(i & 1 ? &s1 : &s2, l_sd, 0, 0, NULL, 0,
+			  &l_addr, &r_addr, pkt, sizeof(pkt)));
+
+      // too big to be queued
+      unsigned char big[RTP_PACER_MAX_LEN + 1];
+      fct_chk(!pacer.add(&s1, l_sd, 0, 0, NULL, 0, &l_addr, &r_addr,
+			 big, sizeof(big)));
+
+      // s2's packets are dropped
+      pacer.cancel(&s2);
+
+      struct timeval start, tick, end, diff;
+      tick.tv_sec = 0;
+      tick.tv_usec = 10000;
+      gettimeofday(&start, NULL);
+
+      pacer.flush(start, tick);
+      gettimeofday(&end, NULL);
+      timersub(&end, &start, &diff);
+
+      // last slot after 3/4 of the tick (without the guard time)
+      fct_chk(diff.tv_sec == 0 && diff.tv_usec >= 6000);
+      fct_chk(recv_all(r_sd) == 4);
+
+      // nothing left
+      pacer.flush(start, tick);
+      fct_chk(recv_all(r_sd) == 0);
+
+      close(l_sd);
+      close(r_sd);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtppacer_media_tick) {
+      // same sequence as AmMediaProcessorThread::run()
+      struct sockaddr_storage l_addr, r_addr;
+      int l_sd = bind_local(l_addr);
+      int r_sd = bind_local(r_addr);
+
+      AmRtpStream s(NULL, 0);
+      AmRtpPacer pacer;
+      unsigned char pkt[172];
+      memset(pkt, 0, sizeof(pkt));
+
+      struct timeval now, next_tick, diff, tick;
+      tick.tv_sec = 0;
+      tick.tv_usec = 10000;
+      gettimeofday(&now, NULL);
+      timeradd(&tick, &now, &next_tick);
+
+      bool spread = true, in_tick = true;
+      for (int t = 0; t < 3; t++) {
+	gettimeofday(&now, NULL);
+	if (timercmp(&now, &next_tick, <)) {
+	  struct timespec sdiff, rem;
+	  timersub(&next_tick, &now, &diff);
+	  sdiff.tv_sec  = diff.tv_sec;
+	  sdiff.tv_nsec = diff.tv_usec * 1000;
+	  nanosleep(&sdiff, &rem);
+	}
+
+	// processAudio()
+	for (int i = 0; i < 4; i++)
+	  pacer.add(&s, l_sd, 0, 0, NULL, 0, &l_addr, &r_addr, pkt, sizeof(pkt));
+
+	struct timeval begin, end, tick_end;
+	gettimeofday(&begin, NULL);
+	pacer.flush(next_tick, tick);
+	gettimeofday(&end, NULL);
+
+	// spread over the rest of the tick (not one burst), done before
+	// the next one - with some slack for a loaded machine
+	struct timeval left, slack;
+	timeradd(&next_tick, &tick, &tick_end);
+	timersub(&tick_end, &begin, &left);
+	timersub(&end, &begin, &diff);
+	if (!left.tv_sec && left.tv_usec > 4000 && diff.tv_usec < left.tv_usec / 4)
+	  spread = false;
+	slack.tv_sec = 0;
+	slack.tv_usec = 3000;
+	timeradd(&tick_end, &slack, &tick_end);
+	if (timercmp(&end, &tick_end, >)) in_tick = false;
+
+	timeradd(&tick, &next_tick, &next_tick);
+      }
+
+      fct_chk(spread);
+      fct_chk(in_tick);
+      fct_chk(recv_all(r_sd) == 12);
+
+      close(l_sd);
+      close(r_sd);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,78 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtpPortMap.h"
+#include "sip/ip_util.h"
+
+#include <unistd.h>
+
+FCTMF_SUITE_BGN(test_rtpportmap) {
+
+    FCT_TEST_BGN(rtpportmap_alloc) {
+      // 4 pairs: 10001..10009 -> 10002, 10004, 10006, 10008
+      AmRtpPortMap ports(10001, 10009, 0);
+
+      fct_chk(ports.alloc() == 10002);
+      fct_chk(ports.alloc() == 10004);
+      fct_chk(ports.alloc() == 10006);
+      fct_chk(ports.alloc() == 10008);
+      fct_chk(ports.alloc() == 0);
+
+      // no quarantine: free again right away
+      ports.release(10004);
+      fct_chk(ports.alloc() == 10004);
+      fct_chk(ports.alloc() == 0);
+
+      AmArg stats;
+      ports.getStats(stats);
+      fct_chk(stats["used"].asInt() == 4);
+      fct_chk(stats["alloc_failed"].asLongLong() == 2);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtpportmap_quarantine) {
+      AmRtpPortMap ports(20000, 20003, 50);
+
+      fct_chk(ports.alloc() == 20000);
+      fct_chk(ports.alloc() == 20002);
+      ports.release(20000);
+      fct_chk(ports.alloc() == 0);
+
+      usleep(60000);
+      fct_chk(ports.alloc() == 20000);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtpportmap_pool) {
+      AmRtpPortMap ports(42000, 42099, 0);
+      struct sockaddr_storage addr, other;
+      AmRtpSocketPair p;
+
+      am_inet_pton("127.0.0.1", &addr);
+      am_inet_pton("127.0.0.2", &other);
+
+      ports.setPool("127.0.0.1", 4);
+      ports.fillPool();
+
+      AmArg stats;
+      ports.getStats(stats);
+      fct_chk(stats["pooled"].asInt() == 4);
+
+      fct_chk(!ports.take(&other, p));
+      fct_chk(ports.take(&addr, p));
+      fct_chk(p.port >= 42000 && p.port < 42100 && !(p.port & 1));
+      fct_chk(p.rtp_sd > 0 && p.rtcp_sd > 0);
+
+      // the pair is in use: binding it again fails
+      int sd, rtcp_sd;
+      fct_chk(AmRtpPortMap::bindPair(&addr, p.port, sd, rtcp_sd) == -1);
+
+      close(p.rtp_sd);
+      close(p.rtcp_sd);
+      ports.release(p.port);
+      ports.clearPool();
+
+      ports.getStats(stats);
+      fct_chk(stats["pooled"].asInt() == 0);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
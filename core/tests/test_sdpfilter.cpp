@@ -0,0 +1,118 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../../apps/sbc/SDPFilter.h"
+
+#define SDP_SESSION \
+  "v=0\r\n" \
+  "o=- 123 456 IN IP4 10.0.0.1\r\n" \
+  "s=-\r\n" \
+  "c=IN IP4 10.0.0.1\r\n" \
+  "t=0 0\r\n" \
+  "a=X-session:1\r\n"
+
+#define SDP_AUDIO \
+  "m=audio 10000 RTP/AVP 0 8 101\r\n" \
+  "a=rtpmap:101 telephone-event/8000\r\n" \
+  "a=ptime:20\r\n" \
+  "a=sendrecv\r\n"
+
+#define SDP_VIDEO \
+  "m=video 10002 RTP/AVP 96\r\n" \
+  "a=rtpmap:96 H264/90000\r\n" \
+  "a=X-video\r\n"
+
+static vector<FilterEntry> make_filter(FilterType t, const char* item)
+{
+  vector<FilterEntry> res;
+  res.push_back(FilterEntry());
+  res.back().filter_type = t;
+  res.back().filter_list.insert(item);
+  return res;
+}
+
+FCTMF_SUITE_BGN(test_sdpfilter) {
+
+    FCT_TEST_BGN(sdplines_alines) {
+      const string sdp = SDP_SESSION SDP_AUDIO SDP_VIDEO;
+      string out;
+      int res = filterSDPLines(sdp.c_str(), sdp.length(), out,
+			       vector<FilterEntry>(), make_filter(Blacklist, "x-video"));
+      fct_chk(res == 0);
+      fct_chk(out == SDP_SESSION SDP_AUDIO
+	      "m=video 10002 RTP/AVP 96\r\n"
+	      "a=rtpmap:96 H264/90000\r\n");
+
+      // rtpmap & co. are not subject to a-line filtering on media level
+      res = filterSDPLines(sdp.c_str(), sdp.length(), out,
+			   vector<FilterEntry>(), make_filter(Whitelist, "ptime"));
+      fct_chk(res == 0);
+      fct_chk(out ==
+	      "v=0\r\n"
+	      "o=- 123 456 IN IP4 10.0.0.1\r\n"
+	      "s=-\r\n"
+	      "c=IN IP4 10.0.0.1\r\n"
+	      "t=0 0\r\n"
+	      SDP_AUDIO
+	      "m=video 10002 RTP/AVP 96\r\n"
+	      "a=rtpmap:96 H264/90000\r\n");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(sdplines_media) {
+      const string sdp = SDP_SESSION SDP_AUDIO SDP_VIDEO;
+      string out;
+      int res = filterSDPLines(sdp.c_str(), sdp.length(), out,
+			       make_filter(Whitelist, "audio"), vector<FilterEntry>());
+      fct_chk(res == 0);
+      fct_chk(out == SDP_SESSION SDP_AUDIO
+	      "m=video 0 RTP/AVP 96\r\n"
+	      "a=rtpmap:96 H264/90000\r\n"
+	      "a=X-video\r\n");
+
+      res = filterSDPLines(sdp.c_str(), sdp.length(), out,
+			   make_filter(Whitelist, "image"), vector<FilterEntry>());
+      fct_chk(res == -488);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(sdplines_same_as_amsdp) {
+      const string sdp = SDP_SESSION SDP_AUDIO SDP_VIDEO;
+      vector<FilterEntry> mf = make_filter(Blacklist, "video");
+      vector<FilterEntry> af = make_filter(Blacklist, "ptime");
+
+      string out;
+      filterSDPLines(sdp.c_str(), sdp.length(), out, mf, af);
+
+      AmSdp s1, s2;
+      fct_chk(s1.parse(out.c_str()) == 0);
+      fct_chk(s2.parse(sdp.c_str()) == 0);
+      filterMedia(s2, mf);
+      filterSDPalines(s2, af);
+
+      string p1, p2;
+      s1.print(p1);
+      s2.print(p2);
+      fct_chk(p1 == p2);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(sdp_rtcp_mux) {
+      const string sdp = SDP_SESSION SDP_AUDIO "a=rtcp-mux\r\n" SDP_VIDEO;
+
+      AmSdp s;
+      fct_chk(s.parse(sdp.c_str()) == 0);
+      fct_chk(s.media.size() == 2);
+      fct_chk(s.media[0].hasRtcpMux());
+      fct_chk(!s.media[1].hasRtcpMux());
+
+      s.media[0].setRtcpMux(true);
+      s.media[0].setRtcpMux(false);
+      fct_chk(!s.media[0].hasRtcpMux());
+      s.media[1].setRtcpMux(true);
+
+      string p;
+      s.print(p);
+      fct_chk(p.find("a=X-video\r\na=rtcp-mux\r\n") != string::npos);
+      fct_chk(p.find("rtcp-mux") == p.rfind("rtcp-mux"));
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
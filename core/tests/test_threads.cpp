@@ -0,0 +1,110 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmThread.h"
+#include "AmEventQueue.h"
+#include "AmArg.h"
+
+#include <string.h>
+
+class TestQueueThread
+  : public AmThread,
+    public AmEventQueue,
+    public AmEventHandler
+{
+public:
+  AmCondition<bool> started;
+  AmCondition<bool> go;
+
+  TestQueueThread() : AmEventQueue(this) { setThreadName("test-queue"); }
+
+  void run() {
+    started.set(true);
+    go.wait_for();
+    processEvents();
+  }
+  void on_stop() {}
+  void process(AmEvent*) {}
+};
+
+class TestStatsThread
+  : public AmThread
+{
+public:
+  AmSharedVar<bool> stop_requested;
+  int rounds;
+
+  TestStatsThread() : stop_requested(false), rounds(0) {}
+
+  void run() {
+    while (!stop_requested.get()) {
+      AmArg stats;
+      AmThread::getThreadStats(stats);
+      rounds++;
+    }
+  }
+  void on_stop() {}
+};
+
+static int find_thread(AmArg& stats, const char* name)
+{
+  for (size_t i = 0; i < stats["threads"].size(); i++)
+    if (!strcmp(stats["threads"][i]["name"].asCStr(), name))
+      return (int)i;
+  return -1;
+}
+
+FCTMF_SUITE_BGN(test_threads) {
+
+    FCT_TEST_BGN(threads_registry) {
+      TestQueueThread t;
+      t.start();
+      t.started.wait_for();
+
+      for (int i = 0; i < 3; i++)
+	t.postEvent(new AmEvent(0));
+
+      AmArg stats;
+      AmThread::getThreadStats(stats);
+      int i = find_thread(stats, "test-queue");
+      fct_chk(i >= 0);
+      if (i >= 0) {
+	AmArg& s = stats["threads"][i];
+	fct_chk(s["role"].asCStr() == std::string("TestQueueThread"));
+	fct_chk(s["queue"].asInt() == 3);
+	fct_chk(s["tid"].asInt() > 0);
+      }
+      fct_chk(stats["roles"]["TestQueueThread"]["threads"].asInt() == 1);
+
+      t.go.set(true);
+      t.join();
+
+      AmArg after;
+      AmThread::getThreadStats(after);
+      fct_chk(find_thread(after, "test-queue") < 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(threads_stats_while_ending) {
+      // threads end and are deleted while their stats are read
+      TestStatsThread reader;
+      reader.start();
+
+      for (int i = 0; i < 200; i++) {
+	TestQueueThread* t = new TestQueueThread();
+	t->start();
+	t->go.set(true);
+	t->join();
+	delete t;
+      }
+
+      reader.stop_requested.set(true);
+      reader.join();
+      fct_chk(reader.rounds > 0);
+
+      AmArg stats;
+      AmThread::getThreadStats(stats);
+      fct_chk(find_thread(stats, "test-queue") < 0);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
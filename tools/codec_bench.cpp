@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2013 FRAFOS GmbH
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * sems-codec-bench: runs the codecs of SEMS codec plug-ins (amci) over
+ * a reference corpus and reports the encoding/decoding speed.
+ *
+ *   sems-codec-bench [-c corpus.raw [-r rate]] [-t seconds] plugin.so ...
+ *
+ * The corpus is raw 16 bit mono PCM (host byte order); without corpus
+ * a speech-like test signal is generated. The corpus is resampled
+ * (linear interpolation) to each payload's sample rate.
+ */
+
+#include "amci/amci.h"
+#include "amci/codecs.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+using std::string;
+using std::vector;
+
+/* logging symbols referenced by the plug-ins (see core/log.h),
+   exported to them with -rdynamic */
+extern "C" {
+  int log_level  = 1;
+  int log_stderr = 1;
+  const char* log_level2str[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+
+  // log_stderr already prints the message
+  void run_log_hooks(int, pid_t, pthread_t, const char*, const char*, int, char*) {}
+}
+
+#define DEFAULT_FRAME_MS 20
+#define MAX_ENCODED_FACTOR 4 /* encoded frame buffer: bytes per sample */
+
+static double now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* voiced segments (harmonics of a gliding pitch) and noise, ~10 s */
+static void generate_corpus(vector<short>& out, unsigned int rate)
+{
+  unsigned int n = rate * 10;
+  double phase = 0.0;
+  unsigned int seed = 1;
+
+  out.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    double t = (double)i / rate;
+    double f0 = 120.0 + 40.0 * sin(2 * M_PI * 0.7 * t);
+    phase += 2 * M_PI * f0 / rate;
+
+    double s = 0.0;
+    // voiced 200ms, unvoiced 100ms
+    if (fmod(t, 0.3) < 0.2) {
+      for (int h = 1; h <= 12 && h * f0 < rate / 2; h++)
+	s += sin(h * phase) / h;
+      s *= 0.5 + 0.5 * sin(2 * M_PI * 3.0 * t);
+    } else {
+      seed = seed * 1103515245 + 12345;
+      s = ((int)((seed >> 16) & 0x7fff) - 16384) / 32768.0;
+    }
+    out[i] = (short)(s * 8000.0);
+  }
+}
+
+static void resample_linear(const vector<short>& in, unsigned int in_rate,
+			    vector<short>& out, unsigned int out_rate)
+{
+  if (in_rate == out_rate) {
+    out = in;
+    return;
+  }
+
+  unsigned int n = (unsigned int)((unsigned long long)in.size() * out_rate / in_rate);
+  out.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    double pos = (double)i * in_rate / out_rate;
+    unsigned int k = (unsigned int)pos;
+    double frac = pos - k;
+    short a = in[k];
+    short b = k + 1 < in.size() ? in[k + 1] : a;
+    out[i] = (short)(a + (b - a) * frac);
+  }
+}
+
+static bool load_corpus(const char* file, vector<short>& out)
+{
+  FILE* fp = fopen(file, "rb");
+  if (!fp) {
+    perror(file);
+    return false;
+  }
+
+  short buf[4096];
+  size_t n;
+  while ((n = fread(buf, sizeof(short), 4096, fp)) > 0)
+    out.insert(out.end(), buf, buf + n);
+  fclose(fp);
+
+  if (out.empty()) {
+    fprintf(stderr, "%s: empty corpus\n", file);
+    return false;
+  }
+  return true;
+}
+
+static amci_codec_t* find_codec(amci_exports_t* exports, int codec_id)
+{
+  for (amci_codec_t* c = exports->codecs; c && c->id >= 0; c++)
+    if (c->id == codec_id)
+      return c;
+  return NULL;
+}
+
+struct BenchResult
+{
+  double us;
+  unsigned int frames;
+};
+
+/* runs fn over all frames until at least 'seconds' have elapsed */
+template<class Fn>
+static BenchResult run_timed(Fn& fn, unsigned int num_frames, double seconds)
+{
+  BenchResult r;
+  r.frames = 0;
+
+  double start = now_us();
+  double end = start + seconds * 1e6;
+  double t;
+  do {
+    for (unsigned int i = 0; i < num_frames; i++)
+      fn(i);
+    r.frames += num_frames;
+    t = now_us();
+  } while (t < end);
+
+  r.us = t - start;
+  return r;
+}
+
+struct Encoder
+{
+  amci_codec_t* codec;
+  long h_codec;
+  unsigned int rate;
+  const vector<short>& pcm;
+  unsigned int frame_samples;
+  vector<unsigned char> out;
+  unsigned int max_out;
+  vector<int> sizes;
+
+  Encoder(amci_codec_t* c, long h, unsigned int r, const vector<short>& p,
+	  unsigned int fs, unsigned int num_frames)
+    : codec(c), h_codec(h), rate(r), pcm(p), frame_samples(fs),
+      out(num_frames * fs * MAX_ENCODED_FACTOR), max_out(fs * MAX_ENCODED_FACTOR),
+      sizes(num_frames) {}
+
+  void operator()(unsigned int i) {
+    sizes[i] = codec->encode(&out[i * max_out],
+			     (unsigned char*)&pcm[i * frame_samples],
+			     frame_samples * sizeof(short), 1, rate, h_codec);
+  }
+};
+
+struct Decoder
+{
+  amci_codec_t* codec;
+  long h_codec;
+  unsigned int rate;
+  const Encoder& enc;
+  vector<unsigned char> out;
+
+  Decoder(amci_codec_t* c, long h, unsigned int r, const Encoder& e)
+    : codec(c), h_codec(h), rate(r), enc(e),
+      out(e.frame_samples * sizeof(short) * 4) {}
+
+  void operator()(unsigned int i) {
+    // codecs with larger internal frames (iSAC) return nothing for some calls
+    if (enc.sizes[i] <= 0)
+      return;
+    codec->decode(&out[0], (unsigned char*)&enc.out[i * enc.max_out],
+		  enc.sizes[i], 1, rate, h_codec);
+  }
+};
+
+static void bench_payload(amci_exports_t* exports, amci_payload_t* p,
+			  const vector<short>& corpus, unsigned int corpus_rate,
+			  double seconds)
+{
+  amci_codec_t* codec = find_codec(exports, p->codec_id);
+  if (!codec || !codec->encode || !codec->decode)
+    return;
+
+  unsigned int rate = p->sample_rate;
+  unsigned int frame_samples = rate * DEFAULT_FRAME_MS / 1000;
+  long h_codec = 0;
+
+  if (codec->init) {
+    amci_codec_fmt_info_t fmt_info[4];
+    memset(fmt_info, 0, sizeof(fmt_info));
+    h_codec = codec->init(NULL, fmt_info);
+    if (h_codec == -1) {
+      fprintf(stderr, "%s/%u: codec init failed\n", p->name, rate);
+      return;
+    }
+    for (int i = 0; i < 4 && fmt_info[i].id; i++) {
+      if (fmt_info[i].id == AMCI_FMT_FRAME_SIZE)
+	frame_samples = fmt_info[i].value;
+      else if (fmt_info[i].id == AMCI_FMT_FRAME_LENGTH)
+	frame_samples = rate * fmt_info[i].value / 1000;
+    }
+  }
+
+  vector<short> pcm;
+  resample_linear(corpus, corpus_rate, pcm, rate);
+  unsigned int num_frames = pcm.size() / frame_samples;
+  if (!num_frames) {
+    fprintf(stderr, "%s/%u: corpus shorter than one frame\n", p->name, rate);
+  } else {
+    Encoder enc(codec, h_codec, rate, pcm, frame_samples, num_frames);
+    BenchResult e = run_timed(enc, num_frames, seconds);
+    Decoder dec(codec, h_codec, rate, enc);
+    BenchResult d = run_timed(dec, num_frames, seconds);
+
+    int bytes = 0;
+    for (unsigned int i = 0; i < num_frames && bytes <= 0; i++)
+      bytes = enc.sizes[i];
+
+    double frame_ms = 1000.0 * frame_samples / rate;
+    double enc_us = e.us / e.frames;
+    double dec_us = d.us / d.frames;
+    printf("%-12s %6u %6.1f %6d %10.3f %10.3f %12.0f %12.0f %9.0f\n",
+	   p->name, rate, frame_ms, bytes, enc_us, dec_us,
+	   1e6 / enc_us, 1e6 / dec_us,
+	   frame_ms * 1000.0 / (enc_us + dec_us));
+  }
+
+  if (codec->destroy)
+    codec->destroy(h_codec);
+}
+
+static void usage(const char* prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-c corpus.raw [-r rate]] [-t seconds] plugin.so ...\n"
+	  "  -c  raw 16 bit mono PCM corpus (default: generated signal)\n"
+	  "  -r  sample rate of the corpus (default: 8000)\n"
+	  "  -t  seconds to run encoding and decoding per codec (default: 1)\n",
+	  prog);
+}
+
+int main(int argc, char** argv)
+{
+  const char* corpus_file = NULL;
+  unsigned int corpus_rate = 8000;
+  double seconds = 1.0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:r:t:h")) != -1) {
+    switch (opt) {
+    case 'c': corpus_file = optarg; break;
+    case 'r': corpus_rate = atoi(optarg); break;
+    case 't': seconds = atof(optarg); break;
+    default: usage(argv[0]); return 1;
+    }
+  }
+
+  if (optind >= argc || !corpus_rate || seconds <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  vector<short> corpus;
+  if (corpus_file) {
+    if (!load_corpus(corpus_file, corpus))
+      return 1;
+  } else {
+    corpus_rate = 48000;
+    generate_corpus(corpus, corpus_rate);
+  }
+
+  printf("%-12s %6s %6s %6s %10s %10s %12s %12s %9s\n",
+	 "payload", "rate", "ms", "bytes", "enc us/fr", "dec us/fr",
+	 "enc fr/s", "dec fr/s", "channels");
+
+  std::set<std::pair<int, int> > done;
+  for (int i = optind; i < argc; i++) {
+    void* h = dlopen(argv[i], RTLD_NOW);
+    if (!h) {
+      fprintf(stderr, "%s\n", dlerror());
+      continue;
+    }
+
+    amci_exports_t* exports = (amci_exports_t*)dlsym(h, "amci_exports");
+    if (!exports) {
+      fprintf(stderr, "%s: not a codec plug-in\n", argv[i]);
+      dlclose(h);
+      continue;
+    }
+
+    if (exports->module_load && exports->module_load() < 0) {
+      fprintf(stderr, "%s: module_load failed\n", argv[i]);
+      dlclose(h);
+      continue;
+    }
+
+    for (amci_payload_t* p = exports->payloads; p && p->name; p++) {
+      // same codec at same rate, e.g. payload aliases
+      if (!done.insert(std::make_pair(p->codec_id, p->sample_rate)).second)
+	continue;
+      bench_payload(exports, p, corpus, corpus_rate, seconds);
+    }
+
+    if (exports->module_destroy)
+      exports->module_destroy();
+    // keep the plug-in loaded: codecs may have registered atexit handlers
+  }
+
+  return 0;
+}